@@ -18,6 +18,8 @@
 #include <consensus/validation.h>
 #include <chainparams.h>
 #include <txmempool.h>
+#include <proofcache.h>
+#include <validationstats.h>
 
 
 bool VerifyMLSAG(const CTransaction &tx, CValidationState &state)
@@ -53,7 +55,9 @@ bool VerifyMLSAG(const CTransaction &tx, CValidationState &state)
         vpInputSplitCommits.reserve(tx.vin.size());
     }
 
-    for (const auto &txin : tx.vin) {
+    const uint256 &wtxid = tx.GetWitnessHash();
+    for (uint32_t n = 0; n < tx.vin.size(); ++n) {
+        const auto &txin = tx.vin[n];
         if (!txin.IsAnonInput()) {
             return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_MALFORMED, "bad-anon-input");
         }
@@ -178,11 +182,29 @@ bool VerifyMLSAG(const CTransaction &tx, CValidationState &state)
             &vpInCommits[0], &vpOutCommits[0], nullptr))) {
             return state.Invalid(ValidationInvalidReason::CONSENSUS, error("%s: prepare-mlsag-failed %d", __func__, rv), REJECT_INVALID, "prepare-mlsag-failed");
         }
-        if (0 != (rv = secp256k1_verify_mlsag(secp256k1_ctx_blind,
+
+        // The ring is read from the anon output index, vM commits to it and to the input commitment sums
+        uint256 cache_entry;
+        ComputeProofCacheEntry(cache_entry, wtxid, PROOF_MLSAG, n, vM.data(), vM.size());
+        if (ProofCacheContains(cache_entry, !state.m_cache_proofs)) {
+            if (!state.m_cache_proofs) {
+                IncrementValidationCounter(VCOUNT_MLSAG_CACHE_HITS);
+            }
+            continue;
+        }
+        int64_t nTimeVerify = GetTimeMicros();
+        rv = secp256k1_verify_mlsag(secp256k1_ctx_blind,
             txhash.begin(), nCols, nRows,
-            &vM[0], &vKeyImages[0], &vDL[0], &vDL[32]))) {
+            &vM[0], &vKeyImages[0], &vDL[0], &vDL[32]);
+        if (!state.m_cache_proofs) { // Not counted for the mempool and block templates
+            RecordValidationStat(VSTAT_MLSAG_VERIFY, GetTimeMicros() - nTimeVerify);
+        }
+        if (0 != rv) {
             return state.Invalid(ValidationInvalidReason::CONSENSUS, error("%s: verify-mlsag-failed %d", __func__, rv), REJECT_INVALID, "verify-mlsag-failed");
         }
+        if (state.m_cache_proofs) {
+            ProofCacheInsert(cache_entry);
+        }
     }
 
     // Verify commitment sums match
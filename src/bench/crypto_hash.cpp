@@ -8,6 +8,7 @@
 #include <hash.h>
 #include <random.h>
 #include <uint256.h>
+#include <crypto/hmac_sha512.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -67,6 +68,49 @@ static void SHA512(benchmark::State& state)
         CSHA512().Write(in.data(), in.size()).Finalize(hash);
 }
 
+static void SHA512_32b_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(32 * 1024, 0), out(64 * 1024);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < 1024; ++i) {
+            CSHA512().Write(in.data() + 32 * i, 32).Finalize(out.data() + 64 * i);
+        }
+    }
+}
+
+static void SHA512_32b_Batch_1024(benchmark::State& state)
+{
+    static const std::string algo = SHA512AutoDetect();
+    std::vector<uint8_t> in(32 * 1024, 0), out(64 * 1024);
+    while (state.KeepRunning()) {
+        CSHA512().FinalizeBatch(in.data(), 32, 1024, out.data());
+    }
+}
+
+/** HMAC-SHA512 of BIP32 child numbers after the chain code key and parent pubkey */
+static void HMAC_SHA512_BIP32_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(33 + 4 * 1024, 0), out(64 * 1024);
+    CHMAC_SHA512 parent(in.data(), 32);
+    parent.Write(in.data(), 33);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < 1024; ++i) {
+            CHMAC_SHA512(parent).Write(in.data() + 33 + 4 * i, 4).Finalize(out.data() + 64 * i);
+        }
+    }
+}
+
+static void HMAC_SHA512_BIP32_Batch_1024(benchmark::State& state)
+{
+    static const std::string algo = SHA512AutoDetect();
+    std::vector<uint8_t> in(33 + 4 * 1024, 0), out(64 * 1024);
+    CHMAC_SHA512 parent(in.data(), 32);
+    parent.Write(in.data(), 33);
+    while (state.KeepRunning()) {
+        parent.FinalizeBatch(in.data() + 33, 4, 1024, out.data());
+    }
+}
+
 static void SipHash_32b(benchmark::State& state)
 {
     uint256 x;
@@ -100,5 +144,9 @@ BENCHMARK(SHA512, 330);
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(SHA512_32b_1024, 1000);
+BENCHMARK(SHA512_32b_Batch_1024, 1000);
+BENCHMARK(HMAC_SHA512_BIP32_1024, 500);
+BENCHMARK(HMAC_SHA512_BIP32_Batch_1024, 500);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -5,6 +5,9 @@
 
 #include <chain.h>
 
+#include <algorithm>
+#include <map>
+
 /**
  * CChain implementation
  */
@@ -59,6 +62,98 @@ const CBlockIndex *CChain::FindFork(const CBlockIndex *pindex) const {
     return pindex;
 }
 
+std::atomic<int> CChainView::s_num_views{0};
+
+CChainView::CChainView(const CChain& chain, const CChainView* prev, std::shared_ptr<const CDBSnapshot> block_tree_snapshot)
+    : m_height(chain.Height()), m_block_tree_snapshot(std::move(block_tree_snapshot))
+{
+    s_num_views++;
+    int fork_height = -1;
+    if (prev) {
+        fork_height = std::min(prev->m_height, m_height);
+        while (fork_height >= 0 && (*prev)[fork_height] != chain[fork_height]) {
+            fork_height--;
+        }
+        // Full chunks below the fork are unchanged
+        size_t shared = (fork_height + 1) / CHUNK_SIZE;
+        m_chunks.assign(prev->m_chunks.begin(), prev->m_chunks.begin() + shared);
+        m_hash_index = prev->m_hash_index;
+    }
+
+    for (int chunk_start = m_chunks.size() * CHUNK_SIZE; chunk_start <= m_height; chunk_start += CHUNK_SIZE) {
+        std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+        int chunk_end = std::min(chunk_start + CHUNK_SIZE - 1, m_height);
+        chunk->reserve(chunk_end - chunk_start + 1);
+        for (int h = chunk_start; h <= chunk_end; ++h) {
+            chunk->push_back(chain[h]);
+        }
+        m_chunks.push_back(std::move(chunk));
+    }
+
+    // Blocks leaving and joining the chain, grouped by hash bucket
+    std::map<int, std::pair<std::vector<const CBlockIndex*>, std::vector<const CBlockIndex*>>> changes;
+    if (prev) {
+        for (int h = fork_height + 1; h <= prev->m_height; ++h) {
+            const CBlockIndex *pindex = (*prev)[h];
+            changes[HashBucketId(pindex->GetBlockHash())].first.push_back(pindex);
+        }
+    }
+    for (int h = fork_height + 1; h <= m_height; ++h) {
+        const CBlockIndex *pindex = chain[h];
+        changes[HashBucketId(pindex->GetBlockHash())].second.push_back(pindex);
+    }
+
+    auto by_hash = [](const CBlockIndex *a, const CBlockIndex *b) {
+        return a->GetBlockHash() < b->GetBlockHash();
+    };
+    std::map<int, std::shared_ptr<HashLevel>> levels;
+    for (const auto& change : changes) {
+        int top = change.first / HASH_FANOUT, sub = change.first % HASH_FANOUT;
+        std::shared_ptr<HashLevel>& level = levels[top];
+        if (!level) {
+            level = m_hash_index[top] ? std::make_shared<HashLevel>(*m_hash_index[top]) : std::make_shared<HashLevel>();
+        }
+
+        std::shared_ptr<HashBucket> bucket = (*level)[sub] ? std::make_shared<HashBucket>(*(*level)[sub]) : std::make_shared<HashBucket>();
+        for (const CBlockIndex *pindex : change.second.first) {
+            auto it = std::lower_bound(bucket->begin(), bucket->end(), pindex, by_hash);
+            if (it != bucket->end() && *it == pindex) {
+                bucket->erase(it);
+            }
+        }
+        const auto& added = change.second.second;
+        if (added.size() > 16) {
+            bucket->insert(bucket->end(), added.begin(), added.end());
+            std::sort(bucket->begin(), bucket->end(), by_hash);
+        } else {
+            for (const CBlockIndex *pindex : added) {
+                bucket->insert(std::lower_bound(bucket->begin(), bucket->end(), pindex, by_hash), pindex);
+            }
+        }
+        (*level)[sub] = std::move(bucket);
+    }
+    for (auto& level : levels) {
+        m_hash_index[level.first] = std::move(level.second);
+    }
+}
+
+const CBlockIndex *CChainView::Find(const uint256& hash) const
+{
+    int bucket_id = HashBucketId(hash);
+    const std::shared_ptr<const HashLevel>& level = m_hash_index[bucket_id / HASH_FANOUT];
+    if (!level || !(*level)[bucket_id % HASH_FANOUT]) {
+        return nullptr;
+    }
+    const HashBucket& bucket = *(*level)[bucket_id % HASH_FANOUT];
+    auto it = std::lower_bound(bucket.begin(), bucket.end(), hash, [](const CBlockIndex *pindex, const uint256& h) {
+        return pindex->GetBlockHash() < h;
+    });
+    if (it != bucket.end() && (*it)->GetBlockHash() == hash) {
+        return *it;
+    }
+    return nullptr;
+}
+
 CBlockIndex* CChain::FindEarliestAtLeast(int64_t nTime, int height) const
 {
     std::pair<int64_t, int> blockparams = std::make_pair(nTime, height);
@@ -13,8 +13,13 @@
 #include <tinyformat.h>
 #include <uint256.h>
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <vector>
 
+class CDBSnapshot;
+
 enum eBlockFlags
 {
     BLOCK_PROOF_OF_STAKE            = (1 << 0),
@@ -208,6 +213,9 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax;
 
+    //! (memory only) The block data written to disk passed CheckBlock, only the merkle roots and block signature are checked again when it's connected.
+    bool fBlockChecked;
+
     void SetNull()
     {
         phashBlock = nullptr;
@@ -223,6 +231,7 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        fBlockChecked = false;
 
         nFlags = 0;
         bnStakeModifier = uint256();
@@ -532,4 +541,82 @@ public:
     CBlockIndex* FindEarliestAtLeast(int64_t nTime, int height) const;
 };
 
+/**
+ * An immutable copy of the active chain that can be read without cs_main.
+ *
+ * Heights are kept in fixed size chunks and hashes in a two level bucket index,
+ * both are shared between successive views so publishing a view after a tip
+ * change only copies the parts touched by the blocks from the fork point.
+ * Only the fields of CBlockIndex that don't change once the block is connected
+ * (hash, height, header, pprev, nChainWork) may be read through a view, nStatus
+ * and the block file positions may not.
+ *
+ * A view points into the block index and the block tree database, every view
+ * must be released before either is unloaded, see ResetChainView.
+ */
+class CChainView {
+private:
+    static constexpr int CHUNK_SIZE = 1024;
+    static constexpr int HASH_FANOUT = 32;
+
+    typedef std::vector<const CBlockIndex*> Chunk;
+    //! Blocks in a hash bucket, ordered by hash
+    typedef std::vector<const CBlockIndex*> HashBucket;
+    typedef std::array<std::shared_ptr<const HashBucket>, HASH_FANOUT> HashLevel;
+
+    std::vector<std::shared_ptr<const Chunk>> m_chunks;
+    std::array<std::shared_ptr<const HashLevel>, HASH_FANOUT> m_hash_index;
+    int m_height = -1;
+    std::shared_ptr<const CDBSnapshot> m_block_tree_snapshot;
+
+    static std::atomic<int> s_num_views;
+
+    static int HashBucketId(const uint256& hash) {
+        return hash.GetUint64(0) % (HASH_FANOUT * HASH_FANOUT);
+    }
+
+public:
+    /** Copy chain, sharing the parts below the fork point with prev */
+    CChainView(const CChain& chain, const CChainView* prev, std::shared_ptr<const CDBSnapshot> block_tree_snapshot);
+    CChainView(const CChainView&) = delete;
+    CChainView& operator=(const CChainView&) = delete;
+    ~CChainView() { s_num_views--; }
+
+    /** Number of views alive */
+    static int NumViews() { return s_num_views; }
+
+    const CBlockIndex *Tip() const {
+        return (*this)[m_height];
+    }
+
+    const CBlockIndex *operator[](int nHeight) const {
+        if (nHeight < 0 || nHeight > m_height)
+            return nullptr;
+        return (*m_chunks[nHeight / CHUNK_SIZE])[nHeight % CHUNK_SIZE];
+    }
+
+    bool Contains(const CBlockIndex *pindex) const {
+        return (*this)[pindex->nHeight] == pindex;
+    }
+
+    const CBlockIndex *Next(const CBlockIndex *pindex) const {
+        if (Contains(pindex))
+            return (*this)[pindex->nHeight + 1];
+        else
+            return nullptr;
+    }
+
+    int Height() const {
+        return m_height;
+    }
+
+    /** Find a block in the view by hash, nullptr if it's not in the chain */
+    const CBlockIndex *Find(const uint256& hash) const;
+
+    /** Read snapshot of the block tree db taken when the view was published, may be null */
+    const CDBSnapshot *BlockTreeSnapshot() const {
+        return m_block_tree_snapshot.get();
+    }
+};
+
 #endif // BITCOIN_CHAIN_H
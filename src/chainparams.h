@@ -135,6 +135,8 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    /** Expected snapshot hashes by height, a snapshot must match the hash of its height. Outside regtest snapshots of unlisted heights are refused */
+    const MapCheckpoints& SnapshotHashes() const { return m_snapshot_hashes; }
 
     bool IsBech32Prefix(const std::vector<unsigned char> &vchPrefixIn) const;
     bool IsBech32Prefix(const std::vector<unsigned char> &vchPrefixIn, CChainParams::Base58Type &rtype) const;
@@ -193,6 +195,7 @@ protected:
     bool m_is_test_chain;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapCheckpoints m_snapshot_hashes;
 };
 
 /**
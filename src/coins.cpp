@@ -16,6 +16,16 @@ std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
 
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsView::PartitionedCursors(size_t n_partitions) const
+{
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    std::unique_ptr<CCoinsViewCursor> cursor(Cursor());
+    if (cursor) {
+        cursors.push_back(std::move(cursor));
+    }
+    return cursors;
+}
+
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
 {
     Coin coin;
@@ -30,6 +40,7 @@ std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetH
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewBacked::PartitionedCursors(size_t n_partitions) const { return base->PartitionedCursors(n_partitions); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -110,7 +121,7 @@ void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, bool
                 CTxOut txout(nV, *out->GetPScriptPubKey());
                 coin = Coin(txout, nHeight, fCoinbase);
                 coin.nType = OUTPUT_CT;
-                coin.commitment = ((CTxOutCT*)out)->commitment;
+                coin.SetCommitment(((CTxOutCT*)out)->commitment);
             } else
             {
                 continue; // Data or anon
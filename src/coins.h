@@ -18,7 +18,9 @@
 #include <stdint.h>
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 #include <insight/addressindex.h>
 #include <insight/spentindex.h>
 #include <rctindex.h>
@@ -45,12 +47,63 @@ public:
     uint32_t nHeight : 31;
 
     uint8_t nType = OUTPUT_STANDARD;
-    secp256k1_pedersen_commitment commitment;
 
+private:
+    //! commitment of an OUTPUT_CT coin, allocated out of line so plain coins don't carry it
+    std::unique_ptr<secp256k1_pedersen_commitment> m_commitment;
+
+public:
     //! construct a Coin from a CTxOut and height/coinbase information.
     Coin(CTxOut&& outIn, int nHeightIn, bool fCoinBaseIn) : out(std::move(outIn)), fCoinBase(fCoinBaseIn), nHeight(nHeightIn) {}
     Coin(const CTxOut& outIn, int nHeightIn, bool fCoinBaseIn) : out(outIn), fCoinBase(fCoinBaseIn),nHeight(nHeightIn) {}
 
+    Coin(const Coin &other) : out(other.out), fCoinBase(other.fCoinBase), nHeight(other.nHeight), nType(other.nType)
+    {
+        if (other.m_commitment) {
+            m_commitment.reset(new secp256k1_pedersen_commitment(*other.m_commitment));
+        }
+    }
+    Coin(Coin &&other) = default;
+    Coin &operator=(const Coin &other)
+    {
+        if (this != &other) {
+            out = other.out;
+            fCoinBase = other.fCoinBase;
+            nHeight = other.nHeight;
+            nType = other.nType;
+            if (other.m_commitment) {
+                SetCommitment(*other.m_commitment);
+            } else {
+                m_commitment.reset();
+            }
+        }
+        return *this;
+    }
+    Coin &operator=(Coin &&other) = default;
+
+    //! commitment of an OUTPUT_CT coin, all zero if not set
+    const secp256k1_pedersen_commitment &GetCommitment() const
+    {
+        static const secp256k1_pedersen_commitment null_commitment = {{0}};
+        return m_commitment ? *m_commitment : null_commitment;
+    }
+
+    void SetCommitment(const secp256k1_pedersen_commitment &commitment)
+    {
+        if (!m_commitment) {
+            m_commitment.reset(new secp256k1_pedersen_commitment(commitment));
+            return;
+        }
+        *m_commitment = commitment;
+    }
+
+    void SetCommitment(const uint8_t *p)
+    {
+        secp256k1_pedersen_commitment commitment;
+        memcpy(commitment.data, p, 33);
+        SetCommitment(commitment);
+    }
+
     bool Matches(CTxOutBase *txo) const
     {
         if (!txo->IsType(nType)) {
@@ -64,7 +117,7 @@ public:
             return false;
         }
         if (nType == OUTPUT_CT
-            && memcmp(commitment.data, ((CTxOutCT*)txo)->commitment.data, 33) != 0) {
+            && memcmp(GetCommitment().data, ((CTxOutCT*)txo)->commitment.data, 33) != 0) {
             return false;
         }
         return true;
@@ -74,6 +127,7 @@ public:
         out.SetNull();
         fCoinBase = false;
         nHeight = 0;
+        m_commitment.reset();
     }
 
     //! empty constructor
@@ -93,7 +147,7 @@ public:
         if (!fParticlMode) return;
         ::Serialize(s, nType);
         if (nType == OUTPUT_CT)
-            s.write((char*)&commitment.data[0], 33);
+            s.write((char*)&GetCommitment().data[0], 33);
     }
 
     template<typename Stream>
@@ -105,8 +159,13 @@ public:
         ::Unserialize(s, CTxOutCompressor(out));
         if (!fParticlMode) return;
         ::Unserialize(s, nType);
-        if (nType == OUTPUT_CT)
-            s.read((char*)&commitment.data[0], 33);
+        if (nType == OUTPUT_CT) {
+            uint8_t data[33];
+            s.read((char*)data, 33);
+            SetCommitment(data);
+        } else {
+            m_commitment.reset();
+        }
     }
 
     bool IsSpent() const {
@@ -114,7 +173,7 @@ public:
     }
 
     size_t DynamicMemoryUsage() const {
-        return memusage::DynamicUsage(out.scriptPubKey);
+        return memusage::DynamicUsage(out.scriptPubKey) + memusage::DynamicUsage(m_commitment);
     }
 };
 
@@ -215,6 +274,12 @@ public:
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
 
+    //! Get up to n_partitions cursors over disjoint, ordered ranges of the state that
+    //! together cover all of it. Every cursor reads the same consistent state and all
+    //! outputs of a transaction are in the same range. Views that can't be split
+    //! return a single Cursor().
+    virtual std::vector<std::unique_ptr<CCoinsViewCursor>> PartitionedCursors(size_t n_partitions) const;
+
     //! As we use CCoinsViews polymorphically, have a virtual destructor
     virtual ~CCoinsView() {}
 
@@ -238,6 +303,7 @@ public:
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    std::vector<std::unique_ptr<CCoinsViewCursor>> PartitionedCursors(size_t n_partitions) const override;
     size_t EstimateSize() const override;
 };
 
@@ -12,6 +12,8 @@
 #include <chainparams.h>
 
 #include <blind.h>
+#include <proofcache.h>
+#include <validationstats.h>
 #include <timedata.h>
 #include <util/system.h>
 
@@ -218,30 +220,32 @@ bool CheckStandardOutput(CValidationState &state, const Consensus::Params& conse
     return true;
 }
 
-bool CheckBlindOutput(CValidationState &state, const CTxOutCT *p)
+static bool VerifyRangeProof(CValidationState &state, const secp256k1_pedersen_commitment *commitment, const std::vector<uint8_t> &vRangeproof,
+    const uint256 *wtxid, uint32_t n)
 {
-    if (p->vData.size() < 33 || p->vData.size() > 33 + 5 + 33) {
-        return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-ctout-ephem-size");
-    }
-    size_t nRangeProofLen = 5134;
-    if (p->vRangeproof.size() < 500 || p->vRangeproof.size() > nRangeProofLen) {
-        return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-ctout-rangeproof-size");
-    }
-
-    if ((fBusyImporting) && fSkipRangeproof) {
-        return true;
+    uint256 cache_entry;
+    if (wtxid) {
+        ComputeProofCacheEntry(cache_entry, *wtxid, state.fBulletproofsActive ? PROOF_BULLETPROOF : PROOF_RANGEPROOF, n);
+        if (ProofCacheContains(cache_entry, !state.m_cache_proofs)) {
+            if (!state.m_cache_proofs) {
+                IncrementValidationCounter(VCOUNT_RANGEPROOF_CACHE_HITS);
+            }
+            return true;
+        }
     }
 
+    // m_cache_proofs is set for the mempool and block templates, only blocks are counted
+    ValidationStatsTimer verify_timer(VSTAT_RANGEPROOF_VERIFY, !state.m_cache_proofs);
     uint64_t min_value = 0, max_value = 0;
     int rv = 0;
 
     if (state.fBulletproofsActive) {
         rv = secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind,
-            blind_scratch, blind_gens, p->vRangeproof.data(), p->vRangeproof.size(),
-            nullptr, &p->commitment, 1, 64, &secp256k1_generator_const_h, nullptr, 0);
+            blind_scratch, blind_gens, vRangeproof.data(), vRangeproof.size(),
+            nullptr, commitment, 1, 64, &secp256k1_generator_const_h, nullptr, 0);
     } else {
         rv = secp256k1_rangeproof_verify(secp256k1_ctx_blind, &min_value, &max_value,
-            &p->commitment, p->vRangeproof.data(), p->vRangeproof.size(),
+            commitment, vRangeproof.data(), vRangeproof.size(),
             nullptr, 0,
             secp256k1_generator_h);
     }
@@ -252,13 +256,36 @@ bool CheckBlindOutput(CValidationState &state, const CTxOutCT *p)
     }
 
     if (rv != 1) {
+        return false;
+    }
+    if (wtxid && state.m_cache_proofs) {
+        ProofCacheInsert(cache_entry);
+    }
+    return true;
+}
+
+bool CheckBlindOutput(CValidationState &state, const CTxOutCT *p, const uint256 *wtxid, uint32_t n)
+{
+    if (p->vData.size() < 33 || p->vData.size() > 33 + 5 + 33) {
+        return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-ctout-ephem-size");
+    }
+    size_t nRangeProofLen = 5134;
+    if (p->vRangeproof.size() < 500 || p->vRangeproof.size() > nRangeProofLen) {
+        return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-ctout-rangeproof-size");
+    }
+
+    if ((fBusyImporting) && fSkipRangeproof) {
+        return true;
+    }
+
+    if (!VerifyRangeProof(state, &p->commitment, p->vRangeproof, wtxid, n)) {
         return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-ctout-rangeproof-verify");
     }
 
     return true;
 }
 
-bool CheckAnonOutput(CValidationState &state, const CTxOutRingCT *p)
+bool CheckAnonOutput(CValidationState &state, const CTxOutRingCT *p, const uint256 *wtxid, uint32_t n)
 {
     if (!state.rct_active) {
         return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "rctout-before-active");
@@ -276,26 +303,7 @@ bool CheckAnonOutput(CValidationState &state, const CTxOutRingCT *p)
         return true;
     }
 
-    uint64_t min_value = 0, max_value = 0;
-    int rv = 0;
-
-    if (state.fBulletproofsActive) {
-        rv = secp256k1_bulletproof_rangeproof_verify(secp256k1_ctx_blind,
-            blind_scratch, blind_gens, p->vRangeproof.data(), p->vRangeproof.size(),
-            nullptr, &p->commitment, 1, 64, &secp256k1_generator_const_h, nullptr, 0);
-    } else {
-        rv = secp256k1_rangeproof_verify(secp256k1_ctx_blind, &min_value, &max_value,
-            &p->commitment, p->vRangeproof.data(), p->vRangeproof.size(),
-            nullptr, 0,
-            secp256k1_generator_h);
-    }
-
-    if (LogAcceptCategory(BCLog::RINGCT)) {
-        LogPrintf("%s: rv, min_value, max_value %d, %s, %s\n", __func__,
-            rv, FormatMoney((CAmount)min_value), FormatMoney((CAmount)max_value));
-    }
-
-    if (rv != 1) {
+    if (!VerifyRangeProof(state, &p->commitment, p->vRangeproof, wtxid, n)) {
         return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-rctout-rangeproof-verify");
     }
 
@@ -337,7 +345,9 @@ bool CheckTransaction(const CTransaction& tx, CValidationState &state, bool fChe
 
         size_t nStandardOutputs = 0, nDataOutputs = 0, nBlindOutputs = 0, nAnonOutputs = 0;
         CAmount nValueOut = 0;
-        for (const auto &txout : tx.vpout) {
+        const uint256 &wtxid = tx.GetWitnessHash();
+        for (uint32_t n = 0; n < tx.vpout.size(); ++n) {
+            const auto &txout = tx.vpout[n];
             switch (txout->nVersion) {
                 case OUTPUT_STANDARD:
                     if (!CheckStandardOutput(state, consensusParams, (CTxOutStandard*) txout.get(), nValueOut)) {
@@ -346,13 +356,13 @@ bool CheckTransaction(const CTransaction& tx, CValidationState &state, bool fChe
                     nStandardOutputs++;
                     break;
                 case OUTPUT_CT:
-                    if (!CheckBlindOutput(state, (CTxOutCT*) txout.get())) {
+                    if (!CheckBlindOutput(state, (CTxOutCT*) txout.get(), &wtxid, n)) {
                         return false;
                     }
                     nBlindOutputs++;
                     break;
                 case OUTPUT_RINGCT:
-                    if (!CheckAnonOutput(state, (CTxOutRingCT*) txout.get())) {
+                    if (!CheckAnonOutput(state, (CTxOutRingCT*) txout.get(), &wtxid, n)) {
                         return false;
                     }
                     nAnonOutputs++;
@@ -491,7 +501,7 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, c
                 nStandard++;
             } else
             if (coin.nType == OUTPUT_CT) {
-                vpCommitsIn.push_back(&coin.commitment);
+                vpCommitsIn.push_back(&coin.GetCommitment());
                 nCt++;
             } else {
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-txns-input-type");
@@ -165,6 +165,7 @@ public:
     bool fHasAnonOutput = false; // per tx
     bool fHasAnonInput = false; // per tx
     bool fIncDataOutputs = false; // per block
+    bool m_cache_proofs = false; // per tx, store verified proofs in the proof cache, else matched entries are erased
     int m_spend_height = 0;
 
     void SetStateInfo(int64_t time, int spend_height, const Consensus::Params& consensusParams)
@@ -5,6 +5,7 @@
 #include <crypto/hmac_sha512.h>
 
 #include <string.h>
+#include <vector>
 
 CHMAC_SHA512::CHMAC_SHA512(const unsigned char* key, size_t keylen)
 {
@@ -32,3 +33,10 @@ void CHMAC_SHA512::Finalize(unsigned char hash[OUTPUT_SIZE])
     inner.Finalize(temp);
     outer.Write(temp, 64).Finalize(hash);
 }
+
+void CHMAC_SHA512::FinalizeBatch(const unsigned char* data, size_t len, size_t count, unsigned char* hashes) const
+{
+    std::vector<unsigned char> temp(count * OUTPUT_SIZE);
+    inner.FinalizeBatch(data, len, count, temp.data());
+    outer.FinalizeBatch(temp.data(), OUTPUT_SIZE, count, hashes);
+}
@@ -27,6 +27,10 @@ public:
         return *this;
     }
     void Finalize(unsigned char hash[OUTPUT_SIZE]);
+
+    /** HMAC of count messages of len bytes each, stored back to back at data, each
+     *  appended to the data written so far. hashes receives count * OUTPUT_SIZE bytes. */
+    void FinalizeBatch(const unsigned char* data, size_t len, size_t count, unsigned char* hashes) const;
 };
 
 #endif // BITCOIN_CRYPTO_HMAC_SHA512_H
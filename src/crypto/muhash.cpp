@@ -0,0 +1,278 @@
+// Copyright (c) 2017-2019 The Bitcoin Core developers
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <assert.h>
+#include <limits>
+
+namespace {
+
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+constexpr int LIMB_SIZE = Num3072::LIMB_SIZE;
+constexpr int LIMBS = Num3072::LIMBS;
+/** 2^3072 - 1103717 is the largest 3072-bit safe prime number and is used in MuHash3072 */
+constexpr limb_t MAX_PRIME_DIFF = 1103717;
+/** Number of low bits of the inversion exponent that are not all set */
+constexpr int INV_LOW_BITS = 21;
+
+/** Add carry * 2^3072 to a, which is congruent to adding carry * MAX_PRIME_DIFF. */
+inline void FoldCarry(limb_t *a, limb_t carry)
+{
+    while (carry != 0) {
+        double_limb_t t = (double_limb_t)a[0] + (double_limb_t)carry * MAX_PRIME_DIFF;
+        a[0] = (limb_t)t;
+        carry = (limb_t)(t >> LIMB_SIZE);
+        for (int i = 1; i < LIMBS && carry != 0; ++i) {
+            t = (double_limb_t)a[i] + carry;
+            a[i] = (limb_t)t;
+            carry = (limb_t)(t >> LIMB_SIZE);
+        }
+    }
+}
+
+/** Reduce a 6144 bit product in tmp into out, using 2^3072 = MAX_PRIME_DIFF (mod p). */
+inline void ReduceProduct(limb_t *out, const limb_t *tmp)
+{
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t t = (double_limb_t)tmp[i + LIMBS] * MAX_PRIME_DIFF + tmp[i] + carry;
+        out[i] = (limb_t)t;
+        carry = (limb_t)(t >> LIMB_SIZE);
+    }
+    FoldCarry(out, carry);
+}
+
+/** Square a n times. */
+inline void SquareN(Num3072 &a, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        a.Square();
+    }
+}
+
+} // namespace
+
+bool Num3072::IsOverflow() const
+{
+    if (this->limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (this->limbs[i] != std::numeric_limits<limb_t>::max()) return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtracting the prime is adding MAX_PRIME_DIFF and dropping the 2^3072 carry
+    limb_t carry = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t t = (double_limb_t)this->limbs[i] + carry;
+        this->limbs[i] = (limb_t)t;
+        carry = (limb_t)(t >> LIMB_SIZE);
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t tmp[2 * LIMBS] = {0};
+
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)this->limbs[i] * a.limbs[j] + tmp[i + j] + carry;
+            tmp[i + j] = (limb_t)t;
+            carry = (limb_t)(t >> LIMB_SIZE);
+        }
+        tmp[i + LIMBS] = carry;
+    }
+
+    ReduceProduct(this->limbs, tmp);
+    if (this->IsOverflow()) this->FullReduce();
+}
+
+void Num3072::Square()
+{
+    limb_t tmp[2 * LIMBS] = {0};
+
+    // Cross products a[i] * a[j] for i < j, counted once
+    for (int i = 0; i < LIMBS - 1; ++i) {
+        limb_t carry = 0;
+        for (int j = i + 1; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)this->limbs[i] * this->limbs[j] + tmp[i + j] + carry;
+            tmp[i + j] = (limb_t)t;
+            carry = (limb_t)(t >> LIMB_SIZE);
+        }
+        tmp[i + LIMBS] = carry;
+    }
+
+    // Double the cross products, the square is below 2^6144 so the top bit can't be lost
+    for (int i = 2 * LIMBS - 1; i > 0; --i) {
+        tmp[i] = (tmp[i] << 1) | (tmp[i - 1] >> (LIMB_SIZE - 1));
+    }
+    tmp[0] <<= 1;
+
+    // Add the diagonal terms a[i]^2
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t t = (double_limb_t)this->limbs[i] * this->limbs[i] + tmp[2 * i] + carry;
+        tmp[2 * i] = (limb_t)t;
+        t = (double_limb_t)tmp[2 * i + 1] + (limb_t)(t >> LIMB_SIZE);
+        tmp[2 * i + 1] = (limb_t)t;
+        carry = (limb_t)(t >> LIMB_SIZE);
+    }
+
+    ReduceProduct(this->limbs, tmp);
+    if (this->IsOverflow()) this->FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat's little theorem: x^-1 = x^(p - 2) with p - 2 = 2^3072 - 1103719.
+    // The exponent is (2^(3072 - 21) - 1) * 2^21 + (2^21 - 1103719), the all ones
+    // high part is computed with an addition chain over the bits of its length.
+    const int ones_len = LIMBS * LIMB_SIZE - INV_LOW_BITS;
+    const uint32_t low_exp = (1u << INV_LOW_BITS) - (MAX_PRIME_DIFF + 2);
+
+    int top_bit = 0;
+    while ((ones_len >> (top_bit + 1)) != 0) {
+        ++top_bit;
+    }
+
+    // r = x^(2^len - 1)
+    Num3072 r = *this;
+    int len = 1;
+    for (int b = top_bit - 1; b >= 0; --b) {
+        Num3072 t = r;
+        SquareN(t, len);
+        t.Multiply(r);
+        r = t;
+        len *= 2;
+        if ((ones_len >> b) & 1) {
+            r.Square();
+            r.Multiply(*this);
+            len += 1;
+        }
+    }
+    assert(len == ones_len);
+
+    SquareN(r, INV_LOW_BITS);
+
+    Num3072 low;
+    for (int b = INV_LOW_BITS - 1; b >= 0; --b) {
+        low.Square();
+        if ((low_exp >> b) & 1) {
+            low.Multiply(*this);
+        }
+    }
+    r.Multiply(low);
+    return r;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    if (this->IsOverflow()) this->FullReduce();
+
+    Num3072 inv;
+    if (a.IsOverflow()) {
+        Num3072 b = a;
+        b.FullReduce();
+        inv = b.GetInverse();
+    } else {
+        inv = a.GetInverse();
+    }
+
+    this->Multiply(inv);
+    if (this->IsOverflow()) this->FullReduce();
+}
+
+void Num3072::SetToOne()
+{
+    this->limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        this->limbs[i] = 0;
+    }
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            this->limbs[i] = ReadLE32(data + 4 * i);
+        } else if (sizeof(limb_t) == 8) {
+            this->limbs[i] = ReadLE64(data + 8 * i);
+        }
+    }
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            WriteLE32(out + i * 4, this->limbs[i]);
+        } else if (sizeof(limb_t) == 8) {
+            WriteLE64(out + i * 8, this->limbs[i]);
+        }
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(Span<const unsigned char> in)
+{
+    unsigned char tmp[Num3072::BYTE_SIZE];
+
+    uint256 hashed_in;
+    CSHA256().Write(in.data(), in.size()).Finalize(hashed_in.begin());
+    ChaCha20(hashed_in.begin(), hashed_in.size()).Keystream(tmp, Num3072::BYTE_SIZE);
+    Num3072 out{tmp};
+
+    return out;
+}
+
+MuHash3072::MuHash3072(Span<const unsigned char> in) noexcept
+{
+    m_numerator = ToNum3072(in);
+}
+
+void MuHash3072::Finalize(uint256& out) noexcept
+{
+    m_numerator.Divide(m_denominator);
+    m_denominator.SetToOne();  // Needed to keep the MuHash object valid
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    m_numerator.ToBytes(data);
+
+    CSHA256().Write(data, Num3072::BYTE_SIZE).Finalize(out.begin());
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul) noexcept
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div) noexcept
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::Insert(Span<const unsigned char> in) noexcept
+{
+    m_numerator.Multiply(ToNum3072(in));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(Span<const unsigned char> in) noexcept
+{
+    m_denominator.Multiply(ToNum3072(in));
+    return *this;
+}
@@ -6,7 +6,26 @@
 
 #include <crypto/common.h>
 
+#include <assert.h>
 #include <string.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(USE_ASM)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace sha512_avx2
+{
+void Transform_4way(uint64_t* s, const unsigned char* chunks);
+}
+
+namespace sha512_avx512
+{
+void Transform_8way(uint64_t* s, const unsigned char* chunks);
+}
 
 // Internal implementation code.
 namespace
@@ -146,8 +165,98 @@ void Transform(uint64_t* s, const unsigned char* chunk)
 
 } // namespace sha512
 
+typedef void (*TransformMultiType)(uint64_t*, const unsigned char*);
+
+TransformMultiType Transform_4way = nullptr;
+TransformMultiType Transform_8way = nullptr;
+
+bool SelfTest()
+{
+    // Hash 9 messages of 200 bytes in one batch, which crosses a block and uses every transform
+    unsigned char data[9 * 200];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = (unsigned char)(i * 7 + 3);
+    }
+    unsigned char batch[9 * 64], single[64];
+    CSHA512 prefix;
+    prefix.Write(data, 50);
+    prefix.FinalizeBatch(data, 200, 9, batch);
+    for (int i = 0; i < 9; ++i) {
+        CSHA512(prefix).Write(data + 200 * i, 200).Finalize(single);
+        if (memcmp(single, batch + 64 * i, 64) != 0) return false;
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Return the register state enabled by the OS, XCR0. */
+uint32_t XCR0()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return a;
+}
+#endif
 } // namespace
 
+std::string SHA512AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_avx2 = false;
+    bool have_avx512 = false;
+    bool enabled_avx = false;
+    bool enabled_avx512 = false;
+
+    (void)have_avx2;
+    (void)have_avx512;
+    (void)enabled_avx;
+    (void)enabled_avx512;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    bool have_xsave = (ecx >> 27) & 1;
+    bool have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        uint32_t xcr0 = XCR0();
+        enabled_avx = (xcr0 & 0x06) == 0x06;
+        enabled_avx512 = (xcr0 & 0xe6) == 0xe6; // Also the opmask and upper ZMM registers
+        cpuid(0, 0, eax, ebx, ecx, edx);
+        if (eax >= 7) {
+            cpuid(7, 0, eax, ebx, ecx, edx);
+            have_avx2 = (ebx >> 5) & 1;
+            have_avx512 = (ebx >> 16) & 1;
+        }
+    }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && enabled_avx) {
+        Transform_4way = sha512_avx2::Transform_4way;
+        ret = "avx2(4way)";
+    }
+#endif
+#if defined(ENABLE_AVX512) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx512 && enabled_avx512) {
+        Transform_8way = sha512_avx512::Transform_8way;
+        ret = ret == "standard" ? "avx512(8way)" : ret + ",avx512(8way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
 
 ////// SHA-512
 
@@ -205,3 +314,64 @@ CSHA512& CSHA512::Reset()
     sha512::Initialize(s);
     return *this;
 }
+
+void CSHA512::FinalizeBatch(const unsigned char* data, size_t len, size_t count, unsigned char* hashes) const
+{
+    // Every message is the same length, so all of them end after the same number of
+    // blocks and can be padded up front and transformed side by side.
+    size_t bufsize = bytes % 128;
+    size_t tail = bufsize + len;
+    size_t blocks = (tail + 17 + 127) / 128;
+    std::vector<unsigned char> chunks;
+    uint64_t states[8 * 8];
+
+    size_t i = 0;
+    while (i < count) {
+        size_t lanes = 1;
+        TransformMultiType transform = nullptr;
+        if (Transform_8way && count - i >= 8) {
+            lanes = 8;
+            transform = Transform_8way;
+        } else
+        if (Transform_4way && count - i >= 4) {
+            lanes = 4;
+            transform = Transform_4way;
+        }
+        if (!transform) {
+            CSHA512(*this).Write(data + i * len, len).Finalize(hashes + i * OUTPUT_SIZE);
+            i++;
+            continue;
+        }
+
+        // Chunk b of lane l is at (b * lanes + l) * 128
+        chunks.assign(blocks * lanes * 128, 0);
+        for (size_t l = 0; l < lanes; ++l) {
+            unsigned char msg[256];
+            std::vector<unsigned char> long_msg;
+            unsigned char* p = msg;
+            if (blocks * 128 > sizeof(msg)) {
+                long_msg.assign(blocks * 128, 0);
+                p = long_msg.data();
+            } else {
+                memset(msg, 0, sizeof(msg));
+            }
+            memcpy(p, buf, bufsize);
+            memcpy(p + bufsize, data + (i + l) * len, len);
+            p[tail] = 0x80;
+            WriteBE64(p + blocks * 128 - 8, (bytes + len) << 3);
+            for (size_t b = 0; b < blocks; ++b) {
+                memcpy(chunks.data() + (b * lanes + l) * 128, p + b * 128, 128);
+            }
+            memcpy(states + 8 * l, s, sizeof(s));
+        }
+        for (size_t b = 0; b < blocks; ++b) {
+            transform(states, chunks.data() + b * lanes * 128);
+        }
+        for (size_t l = 0; l < lanes; ++l) {
+            for (int k = 0; k < 8; ++k) {
+                WriteBE64(hashes + (i + l) * OUTPUT_SIZE + 8 * k, states[8 * l + k]);
+            }
+        }
+        i += lanes;
+    }
+}
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-512. */
 class CSHA512
@@ -23,6 +24,17 @@ public:
     CSHA512& Write(const unsigned char* data, size_t len);
     void Finalize(unsigned char hash[OUTPUT_SIZE]);
     CSHA512& Reset();
+
+    /** Hash count messages of len bytes each, stored back to back at data, as if each
+     *  was written to a copy of this hasher which was then finalized. hashes receives
+     *  count * OUTPUT_SIZE bytes. Groups of messages run through the multi-buffer
+     *  transforms selected by SHA512AutoDetect. */
+    void FinalizeBatch(const unsigned char* data, size_t len, size_t count, unsigned char* hashes) const;
 };
 
+/** Autodetect the best available multi-buffer SHA512 implementation.
+ *  Returns the name of the implementation.
+ */
+std::string SHA512AutoDetect();
+
 #endif // BITCOIN_CRYPTO_SHA512_H
@@ -0,0 +1,128 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace sha512_avx2 {
+namespace {
+
+static const uint64_t K[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull,
+};
+
+__m256i inline K4(uint64_t x) { return _mm256_set1_epi64x(x); }
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z) { return Add(Add(x, y), z); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z, __m256i w) { return Add(Add(x, y), Add(z, w)); }
+__m256i inline Add(__m256i x, __m256i y, __m256i z, __m256i w, __m256i v) { return Add(Add(x, y, z), Add(w, v)); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Xor(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+__m256i inline ShR(__m256i x, int n) { return _mm256_srli_epi64(x, n); }
+__m256i inline ShL(__m256i x, int n) { return _mm256_slli_epi64(x, n); }
+__m256i inline RotR(__m256i x, int n) { return Or(ShR(x, n), ShL(x, 64 - n)); }
+
+__m256i inline Ch(__m256i x, __m256i y, __m256i z) { return Xor(z, And(x, Xor(y, z))); }
+__m256i inline Maj(__m256i x, __m256i y, __m256i z) { return Or(And(x, y), And(z, Or(x, y))); }
+__m256i inline Sigma0(__m256i x) { return Xor(RotR(x, 28), RotR(x, 34), RotR(x, 39)); }
+__m256i inline Sigma1(__m256i x) { return Xor(RotR(x, 14), RotR(x, 18), RotR(x, 41)); }
+__m256i inline sigma0(__m256i x) { return Xor(RotR(x, 1), RotR(x, 8), ShR(x, 7)); }
+__m256i inline sigma1(__m256i x) { return Xor(RotR(x, 19), RotR(x, 61), ShR(x, 6)); }
+
+/** One round of SHA-512. */
+void inline __attribute__((always_inline)) Round(__m256i a, __m256i b, __m256i c, __m256i& d, __m256i e, __m256i f, __m256i g, __m256i& h, __m256i k)
+{
+    __m256i t1 = Add(h, Sigma1(e), Ch(e, f, g), k);
+    __m256i t2 = Add(Sigma0(a), Maj(a, b, c));
+    d = Add(d, t1);
+    h = Add(t1, t2);
+}
+
+__m256i inline Read4(const unsigned char* chunks, int offset) {
+    return _mm256_set_epi64x(
+        ReadBE64(chunks + 384 + offset),
+        ReadBE64(chunks + 256 + offset),
+        ReadBE64(chunks + 128 + offset),
+        ReadBE64(chunks + 0 + offset)
+    );
+}
+
+__m256i inline Load4(const uint64_t* s, int i) { return _mm256_set_epi64x(s[24 + i], s[16 + i], s[8 + i], s[i]); }
+
+void inline Store4(uint64_t* s, int i, __m256i v) {
+    alignas(32) uint64_t tmp[4];
+    _mm256_store_si256((__m256i*)tmp, v);
+    s[i] = tmp[0];
+    s[8 + i] = tmp[1];
+    s[16 + i] = tmp[2];
+    s[24 + i] = tmp[3];
+}
+
+}
+
+/** Run one SHA-512 transform on 4 independent states s[8*i..8*i+7] with 128-byte chunks at chunks + 128*i. */
+void Transform_4way(uint64_t* s, const unsigned char* chunks)
+{
+    __m256i a = Load4(s, 0), b = Load4(s, 1), c = Load4(s, 2), d = Load4(s, 3);
+    __m256i e = Load4(s, 4), f = Load4(s, 5), g = Load4(s, 6), h = Load4(s, 7);
+    __m256i w[16];
+
+    for (int i = 0; i < 80; i += 8) {
+        for (int j = 0; j < 8; ++j) {
+            int t = i + j;
+            if (t < 16) {
+                w[t] = Read4(chunks, 8 * t);
+            } else {
+                w[t & 15] = Add(w[t & 15], sigma1(w[(t - 2) & 15]), w[(t - 7) & 15], sigma0(w[(t - 15) & 15]));
+            }
+        }
+        Round(a, b, c, d, e, f, g, h, Add(K4(K[i + 0]), w[(i + 0) & 15]));
+        Round(h, a, b, c, d, e, f, g, Add(K4(K[i + 1]), w[(i + 1) & 15]));
+        Round(g, h, a, b, c, d, e, f, Add(K4(K[i + 2]), w[(i + 2) & 15]));
+        Round(f, g, h, a, b, c, d, e, Add(K4(K[i + 3]), w[(i + 3) & 15]));
+        Round(e, f, g, h, a, b, c, d, Add(K4(K[i + 4]), w[(i + 4) & 15]));
+        Round(d, e, f, g, h, a, b, c, Add(K4(K[i + 5]), w[(i + 5) & 15]));
+        Round(c, d, e, f, g, h, a, b, Add(K4(K[i + 6]), w[(i + 6) & 15]));
+        Round(b, c, d, e, f, g, h, a, Add(K4(K[i + 7]), w[(i + 7) & 15]));
+    }
+
+    Store4(s, 0, Add(a, Load4(s, 0)));
+    Store4(s, 1, Add(b, Load4(s, 1)));
+    Store4(s, 2, Add(c, Load4(s, 2)));
+    Store4(s, 3, Add(d, Load4(s, 3)));
+    Store4(s, 4, Add(e, Load4(s, 4)));
+    Store4(s, 5, Add(f, Load4(s, 5)));
+    Store4(s, 6, Add(g, Load4(s, 6)));
+    Store4(s, 7, Add(h, Load4(s, 7)));
+}
+
+}
+
+#endif
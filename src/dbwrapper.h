@@ -183,6 +183,22 @@ public:
 
 };
 
+/** A read snapshot of a CDBWrapper, released with the last reference to it */
+class CDBSnapshot
+{
+    friend class CDBWrapper;
+private:
+    leveldb::DB* pdb;
+    const leveldb::Snapshot* m_snapshot;
+
+public:
+    CDBSnapshot(leveldb::DB* db, const leveldb::Snapshot* snapshot) : pdb(db), m_snapshot(snapshot) {}
+    ~CDBSnapshot() { pdb->ReleaseSnapshot(m_snapshot); }
+
+    CDBSnapshot(const CDBSnapshot&) = delete;
+    CDBSnapshot& operator=(const CDBSnapshot&) = delete;
+};
+
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
@@ -241,7 +257,7 @@ public:
     CDBWrapper& operator=(const CDBWrapper&) = delete;
 
     template <typename K, typename V>
-    bool Read(const K& key, V& value) const
+    bool Read(const K& key, V& value, const CDBSnapshot* snapshot = nullptr) const
     {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
@@ -249,7 +265,14 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status;
+        if (snapshot) {
+            leveldb::ReadOptions snapshot_options = readoptions;
+            snapshot_options.snapshot = snapshot->m_snapshot;
+            status = pdb->Get(snapshot_options, slKey, &strValue);
+        } else {
+            status = pdb->Get(readoptions, slKey, &strValue);
+        }
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -318,11 +341,22 @@ public:
         return WriteBatch(batch, true);
     }
 
-    CDBIterator *NewIterator()
+    CDBIterator *NewIterator(const CDBSnapshot* snapshot = nullptr)
     {
+        if (snapshot) {
+            leveldb::ReadOptions snapshot_options = iteroptions;
+            snapshot_options.snapshot = snapshot->m_snapshot;
+            return new CDBIterator(*this, pdb->NewIterator(snapshot_options));
+        }
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /** Take a read snapshot, reads and iterators given it see the database as it is now */
+    std::shared_ptr<const CDBSnapshot> GetSnapshot() const
+    {
+        return std::make_shared<const CDBSnapshot>(pdb, pdb->GetSnapshot());
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -8,6 +8,7 @@
 #include <crypto/hmac_sha256.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <sync.h>
@@ -17,7 +18,9 @@
 #include <util/translation.h>
 #include <walletinitinterface.h>
 
+#include <iterator>
 #include <memory>
+#include <set>
 #include <stdio.h>
 
 #include <boost/algorithm/string.hpp> // boost::trim
@@ -66,9 +69,32 @@ private:
 static std::string strRPCUserColonPass;
 /* Stored RPC timer interface (for unregistration) */
 static std::unique_ptr<HTTPRPCTimerInterface> httpRPCTimerInterface;
+/* Methods queued on the fast lane */
+static std::set<std::string> setFastMethods;
+
+/** Cheap read-only calls answered on the fast lane by default, more can be added with -rpcfastmethod */
+static const char* const DEFAULT_FAST_METHODS[] = {
+    "getbestblockhash",
+    "getblockcount",
+    "getconnectioncount",
+    "getdifficulty",
+    "getrpcinfo",
+    "uptime",
+};
+
+/** Bytes of a request body searched for the method */
+static const size_t MAX_CLASSIFY_PEEK = 4096;
 
 static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const UniValue& id)
 {
+    if (req->IsReplyStarted()) {
+        // Part of a streamed result was sent with a success status, drop the connection
+        // without ending the chunked encoding so the client can't take the reply as complete
+        LogPrintf("ThreadRPCServer error after the reply was started: %s\n", objError.write());
+        req->WriteReplyAbort();
+        return;
+    }
+
     // Send error reply from json-rpc error object
     int nStatus = HTTP_INTERNAL_SERVER_ERROR;
     int code = find_value(objError, "code").get_int();
@@ -198,8 +224,27 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            // Calls that support it write their result into the reply as it's sent
+            JSONWriter writer([req](const std::string& chunk) {
+                if (!req->IsReplyStarted()) {
+                    req->WriteHeader("Content-Type", "application/json");
+                    req->WriteReplyStart(HTTP_OK);
+                }
+                req->WriteReplyChunk(chunk);
+            });
+            writer.Append("{\"result\":");
+            jreq.replyWriter = &writer;
+
             UniValue result = tableRPC.execute(jreq);
 
+            if (writer.NumValues() > 0) {
+                // Close the reply as JSONRPCReply would
+                writer.Append(",\"error\":null,\"id\":" + jreq.id.write() + "}\n");
+                writer.Flush();
+                req->WriteReplyEnd();
+                return true;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
@@ -221,6 +266,23 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+static HTTPWorkClass HTTPReq_JSONRPCClass(HTTPRequest* req, const std::string &)
+{
+    // Requests are classed by method before being authorized, so only registered
+    // methods get a class of their own.
+    HTTPWorkClass work_class;
+    std::string method;
+    if (req->GetRequestMethod() == HTTPRequest::POST
+        && JSONRPCPeekMethod(req->PeekBody(MAX_CLASSIFY_PEEK), method)
+        && tableRPC.hasCommand(method)) {
+        work_class.name = method;
+        work_class.fast_lane = setFastMethods.count(method);
+    } else {
+        work_class.name = "other";
+    }
+    return work_class;
+}
+
 static bool InitRPCAuthentication()
 {
     if (gArgs.GetArg("-rpcpassword", "") == "")
@@ -249,9 +311,15 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    setFastMethods.clear();
+    setFastMethods.insert(std::begin(DEFAULT_FAST_METHODS), std::end(DEFAULT_FAST_METHODS));
+    for (const std::string& method : gArgs.GetArgs("-rpcfastmethod")) {
+        setFastMethods.insert(method);
+    }
+
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPReq_JSONRPCClass);
     if (g_wallet_init_interface.HasWalletSupport()) {
-        RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC);
+        RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC, HTTPReq_JSONRPCClass);
     }
     struct event_base* eventBase = EventBase();
     assert(eventBase);
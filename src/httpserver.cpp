@@ -15,6 +15,10 @@
 #include <sync.h>
 #include <ui_interface.h>
 
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <map>
 #include <memory>
 #include <stdio.h>
 #include <stdlib.h>
@@ -62,23 +66,78 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
+/** Work queue for distributing work over multiple threads.
+ * Work items are simply callable objects, queued per class. Workers take items
+ * from the classes in turn, skipping classes already running as many items as
+ * they are limited to, so a burst of one kind of request can't occupy every worker.
  */
 template <typename WorkItem>
 class WorkQueue
 {
 private:
+    struct WorkClass
+    {
+        std::deque<std::pair<std::unique_ptr<WorkItem>, int64_t>> queue;
+        HTTPWorkClassStats stats;
+    };
+
     /** Mutex protects entire object */
     Mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    std::map<std::string, WorkClass> classes GUARDED_BY(cs);
+    //! Class the last item was taken from
+    std::string lastClass GUARDED_BY(cs);
+    size_t depth GUARDED_BY(cs);
+    size_t peakDepth GUARDED_BY(cs);
     bool running;
-    size_t maxDepth;
+    const std::string name;
+    const size_t maxDepth;
+    const int numThreads;
+    const int defaultLimit;
+    const std::map<std::string, int> limits;
+
+    WorkClass& GetClass(const std::string& class_name) EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        auto it = classes.find(class_name);
+        if (it == classes.end()) {
+            it = classes.emplace(class_name, WorkClass()).first;
+            auto li = limits.find(class_name);
+            it->second.stats.limit = std::min(numThreads, li == limits.end() ? defaultLimit : li->second);
+        }
+        return it->second;
+    }
+
+    /** Take the next item of the class after the last one served that is below its limit */
+    bool Next(std::unique_ptr<WorkItem>& item, std::string& class_name) EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        if (depth == 0) {
+            return false;
+        }
+        auto it = classes.upper_bound(lastClass);
+        for (size_t n = 0; n < classes.size(); ++n, ++it) {
+            if (it == classes.end()) {
+                it = classes.begin();
+            }
+            WorkClass& c = it->second;
+            if (c.queue.empty() || c.stats.running >= c.stats.limit) {
+                continue;
+            }
+            item = std::move(c.queue.front().first);
+            c.stats.wait.Add(GetTimeMicros() - c.queue.front().second);
+            c.queue.pop_front();
+            c.stats.queued--;
+            c.stats.running++;
+            depth--;
+            lastClass = class_name = it->first;
+            return true;
+        }
+        return false;
+    }
 
 public:
-    explicit WorkQueue(size_t _maxDepth) : running(true),
-                                 maxDepth(_maxDepth)
+    WorkQueue(const std::string& _name, size_t _maxDepth, int _numThreads, int _defaultLimit, const std::map<std::string, int>& _limits) :
+        depth(0), peakDepth(0), running(true), name(_name), maxDepth(_maxDepth),
+        numThreads(_numThreads), defaultLimit(_defaultLimit), limits(_limits)
     {
     }
     /** Precondition: worker threads have all stopped (they have been joined).
@@ -87,13 +146,19 @@ public:
     {
     }
     /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    bool Enqueue(WorkItem* item, const std::string& class_name)
     {
         LOCK(cs);
-        if (queue.size() >= maxDepth) {
+        WorkClass& c = GetClass(class_name);
+        if (depth >= maxDepth) {
+            c.stats.rejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        c.queue.emplace_back(std::unique_ptr<WorkItem>(item), GetTimeMicros());
+        c.stats.queued++;
+        c.stats.peak_queued = std::max(c.stats.peak_queued, c.stats.queued);
+        depth++;
+        peakDepth = std::max(peakDepth, depth);
         cond.notify_one();
         return true;
     }
@@ -102,16 +167,28 @@ public:
     {
         while (true) {
             std::unique_ptr<WorkItem> i;
+            std::string class_name;
             {
                 WAIT_LOCK(cs, lock);
-                while (running && queue.empty())
+                while (running && !Next(i, class_name))
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
-                queue.pop_front();
             }
+            int64_t start = GetTimeMicros();
             (*i)();
+            i.reset();
+            {
+                LOCK(cs);
+                HTTPWorkClassStats& stats = classes[class_name].stats;
+                stats.running--;
+                stats.calls++;
+                stats.duration.Add(GetTimeMicros() - start);
+                // The freed slot may let an item of a limited class run
+                if (depth > 0) {
+                    cond.notify_one();
+                }
+            }
         }
     }
     /** Interrupt and exit loops */
@@ -121,17 +198,33 @@ public:
         running = false;
         cond.notify_all();
     }
+    HTTPWorkQueueStats GetStats()
+    {
+        LOCK(cs);
+        HTTPWorkQueueStats stats;
+        stats.name = name;
+        stats.threads = numThreads;
+        stats.depth = depth;
+        stats.peak_depth = peakDepth;
+        stats.max_depth = maxDepth;
+        for (const auto& c : classes) {
+            stats.classes.emplace(c.first, c.second.stats);
+        }
+        return stats;
+    }
+    int NumThreads() const { return numThreads; }
 };
 
 struct HTTPPathHandler
 {
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPRequestClassifier _classifier):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), classifier(_classifier)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPRequestClassifier classifier;
 };
 
 /** HTTP module state */
@@ -144,6 +237,8 @@ static struct evhttp* eventHTTP = nullptr;
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = nullptr;
+//! Work queue for requests classified as fast, nullptr with -rpcfastthreads=0
+static WorkQueue<HTTPClosure>* fastWorkQueue = nullptr;
 //! Handlers for (sub)paths
 static std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -265,12 +360,19 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        HTTPWorkClass work_class;
+        if (i->classifier) {
+            work_class = i->classifier(hreq.get(), path);
+        } else {
+            work_class.name = i->prefix;
+        }
+        WorkQueue<HTTPClosure>* queue = work_class.fast_lane && fastWorkQueue ? fastWorkQueue : workQueue;
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
-        assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        assert(queue);
+        if (queue->Enqueue(item.get(), work_class.name))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: %s request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n", SanitizeString(work_class.name));
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -339,9 +441,9 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue, int worker_num)
+static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue, std::string thread_name)
 {
-    util::ThreadRename(strprintf("httpworker.%i", worker_num));
+    util::ThreadRename(std::move(thread_name));
     queue->Run();
 }
 
@@ -400,11 +502,31 @@ bool InitHTTPServer()
         return false;
     }
 
+    // Limits of the requests of one class running at once
+    std::map<std::string, int> limits;
+    for (const std::string& strLimit : gArgs.GetArgs("-rpcmethodlimit")) {
+        size_t pos = strLimit.rfind(':');
+        int64_t limit;
+        if (pos == std::string::npos || pos == 0 || !ParseInt64(strLimit.substr(pos + 1), &limit) || limit < 1) {
+            uiInterface.ThreadSafeMessageBox(
+                strprintf("Invalid -rpcmethodlimit specification: %s. Expected <method>:<n> with n at least 1.", strLimit),
+                "", CClientUIInterface::MSG_ERROR);
+            return false;
+        }
+        limits[strLimit.substr(0, pos)] = (int)std::min(limit, (int64_t)std::numeric_limits<int>::max());
+    }
+
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
+    int rpcThreads = std::max((long)gArgs.GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    int fastThreads = std::max((long)gArgs.GetArg("-rpcfastthreads", DEFAULT_HTTP_FAST_THREADS), 0L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    // Unless limited otherwise a single class of requests leaves a worker free for the others
+    workQueue = new WorkQueue<HTTPClosure>("main", workQueueDepth, rpcThreads, std::max(rpcThreads - 1, 1), limits);
+    if (fastThreads > 0) {
+        fastWorkQueue = new WorkQueue<HTTPClosure>("fast", workQueueDepth, fastThreads, fastThreads, limits);
+    }
     // transfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -431,12 +553,16 @@ static std::vector<std::thread> g_thread_http_workers;
 void StartHTTPServer()
 {
     LogPrint(BCLog::HTTP, "Starting HTTP server\n");
-    int rpcThreads = std::max((long)gArgs.GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
+    int rpcThreads = workQueue->NumThreads();
+    int fastThreads = fastWorkQueue ? fastWorkQueue->NumThreads() : 0;
+    LogPrintf("HTTP: starting %d worker threads and %d fast lane threads\n", rpcThreads, fastThreads);
     threadHTTP = std::thread(ThreadHTTP, eventBase);
 
     for (int i = 0; i < rpcThreads; i++) {
-        g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueue, i);
+        g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueue, strprintf("httpworker.%i", i));
+    }
+    for (int i = 0; i < fastThreads; i++) {
+        g_thread_http_workers.emplace_back(HTTPWorkQueueRun, fastWorkQueue, strprintf("httpfast.%i", i));
     }
 }
 
@@ -449,6 +575,8 @@ void InterruptHTTPServer()
     }
     if (workQueue)
         workQueue->Interrupt();
+    if (fastWorkQueue)
+        fastWorkQueue->Interrupt();
 }
 
 void StopHTTPServer()
@@ -462,6 +590,8 @@ void StopHTTPServer()
         g_thread_http_workers.clear();
         delete workQueue;
         workQueue = nullptr;
+        delete fastWorkQueue;
+        fastWorkQueue = nullptr;
     }
     // Unlisten sockets, these are what make the event loop running, which means
     // that after this and all connections are closed the event loop will quit.
@@ -489,6 +619,27 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+void HTTPLatencyHistogram::Add(int64_t micros)
+{
+    int i = 0;
+    for (int64_t bound = 1000; i < BUCKETS - 1 && micros >= bound; bound *= 4) {
+        ++i;
+    }
+    counts[i]++;
+}
+
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats()
+{
+    std::vector<HTTPWorkQueueStats> stats;
+    if (workQueue) {
+        stats.push_back(workQueue->GetStats());
+    }
+    if (fastWorkQueue) {
+        stats.push_back(fastWorkQueue->GetStats());
+    }
+    return stats;
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -516,11 +667,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
+    if (replyStarted && !replySent) {
+        // The status is already sent, close the connection so the client sees the reply is incomplete
+        LogPrintf("%s: Unfinished reply\n", __func__);
+        WriteReplyAbort();
+    }
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
@@ -560,6 +717,19 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t max_size) const
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    std::string rv(std::min(evbuffer_get_length(buf), max_size), '\0');
+    if (rv.empty())
+        return rv;
+    ev_ssize_t copied = evbuffer_copyout(buf, &rv[0], rv.size());
+    rv.resize(copied > 0 ? copied : 0);
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -602,6 +772,82 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = nullptr; // transferred back to main thread
 }
 
+void HTTPRequest::WriteReplyStart(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+    replyStarted = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replyStarted && !replySent && req);
+    // An empty chunk would end the chunked encoding
+    if (strChunk.empty()) {
+        return;
+    }
+    // Events are run in the order triggered, so chunks are sent in order
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb]{
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::WriteReplyEnd()
+{
+    assert(replyStarted && !replySent && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        // The request is freed by evhttp_send_reply_end when the connection is gone
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        evhttp_send_reply_end(req_copy);
+        // Re-enable reading from the socket, as in WriteReply.
+        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+            if (conn) {
+                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+                if (bev) {
+                    bufferevent_enable(bev, EV_READ | EV_WRITE);
+                }
+            }
+        }
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+void HTTPRequest::WriteReplyAbort()
+{
+    assert(replyStarted && !replySent && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (!conn) {
+            // The client is gone, only the request is left to free
+            evhttp_send_reply_end(req_copy);
+            return;
+        }
+        // Freeing the connection closes the socket and frees the request, the
+        // terminating chunk is never sent
+        evhttp_connection_free(conn);
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer() const
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -645,10 +891,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod() const
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPRequestClassifier &classifier)
 {
     LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, classifier));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
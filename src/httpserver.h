@@ -5,11 +5,14 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include <map>
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <vector>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_FAST_THREADS=1;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
@@ -38,14 +41,60 @@ bool UpdateHTTPServerLogging(bool enable);
 
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+
+/** The class a request is queued, limited and counted as */
+struct HTTPWorkClass
+{
+    std::string name;
+    //! Queue on the fast lane, for requests answered without waiting behind slow ones
+    bool fast_lane{false};
+};
+/** Classifies requests to a certain HTTP path, called on the event thread before dispatch */
+typedef std::function<HTTPWorkClass(HTTPRequest* req, const std::string &)> HTTPRequestClassifier;
+
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
  * be invoked.
+ * Without a classifier requests are queued as a class named by the prefix.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPRequestClassifier &classifier = nullptr);
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Counts of durations in buckets bounded by 1, 4, 16, ... 65536 milliseconds, the last bucket is unbounded */
+struct HTTPLatencyHistogram
+{
+    static const int BUCKETS = 10;
+    uint64_t counts[BUCKETS] = {};
+
+    void Add(int64_t micros);
+};
+
+struct HTTPWorkClassStats
+{
+    size_t queued = 0;
+    size_t peak_queued = 0;
+    int running = 0;
+    int limit = 0;              //! Most requests of the class run at once
+    uint64_t calls = 0;
+    uint64_t rejected = 0;
+    HTTPLatencyHistogram wait;
+    HTTPLatencyHistogram duration;
+};
+
+struct HTTPWorkQueueStats
+{
+    std::string name;
+    int threads = 0;
+    size_t depth = 0;
+    size_t peak_depth = 0;
+    size_t max_depth = 0;
+    std::map<std::string, HTTPWorkClassStats> classes;
+};
+
+/** Snapshot of the work queues, empty when the HTTP server is not running */
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -59,6 +108,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -99,6 +149,11 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Copy up to max_size bytes from the start of the request body, leaving it to be read.
+     */
+    std::string PeekBody(size_t max_size) const;
+
     /**
      * Write output header.
      *
@@ -115,6 +170,37 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply sent in chunks, with chunked transfer encoding for HTTP/1.1 clients.
+     * nStatus is the HTTP status code to send.
+     *
+     * @note Call WriteReplyChunk for the body and WriteReplyEnd when done, in place
+     * of WriteReply. The status can't be changed once the reply is started.
+     */
+    void WriteReplyStart(int nStatus);
+
+    /**
+     * Queue a chunk of the body of a started reply to be sent.
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a started reply.
+     *
+     * @note As WriteReply, this gives the request back to the main thread.
+     */
+    void WriteReplyEnd();
+
+    /**
+     * Abandon a started reply, closing the connection without ending the chunked
+     * encoding so the client sees the reply was cut short.
+     *
+     * @note As WriteReply, this gives the request back to the main thread.
+     */
+    void WriteReplyAbort();
+
+    bool IsReplyStarted() const { return replyStarted; }
 };
 
 /** Event handler closure.
@@ -0,0 +1,460 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/coinstatsindex.h>
+
+#include <chainparams.h>
+#include <coins.h>
+#include <dbwrapper.h>
+#include <undo.h>
+#include <util/moneystr.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores the UTXO set statistics as of each block. Entries for blocks on the
+ * active chain are indexed by height, entries for blocks that have been reorganized out of the
+ * active chain are indexed by block hash, as in the block filter index.
+ *
+ * The MuHash3072 state of the best block is stored under DB_MUHASH and committed together with
+ * the best block locator, only its digest is kept per block.
+ *
+ * Keys for the height index have the type [DB_BLOCK_HEIGHT, uint32 (BE)].
+ * Keys for the hash index have the type [DB_BLOCK_HASH, uint256].
+ */
+constexpr char DB_BLOCK_HASH = 's';
+constexpr char DB_BLOCK_HEIGHT = 't';
+constexpr char DB_MUHASH = 'M';
+
+std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+namespace {
+
+struct DBVal {
+    uint256 muhash;
+    uint64_t transaction_output_count = 0;
+    uint64_t blind_output_count = 0;
+    uint64_t bogo_size = 0;
+    CAmount total_amount = 0;
+    CAmount total_unspendable_amount = 0;
+    CCoinsScriptTypeStats script_types[COINSTATS_SCRIPT_TYPES];
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(muhash);
+        READWRITE(transaction_output_count);
+        READWRITE(blind_output_count);
+        READWRITE(bogo_size);
+        READWRITE(total_amount);
+        READWRITE(total_unspendable_amount);
+        for (size_t i = 0; i < COINSTATS_SCRIPT_TYPES; ++i) {
+            READWRITE(script_types[i]);
+        }
+    }
+};
+
+struct DBHeightKey {
+    int height;
+
+    DBHeightKey() : height(0) {}
+    explicit DBHeightKey(int height_in) : height(height_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_BLOCK_HEIGHT);
+        ser_writedata32be(s, height);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_BLOCK_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for coinstatsindex DB height key");
+        }
+        height = ser_readdata32be(s);
+    }
+};
+
+struct DBHashKey {
+    uint256 hash;
+
+    explicit DBHashKey(const uint256& hash_in) : hash(hash_in) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        char prefix = DB_BLOCK_HASH;
+        READWRITE(prefix);
+        if (prefix != DB_BLOCK_HASH) {
+            throw std::ios_base::failure("Invalid format for coinstatsindex DB hash key");
+        }
+
+        READWRITE(hash);
+    }
+};
+
+}; // namespace
+
+/** Get the coin output n of tx adds to the UTXO set, returns false for data and anon outputs. */
+static bool GetOutputCoin(const CTransaction& tx, size_t n, int height, Coin& coin)
+{
+    bool fCoinbase = tx.IsCoinBase() || tx.IsCoinStake();
+    if (!tx.IsParticlVersion()) {
+        coin = Coin(tx.vout[n], height, fCoinbase);
+        return true;
+    }
+
+    const CTxOutBase *out = tx.vpout[n].get();
+    if (out->IsType(OUTPUT_STANDARD)) {
+        coin = Coin(CTxOut(out->GetValue(), *out->GetPScriptPubKey()), height, fCoinbase);
+        return true;
+    }
+    if (out->IsType(OUTPUT_CT)) {
+        coin = Coin(CTxOut(0, *out->GetPScriptPubKey()), height, fCoinbase);
+        coin.nType = OUTPUT_CT;
+        coin.SetCommitment(((CTxOutCT*)out)->commitment);
+        return true;
+    }
+    return false;
+}
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+{
+    fs::path path = GetDataDir() / "indexes" / "coinstats";
+    fs::create_directories(path);
+
+    m_db = MakeUnique<BaseIndex::DB>(path / "db", n_cache_size, f_memory, f_wipe);
+}
+
+void CoinStatsIndex::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    ApplyCoinHash(m_muhash, outpoint, coin);
+
+    CCoinsScriptTypeStats &script_stats = m_script_types[GetCoinStatsScriptType(coin.out.scriptPubKey)];
+    if (coin.nType == OUTPUT_CT) {
+        m_blind_output_count++;
+        script_stats.nBlinded++;
+    } else {
+        m_transaction_output_count++;
+        m_total_amount += coin.out.nValue;
+        script_stats.nPlain++;
+        script_stats.nPlainValue += coin.out.nValue;
+    }
+    m_bogo_size += GetBogoSize(coin);
+}
+
+void CoinStatsIndex::SpendCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    RemoveCoinHash(m_muhash, outpoint, coin);
+
+    CCoinsScriptTypeStats &script_stats = m_script_types[GetCoinStatsScriptType(coin.out.scriptPubKey)];
+    if (coin.nType == OUTPUT_CT) {
+        m_blind_output_count--;
+        script_stats.nBlinded--;
+    } else {
+        m_transaction_output_count--;
+        m_total_amount -= coin.out.nValue;
+        script_stats.nPlain--;
+        script_stats.nPlainValue -= coin.out.nValue;
+    }
+    m_bogo_size -= GetBogoSize(coin);
+}
+
+bool CoinStatsIndex::ApplyBlockHash(const CBlock& block, const CBlockUndo& block_undo, int height, bool fReverse)
+{
+    // The genesis outputs are only added to the UTXO set in Particl mode, see ConnectBlock
+    if (height == 0 && !fParticlMode) {
+        return true;
+    }
+
+    size_t undo_pos = 0;
+    for (const auto &ptx : block.vtx) {
+        const CTransaction &tx = *ptx;
+        const uint256 &txid = tx.GetHash();
+
+        size_t num_outputs = tx.IsParticlVersion() ? tx.vpout.size() : tx.vout.size();
+        for (size_t n = 0; n < num_outputs; ++n) {
+            Coin coin;
+            if (!GetOutputCoin(tx, n, height, coin)) {
+                continue; // Data or anon
+            }
+            if (coin.out.scriptPubKey.IsUnspendable()) {
+                if (!fReverse && coin.nType != OUTPUT_CT) {
+                    m_total_unspendable_amount += coin.out.nValue;
+                }
+                continue;
+            }
+            if (fReverse) {
+                RemoveCoinHash(m_muhash, COutPoint(txid, n), coin);
+            } else {
+                AddCoin(COutPoint(txid, n), coin);
+            }
+        }
+
+        if (tx.IsCoinBase()) {
+            continue;
+        }
+        if (undo_pos >= block_undo.vtxundo.size()) {
+            return error("%s: Missing undo data for tx %s", __func__, txid.ToString());
+        }
+        const CTxUndo &tx_undo = block_undo.vtxundo[undo_pos++];
+        size_t j = 0;
+        for (const auto &txin : tx.vin) {
+            if (txin.IsAnonInput()) {
+                continue;
+            }
+            if (j >= tx_undo.vprevout.size()) {
+                return error("%s: Missing undo data for input of tx %s", __func__, txid.ToString());
+            }
+            const Coin &coin = tx_undo.vprevout[j++];
+            if (fReverse) {
+                ApplyCoinHash(m_muhash, txin.prevout, coin);
+            } else {
+                SpendCoin(txin.prevout, coin);
+            }
+        }
+    }
+    return true;
+}
+
+static bool LookUpOne(const CDBWrapper& db, const CBlockIndex* block_index, DBVal& result)
+{
+    // First check if the result is stored under the height index and the value there matches the
+    // block hash. This should be the case if the block is on the active chain.
+    std::pair<uint256, DBVal> read_out;
+    if (!db.Read(DBHeightKey(block_index->nHeight), read_out)) {
+        return false;
+    }
+    if (read_out.first == block_index->GetBlockHash()) {
+        result = std::move(read_out.second);
+        return true;
+    }
+
+    // If value at the height index corresponds to an different block, the result will be stored in
+    // the hash index.
+    return db.Read(DBHashKey(block_index->GetBlockHash()), result);
+}
+
+bool CoinStatsIndex::Init()
+{
+    if (!m_db->Read(DB_MUHASH, m_muhash)) {
+        // Check that the cause of the read failure is that the key does not exist. Any other errors
+        // indicate database corruption or a disk failure, and starting the index would cause
+        // further corruption.
+        if (m_db->Exists(DB_MUHASH)) {
+            return error("%s: Cannot read current %s state; index may be corrupted",
+                         __func__, GetName());
+        }
+    }
+
+    if (!BaseIndex::Init()) {
+        return false;
+    }
+
+    const CBlockIndex* pindex = m_best_block_index.load();
+    if (pindex) {
+        DBVal entry;
+        if (!LookUpOne(*m_db, pindex, entry)) {
+            return error("%s: Cannot read current %s state; index may be corrupted",
+                         __func__, GetName());
+        }
+
+        uint256 out;
+        m_muhash.Finalize(out);
+        if (entry.muhash != out) {
+            return error("%s: Cannot read current %s state; index may be corrupted",
+                         __func__, GetName());
+        }
+
+        m_transaction_output_count = entry.transaction_output_count;
+        m_blind_output_count = entry.blind_output_count;
+        m_bogo_size = entry.bogo_size;
+        m_total_amount = entry.total_amount;
+        m_total_unspendable_amount = entry.total_unspendable_amount;
+        for (size_t i = 0; i < COINSTATS_SCRIPT_TYPES; ++i) {
+            m_script_types[i] = entry.script_types[i];
+        }
+    }
+
+    return true;
+}
+
+bool CoinStatsIndex::CommitInternal(CDBBatch& batch)
+{
+    // The MuHash state of the best block must be written atomically with the locator
+    batch.Write(DB_MUHASH, m_muhash);
+    return BaseIndex::CommitInternal(batch);
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo block_undo;
+
+    if (pindex->nHeight > 0) {
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+
+        std::pair<uint256, DBVal> read_out;
+        if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
+            return false;
+        }
+
+        uint256 expected_block_hash = pindex->pprev->GetBlockHash();
+        if (read_out.first != expected_block_hash) {
+            return error("%s: previous block stats belong to unexpected block %s; expected %s",
+                         __func__, read_out.first.ToString(), expected_block_hash.ToString());
+        }
+    }
+
+    if (!ApplyBlockHash(block, block_undo, pindex->nHeight, false)) {
+        return false;
+    }
+
+    std::pair<uint256, DBVal> value;
+    value.first = pindex->GetBlockHash();
+    m_muhash.Finalize(value.second.muhash);
+    value.second.transaction_output_count = m_transaction_output_count;
+    value.second.blind_output_count = m_blind_output_count;
+    value.second.bogo_size = m_bogo_size;
+    value.second.total_amount = m_total_amount;
+    value.second.total_unspendable_amount = m_total_unspendable_amount;
+    for (size_t i = 0; i < COINSTATS_SCRIPT_TYPES; ++i) {
+        value.second.script_types[i] = m_script_types[i];
+    }
+
+    if (!MoneyRange(m_total_amount) || !MoneyRange(m_total_unspendable_amount)
+        || m_total_amount + m_total_unspendable_amount > pindex->nMoneySupply) {
+        LogPrintf("%s: WARNING: Plain UTXO amount %s and unspendable amount %s at block %s exceed the money supply %s\n",
+                  __func__, FormatMoney(m_total_amount), FormatMoney(m_total_unspendable_amount),
+                  pindex->GetBlockHash().ToString(), FormatMoney(pindex->nMoneySupply));
+    }
+
+    return m_db->Write(DBHeightKey(pindex->nHeight), value);
+}
+
+static bool CopyHeightIndexToHashIndex(CDBIterator& db_it, CDBBatch& batch,
+                                       const std::string& index_name,
+                                       int start_height, int stop_height)
+{
+    DBHeightKey key(start_height);
+    db_it.Seek(key);
+
+    for (int height = start_height; height <= stop_height; ++height) {
+        if (!db_it.GetKey(key) || key.height != height) {
+            return error("%s: unexpected key in %s: expected (%c, %d)",
+                         __func__, index_name, DB_BLOCK_HEIGHT, height);
+        }
+
+        std::pair<uint256, DBVal> value;
+        if (!db_it.GetValue(value)) {
+            return error("%s: unable to read value in %s at key (%c, %d)",
+                         __func__, index_name, DB_BLOCK_HEIGHT, height);
+        }
+
+        batch.Write(DBHashKey(value.first), std::move(value.second));
+
+        db_it.Next();
+    }
+    return true;
+}
+
+bool CoinStatsIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+
+    // During a reorg, we need to copy all stats for blocks that are getting disconnected from the
+    // height index to the hash index so we can still find them when the height index entries are
+    // overwritten.
+    if (!CopyHeightIndexToHashIndex(*db_it, batch, GetName(), new_tip->nHeight, current_tip->nHeight)) {
+        return false;
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    // Only the digest is stored per block, so the MuHash state is rolled back block by block.
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        CBlockUndo block_undo;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+        if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+            return error("%s: Failed to read undo data for block %s",
+                         __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!ApplyBlockHash(block, block_undo, pindex->nHeight, true)) {
+            return false;
+        }
+    }
+
+    DBVal entry;
+    if (!LookUpOne(*m_db, new_tip, entry)) {
+        return error("%s: Failed to read stats for block %s from %s",
+                     __func__, new_tip->GetBlockHash().ToString(), GetName());
+    }
+    uint256 out;
+    m_muhash.Finalize(out);
+    if (entry.muhash != out) {
+        return error("%s: Rolled back MuHash does not match the stored value for block %s",
+                     __func__, new_tip->GetBlockHash().ToString());
+    }
+
+    m_transaction_output_count = entry.transaction_output_count;
+    m_blind_output_count = entry.blind_output_count;
+    m_bogo_size = entry.bogo_size;
+    m_total_amount = entry.total_amount;
+    m_total_unspendable_amount = entry.total_unspendable_amount;
+    for (size_t i = 0; i < COINSTATS_SCRIPT_TYPES; ++i) {
+        m_script_types[i] = entry.script_types[i];
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+bool CoinStatsIndex::DisconnectBlock(const CBlock& block)
+{
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = LookupBlockIndex(block.GetHash());
+    }
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (!pindex || pindex != best_block_index || !pindex->pprev) {
+        return true;
+    }
+    return Rewind(best_block_index, pindex->pprev);
+}
+
+bool CoinStatsIndex::LookUpStats(const CBlockIndex* block_index, CCoinsStats& coins_stats) const
+{
+    DBVal entry;
+    if (!LookUpOne(*m_db, block_index, entry)) {
+        return false;
+    }
+
+    coins_stats.nHeight = block_index->nHeight;
+    coins_stats.hashBlock = block_index->GetBlockHash();
+    coins_stats.hashSerialized = entry.muhash;
+    coins_stats.nTransactionOutputs = entry.transaction_output_count;
+    coins_stats.nBlindTransactionOutputs = entry.blind_output_count;
+    coins_stats.nBogoSize = entry.bogo_size;
+    coins_stats.nTotalAmount = entry.total_amount;
+    coins_stats.nUnspendableAmount = entry.total_unspendable_amount;
+    for (size_t i = 0; i < COINSTATS_SCRIPT_TYPES; ++i) {
+        coins_stats.vScriptTypes[i] = entry.script_types[i];
+    }
+    coins_stats.nAnonOutputs = block_index->nAnonOutputs;
+    coins_stats.nMoneySupply = block_index->nMoneySupply;
+    coins_stats.index_used = true;
+
+    return true;
+}
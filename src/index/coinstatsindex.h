@@ -0,0 +1,71 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_INDEX_COINSTATSINDEX_H
+#define PARTICL_INDEX_COINSTATSINDEX_H
+
+#include <chain.h>
+#include <crypto/muhash.h>
+#include <index/base.h>
+#include <node/coinstats.h>
+
+class CBlockUndo;
+
+static constexpr bool DEFAULT_COINSTATSINDEX = false;
+
+/**
+ * CoinStatsIndex maintains statistics on the UTXO set incrementally as blocks
+ * are connected, so that gettxoutsetinfo and gettxoutsetinfobyscript can be
+ * answered for any block on the active chain with a single database read
+ * instead of a scan of the chainstate.
+ *
+ * The set commitment is a MuHash3072 over the unspent outputs, it is updated
+ * from the block and its undo data and rolled back the same way on reorgs.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    MuHash3072 m_muhash;
+    uint64_t m_transaction_output_count = 0;
+    uint64_t m_blind_output_count = 0;
+    uint64_t m_bogo_size = 0;
+    CAmount m_total_amount = 0;
+    CAmount m_total_unspendable_amount = 0;
+    CCoinsScriptTypeStats m_script_types[COINSTATS_SCRIPT_TYPES];
+
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+    void SpendCoin(const COutPoint& outpoint, const Coin& coin);
+
+    /** Apply a block to the running stats, fReverse only rolls back the MuHash of an applied block */
+    bool ApplyBlockHash(const CBlock& block, const CBlockUndo& block_undo, int height, bool fReverse);
+
+protected:
+    bool Init() override;
+
+    bool CommitInternal(CDBBatch& batch) override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    bool DisconnectBlock(const CBlock& block) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Look up the UTXO set statistics as of block_index, which must be indexed.
+    bool LookUpStats(const CBlockIndex* block_index, CCoinsStats& coins_stats) const;
+};
+
+/// The global UTXO set statistics index. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+#endif // PARTICL_INDEX_COINSTATSINDEX_H
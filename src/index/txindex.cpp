@@ -8,6 +8,7 @@
 #include <util/system.h>
 #include <util/translation.h>
 #include <validation.h>
+#include <validationstats.h>
 
 #include <insight/csindex.h>
 #include <script/script.h>
@@ -277,6 +278,7 @@ bool TxIndex::Init()
 bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
 {
     if (m_cs_index) {
+        ValidationStatsTimer cs_index_timer(VSTAT_CS_INDEX_WRITE);
         IndexCSOutputs(block, pindex);
     }
     // Exclude genesis block transaction because outputs are not spendable.
@@ -17,10 +17,13 @@
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/sha256.h>
+#include <crypto/sha512.h>
 #include <fs.h>
 #include <httprpc.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key.h>
@@ -29,10 +32,13 @@
 #include <net_permissions.h>
 #include <net_processing.h>
 #include <netbase.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
+#include <proofcache.h>
 #include <rpc/blockchain.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
@@ -258,6 +264,9 @@ void Interrupt()
         g_txindex->Interrupt();
     }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
+    if (g_coin_stats_index) {
+        g_coin_stats_index->Interrupt();
+    }
 }
 
 void Shutdown(InitInterfaces& interfaces)
@@ -291,9 +300,11 @@ void Shutdown(InitInterfaces& interfaces)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    if (g_block_template_cache) UnregisterValidationInterface(g_block_template_cache.get());
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
+    if (g_coin_stats_index) g_coin_stats_index->Stop();
 
     StopTorControl();
 
@@ -305,10 +316,12 @@ void Shutdown(InitInterfaces& interfaces)
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     peerLogic.reset();
+    g_block_template_cache.reset();
     g_connman.reset();
     g_banman.reset();
     g_txindex.reset();
     DestroyAllBlockFilterIndexes();
+    g_coin_stats_index.reset();
 
     if (::mempool.IsLoaded() && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool(::mempool);
@@ -353,6 +366,7 @@ void Shutdown(InitInterfaces& interfaces)
             g_chainstate->ForceFlushStateToDisk();
             g_chainstate->ResetCoinsViews();
         }
+        ResetChainView();
         pblocktree.reset();
     }
     for (const auto& client : interfaces.chain_clients) {
@@ -470,6 +484,7 @@ void SetupServerArgs()
 #if HAVE_SYSTEM
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
+    gArgs.AddArg("-blockprecheckthreads=<n>", strprintf("Set the number of threads running the context-independent checks on blocks received out of order during initial block download (0 to %d, 0 = disabled, default: %d)", MAX_SCRIPTCHECK_THREADS, DEFAULT_BLOCK_PRECHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Transactions from the wallet, RPC and relay whitelisted inbound peers are not affected. (default: %u)", DEFAULT_BLOCKSONLY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -480,6 +495,7 @@ void SetupServerArgs()
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-loadsnapshot=<file>", "Load a chainstate snapshot written by dumptxoutset into an empty datadir on startup. Blocks below the snapshot are not downloaded, the datadir is marked as pruned. Outside regtest the snapshot must match a hash known for its height. Relative paths will be prefixed by datadir.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -500,10 +516,12 @@ void SetupServerArgs()
     hidden_args.emplace_back("-sysperms");
 #endif
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-utxoscanthreads=<n>", strprintf("Set the number of threads full scans of the UTXO set by gettxoutsetinfo and scantxoutset are split over (1 to %d, 0 = auto, default: %d)", MAX_UTXO_SCAN_THREADS, DEFAULT_UTXO_SCAN_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockfilterindex=<type>",
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-coinstatsindex", strprintf("Maintain UTXO set statistics for each block, used by the gettxoutsetinfo and gettxoutsetinfobyscript rpc calls (default: %u)", DEFAULT_COINSTATSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 
     gArgs.AddArg("-addressindex", strprintf("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)", DEFAULT_ADDRESSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-timestampindex", strprintf("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)", DEFAULT_TIMESTAMPINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -587,9 +605,12 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawblockbacklog=<n>", strprintf("Hold up to <n> raw block messages while a subscriber is at the high water mark instead of dropping them, the socket at the address then waits for its slowest subscriber (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_BACKLOG), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawtxbacklog=<n>", strprintf("Hold up to <n> raw transaction messages while a subscriber is at the high water mark instead of dropping them, the socket at the address then waits for its slowest subscriber (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_BACKLOG), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
 
     gArgs.AddArg("-zmqpubhashwtx=<address>", "Enable publish hash transaction received by wallets in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubsmsg=<address>", "Enable publish secure message in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubvalidationstats=<address>", "Enable publish validation stats as JSON for each new tip in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-serverkeyzmq=<secret_key>", "Base64 encoded string of the z85 encoded secret key for CurveZMQ.", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-newserverkeypairzmq", "Generate new key pair for CurveZMQ, print and exit.", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-whitelistzmq=<IP address or network>", "Whitelist peers connecting from the given IP address (e.g. 1.2.3.4) or CIDR notated network (e.g. 1.2.3.0/24). Can be specified multiple times.", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
@@ -603,9 +624,12 @@ void SetupServerArgs()
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawblockbacklog=<n>");
+    hidden_args.emplace_back("-zmqpubrawtxbacklog=<n>");
 
     hidden_args.emplace_back("-zmqpubhashwtx=<address>");
     hidden_args.emplace_back("-zmqpubsmsg=<address>");
+    hidden_args.emplace_back("-zmqpubvalidationstats=<address>");
     hidden_args.emplace_back("-serverkeyzmq=<secret_key>");
     hidden_args.emplace_back("-newserverkeypairzmq");
     hidden_args.emplace_back("-whitelistzmq=<IP address or network>");
@@ -640,6 +664,7 @@ void SetupServerArgs()
     gArgs.AddArg("-logthreadnames", strprintf("Prepend debug output with name of the originating thread (only available on platforms supporting thread_local) (default: %u)", DEFAULT_LOGTHREADNAMES), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxproofcachesize=<n>", strprintf("Limit the verified rangeproof and MLSAG cache size to <n> MiB (default: %u)", DEFAULT_MAX_PROOF_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-printpriority", strprintf("Log transaction fee per kB when mining blocks (default: %u)", DEFAULT_PRINTPRIORITY), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -662,6 +687,7 @@ void SetupServerArgs()
 
 
     gArgs.AddArg("-blockmaxweight=<n>", strprintf("Set maximum BIP141 block weight (default: %d)", DEFAULT_BLOCK_MAX_WEIGHT), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-blocktemplatecache", strprintf("Keep the transaction selection for the next block up to date with the mempool (default: %u)", DEFAULT_BLOCK_TEMPLATE_CACHE), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockmintxfee=<amt>", strprintf("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)", CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockversion=<n>", "Override block version to test forking scenarios", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::BLOCK_CREATION);
 
@@ -670,6 +696,9 @@ void SetupServerArgs()
     gArgs.AddArg("-rpcauth=<userpw>", "Username and HMAC-SHA-256 hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcauth. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. Do not expose the RPC server to untrusted networks such as the public internet! This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost)", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpccookiefile=<loc>", "Location of the auth cookie. Relative paths will be prefixed by a net-specific datadir location. (default: data dir)", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcfastmethod=<method>", "Answer calls of <method> on the fast lane, besides getbestblockhash, getblockcount, getconnectioncount, getdifficulty, getrpcinfo and uptime. This option can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcfastthreads=<n>", strprintf("Set the number of threads to service RPC calls on the fast lane, 0 to queue all calls together (default: %d)", DEFAULT_HTTP_FAST_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcmethodlimit=<method>:<n>", "Run at most <n> calls of <method> at once (default: one less than -rpcthreads). This option can be specified multiple times", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcpassword=<pw>", "Password for JSON-RPC connections", ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcport=<port>", strprintf("Listen for JSON-RPC connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort(), regtestBaseParams->RPCPort()), ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::RPC);
     gArgs.AddArg("-rpcserialversion", strprintf("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)", DEFAULT_RPC_SERIALIZE_VERSION), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
@@ -1130,6 +1159,9 @@ bool AppInitParameterInteraction()
         if (!g_enabled_filter_types.empty()) {
             return InitError(_("Prune mode is incompatible with -blockfilterindex.").translated);
         }
+        if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+            return InitError(_("Prune mode is incompatible with -coinstatsindex.").translated);
+        }
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1234,6 +1266,8 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nBlockPrecheckThreads = std::max(0, std::min((int)gArgs.GetArg("-blockprecheckthreads", DEFAULT_BLOCK_PRECHECK_THREADS), MAX_SCRIPTCHECK_THREADS));
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1252,6 +1286,20 @@ bool AppInitParameterInteraction()
         fPruneMode = true;
     }
 
+    if (gArgs.IsArgSet("-loadsnapshot")) {
+        if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)
+            || gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)
+            || gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
+            return InitError(_("-loadsnapshot is incompatible with -addressindex, -spentindex and -timestampindex.").translated);
+        }
+        // The indexes synced in the background start from genesis and need the blocks below the snapshot
+        if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)
+            || !g_enabled_filter_types.empty()
+            || gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+            return InitError(_("-loadsnapshot is incompatible with -txindex, -blockfilterindex and -coinstatsindex.").translated);
+        }
+    }
+
     // TODO: Check pruning
     if (fPruneMode && fParticlMode) {
         LogPrintf("Block pruning disabled.  Todo.\n");
@@ -1349,6 +1397,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string sha512_algo = SHA512AutoDetect();
+    LogPrintf("Using the '%s' SHA512 multi-buffer implementation\n", sha512_algo);
     RandomInit();
     ECC_Start();
     ECC_Start_Stealth();
@@ -1427,6 +1477,7 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitProofCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
@@ -1434,6 +1485,11 @@ bool AppInitMain(InitInterfaces& interfaces)
             threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
     }
 
+    LogPrintf("Using %u threads for block prechecks\n", nBlockPrecheckThreads);
+    for (int i = 0; i < nBlockPrecheckThreads; i++) {
+        threadGroup.create_thread([i]() { return ThreadBlockPrecheck(i); });
+    }
+
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = std::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
@@ -1497,6 +1553,11 @@ bool AppInitMain(InitInterfaces& interfaces)
     peerLogic.reset(new PeerLogicValidation(g_connman.get(), g_banman.get(), scheduler, gArgs.GetBoolArg("-enablebip61", DEFAULT_ENABLE_BIP61)));
     RegisterValidationInterface(peerLogic.get());
 
+    if (gArgs.GetBoolArg("-blocktemplatecache", DEFAULT_BLOCK_TEMPLATE_CACHE)) {
+        g_block_template_cache = MakeUnique<BlockTemplateCache>(chainparams);
+        RegisterValidationInterface(g_block_template_cache.get());
+    }
+
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
     for (const std::string& cmt : gArgs.GetArgs("-uacomment")) {
@@ -1588,6 +1649,12 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     if (g_zmq_notification_interface) {
         RegisterValidationInterface(g_zmq_notification_interface);
+        // Messages held back are otherwise only retried when the next notification is sent
+        scheduler.scheduleEvery([]{
+            if (g_zmq_notification_interface) {
+                g_zmq_notification_interface->FlushBacklogs();
+            }
+        }, ZMQ_BACKLOG_FLUSH_INTERVAL_MS);
     }
 #endif
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
@@ -1642,6 +1709,12 @@ bool AppInitMain(InitInterfaces& interfaces)
         filter_index_cache = max_cache / n_indexes;
         nTotalCache -= filter_index_cache * n_indexes;
     }
+    // The coinstatsindex writes one small entry per block, it doesn't need a large cache
+    int64_t coin_stats_index_cache = 0;
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        coin_stats_index_cache = std::min(nTotalCache / 8, max_filter_index_cache << 20);
+        nTotalCache -= coin_stats_index_cache;
+    }
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1657,11 +1730,15 @@ bool AppInitMain(InitInterfaces& interfaces)
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
     }
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        LogPrintf("* Using %.1f MiB for coinstatsindex database\n", coin_stats_index_cache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
 
     bool fLoaded = false;
+    bool fLoadSnapshot = gArgs.IsArgSet("-loadsnapshot");
     while (!fLoaded && !ShutdownRequestedMainThread()) {
         bool fReset = fReindex;
         std::string strLoadError;
@@ -1699,6 +1776,17 @@ bool AppInitMain(InitInterfaces& interfaces)
 
                 if (ShutdownRequestedMainThread()) break;
 
+                if (fLoadSnapshot) {
+                    fLoadSnapshot = false;
+                    uiInterface.InitMessage(_("Loading snapshot...").translated);
+                    SnapshotMetadata metadata;
+                    std::string error;
+                    if (fReset || !LoadUTXOSnapshot(chainparams, fs::absolute(gArgs.GetArg("-loadsnapshot", ""), GetDataDir()), *pblocktree, nCoinDBCache, metadata, error)) {
+                        return InitError(fReset ? _("-loadsnapshot can't be used with -reindex.").translated : error);
+                    }
+                }
+                if (ShutdownRequestedMainThread()) break;
+
                 // LoadBlockIndex will load fHavePruned if we've ever removed a
                 // block file from disk.
                 // Note that it also sets fReindex based on the disk flag!
@@ -1736,10 +1824,18 @@ bool AppInitMain(InitInterfaces& interfaces)
 
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
-                if (fHavePruned && !fPruneMode) {
+                // A datadir loaded from a snapshot never had the blocks below the snapshot and is not pruned further.
+                bool fLoadedSnapshot = false;
+                pblocktree->ReadFlag("loadedsnapshot", fLoadedSnapshot);
+                if (fHavePruned && !fPruneMode && !fLoadedSnapshot) {
                     strLoadError = _("You need to rebuild the database using -reindex to go back to unpruned mode.  This will redownload the entire blockchain").translated;
                     break;
                 }
+                if (fLoadedSnapshot && (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)
+                    || !g_enabled_filter_types.empty()
+                    || gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))) {
+                    return InitError(_("-txindex, -blockfilterindex and -coinstatsindex can't be used, the blocks below the loaded snapshot are missing.").translated);
+                }
 
                 // At this point blocktree args are consistent with what's on disk.
                 // If we're not mid-reindex (based on disk + args), add a genesis block on disk
@@ -1900,6 +1996,11 @@ bool AppInitMain(InitInterfaces& interfaces)
         GetBlockFilterIndex(filter_type)->Start();
     }
 
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coin_stats_index = MakeUnique<CoinStatsIndex>(coin_stats_index_cache, false, fReindex);
+        g_coin_stats_index->Start();
+    }
+
     // ********************************************************* Step 9: load wallet
     for (const auto& client : interfaces.chain_clients) {
         if (!client->load()) {
@@ -1918,6 +2019,10 @@ bool AppInitMain(InitInterfaces& interfaces)
             uiInterface.InitMessage(_("Pruning blockstore...").translated);
             ::ChainstateActive().PruneAndFlush();
         }
+    } else
+    if (fHavePruned) {
+        LogPrintf("Unsetting NODE_NETWORK, blocks below the loaded snapshot are missing\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
     }
 
     if (chainparams.GetConsensus().SegwitHeight != std::numeric_limits<int>::max()) {
@@ -74,19 +74,46 @@ bool ExtractIndexInfo(const CTxOutBase *out, int &scriptType, std::vector<uint8_
     return true;
 };
 
-bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes)
+static const CDBSnapshot *BlockTreeSnapshot(const CChainView *chain_view)
+{
+    return chain_view ? chain_view->BlockTreeSnapshot() : nullptr;
+}
+
+bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes,
+                       const CChainView *chain_view)
 {
     if (!fTimestampIndex) {
         return error("Timestamp index not enabled");
     }
-    if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes)) {
+
+    std::shared_ptr<const CChainView> active_view;
+    if (fActiveOnly && !chain_view) {
+        active_view = GetChainView();
+        if (!active_view) {
+            return error("Chain not loaded");
+        }
+        chain_view = active_view.get();
+    }
+
+    if (!pblocktree->ReadTimestampIndex(high, low, hashes, BlockTreeSnapshot(chain_view))) {
         return error("Unable to get hashes for timestamps");
     }
 
+    if (fActiveOnly) {
+        hashes.erase(std::remove_if(hashes.begin(), hashes.end(), [chain_view](const std::pair<uint256, unsigned int> &entry) {
+            return !chain_view->Find(entry.first);
+        }), hashes.end());
+    }
+
     return true;
 };
 
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
+{
+    return GetSpentIndex(key, value, nullptr);
+};
+
+bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value, const CChainView *chain_view)
 {
     if (!fSpentIndex) {
         return false;
@@ -94,7 +121,7 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value)) {
         return true;
     }
-    if (!pblocktree->ReadSpentIndex(key, value)) {
+    if (!pblocktree->ReadSpentIndex(key, value, BlockTreeSnapshot(chain_view))) {
         return false;
     }
 
@@ -103,9 +130,9 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 
 bool HashOnchainActive(const uint256 &hash)
 {
-    CBlockIndex* pblockindex = ::BlockIndex()[hash];
+    std::shared_ptr<const CChainView> chain_view = GetChainView();
 
-    if (!::ChainActive().Contains(pblockindex)) {
+    if (!chain_view || !chain_view->Find(hash)) {
         return false;
     }
 
@@ -113,12 +140,13 @@ bool HashOnchainActive(const uint256 &hash)
 };
 
 bool GetAddressIndex(uint256 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     const CChainView *chain_view)
 {
     if (!fAddressIndex) {
         return error("Address index not enabled");
     }
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end)) {
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, BlockTreeSnapshot(chain_view))) {
         return error("Unable to get txids for address");
     }
 
@@ -126,12 +154,13 @@ bool GetAddressIndex(uint256 addressHash, int type,
 };
 
 bool GetAddressUnspent(uint256 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CChainView *chain_view)
 {
     if (!fAddressIndex) {
         return error("Address index not enabled");
     }
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs)) {
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, BlockTreeSnapshot(chain_view))) {
         return error("Unable to get txids for address");
     }
 
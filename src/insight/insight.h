@@ -21,6 +21,8 @@ extern bool fAddressIndex;
 extern bool fSpentIndex;
 extern bool fTimestampIndex;
 
+class CChainView;
+class CDBSnapshot;
 class CTxOutBase;
 class CScript;
 class uint256;
@@ -33,15 +35,20 @@ struct CSpentIndexValue;
 bool ExtractIndexInfo(const CScript *pScript, int &scriptType, std::vector<uint8_t> &hashBytes);
 bool ExtractIndexInfo(const CTxOutBase *out, int &scriptType, std::vector<uint8_t> &hashBytes, CAmount &nValue, const CScript *&pScript);
 
-/** Functions for insight block explorer */
-bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes);
+/** Functions for insight block explorer
+ *  Reads go through the block tree db snapshot of chain_view when one is given,
+ *  so the results are consistent with that view of the active chain. */
+bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes,
+                       const CChainView *chain_view = nullptr);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-bool HashOnchainActive(const uint256 &hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value, const CChainView *chain_view);
+bool HashOnchainActive(const uint256 &hash);
 bool GetAddressIndex(uint256 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0, const CChainView *chain_view = nullptr);
 bool GetAddressUnspent(uint256 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CChainView *chain_view = nullptr);
 
 bool getAddressFromIndex(const int &type, const uint256 &hash, std::string &address);
 
@@ -9,6 +9,7 @@
 #include <util/strencodings.h>
 #include <insight/insight.h>
 #include <insight/csindex.h>
+#include <index/coinstatsindex.h>
 #include <index/txindex.h>
 #include <validation.h>
 #include <txmempool.h>
@@ -95,6 +96,16 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint25
     return true;
 }
 
+/** The published view of the active chain, explorer RPCs read through it instead of taking cs_main */
+static std::shared_ptr<const CChainView> GetChainViewForRPC()
+{
+    std::shared_ptr<const CChainView> chain_view = GetChainView();
+    if (!chain_view || !chain_view->Tip()) {
+        throw JSONRPCError(RPC_IN_WARMUP, "Chain not loaded");
+    }
+    return chain_view;
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b)
 {
@@ -228,9 +239,10 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    std::shared_ptr<const CChainView> chain_view = GetChainViewForRPC();
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent(it->first, it->second, unspentOutputs)) {
+        if (!GetAddressUnspent(it->first, it->second, unspentOutputs, chain_view.get())) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
@@ -258,10 +270,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
     if (includeChainInfo) {
         UniValue result(UniValue::VOBJ);
         result.pushKV("utxos", utxos);
-
-        LOCK(cs_main);
-        result.pushKV("hash", ::ChainActive().Tip()->GetBlockHash().GetHex());
-        result.pushKV("height", (int)::ChainActive().Height());
+        result.pushKV("hash", chain_view->Tip()->GetBlockHash().GetHex());
+        result.pushKV("height", chain_view->Height());
         return result;
     } else {
         return utxos;
@@ -333,15 +343,16 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    std::shared_ptr<const CChainView> chain_view = GetChainViewForRPC();
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
         if (start > 0 && end > 0) {
-            if (!GetAddressIndex(it->first, it->second, addressIndex, start, end)) {
+            if (!GetAddressIndex(it->first, it->second, addressIndex, start, end, chain_view.get())) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         } else {
-            if (!GetAddressIndex(it->first, it->second, addressIndex)) {
+            if (!GetAddressIndex(it->first, it->second, addressIndex, 0, 0, chain_view.get())) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         }
@@ -368,14 +379,12 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
     UniValue result(UniValue::VOBJ);
 
     if (includeChainInfo && start > 0 && end > 0) {
-        LOCK(cs_main);
-
-        if (start > ::ChainActive().Height() || end > ::ChainActive().Height()) {
+        if (start > chain_view->Height() || end > chain_view->Height()) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Start or end is outside chain range");
         }
 
-        CBlockIndex* startIndex = ::ChainActive()[start];
-        CBlockIndex* endIndex = ::ChainActive()[end];
+        const CBlockIndex* startIndex = (*chain_view)[start];
+        const CBlockIndex* endIndex = (*chain_view)[end];
 
         UniValue startInfo(UniValue::VOBJ);
         UniValue endInfo(UniValue::VOBJ);
@@ -430,10 +439,11 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    std::shared_ptr<const CChainView> chain_view = GetChainViewForRPC();
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex(it->first, it->second, addressIndex)) {
+        if (!GetAddressIndex(it->first, it->second, addressIndex, 0, 0, chain_view.get())) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
@@ -502,15 +512,16 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
+    std::shared_ptr<const CChainView> chain_view = GetChainViewForRPC();
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
         if (start > 0 && end > 0) {
-            if (!GetAddressIndex(it->first, it->second, addressIndex, start, end)) {
+            if (!GetAddressIndex(it->first, it->second, addressIndex, start, end, chain_view.get())) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         } else {
-            if (!GetAddressIndex(it->first, it->second, addressIndex)) {
+            if (!GetAddressIndex(it->first, it->second, addressIndex, 0, 0, chain_view.get())) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         }
@@ -580,7 +591,7 @@ UniValue getspentinfo(const JSONRPCRequest& request)
     CSpentIndexKey key(txid, outputIndex);
     CSpentIndexValue value;
 
-    if (!GetSpentIndex(key, value)) {
+    if (!GetSpentIndex(key, value, GetChainViewForRPC().get())) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
     }
 
@@ -612,25 +623,26 @@ static void AddAddress(CScript *script, UniValue &uv)
     }
 }
 
-static UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blockindex)
+static void blockToDeltasJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* blockindex, const CChainView& chain_view)
 {
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", block.GetHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (::ChainActive().Contains(blockindex)) {
-        confirmations = ::ChainActive().Height() - blockindex->nHeight + 1;
+    if (chain_view.Contains(blockindex)) {
+        confirmations = chain_view.Height() - blockindex->nHeight + 1;
     } else {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block is an orphan");
     }
-    result.pushKV("confirmations", confirmations);
-    result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
-    result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", block.nVersion);
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    result.pushKV("witnessmerkleroot", block.hashWitnessMerkleRoot.GetHex());
+    writer.BeginObject();
+    writer.PushKV("hash", block.GetHash().GetHex());
+    writer.PushKV("confirmations", confirmations);
+    writer.PushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
+    writer.PushKV("height", blockindex->nHeight);
+    writer.PushKV("version", block.nVersion);
+    writer.PushKV("merkleroot", block.hashMerkleRoot.GetHex());
+    writer.PushKV("witnessmerkleroot", block.hashWitnessMerkleRoot.GetHex());
 
-    UniValue deltas(UniValue::VARR);
+    writer.Key("deltas");
+    writer.BeginArray();
 
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction &tx = *(block.vtx[i]);
@@ -652,7 +664,7 @@ static UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blocki
                 CSpentIndexValue spentInfo;
                 CSpentIndexKey spentKey(input.prevout.hash, input.prevout.n);
 
-                if (GetSpentIndex(spentKey, spentInfo)) {
+                if (GetSpentIndex(spentKey, spentInfo, &chain_view)) {
                     std::string address;
                     if (!getAddressFromIndex(spentInfo.addressType, spentInfo.addressHash, address)) {
                         continue;
@@ -716,23 +728,23 @@ static UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blocki
         }
 
         entry.pushKV("outputs", outputs);
-        deltas.push_back(entry);
+        writer.Value(entry);
 
     }
-    result.pushKV("deltas", deltas);
-    PushTime(result, "time", block.GetBlockTime());
-    PushTime(result, "mediantime", blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
-    result.pushKV("difficulty", GetDifficulty(blockindex));
-    result.pushKV("chainwork", blockindex->nChainWork.GetHex());
+    writer.EndArray();
+    PushTime(writer, "time", block.GetBlockTime());
+    PushTime(writer, "mediantime", blockindex->GetMedianTimePast());
+    writer.PushKV("nonce", (uint64_t)block.nNonce);
+    writer.PushKV("bits", strprintf("%08x", block.nBits));
+    writer.PushKV("difficulty", GetDifficulty(blockindex));
+    writer.PushKV("chainwork", blockindex->nChainWork.GetHex());
 
     if (blockindex->pprev)
-        result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    CBlockIndex *pnext = ::ChainActive().Next(blockindex);
+        writer.PushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+    const CBlockIndex *pnext = chain_view.Next(blockindex);
     if (pnext)
-        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
-    return result;
+        writer.PushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+    writer.EndObject();
 }
 
 static UniValue getblockdeltas(const JSONRPCRequest& request)
@@ -750,27 +762,34 @@ static UniValue getblockdeltas(const JSONRPCRequest& request)
         },
     }.Check(request);
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
-    if (::BlockIndex().count(hash) == 0) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    std::shared_ptr<const CChainView> chain_view = GetChainViewForRPC();
+    const CBlockIndex* pblockindex = chain_view->Find(hash);
+    if (!pblockindex) {
+        LOCK(cs_main);
+        if (!LookupBlockIndex(hash)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block is an orphan");
     }
 
-    CBlock block;
-    CBlockIndex* pblockindex = ::BlockIndex()[hash];
-
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0) {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+    if (fHavePruned) {
+        LOCK(cs_main);
+        if (!(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+        }
     }
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
+    CBlock block;
+    if (!ReadChainViewBlock(block, pblockindex, Params().GetConsensus())) {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
     }
 
-    return blockToDeltasJSON(block, pblockindex);
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        blockToDeltasJSON(writer, block, pblockindex, *chain_view);
+    });
 }
 
 static UniValue getblockhashes(const JSONRPCRequest& request)
@@ -827,11 +846,7 @@ static UniValue getblockhashes(const JSONRPCRequest& request)
 
     std::vector<std::pair<uint256, unsigned int> > blockHashes;
 
-    if (fActiveOnly) {
-        LOCK(cs_main);
-    }
-
-    if (!GetTimestampIndex(high, low, fActiveOnly, blockHashes)) {
+    if (!GetTimestampIndex(high, low, fActiveOnly, blockHashes, GetChainViewForRPC().get())) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
     }
 
@@ -855,17 +870,20 @@ UniValue gettxoutsetinfobyscript(const JSONRPCRequest& request)
 {
             RPCHelpMan{"gettxoutsetinfobyscript",
                 "\nReturns statistics about the unspent transaction output set per script type.\n"
-                "This call may take some time.\n",
+                "This call may take some time without -coinstatsindex.\n",
                 {
+                    {"hash_or_height", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The block hash or height of the target height (only available with coinstatsindex).", "", {"", "string or numeric"}},
+                    {"use_index", RPCArg::Type::BOOL, /* default */ "true", "Use coinstatsindex, if available."},
                 },
                 RPCResult{
             "{\n"
-            "  \"height\":n,     (numeric) The current block height (index)\n"
-            "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
+            "  \"height\":n,     (numeric) The block height (index) of the returned statistics\n"
+            "  \"bestblock\": \"hex\",   (string) The hash of the block at which these statistics are calculated\n"
             "}\n"
                 },
                 RPCExamples{
             HelpExampleCli("gettxoutsetinfobyscript", "") +
+            HelpExampleCli("gettxoutsetinfobyscript", "1000") +
             "\nAs a JSON-RPC call\n"
             + HelpExampleRpc("gettxoutsetinfobyscript", "")
                 },
@@ -873,78 +891,22 @@ UniValue gettxoutsetinfobyscript(const JSONRPCRequest& request)
 
     UniValue ret(UniValue::VOBJ);
 
-    int nHeight;
-    uint256 hashBlock;
-
-    std::unique_ptr<CCoinsViewCursor> pcursor;
-    {
-        LOCK(cs_main);
-        ::ChainstateActive().ForceFlushStateToDisk();
-        pcursor = std::unique_ptr<CCoinsViewCursor>(::ChainstateActive().CoinsDB().Cursor());
-        assert(pcursor);
-        hashBlock = pcursor->GetBestBlock();
-        nHeight = ::BlockIndex().find(hashBlock)->second->nHeight;
+    CCoinsStats stats;
+    if (!GetUTXOStatsForRPC(stats, CoinStatsHashType::NONE, request.params[0], request.params[1])) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
 
-    class PerScriptTypeStats {
-    public:
-        int64_t nPlain = 0;
-        int64_t nBlinded = 0;
-        int64_t nPlainValue = 0;
-
-        UniValue ToUV()
-        {
-            UniValue ret(UniValue::VOBJ);
-            ret.pushKV("num_plain", nPlain);
-            ret.pushKV("num_blinded", nBlinded);
-            ret.pushKV("total_amount", ValueFromAmount(nPlainValue));
-            return ret;
-        }
-    };
-
-    PerScriptTypeStats statsPKH;
-    PerScriptTypeStats statsSH;
-    PerScriptTypeStats statsCSPKH;
-    PerScriptTypeStats statsCSSH;
-    PerScriptTypeStats statsOther;
-
-    uint256 prevkey;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            PerScriptTypeStats *ps = &statsOther;
-            if (coin.out.scriptPubKey.IsPayToPublicKeyHash())
-                ps = &statsPKH;
-            else if (coin.out.scriptPubKey.IsPayToScriptHash())
-                ps = &statsSH;
-            else if (coin.out.scriptPubKey.IsPayToPublicKeyHash256_CS())
-                ps = &statsCSPKH;
-            else if (coin.out.scriptPubKey.IsPayToScriptHash256_CS() || coin.out.scriptPubKey.IsPayToScriptHash_CS() )
-                ps = &statsCSSH;
-
-            if (coin.nType == OUTPUT_STANDARD) {
-                ps->nPlain++;
-                ps->nPlainValue += coin.out.nValue;
-            } else
-            if (coin.nType == OUTPUT_CT) {
-                ps->nBlinded++;
-            }
-        } else {
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
-        }
-        pcursor->Next();
+    ret.pushKV("height", (int64_t)stats.nHeight);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    for (int i = 0; i < COINSTATS_SCRIPT_TYPES; ++i) {
+        const CCoinsScriptTypeStats &script_stats = stats.vScriptTypes[i];
+        UniValue uv(UniValue::VOBJ);
+        uv.pushKV("num_plain", (int64_t)script_stats.nPlain);
+        uv.pushKV("num_blinded", (int64_t)script_stats.nBlinded);
+        uv.pushKV("total_amount", ValueFromAmount(script_stats.nPlainValue));
+        ret.pushKV(CoinStatsScriptTypeName((CoinStatsScriptType)i), uv);
     }
 
-    ret.pushKV("height", (int64_t)nHeight);
-    ret.pushKV("bestblock", hashBlock.GetHex());
-    ret.pushKV("paytopubkeyhash", statsPKH.ToUV());
-    ret.pushKV("paytoscripthash", statsSH.ToUV());
-    ret.pushKV("coldstake_paytopubkeyhash", statsCSPKH.ToUV());
-    ret.pushKV("coldstake_paytoscripthash", statsCSSH.ToUV());
-    ret.pushKV("other", statsOther.ToUV());
-
     return ret;
 }
 
@@ -1021,14 +983,13 @@ UniValue getblockreward(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_MISC_ERROR, "Requires -txindex enabled");
     }
 
+    std::shared_ptr<const CChainView> chain_view = GetChainViewForRPC();
     int nHeight = request.params[0].get_int();
-    if (nHeight < 0 || nHeight > ::ChainActive().Height()) {
+    if (nHeight < 0 || nHeight > chain_view->Height()) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
     }
 
-    LOCK(cs_main);
-
-    CBlockIndex *pblockindex = ::ChainActive()[nHeight];
+    const CBlockIndex *pblockindex = (*chain_view)[nHeight];
 
     CAmount stake_reward = 0;
     if (pblockindex->pprev) {
@@ -1036,7 +997,7 @@ UniValue getblockreward(const JSONRPCRequest& request)
     }
 
     CBlock block;
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
+    if (!ReadChainViewBlock(block, pblockindex, Params().GetConsensus())) {
         throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
     }
 
@@ -1077,10 +1038,9 @@ UniValue getblockreward(const JSONRPCRequest& request)
             continue;
         }
 
-        CBlockIndex *blockindex = nullptr;
         CTransactionRef tx_prev;
         uint256 hashBlock;
-        if (!GetTransaction(txin.prevout.hash, tx_prev, Params().GetConsensus(), hashBlock, blockindex)) {
+        if (!g_txindex->FindTx(txin.prevout.hash, hashBlock, tx_prev)) {
             throw JSONRPCError(RPC_MISC_ERROR, "Transaction not found on disk");
         }
         if (txin.prevout.n > tx_prev->GetNumVOuts()) {
@@ -1172,11 +1132,9 @@ UniValue listcoldstakeunspent(const JSONRPCRequest& request)
 
     CDBWrapper &db = g_txindex->GetDB();
 
-    LOCK(cs_main);
-
     int height = !request.params[1].isNull() ? request.params[1].get_int() : -1;
     if (height == -1) {
-        height = ::ChainActive().Tip()->nHeight;
+        height = GetChainViewForRPC()->Height();
     }
 
     bool mature_only = false;
@@ -1288,6 +1246,7 @@ UniValue getindexinfo(const JSONRPCRequest& request)
             "  \"spentindex\":  xxx         (bool) Is the spentindex enabled.\n"
             "  \"timestampindex\":  xxx     (bool) Is the timestampindex enabled.\n"
             "  \"coldstakeindex\":  xxx     (bool) Is the coldstakeindex enabled.\n"
+            "  \"coinstatsindex\":  xxx     (bool) Is the coinstatsindex enabled.\n"
             "}\n"
                 },
                 RPCExamples{
@@ -1304,6 +1263,7 @@ UniValue getindexinfo(const JSONRPCRequest& request)
     ret.pushKV("spentindex", fSpentIndex);
     ret.pushKV("timestampindex", fTimestampIndex);
     ret.pushKV("coldstakeindex", (bool) (g_txindex && g_txindex->m_cs_index));
+    ret.pushKV("coinstatsindex", (bool) g_coin_stats_index);
 
     return ret;
 }
@@ -1322,7 +1282,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getspentinfo",           &getspentinfo,           {"inputs"} },
     { "blockchain",         "getblockdeltas",         &getblockdeltas,         {} },
     { "blockchain",         "getblockhashes",         &getblockhashes,         {"high","low","options"} },
-    { "blockchain",         "gettxoutsetinfobyscript",&gettxoutsetinfobyscript,{} },
+    { "blockchain",         "gettxoutsetinfobyscript",&gettxoutsetinfobyscript,{"hash_or_height","use_index"} },
     { "blockchain",         "getblockreward",         &getblockreward,         {"height"} },
 
     { "csindex",            "listcoldstakeunspent",   &listcoldstakeunspent,   {"stakeaddress","height","options"} },
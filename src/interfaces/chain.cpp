@@ -114,7 +114,7 @@ class LockImpl : public Chain::Lock, public UniqueLock<CCriticalSection>
     Optional<int> findPruned(int start_height, Optional<int> stop_height) override
     {
         LockAssertion lock(::cs_main);
-        if (::fPruneMode) {
+        if (::fPruneMode || ::fHavePruned) {
             CBlockIndex* block = stop_height ? ::ChainActive()[*stop_height] : ::ChainActive().Tip();
             while (block && block->nHeight >= start_height) {
                 if ((block->nStatus & BLOCK_HAVE_DATA) == 0) {
@@ -147,6 +147,13 @@ class LockImpl : public Chain::Lock, public UniqueLock<CCriticalSection>
         LockAssertion lock(::cs_main);
         return ::ChainActive().GetLocator();
     }
+    CBlockLocator getLocator(int height) override
+    {
+        LockAssertion lock(::cs_main);
+        CBlockIndex* block = ::ChainActive()[height];
+        assert(block != nullptr);
+        return ::ChainActive().GetLocator(block);
+    }
     Optional<int> findLocatorFork(const CBlockLocator& locator) override
     {
         LockAssertion lock(::cs_main);
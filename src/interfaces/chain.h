@@ -120,6 +120,9 @@ public:
         //! Get locator for the current chain tip.
         virtual CBlockLocator getTipLocator() = 0;
 
+        //! Get locator for the block at the given height of the active chain.
+        virtual CBlockLocator getLocator(int height) = 0;
+
         //! Return height of the highest block on chain in common with the locator,
         //! which will either be the original block used to create the locator,
         //! or one of its ancestors.
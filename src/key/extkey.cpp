@@ -7,8 +7,11 @@
 
 #include <key_io.h>
 #include <crypto/hmac_sha512.h>
+#include <util/threadnames.h>
 
 #include <stdint.h>
+#include <algorithm>
+#include <thread>
 
 CCriticalSection cs_extKey;
 
@@ -552,6 +555,43 @@ std::string CStoredExtKey::GetIDString58() const
     return HDKeyIDToString(kp.GetID());
 };
 
+int CStoredExtKey::DeriveKeys(std::vector<CPubKey> &vKeysOut, uint32_t nChildIn, uint32_t nCount, int nThreads) const
+{
+    if ((nChildIn >> 31) == 1 || nCount > (1u << 31) - nChildIn) {
+        return errorN(1, "No more keys can be derived from master.");
+    }
+
+    uint32_t nParts = std::max(1u, std::min((uint32_t)std::max(nThreads, 1), nCount / DERIVE_KEYS_PER_THREAD));
+    if (nParts == 1) {
+        return kp.pubkey.DeriveRange(vKeysOut, nChildIn, nCount, kp.chaincode) ? 0 : errorN(1, "%s: DeriveRange failed.", __func__);
+    }
+
+    std::vector<std::vector<CPubKey> > vParts(nParts);
+    std::vector<char> vFailed(nParts, 0);
+    std::vector<std::thread> threads;
+    for (uint32_t k = 0; k < nParts; ++k) {
+        uint32_t nFirst = nChildIn + (uint64_t)nCount * k / nParts;
+        uint32_t nLast = nChildIn + (uint64_t)nCount * (k + 1) / nParts;
+        threads.emplace_back([this, &vParts, &vFailed, k, nFirst, nLast]() {
+            util::ThreadRename(strprintf("derivekeys.%d", k));
+            vFailed[k] = !kp.pubkey.DeriveRange(vParts[k], nFirst, nLast - nFirst, kp.chaincode);
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    vKeysOut.clear();
+    vKeysOut.reserve(nCount);
+    for (uint32_t k = 0; k < nParts; ++k) {
+        if (vFailed[k]) {
+            return errorN(1, "%s: DeriveRange failed.", __func__);
+        }
+        vKeysOut.insert(vKeysOut.end(), vParts[k].begin(), vParts[k].end());
+    }
+    return 0;
+};
+
 int CStoredExtKey::SetPath(const std::vector<uint32_t> &vPath_)
 {
     if (vPath_.size() < 1) {
@@ -939,6 +979,47 @@ int CExtKeyAccount::AddLookBehind(uint32_t nChain, uint32_t nKeys)
     return 0;
 };
 
+namespace {
+/** Hands out the public keys of consecutive non-hardened children of a chain, derived in batches */
+class ChildKeyBatch
+{
+private:
+    const CStoredExtKey *m_chain;
+    std::vector<CPubKey> m_keys;
+    uint32_t m_first; // child number of m_keys[0]
+    size_t m_pos = 0;
+
+public:
+    ChildKeyBatch(const CStoredExtKey *chain, uint32_t nChild) : m_chain(chain), m_first(nChild) {}
+
+    //! Get the next valid child, nWanted is the number of keys the caller still expects to take
+    int Next(CPubKey &pk, uint32_t &nChildOut, uint32_t nWanted)
+    {
+        for (;;) {
+            if (m_pos >= m_keys.size()) {
+                m_first += m_keys.size();
+                m_pos = 0;
+                m_keys.clear();
+                uint32_t nCount = std::max(nWanted, 1u);
+                if (m_first < (1u << 31)) {
+                    nCount = std::min(nCount, (1u << 31) - m_first);
+                }
+                if (0 != m_chain->DeriveKeys(m_keys, m_first, nCount, GetNumCores())) {
+                    m_keys.clear();
+                    return 1;
+                }
+            }
+            const CPubKey &key = m_keys[m_pos++];
+            if (key.IsValid()) {
+                pk = key;
+                nChildOut = m_first + m_pos - 1;
+                return 0;
+            }
+        }
+    }
+};
+} // namespace
+
 int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
 {
     // Must start from key 0
@@ -955,6 +1036,8 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
         LogPrintf("%s: chain %s, keys %d, from %d.\n", __func__, pc->GetIDString58(), nKeys, nChildOut);
     }
 
+    // Derive the keys in batches rather than one DeriveKey call per key
+    ChildKeyBatch batch(pc, nChild);
     CKeyID keyId;
     CPubKey pk;
     for (uint32_t k = 0; k < nKeys; ++k) {
@@ -962,10 +1045,9 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
 
         uint32_t nMaxTries = 1000; // TODO: link to lookahead size
         for (uint32_t i = 0; i < nMaxTries; ++i) { // nMaxTries > lookahead pool
-            if (pc->DeriveKey(pk, nChild, nChildOut, false) != 0) {
-                LogPrintf("Error: %s - DeriveKey failed, chain %d, child %d.\n", __func__, nChain, nChild);
-                nChild = nChildOut+1;
-                continue;
+            if (batch.Next(pk, nChildOut, nKeys - k) != 0) {
+                LogPrintf("Error: %s - DeriveKeys failed, chain %d, child %d.\n", __func__, nChain, nChildOut + 1);
+                break;
             }
             nChild = nChildOut+1;
 
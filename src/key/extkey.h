@@ -15,6 +15,8 @@
 #include <script/ismine.h>
 
 static const uint32_t MAX_DERIVE_TRIES = 16;
+//! Smallest number of keys DeriveKeys hands to each thread
+static const uint32_t DERIVE_KEYS_PER_THREAD = 512;
 static const uint32_t BIP32_KEY_LEN = 82;       // raw, 74 + 4 bytes id + 4 checksum
 static const uint32_t BIP32_KEY_N_BYTES = 74;   // raw without id and checksum
 
@@ -345,6 +347,13 @@ public:
         return 1;
     };
 
+    /**
+     * Derive the public keys of nCount consecutive non-hardened children from nChildIn,
+     * vKeysOut[i] is the key of child nChildIn + i and is invalid where the child is.
+     * Ranges of more than DERIVE_KEYS_PER_THREAD keys are split over up to nThreads threads.
+     */
+    int DeriveKeys(std::vector<CPubKey> &vKeysOut, uint32_t nChildIn, uint32_t nCount, int nThreads = 1) const;
+
     template<typename T>
     int DeriveNextKey(T &keyOut, uint32_t &nChildOut, bool fHardened = false, bool fUpdate = true)
     {
@@ -30,6 +30,8 @@
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 
+std::unique_ptr<BlockTemplateCache> g_block_template_cache;
+
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
 {
     int64_t nOldTime = pblock->nTime;
@@ -72,7 +74,11 @@ static BlockAssembler::Options DefaultOptions()
     return options;
 }
 
-BlockAssembler::BlockAssembler(const CChainParams& params) : BlockAssembler(params, DefaultOptions()) {}
+BlockAssembler::BlockAssembler(const CChainParams& params) : BlockAssembler(params, DefaultOptions())
+{
+    // The cache selects with the default options
+    m_use_template_cache = true;
+}
 
 void BlockAssembler::resetBlock()
 {
@@ -111,7 +117,6 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     LOCK2(cs_main, mempool.cs);
     CBlockIndex* pindexPrev = ::ChainActive().Tip();
     assert(pindexPrev != nullptr);
-    nHeight = pindexPrev->nHeight + 1;
 
     pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus());
     // -regtest only: allow overriding block.nVersion with
@@ -119,27 +124,21 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     if (chainparams.MineBlocksOnDemand())
         pblock->nVersion = gArgs.GetArg("-blockversion", pblock->nVersion);
 
-    pblock->nTime = GetAdjustedTime();
-    const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
-
-    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
-                       ? nMedianTimePast
-                       : pblock->GetBlockTime();
-
-    // Decide whether to include witness transactions
-    // This is only needed in case the witness softfork activation is reverted
-    // (which would require a very deep reorganization).
-    // Note that the mempool would accept transactions with witness data before
-    // IsWitnessEnabled, but we would only ever mine blocks after IsWitnessEnabled
-    // unless there is a massive block reorganization with the witness softfork
-    // not activated.
-    // TODO: replace this with a call to main to assess validity of a mempool
-    // transaction (which in most cases can be a no-op).
-    fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus());
+    SetChainContext(pindexPrev);
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    bool fCached = false;
+    std::vector<CTxMemPool::txiter> cached_entries;
+    if (m_use_template_cache && g_block_template_cache &&
+        g_block_template_cache->GetSelection(pindexPrev, nLockTimeCutoff, cached_entries)) {
+        fCached = true;
+        for (const auto& it : cached_entries) {
+            AddToBlock(it);
+        }
+    } else {
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    }
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -183,11 +182,61 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants%s), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, fCached ? ", cached" : "", 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
 
+void BlockAssembler::SetChainContext(const CBlockIndex* pindexPrev)
+{
+    nHeight = pindexPrev->nHeight + 1;
+
+    pblock->nTime = GetAdjustedTime();
+    const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
+
+    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                       ? nMedianTimePast
+                       : pblock->GetBlockTime();
+
+    // Decide whether to include witness transactions
+    // This is only needed in case the witness softfork activation is reverted
+    // (which would require a very deep reorganization).
+    // Note that the mempool would accept transactions with witness data before
+    // IsWitnessEnabled, but we would only ever mine blocks after IsWitnessEnabled
+    // unless there is a massive block reorganization with the witness softfork
+    // not activated.
+    // TODO: replace this with a call to main to assess validity of a mempool
+    // transaction (which in most cases can be a no-op).
+    fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus());
+}
+
+void BlockAssembler::SelectTransactions(const CBlockIndex* pindexPrev, std::vector<CTxMemPool::txiter>& selected)
+{
+    resetBlock();
+
+    pblocktemplate.reset(new CBlockTemplate());
+    pblock = &pblocktemplate->block;
+    pblock->vtx.emplace_back();
+    pblocktemplate->vTxFees.push_back(-1);
+    pblocktemplate->vTxSigOpsCost.push_back(-1);
+
+    SetChainContext(pindexPrev);
+
+    int nPackagesSelected = 0;
+    int nDescendantsUpdated = 0;
+    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+
+    selected.clear();
+    selected.reserve(pblock->vtx.size() - 1);
+    for (size_t i = 1; i < pblock->vtx.size(); ++i) {
+        auto it = mempool.mapTx.find(pblock->vtx[i]->GetHash());
+        assert(it != mempool.mapTx.end());
+        selected.push_back(it);
+    }
+    pblocktemplate.reset();
+    pblock = nullptr;
+}
+
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
@@ -438,6 +487,172 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     }
 }
 
+BlockTemplateCache::BlockTemplateCache(const CChainParams& params) : m_chainparams(params)
+{
+    BlockAssembler::Options options = DefaultOptions();
+    m_block_max_weight = std::max<size_t>(4000, std::min<size_t>(MAX_BLOCK_WEIGHT - 4000, options.nBlockMaxWeight));
+    m_block_min_fee_rate = options.blockMinFeeRate;
+}
+
+void BlockTemplateCache::Rebuild(const CBlockIndex* pindexPrev)
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    std::vector<CTxMemPool::txiter> selected;
+    BlockAssembler(m_chainparams).SelectTransactions(pindexPrev, selected);
+
+    m_prev_hash = pindexPrev->GetBlockHash();
+    m_height = pindexPrev->nHeight + 1;
+    m_lock_time_cutoff = pindexPrev->GetMedianTimePast();
+    m_include_witness = IsWitnessEnabled(pindexPrev, m_chainparams.GetConsensus());
+
+    m_txs.clear();
+    m_selected.clear();
+    m_block_weight = 4000;
+    m_block_sigops = 400;
+    for (const auto& it : selected) {
+        m_txs.push_back(SelectedTx{it->GetTx().GetHash(), it->GetTxWeight(), it->GetSigOpCost()});
+        m_selected.insert(it->GetTx().GetHash());
+        m_block_weight += it->GetTxWeight();
+        m_block_sigops += it->GetSigOpCost();
+    }
+    m_stale = false;
+    m_last_rebuild = GetTimeMillis();
+
+    LogPrint(BCLog::BENCH, "%s: %u txs, %.2fms\n", __func__, m_txs.size(), 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
+bool BlockTemplateCache::FindEntries(std::vector<CTxMemPool::txiter>& entries)
+{
+    entries.clear();
+    entries.reserve(m_txs.size());
+    for (const auto& stx : m_txs) {
+        auto it = mempool.mapTx.find(stx.txid);
+        if (it == mempool.mapTx.end()) {
+            // Removal notifications are delivered asynchronously
+            entries.clear();
+            return false;
+        }
+        entries.push_back(it);
+    }
+    return true;
+}
+
+bool BlockTemplateCache::TryAppend(CTxMemPool::txiter it)
+{
+    // A full selection would skip these too
+    if (it->GetModifiedFee() < m_block_min_fee_rate.GetFee(it->GetTxSize())) {
+        return true;
+    }
+    if (!IsFinalTx(it->GetTx(), m_height, m_lock_time_cutoff) ||
+        (!m_include_witness && it->GetTx().HasWitness())) {
+        return true;
+    }
+
+    // Parents that aren't selected may pay for this transaction as a package
+    for (const auto& parent : mempool.GetMemPoolParents(it)) {
+        if (!m_selected.count(parent->GetTx().GetHash())) {
+            return false;
+        }
+    }
+    if (m_block_weight + WITNESS_SCALE_FACTOR * it->GetTxSize() >= m_block_max_weight ||
+        m_block_sigops + it->GetSigOpCost() >= MAX_BLOCK_SIGOPS_COST) {
+        return false;
+    }
+
+    m_txs.push_back(SelectedTx{it->GetTx().GetHash(), it->GetTxWeight(), it->GetSigOpCost()});
+    m_selected.insert(it->GetTx().GetHash());
+    m_block_weight += it->GetTxWeight();
+    m_block_sigops += it->GetSigOpCost();
+    return true;
+}
+
+void BlockTemplateCache::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload) {
+        return;
+    }
+    {
+        LOCK(m_cs_cache);
+        // Nothing is selected until the first template is requested
+        if (m_prev_hash.IsNull()) {
+            return;
+        }
+    }
+    LOCK2(cs_main, mempool.cs);
+    const CBlockIndex* pindexTip = ::ChainActive().Tip();
+    LOCK(m_cs_cache);
+    if (pindexTip && m_prev_hash != pindexTip->GetBlockHash()) {
+        Rebuild(pindexTip);
+    }
+}
+
+void BlockTemplateCache::TransactionAddedToMempool(const CTransactionRef &ptx)
+{
+    {
+        LOCK(m_cs_cache);
+        if (m_prev_hash.IsNull()) {
+            return;
+        }
+    }
+    LOCK2(cs_main, mempool.cs);
+    LOCK(m_cs_cache);
+    // Nothing to extend until the first rebuild, or a rebuild for the new tip is pending
+    if (m_prev_hash.IsNull() || m_prev_hash != ::ChainActive().Tip()->GetBlockHash()) {
+        return;
+    }
+    if (m_selected.count(ptx->GetHash())) {
+        return;
+    }
+    auto it = mempool.mapTx.find(ptx->GetHash());
+    if (it == mempool.mapTx.end()) {
+        return;
+    }
+    if (!TryAppend(it)) {
+        m_stale = true;
+    }
+    if (m_stale && GetTimeMillis() - m_last_rebuild >= TEMPLATE_CACHE_REBUILD_INTERVAL) {
+        Rebuild(::ChainActive().Tip());
+    }
+}
+
+void BlockTemplateCache::TransactionRemovedFromMempool(const CTransactionRef &ptx)
+{
+    LOCK(m_cs_cache);
+    if (!m_selected.erase(ptx->GetHash())) {
+        return;
+    }
+    for (auto it = m_txs.begin(); it != m_txs.end(); ++it) {
+        if (it->txid == ptx->GetHash()) {
+            m_block_weight -= it->weight;
+            m_block_sigops -= it->sigops;
+            m_txs.erase(it);
+            break;
+        }
+    }
+    // Descendants are removed with the transaction, the rest stays valid but
+    // the freed space could be filled.
+    m_stale = true;
+}
+
+bool BlockTemplateCache::GetSelection(const CBlockIndex* pindexPrev, int64_t nLockTimeCutoff, std::vector<CTxMemPool::txiter>& entries)
+{
+    LOCK(m_cs_cache);
+    if (m_prev_hash != pindexPrev->GetBlockHash() ||
+        (m_stale && GetTimeMillis() - m_last_rebuild >= TEMPLATE_CACHE_REBUILD_INTERVAL) ||
+        !FindEntries(entries)) {
+        Rebuild(pindexPrev);
+        if (!FindEntries(entries)) {
+            return false;
+        }
+    }
+    if (m_lock_time_cutoff != nLockTimeCutoff) {
+        entries.clear();
+        return false;
+    }
+    return true;
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
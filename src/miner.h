@@ -8,8 +8,10 @@
 
 #include <optional.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <memory>
 #include <stdint.h>
@@ -24,6 +26,9 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+static const bool DEFAULT_BLOCK_TEMPLATE_CACHE = false;
+/** Minimum time between rebuilds of a stale cached selection, in milliseconds */
+static const int64_t TEMPLATE_CACHE_REBUILD_INTERVAL = 1000;
 
 struct CBlockTemplate
 {
@@ -148,6 +153,9 @@ private:
     int64_t nLockTimeCutoff;
     const CChainParams& chainparams;
 
+    // Take the transactions from g_block_template_cache when it's available
+    bool m_use_template_cache = false;
+
 public:
     struct Options {
         Options();
@@ -161,6 +169,9 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fTestBlockValidity=true);
 
+    /** Run the package selection for a block on pindexPrev, selected is set in block order */
+    void SelectTransactions(const CBlockIndex* pindexPrev, std::vector<CTxMemPool::txiter>& selected) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+
     static Optional<int64_t> m_last_block_num_txs;
     static Optional<int64_t> m_last_block_weight;
 
@@ -168,6 +179,8 @@ private:
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
     void resetBlock();
+    /** Set the height, time, locktime cutoff and witness flag for a block on pindexPrev */
+    void SetChainContext(const CBlockIndex* pindexPrev);
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
 
@@ -198,6 +211,69 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 };
 
+/**
+ * Keeps the package selection for a block on the current tip up to date with
+ * the mempool, so CreateNewBlock doesn't have to walk the whole mempool when a
+ * template is needed right after a tip change or a kernel hit.
+ *
+ * The selection is rebuilt when the tip changes. Transactions added to the
+ * mempool are appended when their in-mempool parents are already selected and
+ * they fit, otherwise the selection is left valid but stale and is rebuilt at
+ * most once per TEMPLATE_CACHE_REBUILD_INTERVAL.
+ *
+ * Nothing is selected or tracked until the first template is requested, so a
+ * node that doesn't stake or mine doesn't pay for the cache.
+ */
+class BlockTemplateCache final : public CValidationInterface
+{
+private:
+    struct SelectedTx {
+        uint256 txid;
+        size_t weight;
+        int64_t sigops;
+    };
+
+    const CChainParams& m_chainparams;
+    unsigned int m_block_max_weight;
+    CFeeRate m_block_min_fee_rate;
+
+    Mutex m_cs_cache;
+    uint256 m_prev_hash GUARDED_BY(m_cs_cache);
+    int m_height GUARDED_BY(m_cs_cache) = 0;
+    int64_t m_lock_time_cutoff GUARDED_BY(m_cs_cache) = 0;
+    bool m_include_witness GUARDED_BY(m_cs_cache) = false;
+    std::vector<SelectedTx> m_txs GUARDED_BY(m_cs_cache);
+    std::set<uint256> m_selected GUARDED_BY(m_cs_cache);
+    uint64_t m_block_weight GUARDED_BY(m_cs_cache) = 0;
+    int64_t m_block_sigops GUARDED_BY(m_cs_cache) = 0;
+    bool m_stale GUARDED_BY(m_cs_cache) = false;
+    int64_t m_last_rebuild GUARDED_BY(m_cs_cache) = 0;
+
+    void Rebuild(const CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs, m_cs_cache);
+    /** Look up the selected transactions in the mempool, fails if any were removed */
+    bool FindEntries(std::vector<CTxMemPool::txiter>& entries) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs, m_cs_cache);
+    /** Returns false if the transaction should be in the block but can't be appended */
+    bool TryAppend(CTxMemPool::txiter it) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs, m_cs_cache);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef &ptx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef &ptx) override;
+
+public:
+    explicit BlockTemplateCache(const CChainParams& params);
+
+    /**
+     * Get the selection for a block on pindexPrev in block order, rebuilding it
+     * first if it's for another tip or stale. Returns false if the selection
+     * was made with a different locktime cutoff.
+     */
+    bool GetSelection(const CBlockIndex* pindexPrev, int64_t nLockTimeCutoff, std::vector<CTxMemPool::txiter>& entries) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+};
+
+/** The global block template cache, may be null. */
+extern std::unique_ptr<BlockTemplateCache> g_block_template_cache;
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
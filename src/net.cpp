@@ -33,6 +33,10 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -77,6 +81,11 @@ enum BindFlags {
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+#ifdef USE_EPOLL
+/** Maximum number of events returned by a single epoll_wait call */
+static const int MAX_EPOLL_EVENTS = 256;
+#endif
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -1005,6 +1014,9 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
 
     LogPrint(BCLog::NET, "connection from %s accepted\n", addr.ToString());
 
+#ifdef USE_EPOLL
+    RegisterSocketEvents(hSocket, true);
+#endif
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
@@ -1167,7 +1179,88 @@ bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
     return !recv_set.empty() || !send_set.empty() || !error_set.empty();
 }
 
-#ifdef USE_POLL
+#ifdef USE_EPOLL
+bool CConnman::RegisterSocketEvents(SOCKET hSocket, bool edge_triggered)
+{
+    if (m_epoll_fd == -1 || hSocket == INVALID_SOCKET) {
+        return false;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+    if (edge_triggered) {
+        event.events |= EPOLLET;
+    }
+    event.data.fd = hSocket;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+        LogPrintf("%s: epoll_ctl failed for socket %d: %s\n", __func__, hSocket, NetworkErrorString(errno));
+        return false;
+    }
+    return true;
+}
+
+void CConnman::ClearSocketReady(SOCKET hSocket, uint32_t events)
+{
+    auto it = m_socket_ready.find(hSocket);
+    if (it == m_socket_ready.end()) {
+        return;
+    }
+    it->second &= ~events;
+    if (it->second == 0) {
+        m_socket_ready.erase(it);
+    }
+}
+
+void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+{
+    // The interest sets are still built to apply fPauseRecv and the send
+    // before receive preference, the sockets themselves stay registered.
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    GenerateSelectSet(recv_select_set, send_select_set, error_select_set);
+
+    // Don't block if an earlier edge left a socket readable or writable that
+    // wasn't drained, e.g. a receive that filled the buffer.
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        m_socket_ready.erase(hListenSocket.socket);
+    }
+    bool fPending = false;
+    for (auto it = m_socket_ready.begin(); it != m_socket_ready.end(); ) {
+        if (!error_select_set.count(it->first)) {
+            // Socket was closed
+            it = m_socket_ready.erase(it);
+            continue;
+        }
+        if (((it->second & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) && recv_select_set.count(it->first))
+            || ((it->second & EPOLLOUT) && send_select_set.count(it->first))) {
+            fPending = true;
+        }
+        ++it;
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(m_epoll_fd, events, MAX_EPOLL_EVENTS, fPending ? 0 : SELECT_TIMEOUT_MILLISECONDS);
+
+    if (interruptNet) return;
+
+    if (nEvents < 0) {
+        int nErr = errno;
+        if (nErr != EINTR) {
+            LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+            return;
+        }
+        nEvents = 0;
+    }
+    for (int i = 0; i < nEvents; ++i) {
+        m_socket_ready[events[i].data.fd] |= events[i].events;
+    }
+
+    for (const auto &it : m_socket_ready) {
+        if ((it.second & (EPOLLIN | EPOLLRDHUP)) && recv_select_set.count(it.first)) recv_set.insert(it.first);
+        if ((it.second & EPOLLOUT) && send_select_set.count(it.first))            send_set.insert(it.first);
+        if ((it.second & (EPOLLERR | EPOLLHUP)) && error_select_set.count(it.first)) error_set.insert(it.first);
+    }
+}
+#elif defined(USE_POLL)
 void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
 {
     std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
@@ -1324,10 +1417,16 @@ void CConnman::SocketHandler()
         bool recvSet = false;
         bool sendSet = false;
         bool errorSet = false;
+#ifdef USE_EPOLL
+        SOCKET hSocket;
+#endif
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
+#ifdef USE_EPOLL
+            hSocket = pnode->hSocket;
+#endif
             recvSet = recv_set.count(pnode->hSocket) > 0;
             sendSet = send_set.count(pnode->hSocket) > 0;
             errorSet = error_set.count(pnode->hSocket) > 0;
@@ -1343,6 +1442,12 @@ void CConnman::SocketHandler()
                     continue;
                 nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
             }
+#ifdef USE_EPOLL
+            // A short read drained the socket, wait for the next edge
+            if (nBytes < (int)sizeof(pchBuf)) {
+                ClearSocketReady(hSocket, EPOLLIN | EPOLLRDHUP);
+            }
+#endif
             if (nBytes > 0)
             {
                 bool notify = false;
@@ -1397,6 +1502,12 @@ void CConnman::SocketHandler()
             if (nBytes) {
                 RecordBytesSent(nBytes);
             }
+#ifdef USE_EPOLL
+            // Data left over means the send buffer is full
+            if (!pnode->vSendMsg.empty()) {
+                ClearSocketReady(hSocket, EPOLLOUT);
+            }
+#endif
         }
 
         InactivityCheck(pnode);
@@ -1980,6 +2091,12 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         pnode->m_manual_connection = true;
 
     m_msgproc->InitializeNode(pnode);
+#ifdef USE_EPOLL
+    {
+        LOCK(pnode->cs_hSocket);
+        RegisterSocketEvents(pnode->hSocket, true);
+    }
+#endif
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
@@ -2117,6 +2234,10 @@ bool CConnman::BindListenPort(const CService& addrBind, std::string& strError, N
     }
 
     vhListenSocket.push_back(ListenSocket(hListenSocket, permissions));
+#ifdef USE_EPOLL
+    // Level triggered, AcceptConnection takes one connection per call
+    RegisterSocketEvents(hListenSocket, false);
+#endif
 
     if (addrBind.IsRoutable() && fDiscover && (permissions & PF_NOBAN) == 0)
         AddLocal(addrBind, LOCAL_BIND);
@@ -2251,6 +2372,18 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         nMaxOutboundCycleStartTime = 0;
     }
 
+#ifdef USE_EPOLL
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+        if (clientInterface) {
+            clientInterface->ThreadSafeMessageBox(
+                strprintf(_("Failed to create epoll instance: %s").translated, NetworkErrorString(errno)),
+                "", CClientUIInterface::MSG_ERROR);
+        }
+        return false;
+    }
+#endif
+
     if (fListen && !InitBinds(connOptions.vBinds, connOptions.vWhiteBinds)) {
         if (clientInterface) {
             clientInterface->ThreadSafeMessageBox(
@@ -2413,6 +2546,13 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+#ifdef USE_EPOLL
+    if (m_epoll_fd != -1) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    m_socket_ready.clear();
+#endif
     semOutbound.reset();
     semAddnode.reset();
 }
@@ -360,6 +360,11 @@ public:
     void InactivityCheck(CNode *pnode);
     bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
     void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+#ifdef USE_EPOLL
+    bool RegisterSocketEvents(SOCKET hSocket, bool edge_triggered);
+    /** Forget readiness reported for hSocket after a read or write consumed it */
+    void ClearSocketReady(SOCKET hSocket, uint32_t events);
+#endif
     void SocketHandler();
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
@@ -471,6 +476,14 @@ public:
 
     CThreadInterrupt interruptNet;
 
+#ifdef USE_EPOLL
+    /** Sockets are registered once when opened and removed by the kernel when closed */
+    int m_epoll_fd{-1};
+    /** Readiness reported by epoll, peer sockets are edge triggered so it's kept
+     *  until a read or write would block. Used only by SocketHandler thread */
+    std::map<SOCKET, uint32_t> m_socket_ready;
+#endif
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
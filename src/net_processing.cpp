@@ -2630,7 +2630,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // If pruning, don't inv blocks unless we have on disk and are likely to still have
             // for some reasonable time window (1 hour) that block relay might require.
             const int nPrunedBlocksLikelyToHave = MIN_BLOCKS_TO_KEEP - 3600 / chainparams.GetConsensus().nPowTargetSpacing;
-            if (fPruneMode && (!(pindex->nStatus & BLOCK_HAVE_DATA) || pindex->nHeight <= ::ChainActive().Tip()->nHeight - nPrunedBlocksLikelyToHave))
+            // A datadir loaded from a snapshot is missing the blocks below the snapshot without prune mode.
+            if ((fPruneMode || fHavePruned) && (!(pindex->nStatus & BLOCK_HAVE_DATA) || (fPruneMode && pindex->nHeight <= ::ChainActive().Tip()->nHeight - nPrunedBlocksLikelyToHave)))
             {
                 LogPrint(BCLog::NET, " getblocks stopping, pruned or too old block at %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
                 break;
@@ -3268,6 +3269,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 
         bool forceProcessing = false;
+        bool fPrecheck = false;
         const uint256 hash(pblock->GetHash());
         {
             LOCK(cs_main);
@@ -3277,14 +3279,28 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
             mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
+            // Blocks that can't be connected yet are checked on the precheck threads
+            fPrecheck = ::ChainstateActive().IsInitialBlockDownload()
+                && ::ChainActive().Tip()->GetBlockHash() != pblock->hashPrevBlock;
         }
-        bool fNewBlock = false;
-        ProcessNewBlock(chainparams, pblock, forceProcessing, &fNewBlock, pfrom->GetId());
-        if (fNewBlock) {
-            pfrom->nLastBlockTime = GetTime();
-        } else {
-            LOCK(cs_main);
-            mapBlockSource.erase(pblock->GetHash());
+
+        const NodeId node_id = pfrom->GetId();
+        const CChainParams* params = &chainparams;
+        auto process_block = [params, connman, pblock, forceProcessing, node_id]() {
+            bool fNewBlock = false;
+            ProcessNewBlock(*params, pblock, forceProcessing, &fNewBlock, node_id);
+            if (fNewBlock) {
+                connman->ForNode(node_id, [](CNode* pnode) {
+                    pnode->nLastBlockTime = GetTime();
+                    return true;
+                });
+            } else {
+                LOCK(cs_main);
+                mapBlockSource.erase(pblock->GetHash());
+            }
+        };
+        if (!fPrecheck || !QueueBlockPrecheck(pblock, process_block)) {
+            process_block();
         }
         return true;
     }
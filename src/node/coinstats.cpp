@@ -8,83 +8,400 @@
 #include <amount.h>
 #include <coins.h>
 #include <chain.h>
+#include <crypto/muhash.h>
 #include <hash.h>
 #include <serialize.h>
+#include <streams.h>
 #include <validation.h>
 #include <uint256.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <map>
+#include <mutex>
+#include <thread>
 
 #include <boost/thread.hpp>
 
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+CoinStatsScriptType GetCoinStatsScriptType(const CScript& script)
+{
+    if (script.IsPayToPublicKeyHash()) {
+        return COINSTATS_PKH;
+    }
+    if (script.IsPayToScriptHash()) {
+        return COINSTATS_SH;
+    }
+    if (script.IsPayToPublicKeyHash256_CS()) {
+        return COINSTATS_CS_PKH;
+    }
+    if (script.IsPayToScriptHash256_CS() || script.IsPayToScriptHash_CS()) {
+        return COINSTATS_CS_SH;
+    }
+    return COINSTATS_OTHER;
+}
+
+const char* CoinStatsScriptTypeName(CoinStatsScriptType type)
+{
+    switch (type) {
+        case COINSTATS_PKH: return "paytopubkeyhash";
+        case COINSTATS_SH: return "paytoscripthash";
+        case COINSTATS_CS_PKH: return "coldstake_paytopubkeyhash";
+        case COINSTATS_CS_SH: return "coldstake_paytoscripthash";
+        default: return "other";
+    }
+}
+
+uint64_t GetBogoSize(const Coin& coin)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + coin.out.scriptPubKey.size() /* scriptPubKey */ +
+           (fParticlMode ? 1 /* nType */ + 33 /* commitment */ : 0);
+}
+
+static void TxOutSer(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+    ss << coin.nType;
+    if (coin.nType == OUTPUT_CT) {
+        ss.write((const char*)&coin.GetCommitment().data[0], 33);
+    }
+}
+
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    muhash.Insert(Span<const unsigned char>((const unsigned char*)ss.data(), ss.size()));
+}
+
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    muhash.Remove(Span<const unsigned char>((const unsigned char*)ss.data(), ss.size()));
+}
+
+template <typename Stream>
+static void ApplyStats(CCoinsStats &stats, Stream& ss, MuHash3072& muhash, CoinStatsHashType hash_type, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
     assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase ? 1u : 0u);
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        ss << hash;
+        ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase ? 1u : 0u);
+    }
     stats.nTransactions++;
     for (const auto& output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << output.second.out.scriptPubKey;
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            ss << VARINT(output.first + 1);
+            ss << output.second.out.scriptPubKey;
+        } else
+        if (hash_type == CoinStatsHashType::MUHASH) {
+            ApplyCoinHash(muhash, COutPoint(hash, output.first), output.second);
+        }
 
+        CCoinsScriptTypeStats &script_stats = stats.vScriptTypes[GetCoinStatsScriptType(output.second.out.scriptPubKey)];
         switch (output.second.nType) {
             case OUTPUT_STANDARD:
-                ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
+                if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+                    ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
+                }
                 stats.nTransactionOutputs++;
                 stats.nTotalAmount += output.second.out.nValue;
+                script_stats.nPlain++;
+                script_stats.nPlainValue += output.second.out.nValue;
                 break;
             case OUTPUT_CT:
-                ss.write((char*)&output.second.commitment.data[0], 33);
+                if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+                    ss.write((char*)&output.second.GetCommitment().data[0], 33);
+                }
                 stats.nBlindTransactionOutputs++;
+                script_stats.nBlinded++;
                 break;
             default:
                 break;
         }
 
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */ +
-                           (fParticlMode ? 1 /* nType */ + 33 /* commitment */ : 0);
+        stats.nBogoSize += GetBogoSize(output.second);
+    }
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        ss << VARINT(0u);
+    }
+}
+
+int GetUTXOScanThreads()
+{
+    int n_threads = gArgs.GetArg("-utxoscanthreads", DEFAULT_UTXO_SCAN_THREADS);
+    if (n_threads <= 0) {
+        n_threads = GetNumCores();
+    }
+    return std::max(1, std::min(n_threads, MAX_UTXO_SCAN_THREADS));
+}
+
+size_t GetUTXOScanPartitions()
+{
+    int n_threads = GetUTXOScanThreads();
+    return n_threads > 1 ? std::min(n_threads * 16, 256) : 1;
+}
+
+bool ScanCoinsCursors(std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors,
+                      const std::function<bool(size_t, CCoinsViewCursor&)>& scan,
+                      const std::function<void(size_t)>& merge)
+{
+    const size_t n_partitions = cursors.size();
+    const size_t n_threads = std::min<size_t>(n_partitions, GetUTXOScanThreads());
+    if (n_threads <= 1) {
+        for (size_t i = 0; i < n_partitions; ++i) {
+            if (!scan(i, *cursors[i])) {
+                return false;
+            }
+            merge(i);
+        }
+        return true;
+    }
+
+    const size_t max_ahead = 2 * n_threads;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<bool> scanned(n_partitions, false);
+    size_t next = 0, merged = 0;
+    bool stop = false, aborted = false;
+    std::exception_ptr error;
+
+    auto fail = [&](std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+            error = e;
+        }
+        stop = true;
+        cond.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            util::ThreadRename(strprintf("utxoscan.%d", t));
+            while (true) {
+                size_t i;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [&] { return stop || next >= n_partitions || next < merged + max_ahead; });
+                    if (stop || next >= n_partitions) {
+                        return;
+                    }
+                    i = next++;
+                }
+                try {
+                    if (!scan(i, *cursors[i])) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        aborted = stop = true;
+                        cond.notify_all();
+                        return;
+                    }
+                } catch (...) {
+                    fail(std::current_exception());
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                scanned[i] = true;
+                cond.notify_all();
+            }
+        });
+    }
+
+    for (size_t i = 0; i < n_partitions; ++i) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&] { return stop || scanned[i]; });
+            if (stop) {
+                break;
+            }
+        }
+        try {
+            merge(i);
+        } catch (...) {
+            fail(std::current_exception());
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        merged = i + 1;
+        cond.notify_all();
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return !aborted;
+}
+
+/** Bytes of the serialized hash a partition may buffer before it waits to write into the hash in key order */
+static const size_t MAX_PARTITION_HASH_BUFFER = 8 << 20;
+
+/** Running totals of one partition of the UTXO set, merged into the result in partition order */
+struct CoinStatsPartition
+{
+    CCoinsStats stats;
+    MuHash3072 muhash;
+    CDataStream ss{SER_GETHASH, PROTOCOL_VERSION};
+};
+
+static void AddStats(CCoinsStats& stats, const CCoinsStats& part)
+{
+    stats.nTransactions += part.nTransactions;
+    stats.nTransactionOutputs += part.nTransactionOutputs;
+    stats.nBlindTransactionOutputs += part.nBlindTransactionOutputs;
+    stats.nBogoSize += part.nBogoSize;
+    stats.nTotalAmount += part.nTotalAmount;
+    for (int i = 0; i < COINSTATS_SCRIPT_TYPES; ++i) {
+        stats.vScriptTypes[i].nPlain += part.vScriptTypes[i].nPlain;
+        stats.vScriptTypes[i].nBlinded += part.vScriptTypes[i].nBlinded;
+        stats.vScriptTypes[i].nPlainValue += part.vScriptTypes[i].nPlainValue;
     }
-    ss << VARINT(0u);
 }
 
 //! Calculate statistics about the unspent transaction output set
-bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats, CoinStatsHashType hash_type)
 {
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors = view->PartitionedCursors(GetUTXOScanPartitions());
+    assert(!cursors.empty());
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
+    MuHash3072 muhash;
+    stats.hashBlock = cursors[0]->GetBestBlock();
     {
         LOCK(cs_main);
-        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
-    }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
+        const CBlockIndex *pindex = LookupBlockIndex(stats.hashBlock);
+        stats.nHeight = pindex->nHeight;
+        stats.nAnonOutputs = pindex->nAnonOutputs;
+        stats.nMoneySupply = pindex->nMoneySupply;
+    }
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        ss << stats.hashBlock;
+    }
+
+    // Partitions never split the outputs of a transaction, the serialized hash is
+    // fed the partitions in key order so it matches a single cursor scan.
+    // The partition next in order writes into the hash directly, the others
+    // buffer up to MAX_PARTITION_HASH_BUFFER and then wait for their turn.
+    std::vector<CoinStatsPartition> parts(cursors.size());
+    std::atomic<size_t> hash_turn{0};
+    std::mutex turn_mutex;
+    std::condition_variable turn_cond;
+    bool turn_abort = false;
+    auto take_turn = [&](size_t i) {
+        std::unique_lock<std::mutex> lock(turn_mutex);
+        turn_cond.wait(lock, [&] { return turn_abort || hash_turn == i; });
+        return !turn_abort;
+    };
+    auto end_turn = [&](size_t next, bool abort) {
+        {
+            std::lock_guard<std::mutex> lock(turn_mutex);
+            if (abort) {
+                turn_abort = true;
+            } else {
+                hash_turn = next;
             }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
         }
-        pcursor->Next();
+        turn_cond.notify_all();
+    };
+
+    auto scan_partition = [&](size_t i, CCoinsViewCursor& cursor) {
+        CoinStatsPartition& part = parts[i];
+        bool direct = false;
+        auto apply = [&](const uint256& hash, const std::map<uint32_t, Coin>& outputs) {
+            if (hash_type == CoinStatsHashType::HASH_SERIALIZED && !direct &&
+                (hash_turn == i || part.ss.size() >= MAX_PARTITION_HASH_BUFFER)) {
+                if (!take_turn(i)) {
+                    return false;
+                }
+                ss.write(part.ss.data(), part.ss.size());
+                part.ss.clear();
+                direct = true;
+            }
+            if (direct) {
+                ApplyStats(part.stats, ss, part.muhash, hash_type, hash, outputs);
+            } else {
+                ApplyStats(part.stats, part.ss, part.muhash, hash_type, hash, outputs);
+            }
+            return true;
+        };
+
+        uint256 prevkey;
+        std::map<uint32_t, Coin> outputs;
+        while (cursor.Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (cursor.GetKey(key) && cursor.GetValue(coin)) {
+                if (!outputs.empty() && key.hash != prevkey) {
+                    if (!apply(prevkey, outputs)) {
+                        return false;
+                    }
+                    outputs.clear();
+                }
+                prevkey = key.hash;
+                outputs[key.n] = std::move(coin);
+            } else {
+                return error("%s: unable to read value", __func__);
+            }
+            cursor.Next();
+        }
+        if (!outputs.empty()) {
+            return apply(prevkey, outputs);
+        }
+        return true;
+    };
+    auto scan = [&](size_t i, CCoinsViewCursor& cursor) {
+        bool rv = false;
+        try {
+            rv = scan_partition(i, cursor);
+        } catch (...) {
+            end_turn(0, true);
+            throw;
+        }
+        if (!rv) {
+            // Partitions waiting for their turn give up
+            end_turn(0, true);
+        }
+        return rv;
+    };
+    auto merge = [&](size_t i) {
+        try {
+            boost::this_thread::interruption_point();
+        } catch (...) {
+            end_turn(0, true);
+            throw;
+        }
+        CoinStatsPartition& part = parts[i];
+        AddStats(stats, part.stats);
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            ss.write(part.ss.data(), part.ss.size());
+            part.ss = CDataStream(SER_GETHASH, PROTOCOL_VERSION);
+        } else
+        if (hash_type == CoinStatsHashType::MUHASH) {
+            muhash *= part.muhash;
+        }
+        end_turn(i + 1, false);
+    };
+    if (!ScanCoinsCursors(cursors, scan, merge)) {
+        return false;
     }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
+
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        stats.hashSerialized = ss.GetHash();
+    } else
+    if (hash_type == CoinStatsHashType::MUHASH) {
+        muhash.Finalize(stats.hashSerialized);
     }
-    stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
@@ -7,11 +7,57 @@
 #define BITCOIN_NODE_COINSTATS_H
 
 #include <amount.h>
+#include <serialize.h>
 #include <uint256.h>
 
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
 
 class CCoinsView;
+class CCoinsViewCursor;
+class CScript;
+class Coin;
+class COutPoint;
+class MuHash3072;
+
+//! -utxoscanthreads default, 0 = one per core
+static constexpr int DEFAULT_UTXO_SCAN_THREADS = 0;
+//! Maximum number of threads scanning the UTXO set
+static constexpr int MAX_UTXO_SCAN_THREADS = 16;
+
+enum class CoinStatsHashType {
+    HASH_SERIALIZED,
+    MUHASH,
+    NONE,
+};
+
+/** Script types the unspent output totals are split by */
+enum CoinStatsScriptType {
+    COINSTATS_PKH = 0,
+    COINSTATS_SH,
+    COINSTATS_CS_PKH,
+    COINSTATS_CS_SH,
+    COINSTATS_OTHER,
+    COINSTATS_SCRIPT_TYPES,
+};
+
+struct CCoinsScriptTypeStats
+{
+    uint64_t nPlain = 0;
+    uint64_t nBlinded = 0;
+    CAmount nPlainValue = 0;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nPlain);
+        READWRITE(nBlinded);
+        READWRITE(nPlainValue);
+    }
+};
 
 struct CCoinsStats
 {
@@ -25,10 +71,49 @@ struct CCoinsStats
     CAmount nTotalAmount;
     uint64_t nBlindTransactionOutputs;
 
+    //! Anon outputs created up to this block, they are not part of the UTXO set
+    int64_t nAnonOutputs = 0;
+    CAmount nMoneySupply = 0;
+    //! Total amount sent to provably unspendable outputs, only available from the coinstatsindex
+    CAmount nUnspendableAmount = 0;
+    CCoinsScriptTypeStats vScriptTypes[COINSTATS_SCRIPT_TYPES];
+
+    //! Signals if the coinstatsindex was used to retrieve the statistics.
+    bool index_used = false;
+
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0), nBlindTransactionOutputs(0) {}
 };
 
+//! Number of threads full scans of the UTXO set are split over
+int GetUTXOScanThreads();
+//! Number of partitions full scans of the UTXO set are split into, several per thread to balance the load
+size_t GetUTXOScanPartitions();
+
+/**
+ * Scan the partitions of the UTXO set returned by CCoinsView::PartitionedCursors on
+ * GetUTXOScanThreads() threads.
+ * scan(i, cursor) runs on a worker for each partition, merge(i) runs on the calling
+ * thread in partition order once partition i has been scanned, so results can be
+ * combined exactly as a single ordered scan would. Workers stay at most a few
+ * partitions ahead of the merge to bound the memory held by unmerged results.
+ * Returns false if any scan returned false, which stops the remaining partitions.
+ * The first exception thrown by scan or merge is rethrown once the workers stopped.
+ */
+bool ScanCoinsCursors(std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors,
+                      const std::function<bool(size_t, CCoinsViewCursor&)>& scan,
+                      const std::function<void(size_t)>& merge);
+
 //! Calculate statistics about the unspent transaction output set
-bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats);
+bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, CoinStatsHashType hash_type = CoinStatsHashType::HASH_SERIALIZED);
+
+CoinStatsScriptType GetCoinStatsScriptType(const CScript& script);
+const char* CoinStatsScriptTypeName(CoinStatsScriptType type);
+
+//! Bytes counted towards the bogosize of an unspent output
+uint64_t GetBogoSize(const Coin& coin);
+
+//! Add or remove an unspent output from a running MuHash of the UTXO set
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
 
 #endif // BITCOIN_NODE_COINSTATS_H
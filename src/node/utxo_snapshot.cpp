@@ -0,0 +1,525 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/utxo_snapshot.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <hash.h>
+#include <rctindex.h>
+#include <shutdown.h>
+#include <streams.h>
+#include <sync.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+/** Records are buffered and written out in chunks of this size */
+constexpr size_t SNAPSHOT_WRITE_CHUNK = 1 << 20;
+/** Number of records collected before a database batch is written on load */
+constexpr size_t SNAPSHOT_LOAD_BATCH = 10000;
+
+fs::path SectionPath(const fs::path& path, int section)
+{
+    return path.string() + "." + SnapshotSectionName((SnapshotSectionType)section);
+}
+
+void CheckShutdown(uint64_t count)
+{
+    if (count % 10000 == 0 && ShutdownRequested()) {
+        throw std::runtime_error("Shutdown requested");
+    }
+}
+
+/** Run fn for every section on its own thread, returns false with the first error if any failed */
+bool ForEachSection(const std::function<void(int)>& fn, std::string& error)
+{
+    std::string errors[SNAPSHOT_SECTIONS];
+    std::vector<std::thread> threads;
+    for (int i = 0; i < SNAPSHOT_SECTIONS; ++i) {
+        threads.emplace_back([&fn, &errors, i]() {
+            util::ThreadRename(strprintf("snapshot.%d", i));
+            try {
+                fn(i);
+            } catch (const std::exception& e) {
+                errors[i] = e.what();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (int i = 0; i < SNAPSHOT_SECTIONS; ++i) {
+        if (!errors[i].empty()) {
+            error = strprintf("Snapshot %s section: %s", SnapshotSectionName((SnapshotSectionType)i), errors[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Serializes the records of one section to its own file, hashing the bytes as they are written */
+class SectionWriter
+{
+private:
+    CAutoFile m_file;
+    CDataStream m_buffer;
+    CHashWriter m_hasher;
+    SnapshotSection& m_section;
+
+    void Flush()
+    {
+        if (m_buffer.empty()) {
+            return;
+        }
+        m_file.write(m_buffer.data(), m_buffer.size());
+        m_hasher.write(m_buffer.data(), m_buffer.size());
+        m_section.m_size += m_buffer.size();
+        m_buffer.clear();
+    }
+
+public:
+    SectionWriter(const fs::path& path, SnapshotSection& section)
+        : m_file(fsbridge::fopen(path, "wb"), SER_DISK, SNAPSHOT_STREAM_VERSION),
+          m_buffer(SER_DISK, SNAPSHOT_STREAM_VERSION),
+          m_hasher(SER_DISK, SNAPSHOT_STREAM_VERSION),
+          m_section(section)
+    {
+        if (m_file.IsNull()) {
+            throw std::runtime_error(strprintf("Unable to open %s", path.string()));
+        }
+        m_section = SnapshotSection();
+    }
+
+    template<typename... Args>
+    void Add(const Args&... args)
+    {
+        ::SerializeMany(m_buffer, args...);
+        CheckShutdown(++m_section.m_count);
+        if (m_buffer.size() >= SNAPSHOT_WRITE_CHUNK) {
+            Flush();
+        }
+    }
+
+    void Finish()
+    {
+        Flush();
+        if (!FileCommit(m_file.Get())) {
+            throw std::runtime_error("Failed to commit file");
+        }
+        m_file.fclose();
+        m_section.m_hash = m_hasher.GetHash();
+    }
+};
+
+/** Opens a snapshot file positioned at the start of a section */
+FILE* OpenSection(const fs::path& path, const SnapshotSection& section)
+{
+    FILE* file = fsbridge::fopen(path, "rb");
+    if (!file) {
+        throw std::runtime_error(strprintf("Unable to open %s", path.string()));
+    }
+    if (fseek(file, section.m_offset, SEEK_SET) != 0) {
+        fclose(file);
+        throw std::runtime_error("Unable to seek to section");
+    }
+    return file;
+}
+
+uint256 HashSection(const fs::path& path, const SnapshotSection& section)
+{
+    CAutoFile file(OpenSection(path, section), SER_DISK, SNAPSHOT_STREAM_VERSION);
+    CHashWriter hasher(SER_DISK, SNAPSHOT_STREAM_VERSION);
+    std::vector<char> buffer(SNAPSHOT_WRITE_CHUNK);
+    uint64_t remaining = section.m_size;
+    while (remaining > 0) {
+        size_t n = std::min<uint64_t>(remaining, buffer.size());
+        file.read(buffer.data(), n);
+        hasher.write(buffer.data(), n);
+        remaining -= n;
+    }
+    return hasher.GetHash();
+}
+
+void CheckSectionEnd(CAutoFile& file, const SnapshotSection& section)
+{
+    if ((uint64_t)ftell(file.Get()) != section.m_offset + section.m_size) {
+        throw std::runtime_error("Section size mismatch");
+    }
+}
+
+} // namespace
+
+const char* SnapshotSectionName(SnapshotSectionType type)
+{
+    switch (type) {
+        case SNAPSHOT_BLOCK_INDEX: return "blockindex";
+        case SNAPSHOT_COINS: return "coins";
+        case SNAPSHOT_RCT_OUTPUTS: return "rctoutputs";
+        case SNAPSHOT_KEY_IMAGES: return "keyimages";
+        default: return "unknown";
+    }
+}
+
+uint256 SnapshotMetadata::GetSnapshotHash() const
+{
+    CHashWriter ss(SER_GETHASH, SNAPSHOT_STREAM_VERSION);
+    ss << m_magic << m_version << m_base_blockhash << m_base_height;
+    for (int i = 0; i < SNAPSHOT_SECTIONS; ++i) {
+        ss << m_sections[i];
+    }
+    return ss.GetHash();
+}
+
+bool WriteUTXOSnapshot(CChainState& chainstate, const fs::path& path, SnapshotMetadata& metadata, std::string& error)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::unique_ptr<CCoinsViewCursor> coins_cursor;
+    std::unique_ptr<CDBIterator> rct_cursor, key_image_cursor;
+    std::vector<const CBlockIndex*> chain;
+    {
+        LOCK(cs_main);
+        // LevelDB iterators read from an implicit snapshot, once they exist the
+        // chainstate and RCT tables stay consistent with the tip without cs_main.
+        chainstate.ForceFlushStateToDisk();
+        const CBlockIndex* tip = chainstate.m_chain.Tip();
+        if (!tip) {
+            error = "No chain tip";
+            return false;
+        }
+        coins_cursor.reset(chainstate.CoinsDB().Cursor());
+        if (coins_cursor->GetBestBlock() != tip->GetBlockHash()) {
+            error = "Chainstate is not flushed to the tip";
+            return false;
+        }
+        rct_cursor.reset(pblocktree->NewIterator());
+        key_image_cursor.reset(pblocktree->NewIterator());
+
+        chain.resize(tip->nHeight + 1);
+        for (const CBlockIndex* pindex = tip; pindex; pindex = pindex->pprev) {
+            chain[pindex->nHeight] = pindex;
+        }
+
+        metadata = SnapshotMetadata();
+        metadata.m_base_blockhash = tip->GetBlockHash();
+        metadata.m_base_height = tip->nHeight;
+    }
+
+    bool fSuccess = ForEachSection([&](int section) {
+        SectionWriter writer(SectionPath(path, section), metadata.m_sections[section]);
+        switch (section) {
+            case SNAPSHOT_BLOCK_INDEX:
+                for (size_t i = 0; i < chain.size(); i += SNAPSHOT_LOAD_BATCH) {
+                    std::vector<CDiskBlockIndex> entries;
+                    {
+                        // Copy in chunks, the status fields can change under cs_main
+                        LOCK(cs_main);
+                        for (size_t k = i; k < std::min(chain.size(), i + SNAPSHOT_LOAD_BATCH); ++k) {
+                            CDiskBlockIndex entry(chain[k]);
+                            entry.nStatus &= ~BLOCK_HAVE_MASK;
+                            entry.nFile = 0;
+                            entry.nDataPos = 0;
+                            entry.nUndoPos = 0;
+                            entries.push_back(entry);
+                        }
+                    }
+                    for (const auto& entry : entries) {
+                        writer.Add(entry);
+                    }
+                }
+                break;
+            case SNAPSHOT_COINS:
+                for (; coins_cursor->Valid(); coins_cursor->Next()) {
+                    COutPoint key;
+                    Coin coin;
+                    if (!coins_cursor->GetKey(key) || !coins_cursor->GetValue(coin)) {
+                        throw std::runtime_error("Unable to read UTXO set");
+                    }
+                    writer.Add(key, coin);
+                }
+                break;
+            case SNAPSHOT_RCT_OUTPUTS:
+                for (rct_cursor->Seek(DB_RCTOUTPUT); rct_cursor->Valid(); rct_cursor->Next()) {
+                    std::pair<char, int64_t> key;
+                    if (!rct_cursor->GetKey(key) || key.first != DB_RCTOUTPUT) {
+                        break;
+                    }
+                    CAnonOutput ao;
+                    if (!rct_cursor->GetValue(ao)) {
+                        throw std::runtime_error("Unable to read anon output");
+                    }
+                    writer.Add(key.second, ao);
+                }
+                break;
+            case SNAPSHOT_KEY_IMAGES:
+                for (key_image_cursor->Seek(DB_RCTKEYIMAGE); key_image_cursor->Valid(); key_image_cursor->Next()) {
+                    std::pair<char, CCmpPubKey> key;
+                    if (!key_image_cursor->GetKey(key) || key.first != DB_RCTKEYIMAGE) {
+                        break;
+                    }
+                    uint256 txid;
+                    if (!key_image_cursor->GetValue(txid)) {
+                        throw std::runtime_error("Unable to read key image");
+                    }
+                    writer.Add(key.second, txid);
+                }
+                break;
+        }
+        writer.Finish();
+    }, error);
+
+    if (fSuccess) {
+        // Sections are laid out after the fixed size header in order
+        uint64_t offset = ::GetSerializeSize(metadata, SNAPSHOT_STREAM_VERSION);
+        for (auto& section : metadata.m_sections) {
+            section.m_offset = offset;
+            offset += section.m_size;
+        }
+        metadata.m_snapshot_hash = metadata.GetSnapshotHash();
+
+        try {
+            CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, SNAPSHOT_STREAM_VERSION);
+            if (file.IsNull()) {
+                throw std::runtime_error(strprintf("Unable to open %s", path.string()));
+            }
+            file << metadata;
+            std::vector<char> buffer(SNAPSHOT_WRITE_CHUNK);
+            for (int i = 0; i < SNAPSHOT_SECTIONS; ++i) {
+                CAutoFile section_file(fsbridge::fopen(SectionPath(path, i), "rb"), SER_DISK, SNAPSHOT_STREAM_VERSION);
+                if (section_file.IsNull()) {
+                    throw std::runtime_error("Unable to reopen section");
+                }
+                uint64_t remaining = metadata.m_sections[i].m_size;
+                while (remaining > 0) {
+                    size_t n = std::min<uint64_t>(remaining, buffer.size());
+                    section_file.read(buffer.data(), n);
+                    file.write(buffer.data(), n);
+                    remaining -= n;
+                }
+            }
+            if (!FileCommit(file.Get())) {
+                throw std::runtime_error("Failed to commit file");
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+            fSuccess = false;
+        }
+    }
+
+    for (int i = 0; i < SNAPSHOT_SECTIONS; ++i) {
+        fs::remove(SectionPath(path, i));
+    }
+    if (!fSuccess) {
+        return false;
+    }
+
+    LogPrintf("Wrote snapshot of block %s at height %d, %u coins, %u anon outputs, %u key images in %dms\n",
+        metadata.m_base_blockhash.ToString(), metadata.m_base_height,
+        metadata.m_sections[SNAPSHOT_COINS].m_count, metadata.m_sections[SNAPSHOT_RCT_OUTPUTS].m_count,
+        metadata.m_sections[SNAPSHOT_KEY_IMAGES].m_count, GetTimeMillis() - nStart);
+    return true;
+}
+
+bool LoadUTXOSnapshot(const CChainParams& chainparams, const fs::path& path, CBlockTreeDB& blocktree, size_t coins_db_cache, SnapshotMetadata& metadata, std::string& error)
+{
+    int64_t nStart = GetTimeMillis();
+
+    try {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, SNAPSHOT_STREAM_VERSION);
+        if (file.IsNull()) {
+            error = strprintf("Unable to open snapshot file %s", path.string());
+            return false;
+        }
+        file >> metadata;
+        if (fseek(file.Get(), 0, SEEK_END) != 0) {
+            error = "Unable to read snapshot file size";
+            return false;
+        }
+        const SnapshotSection& last = metadata.m_sections[SNAPSHOT_SECTIONS - 1];
+        if ((uint64_t)ftell(file.Get()) != last.m_offset + last.m_size) {
+            error = "Snapshot file is truncated";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        error = strprintf("Unable to read snapshot header: %s", e.what());
+        return false;
+    }
+
+    if (metadata.m_magic != SNAPSHOT_MAGIC || metadata.m_version != SNAPSHOT_VERSION) {
+        error = "Unknown snapshot format";
+        return false;
+    }
+    if (metadata.m_snapshot_hash != metadata.GetSnapshotHash()) {
+        error = "Snapshot header is corrupt";
+        return false;
+    }
+    const auto it_expected = chainparams.SnapshotHashes().find(metadata.m_base_height);
+    if (it_expected != chainparams.SnapshotHashes().end()) {
+        if (it_expected->second != metadata.m_snapshot_hash) {
+            error = strprintf("Snapshot hash %s does not match the known hash for height %d", metadata.m_snapshot_hash.ToString(), metadata.m_base_height);
+            return false;
+        }
+    } else
+    if (chainparams.NetworkIDString() != CBaseChainParams::REGTEST) {
+        error = strprintf("No known snapshot hash for height %d, snapshots can only be loaded at known heights", metadata.m_base_height);
+        return false;
+    } else {
+        LogPrintf("Warning: No known snapshot hash for height %d, trusting %s\n", metadata.m_base_height, path.string());
+    }
+
+    LogPrintf("Verifying snapshot %s of block %s at height %d\n", metadata.m_snapshot_hash.ToString(), metadata.m_base_blockhash.ToString(), metadata.m_base_height);
+    if (!ForEachSection([&](int section) {
+        if (HashSection(path, metadata.m_sections[section]) != metadata.m_sections[section].m_hash) {
+            throw std::runtime_error("Hash mismatch");
+        }
+    }, error)) {
+        return false;
+    }
+
+    const uint256& genesis_hash = chainparams.GetConsensus().hashGenesisBlock;
+    {
+        CCoinsViewDB coins_db(GetDataDir() / "chainstate", coins_db_cache, false, false);
+        uint256 best_block = coins_db.GetBestBlock();
+        if (!coins_db.GetHeadBlocks().empty() || (!best_block.IsNull() && best_block != genesis_hash)) {
+            error = "A snapshot can only be loaded into an empty chainstate";
+            return false;
+        }
+    }
+    // Drop the genesis outputs if the node has been started before
+    CCoinsViewDB coins_db(GetDataDir() / "chainstate", coins_db_cache, false, true);
+
+    LogPrintf("Loading snapshot %s\n", path.string());
+    if (!ForEachSection([&](int section) {
+        const SnapshotSection& info = metadata.m_sections[section];
+        CAutoFile file(OpenSection(path, info), SER_DISK, SNAPSHOT_STREAM_VERSION);
+        switch (section) {
+            case SNAPSHOT_BLOCK_INDEX: {
+                if (info.m_count != (uint64_t)metadata.m_base_height + 1) {
+                    throw std::runtime_error("Unexpected number of entries");
+                }
+                uint256 prev_hash;
+                std::vector<std::pair<uint256, CDiskBlockIndex> > entries;
+                for (uint64_t i = 0; i < info.m_count; ++i) {
+                    CDiskBlockIndex entry;
+                    file >> entry;
+                    uint256 hash = entry.GetBlockHash();
+                    if (entry.nHeight != (int)i || entry.hashPrev != prev_hash
+                        || !entry.IsValid(BLOCK_VALID_SCRIPTS) || (entry.nStatus & BLOCK_HAVE_MASK)
+                        || (i == 0 && hash != genesis_hash)) {
+                        throw std::runtime_error(strprintf("Invalid entry at height %d", i));
+                    }
+                    prev_hash = hash;
+                    entries.emplace_back(hash, entry);
+                    if (entries.size() >= SNAPSHOT_LOAD_BATCH) {
+                        if (!blocktree.WriteSnapshotBlockIndex(entries)) {
+                            throw std::runtime_error("Database write failed");
+                        }
+                        entries.clear();
+                    }
+                    CheckShutdown(i + 1);
+                }
+                if (prev_hash != metadata.m_base_blockhash) {
+                    throw std::runtime_error("Chain does not end at the base block");
+                }
+                if (!blocktree.WriteSnapshotBlockIndex(entries)) {
+                    throw std::runtime_error("Database write failed");
+                }
+                break;
+            }
+            case SNAPSHOT_COINS: {
+                std::vector<std::pair<COutPoint, Coin> > coins;
+                for (uint64_t i = 0; i < info.m_count; ++i) {
+                    COutPoint outpoint;
+                    Coin coin;
+                    file >> outpoint >> coin;
+                    if (coin.nHeight > (uint32_t)metadata.m_base_height) {
+                        throw std::runtime_error(strprintf("Coin %s is above the base height", outpoint.ToString()));
+                    }
+                    coins.emplace_back(std::move(outpoint), std::move(coin));
+                    if (coins.size() >= SNAPSHOT_LOAD_BATCH) {
+                        if (!coins_db.WriteSnapshotCoins(coins, metadata.m_base_blockhash)) {
+                            throw std::runtime_error("Database write failed");
+                        }
+                        coins.clear();
+                    }
+                    CheckShutdown(i + 1);
+                }
+                if (!coins_db.WriteSnapshotCoins(coins, metadata.m_base_blockhash)) {
+                    throw std::runtime_error("Database write failed");
+                }
+                break;
+            }
+            case SNAPSHOT_RCT_OUTPUTS: {
+                CDBBatch batch(blocktree);
+                for (uint64_t i = 0; i < info.m_count; ++i) {
+                    int64_t index;
+                    CAnonOutput ao;
+                    file >> index >> ao;
+                    batch.Write(std::make_pair(DB_RCTOUTPUT, index), ao);
+                    batch.Write(std::make_pair(DB_RCTOUTPUT_LINK, ao.pubkey), index);
+                    if ((i + 1) % SNAPSHOT_LOAD_BATCH == 0) {
+                        if (!blocktree.WriteBatch(batch)) {
+                            throw std::runtime_error("Database write failed");
+                        }
+                        batch.Clear();
+                    }
+                    CheckShutdown(i + 1);
+                }
+                if (!blocktree.WriteBatch(batch)) {
+                    throw std::runtime_error("Database write failed");
+                }
+                break;
+            }
+            case SNAPSHOT_KEY_IMAGES: {
+                CDBBatch batch(blocktree);
+                for (uint64_t i = 0; i < info.m_count; ++i) {
+                    CCmpPubKey ki;
+                    uint256 txid;
+                    file >> ki >> txid;
+                    batch.Write(std::make_pair(DB_RCTKEYIMAGE, ki), txid);
+                    if ((i + 1) % SNAPSHOT_LOAD_BATCH == 0) {
+                        if (!blocktree.WriteBatch(batch)) {
+                            throw std::runtime_error("Database write failed");
+                        }
+                        batch.Clear();
+                    }
+                    CheckShutdown(i + 1);
+                }
+                if (!blocktree.WriteBatch(batch)) {
+                    throw std::runtime_error("Database write failed");
+                }
+                break;
+            }
+        }
+        CheckSectionEnd(file, info);
+    }, error)) {
+        error += ", remove the chainstate and blocks directories before retrying";
+        return false;
+    }
+
+    // Blocks below the base are never downloaded, the datadir is pruned from the start.
+    // loadedsnapshot lets the node run without -prune, Particl doesn't support pruning yet.
+    if (!blocktree.WriteFlag("prunedblockfiles", true)
+        || !blocktree.WriteFlag("loadedsnapshot", true)
+        || !coins_db.FinishSnapshot(metadata.m_base_blockhash)) {
+        error = "Database write failed, remove the chainstate and blocks directories before retrying";
+        return false;
+    }
+
+    LogPrintf("Loaded snapshot of block %s at height %d, %u coins, %u anon outputs, %u key images in %dms\n",
+        metadata.m_base_blockhash.ToString(), metadata.m_base_height,
+        metadata.m_sections[SNAPSHOT_COINS].m_count, metadata.m_sections[SNAPSHOT_RCT_OUTPUTS].m_count,
+        metadata.m_sections[SNAPSHOT_KEY_IMAGES].m_count, GetTimeMillis() - nStart);
+    return true;
+}
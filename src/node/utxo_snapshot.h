@@ -0,0 +1,102 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_NODE_UTXO_SNAPSHOT_H
+#define PARTICL_NODE_UTXO_SNAPSHOT_H
+
+#include <fs.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <string>
+
+class CBlockTreeDB;
+class CChainParams;
+class CChainState;
+
+/** Magic bytes at the start of a snapshot file */
+static constexpr uint32_t SNAPSHOT_MAGIC = 0x70736e70;
+static constexpr uint32_t SNAPSHOT_VERSION = 1;
+/** Fixed stream version so the section hashes don't depend on the client version that wrote them */
+static constexpr int SNAPSHOT_STREAM_VERSION = 180100;
+
+/** Sections of a snapshot file, each is written and read by its own thread */
+enum SnapshotSectionType {
+    SNAPSHOT_BLOCK_INDEX = 0,   //! CDiskBlockIndex entries of the active chain from genesis to the base block
+    SNAPSHOT_COINS,             //! Unspent outputs, (COutPoint, Coin)
+    SNAPSHOT_RCT_OUTPUTS,       //! Anon output table, (int64_t index, CAnonOutput), the links are rebuilt on load
+    SNAPSHOT_KEY_IMAGES,        //! Spent key images, (CCmpPubKey, uint256 txid)
+    SNAPSHOT_SECTIONS,
+};
+
+const char* SnapshotSectionName(SnapshotSectionType type);
+
+struct SnapshotSection
+{
+    uint64_t m_count = 0;
+    uint64_t m_offset = 0;
+    uint64_t m_size = 0;
+    uint256 m_hash;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(m_count);
+        READWRITE(m_offset);
+        READWRITE(m_size);
+        READWRITE(m_hash);
+    }
+};
+
+/**
+ * Header of a chainstate snapshot file.
+ *
+ * The header is fixed size and followed by the sections in order. m_snapshot_hash
+ * commits to the base block and the hash of every section, it is what
+ * CChainParams::SnapshotHashes() pins for known heights.
+ */
+class SnapshotMetadata
+{
+public:
+    uint32_t m_magic = SNAPSHOT_MAGIC;
+    uint32_t m_version = SNAPSHOT_VERSION;
+    uint256 m_base_blockhash;
+    int m_base_height = 0;
+    SnapshotSection m_sections[SNAPSHOT_SECTIONS];
+    uint256 m_snapshot_hash;
+
+    uint256 GetSnapshotHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(m_magic);
+        READWRITE(m_version);
+        READWRITE(m_base_blockhash);
+        READWRITE(m_base_height);
+        for (int i = 0; i < SNAPSHOT_SECTIONS; ++i) {
+            READWRITE(m_sections[i]);
+        }
+        READWRITE(m_snapshot_hash);
+    }
+};
+
+/**
+ * Write a snapshot of the chainstate at the current tip to path.
+ * cs_main is only held while the state is flushed and the database iterators are
+ * created, the sections are then streamed by one thread each.
+ */
+bool WriteUTXOSnapshot(CChainState& chainstate, const fs::path& path, SnapshotMetadata& metadata, std::string& error);
+
+/**
+ * Load a snapshot into an empty datadir, must run before the block index is loaded.
+ * The section hashes are verified before anything is written, then the sections
+ * are loaded into the block tree and coins databases in parallel.
+ */
+bool LoadUTXOSnapshot(const CChainParams& chainparams, const fs::path& path, CBlockTreeDB& blocktree, size_t coins_db_cache, SnapshotMetadata& metadata, std::string& error);
+
+#endif // PARTICL_NODE_UTXO_SNAPSHOT_H
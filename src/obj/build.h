@@ -0,0 +1 @@
+#define BUILD_SUFFIX 7b26e62-dirty
@@ -22,6 +22,7 @@
 
 typedef CWallet* CWalletRef;
 std::vector<StakeThread*> vStakeThreads;
+StakeScheduler g_stake_scheduler;
 
 void StakeThread::condWaitFor(int ms)
 {
@@ -30,6 +31,79 @@ void StakeThread::condWaitFor(int ms)
     condMinerProc.wait_for(lock, std::chrono::milliseconds(ms), [this] { return this->fWakeMinerProc; });
 };
 
+void StakeScheduler::SetWallets(const std::vector<std::shared_ptr<CWallet>> &vpwallets)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wallets.clear();
+    for (const auto &pw : vpwallets) {
+        m_wallets.push_back(GetParticlWallet(pw.get()));
+    }
+    m_queue.clear();
+    m_in_progress.clear();
+    m_height = -1;
+    m_search_time = 0;
+};
+
+bool StakeScheduler::GetTask(int nHeight, int64_t nSearchTime, size_t &nWallet)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (nHeight != m_height || nSearchTime != m_search_time) {
+        // Wallets still queued when the slot moves on were never searched in it
+        for (auto i : m_queue) {
+            m_wallets[i]->m_stake_missed_slots++;
+        }
+        m_queue.clear();
+        m_height = nHeight;
+        m_search_time = nSearchTime;
+
+        std::vector<std::pair<int64_t, size_t> > vOrder;
+        for (size_t i = 0; i < m_wallets.size(); ++i) {
+            CHDWallet *pwallet = m_wallets[i];
+            int64_t nSearches = pwallet->m_stake_searches;
+            vOrder.emplace_back(nSearches > 0 ? pwallet->m_stake_total_latency / nSearches : 0, i);
+        }
+        std::stable_sort(vOrder.begin(), vOrder.end(), [](const std::pair<int64_t, size_t> &a, const std::pair<int64_t, size_t> &b) {
+            return a.first > b.first;
+        });
+        for (const auto &o : vOrder) {
+            m_queue.push_back(o.second);
+        }
+    }
+
+    while (!m_queue.empty()) {
+        size_t i = m_queue.front();
+        m_queue.pop_front();
+        if (m_in_progress.count(i)) {
+            continue; // Still being searched by another thread from an earlier slot
+        }
+        m_in_progress.insert(i);
+        nWallet = i;
+        return true;
+    }
+    return false;
+};
+
+void StakeScheduler::TaskDone(size_t nWallet)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_in_progress.erase(nWallet);
+};
+
+void StakeScheduler::SlotDone()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.clear();
+};
+
+void StakeScheduler::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.clear();
+    m_height = -1;
+    m_search_time = 0;
+};
+
 std::atomic<bool> fStopMinerProc(false);
 std::atomic<bool> fTryToSync(false);
 std::atomic<bool> fIsStaking(false);
@@ -236,15 +310,12 @@ void StartThreadStakeMiner()
         }
         size_t nThreads = std::min(nWallets, (size_t)gArgs.GetArg("-stakingthreads", 1));
 
-        size_t nPerThread = nWallets / nThreads;
+        g_stake_scheduler.SetWallets(vpwallets);
         for (size_t i = 0; i < nThreads; ++i) {
-            size_t nStart = nPerThread * i;
-            size_t nEnd = (i == nThreads-1) ? nWallets : nPerThread * (i+1);
             StakeThread *t = new StakeThread();
             vStakeThreads.push_back(t);
-            GetParticlWallet(vpwallets[i].get())->nStakeThread = i;
             t->sName = strprintf("miner%d", i);
-            t->thread = std::thread(&TraceThread<std::function<void()> >, t->sName.c_str(), std::function<void()>(std::bind(&ThreadStakeMiner, i, vpwallets, nStart, nEnd)));
+            t->thread = std::thread(&TraceThread<std::function<void()> >, t->sName.c_str(), std::function<void()>(std::bind(&ThreadStakeMiner, i, vpwallets)));
         }
     }
 
@@ -276,19 +347,22 @@ void WakeThreadStakeMiner(CHDWallet *pwallet)
 {
     // Call when chain is synced, wallet unlocked or balance changed
     LOCK(pwallet->cs_wallet);
-    LogPrint(BCLog::POS, "WakeThreadStakeMiner thread %d\n", pwallet->nStakeThread);
+    LogPrint(BCLog::POS, "WakeThreadStakeMiner %s\n", pwallet->GetDisplayName());
 
-    if (pwallet->nStakeThread >= vStakeThreads.size()) {
+    if (vStakeThreads.size() < 1) {
         return; // stake unit test
     }
-    StakeThread *t = vStakeThreads[pwallet->nStakeThread];
     pwallet->nLastCoinStakeSearchTime = 0;
-    {
-        std::lock_guard<std::mutex> lock(t->mtxMinerProc);
-        t->fWakeMinerProc = true;
-    }
+    g_stake_scheduler.Reset();
 
-    t->condMinerProc.notify_all();
+    // Any thread can search the wallet
+    for (auto t : vStakeThreads) {
+        {
+            std::lock_guard<std::mutex> lock(t->mtxMinerProc);
+            t->fWakeMinerProc = true;
+        }
+        t->condMinerProc.notify_all();
+    }
 };
 
 bool ThreadStakeMinerStopped()
@@ -303,15 +377,109 @@ static inline void condWaitFor(size_t nThreadID, int ms)
     t->condWaitFor(ms);
 };
 
-void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<CWallet>> &vpwallets, size_t nStart, size_t nEnd)
+/** Search one wallet for a kernel in the slot at nSearchTime, returns true if a block was staked. */
+static bool TryStakeWallet(size_t i, CHDWallet *pwallet, int nBestHeight, int64_t nSearchTime, const CScript &coinbaseScript,
+    std::unique_ptr<CBlockTemplate> &pblocktemplate, size_t &nWaitFor)
+{
+    int nLastImportHeight = Params().GetLastImportHeight();
+
+    if (!pwallet->fStakingEnabled) {
+        pwallet->m_is_staking = CHDWallet::NOT_STAKING_DISABLED;
+        return false;
+    }
+
+    CAmount reserve_balance;
+    {
+    LOCK(pwallet->cs_wallet);
+    if (nSearchTime <= pwallet->nLastCoinStakeSearchTime) {
+        nWaitFor = std::min(nWaitFor, (size_t)nMinerSleep);
+        return false;
+    }
+
+    if (pwallet->nStakeLimitHeight && nBestHeight >= pwallet->nStakeLimitHeight) {
+        pwallet->m_is_staking = CHDWallet::NOT_STAKING_LIMITED;
+        nWaitFor = std::min(nWaitFor, (size_t)30000);
+        return false;
+    }
+
+    if (pwallet->IsLocked()) {
+        pwallet->m_is_staking = CHDWallet::NOT_STAKING_LOCKED;
+        nWaitFor = std::min(nWaitFor, (size_t)30000);
+        return false;
+    }
+    reserve_balance = pwallet->nReserveBalance;
+    }
+    CAmount balance = pwallet->GetSpendableBalance();
+
+    if (balance <= reserve_balance) {
+        LOCK(pwallet->cs_wallet);
+        pwallet->m_is_staking = CHDWallet::NOT_STAKING_BALANCE;
+        nWaitFor = std::min(nWaitFor, (size_t)60000);
+        pwallet->nLastCoinStakeSearchTime = nSearchTime + 60;
+        LogPrint(BCLog::POS, "%s: Wallet %d, low balance.\n", __func__, i);
+        return false;
+    }
+
+    if (!pblocktemplate.get()) {
+        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(coinbaseScript, false);
+        if (!pblocktemplate.get()) {
+            fIsStaking = false;
+            nWaitFor = std::min(nWaitFor, (size_t)nMinerSleep);
+            LogPrint(BCLog::POS, "%s: Couldn't create new block.\n", __func__);
+            return false;
+        }
+
+        if (nBestHeight + 1 <= nLastImportHeight
+            && !ImportOutputs(pblocktemplate.get(), nBestHeight + 1)) {
+            fIsStaking = false;
+            nWaitFor = std::min(nWaitFor, (size_t)30000);
+            LogPrint(BCLog::POS, "%s: ImportOutputs failed.\n", __func__);
+            return false;
+        }
+    }
+
+    pwallet->m_is_staking = CHDWallet::IS_STAKING;
+
+    nWaitFor = nMinerSleep;
+    fIsStaking = true;
+
+    int64_t nTimeStart = GetTimeMicros();
+    bool fSigned = pwallet->SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime);
+    int64_t nLatency = GetTimeMicros() - nTimeStart;
+    pwallet->m_stake_searches++;
+    pwallet->m_stake_last_latency = nLatency;
+    pwallet->m_stake_total_latency += nLatency;
+    if (nLatency > pwallet->m_stake_max_latency) {
+        pwallet->m_stake_max_latency = nLatency;
+    }
+
+    if (fSigned) {
+        CBlock *pblock = &pblocktemplate->block;
+        if (CheckStake(pblock)) {
+             nTimeLastStake = GetTime();
+             return true;
+        }
+    } else {
+        int nRequiredDepth = std::min((int)(Params().GetStakeMinConfirmations() - 1), (int)(nBestHeight / 2));
+        LOCK(pwallet->cs_wallet);
+        if (pwallet->m_greatest_txn_depth < nRequiredDepth - 4) {
+            pwallet->m_is_staking = CHDWallet::NOT_STAKING_DEPTH;
+            size_t nSleep = (nRequiredDepth - pwallet->m_greatest_txn_depth) / 4;
+            nWaitFor = std::min(nWaitFor, (size_t)(nSleep * 1000));
+            pwallet->nLastCoinStakeSearchTime = nSearchTime + nSleep;
+            LogPrint(BCLog::POS, "%s: Wallet %d, no outputs with required depth, sleeping for %ds.\n", __func__, i, nSleep);
+        }
+    }
+    return false;
+};
+
+void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<CWallet>> &vpwallets)
 {
-    LogPrintf("Starting staking thread %d, %d wallet%s.\n", nThreadID, nEnd - nStart, (nEnd - nStart) > 1 ? "s" : "");
+    LogPrintf("Starting staking thread %d, %d wallet%s.\n", nThreadID, vpwallets.size(), vpwallets.size() > 1 ? "s" : "");
 
     int nBestHeight; // TODO: set from new block signal?
     int64_t nBestTime;
 
-    int nLastImportHeight = Params().GetLastImportHeight();
-
     if (!gArgs.GetBoolArg("-staking", true)) {
         LogPrint(BCLog::POS, "%s: -staking is false.\n", __func__);
         return;
@@ -383,90 +551,23 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<CWallet>> &v
 
         std::unique_ptr<CBlockTemplate> pblocktemplate;
 
+        // Take wallets from the shared scheduler until none remain in this slot,
+        // a slow wallet only delays the thread searching it.
         size_t nWaitFor = 60000;
-        CAmount reserve_balance;
-        for (size_t i = nStart; i < nEnd; ++i) {
-            auto pwallet = GetParticlWallet(vpwallets[i].get());
-
-            if (!pwallet->fStakingEnabled) {
-                pwallet->m_is_staking = CHDWallet::NOT_STAKING_DISABLED;
-                continue;
-            }
-
-            {
-            LOCK(pwallet->cs_wallet);
-            if (nSearchTime <= pwallet->nLastCoinStakeSearchTime) {
-                nWaitFor = std::min(nWaitFor, (size_t)nMinerSleep);
-                continue;
-            }
-
-            if (pwallet->nStakeLimitHeight && nBestHeight >= pwallet->nStakeLimitHeight) {
-                pwallet->m_is_staking = CHDWallet::NOT_STAKING_LIMITED;
-                nWaitFor = std::min(nWaitFor, (size_t)30000);
-                continue;
-            }
-
-            if (pwallet->IsLocked()) {
-                pwallet->m_is_staking = CHDWallet::NOT_STAKING_LOCKED;
-                nWaitFor = std::min(nWaitFor, (size_t)30000);
-                continue;
-            }
-            reserve_balance = pwallet->nReserveBalance;
-            }
-            CAmount balance = pwallet->GetSpendableBalance();
-
-            if (balance <= reserve_balance) {
-                LOCK(pwallet->cs_wallet);
-                pwallet->m_is_staking = CHDWallet::NOT_STAKING_BALANCE;
-                nWaitFor = std::min(nWaitFor, (size_t)60000);
-                pwallet->nLastCoinStakeSearchTime = nSearchTime + 60;
-                LogPrint(BCLog::POS, "%s: Wallet %d, low balance.\n", __func__, i);
-                continue;
-            }
-
-            if (!pblocktemplate.get()) {
-                pblocktemplate = BlockAssembler(Params()).CreateNewBlock(coinbaseScript, false);
-                if (!pblocktemplate.get()) {
-                    fIsStaking = false;
-                    nWaitFor = std::min(nWaitFor, (size_t)nMinerSleep);
-                    LogPrint(BCLog::POS, "%s: Couldn't create new block.\n", __func__);
-                    continue;
-                }
-
-                if (nBestHeight + 1 <= nLastImportHeight
-                    && !ImportOutputs(pblocktemplate.get(), nBestHeight + 1)) {
-                    fIsStaking = false;
-                    nWaitFor = std::min(nWaitFor, (size_t)30000);
-                    LogPrint(BCLog::POS, "%s: ImportOutputs failed.\n", __func__);
-                    continue;
-                }
+        size_t nSearched = 0, i;
+        while (!fStopMinerProc && g_stake_scheduler.GetTask(nBestHeight, nSearchTime, i)) {
+            nSearched++;
+            bool fStaked = TryStakeWallet(i, GetParticlWallet(vpwallets[i].get()), nBestHeight, nSearchTime, coinbaseScript, pblocktemplate, nWaitFor);
+            g_stake_scheduler.TaskDone(i);
+            if (fStaked) {
+                g_stake_scheduler.SlotDone();
+                break;
             }
-
-            pwallet->m_is_staking = CHDWallet::IS_STAKING;
-
+        }
+        if (nSearched == 0) {
             nWaitFor = nMinerSleep;
-            fIsStaking = true;
-            if (pwallet->SignBlock(pblocktemplate.get(), nBestHeight + 1, nSearchTime)) {
-                CBlock *pblock = &pblocktemplate->block;
-                if (CheckStake(pblock)) {
-                     nTimeLastStake = GetTime();
-                     break;
-                }
-            } else {
-                int nRequiredDepth = std::min((int)(Params().GetStakeMinConfirmations() - 1), (int)(nBestHeight / 2));
-                LOCK(pwallet->cs_wallet);
-                if (pwallet->m_greatest_txn_depth < nRequiredDepth - 4) {
-                    pwallet->m_is_staking = CHDWallet::NOT_STAKING_DEPTH;
-                    size_t nSleep = (nRequiredDepth - pwallet->m_greatest_txn_depth) / 4;
-                    nWaitFor = std::min(nWaitFor, (size_t)(nSleep * 1000));
-                    pwallet->nLastCoinStakeSearchTime = nSearchTime + nSleep;
-                    LogPrint(BCLog::POS, "%s: Wallet %d, no outputs with required depth, sleeping for %ds.\n", __func__, i, nSleep);
-                    continue;
-                }
-            }
         }
 
         condWaitFor(nThreadID, nWaitFor);
     }
 };
-
@@ -10,6 +10,10 @@
 #include <atomic>
 #include <vector>
 #include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
 
 class CHDWallet;
 class CWallet;
@@ -28,7 +32,36 @@ public:
     bool fWakeMinerProc = false;
 };
 
+/** Hands out one task per wallet per search slot to whichever staking thread is free.
+ *  Wallets with the highest average search latency are handed out first.
+ */
+class StakeScheduler
+{
+public:
+    void SetWallets(const std::vector<std::shared_ptr<CWallet>> &vpwallets);
+
+    /** Get the next wallet to search, starts a new slot when nHeight or nSearchTime changes.
+     *  Returns false when no wallets remain to be searched in the slot. */
+    bool GetTask(int nHeight, int64_t nSearchTime, size_t &nWallet);
+    void TaskDone(size_t nWallet);
+
+    /** A stake was found, drop the remaining tasks. */
+    void SlotDone();
+
+    /** Search all wallets again at the next call to GetTask. */
+    void Reset();
+
+private:
+    std::mutex m_mutex;
+    std::vector<CHDWallet*> m_wallets;
+    std::deque<size_t> m_queue;
+    std::set<size_t> m_in_progress;
+    int m_height = -1;
+    int64_t m_search_time = 0;
+};
+
 extern std::vector<StakeThread*> vStakeThreads;
+extern StakeScheduler g_stake_scheduler;
 
 extern std::atomic<bool> fIsStaking;
 
@@ -44,7 +77,7 @@ void StopThreadStakeMiner();
 void WakeThreadStakeMiner(CHDWallet *pwallet);
 bool ThreadStakeMinerStopped(); // replace interruption_point
 
-void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<CWallet>> &vpwallets, size_t nStart, size_t nEnd);
+void ThreadStakeMiner(size_t nThreadID, std::vector<std::shared_ptr<CWallet>> &vpwallets);
 
 #endif // PARTICL_POS_MINER_H
 
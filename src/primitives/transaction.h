@@ -16,6 +16,10 @@
 
 #include <secp256k1_rangeproof.h>
 
+#include <cstddef>
+#include <memory>
+#include <new>
+
 static const int SERIALIZE_TRANSACTION_NO_WITNESS = 0x40000000;
 
 static const uint8_t PARTICL_BLOCK_VERSION = 0xA0;
@@ -545,6 +549,61 @@ public:
 };
 
 
+constexpr size_t TxOutMaxSize(size_t a, size_t b) { return a > b ? a : b; };
+
+/** Storage for the outputs of a deserialized transaction.
+ *
+ * Outputs are placed in fixed size slots in chunks of up to MAX_CHUNK_SLOTS,
+ * so most transactions need a single allocation for all their outputs.
+ * Outputs are handed out as shared_ptrs aliasing the arena, the arena lives
+ * until the last output referencing it is released.
+ */
+class CTxOutArena
+{
+public:
+    static const size_t MAX_CHUNK_SLOTS = 256;
+
+    explicit CTxOutArena(size_t nOutputs) : m_chunk_slots(nOutputs < 1 ? 1 : nOutputs > MAX_CHUNK_SLOTS ? MAX_CHUNK_SLOTS : nOutputs) {};
+    ~CTxOutArena()
+    {
+        for (auto p : m_outputs) {
+            p->~CTxOutBase();
+        }
+        for (auto p : m_chunks) {
+            ::operator delete(p);
+        }
+    };
+    CTxOutArena(const CTxOutArena&) = delete;
+    CTxOutArena& operator=(const CTxOutArena&) = delete;
+
+    template<typename T>
+    T *Emplace()
+    {
+        static_assert(sizeof(T) <= SLOT_SIZE, "Output type too large for arena slot");
+        if (m_chunks.empty() || m_used == m_chunk_slots) {
+            m_outputs.reserve(m_outputs.size() + m_chunk_slots);
+            m_chunks.push_back(static_cast<uint8_t*>(::operator new(m_chunk_slots * SLOT_SIZE)));
+            m_used = 0;
+        }
+        T *p = new (m_chunks.back() + m_used * SLOT_SIZE) T();
+        m_used++;
+        m_outputs.push_back(p);
+        return p;
+    };
+
+    size_t NumChunks() const { return m_chunks.size(); };
+
+private:
+    static constexpr size_t SLOT_ALIGN = alignof(std::max_align_t);
+    static constexpr size_t SLOT_SIZE = ((TxOutMaxSize(TxOutMaxSize(sizeof(CTxOutStandard), sizeof(CTxOutCT)), TxOutMaxSize(sizeof(CTxOutRingCT), sizeof(CTxOutData)))
+        + SLOT_ALIGN - 1) / SLOT_ALIGN) * SLOT_ALIGN;
+
+    size_t m_chunk_slots;
+    size_t m_used = 0;
+    std::vector<uint8_t*> m_chunks;
+    std::vector<CTxOutBase*> m_outputs;
+};
+
 /** An output of a transaction.  It contains the public key that the next input
  * must be able to sign with to claim it.
  */
@@ -640,20 +699,21 @@ inline void UnserializeTransaction(TxType& tx, Stream& s) {
         size_t nOutputs = ReadCompactSize(s);
         tx.vpout.clear();
         tx.vpout.reserve(nOutputs);
+        std::shared_ptr<CTxOutArena> arena = std::make_shared<CTxOutArena>(nOutputs);
         for (size_t k = 0; k < nOutputs; ++k) {
             s >> bv;
             switch (bv) {
                 case OUTPUT_STANDARD:
-                    tx.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>());
+                    tx.vpout.push_back(CTxOutBaseRef(arena, arena->Emplace<CTxOutStandard>()));
                     break;
                 case OUTPUT_CT:
-                    tx.vpout.push_back(MAKE_OUTPUT<CTxOutCT>());
+                    tx.vpout.push_back(CTxOutBaseRef(arena, arena->Emplace<CTxOutCT>()));
                     break;
                 case OUTPUT_RINGCT:
-                    tx.vpout.push_back(MAKE_OUTPUT<CTxOutRingCT>());
+                    tx.vpout.push_back(CTxOutBaseRef(arena, arena->Emplace<CTxOutRingCT>()));
                     break;
                 case OUTPUT_DATA:
-                    tx.vpout.push_back(MAKE_OUTPUT<CTxOutData>());
+                    tx.vpout.push_back(CTxOutBaseRef(arena, arena->Emplace<CTxOutData>()));
                     break;
                 default:
                     throw std::ios_base::failure("Unknown transaction output type");
@@ -0,0 +1,88 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <proofcache.h>
+
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <random.h>
+#include <script/sigcache.h>
+#include <util/system.h>
+
+#include <boost/thread.hpp>
+
+namespace {
+class CProofCache
+{
+private:
+    //! Entries are SHA256(nonce || wtxid || type || index || data)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_proofcache;
+
+public:
+    CProofCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256 &entry, const uint256 &wtxid, uint8_t type, uint32_t index, const uint8_t *data, size_t data_len)
+    {
+        CSHA256 hasher;
+        hasher.Write(nonce.begin(), 32).Write(wtxid.begin(), 32).Write(&type, 1).Write((const unsigned char*)&index, sizeof(index));
+        if (data_len > 0) {
+            hasher.Write(data, data_len);
+        }
+        hasher.Finalize(entry.begin());
+    }
+
+    bool Get(const uint256 &entry, const bool erase)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_proofcache);
+        return setValid.contains(entry, erase);
+    }
+
+    void Set(const uint256 &entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_proofcache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CProofCache proofCache;
+} // namespace
+
+void ComputeProofCacheEntry(uint256 &entry, const uint256 &wtxid, ProofCacheType type, uint32_t index,
+    const uint8_t *data, size_t data_len)
+{
+    proofCache.ComputeEntry(entry, wtxid, type, index, data, data_len);
+}
+
+bool ProofCacheContains(const uint256 &entry, bool erase)
+{
+    return proofCache.Get(entry, erase);
+}
+
+void ProofCacheInsert(const uint256 &entry)
+{
+    proofCache.Set(entry);
+}
+
+// To be called once in AppInitMain/BasicTestingSetup to initialize the
+// proofCache.
+void InitProofCache()
+{
+    // nMaxCacheSize is unsigned. If -maxproofcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxproofcachesize", DEFAULT_MAX_PROOF_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = proofCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for proof cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
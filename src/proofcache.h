@@ -0,0 +1,41 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_PROOFCACHE_H
+#define PARTICL_PROOFCACHE_H
+
+#include <uint256.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Default size of the verified proof cache in MiB */
+static const unsigned int DEFAULT_MAX_PROOF_CACHE_SIZE = 16;
+
+enum ProofCacheType : uint8_t {
+    PROOF_RANGEPROOF = 0,   //! Borromean rangeproof of a CT or RingCT output
+    PROOF_BULLETPROOF,      //! Bulletproof rangeproof of a CT or RingCT output
+    PROOF_MLSAG,            //! MLSAG signature of an anon input
+};
+
+/**
+ * Cache of successfully verified rangeproofs and MLSAG signatures, so that
+ * proofs checked when a transaction enters the mempool are not verified again
+ * when the transaction is connected in a block.
+ *
+ * Entries are SHA256(nonce || wtxid || type || index || data), data must commit
+ * to anything the proof is verified against that the wtxid does not, for an
+ * MLSAG that is the ring looked up from the anon output index.
+ */
+void ComputeProofCacheEntry(uint256 &entry, const uint256 &wtxid, ProofCacheType type, uint32_t index,
+    const uint8_t *data = nullptr, size_t data_len = 0);
+
+/** Return true if entry was verified before, set erase when the entry will likely not be needed again */
+bool ProofCacheContains(const uint256 &entry, bool erase);
+
+void ProofCacheInsert(const uint256 &entry);
+
+void InitProofCache();
+
+#endif // PARTICL_PROOFCACHE_H
@@ -5,9 +5,13 @@
 
 #include <pubkey.h>
 
+#include <crypto/hmac_sha512.h>
+
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 
+#include <algorithm>
+
 namespace
 {
 /* Global secp256k1_context object used for verification. */
@@ -285,6 +289,57 @@ bool CPubKey::Derive(CPubKey& pubkeyChild, unsigned char ccChild[32], unsigned i
     pubkeyChild.Set(pub, pub + publen);
     return true;
 }
+bool CPubKey::DeriveRange(std::vector<CPubKey>& pubkeysOut, unsigned int nFirst, unsigned int nCount, const unsigned char cc[32]) const
+{
+    assert(IsValid());
+    assert((nFirst >> 31) == 0 && nCount <= (1u << 31) - nFirst);
+    assert(begin() + 33 == end());
+    pubkeysOut.assign(nCount, CPubKey());
+    if (nCount == 0) {
+        return true;
+    }
+    secp256k1_pubkey pubkey;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
+        return false;
+    }
+
+    // Every child hashes the same chain code key and parent key, only the child number differs
+    CHMAC_SHA512 hmac_parent(cc, 32);
+    hmac_parent.Write(begin(), 33);
+
+    static const unsigned int BATCH_SIZE = 128;
+    unsigned char nums[BATCH_SIZE * 4];
+    unsigned char out[BATCH_SIZE * 64];
+    unsigned char tweaks[BATCH_SIZE * 32];
+    secp256k1_pubkey children[BATCH_SIZE];
+    int valid[BATCH_SIZE];
+    for (unsigned int i = 0; i < nCount; i += BATCH_SIZE) {
+        unsigned int n = std::min(nCount - i, BATCH_SIZE);
+        for (unsigned int k = 0; k < n; ++k) {
+            unsigned int nChild = nFirst + i + k;
+            nums[k * 4 + 0] = (nChild >> 24) & 0xFF;
+            nums[k * 4 + 1] = (nChild >> 16) & 0xFF;
+            nums[k * 4 + 2] = (nChild >>  8) & 0xFF;
+            nums[k * 4 + 3] = (nChild >>  0) & 0xFF;
+        }
+        hmac_parent.FinalizeBatch(nums, 4, n, out);
+        for (unsigned int k = 0; k < n; ++k) {
+            memcpy(tweaks + k * 32, out + k * 64, 32);
+        }
+        secp256k1_ec_pubkey_tweak_add_batch(secp256k1_context_verify, children, valid, &pubkey, tweaks, n);
+        for (unsigned int k = 0; k < n; ++k) {
+            if (!valid[k]) {
+                continue;
+            }
+            unsigned char pub[33];
+            size_t publen = 33;
+            secp256k1_ec_pubkey_serialize(secp256k1_context_verify, pub, &publen, &children[k], SECP256K1_EC_COMPRESSED);
+            pubkeysOut[i + k].Set(pub, pub + publen);
+        }
+    }
+    return true;
+}
+
 /*
 void CExtPubKey::Encode(unsigned char code[BIP32_EXTKEY_SIZE]) const {
     code[0] = nDepth;
@@ -220,6 +220,13 @@ public:
     bool Derive(CPubKey& pubkeyChild, ChainCode &ccChild, unsigned int nChild, const ChainCode& cc) const;
 
     bool Derive(CPubKey& pubkeyChild, unsigned char ccChild[32], unsigned int nChild, const unsigned char cc[32]) const;
+
+    /**
+     * Derive the BIP32 child pubkeys nFirst to nFirst + nCount - 1, pubkeysOut[i] is child nFirst + i.
+     * Children that are invalid under BIP32 are returned as invalid keys. The parent key is parsed and
+     * the HMAC state keyed by the chain code computed once, the children are tweaked in batches.
+     */
+    bool DeriveRange(std::vector<CPubKey>& pubkeysOut, unsigned int nFirst, unsigned int nCount, const unsigned char cc[32]) const;
 };
 
 /** An encapsulated compressed public key. */
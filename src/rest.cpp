@@ -12,6 +12,7 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <streams.h>
@@ -72,6 +73,38 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string me
     return false;
 }
 
+/** Send a JSON document in chunks as it's written, ending with a newline */
+static bool RESTWriteJSON(HTTPRequest* req, const std::function<void(JSONWriter&)>& write)
+{
+    JSONWriter writer([req](const std::string& chunk) {
+        if (!req->IsReplyStarted()) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReplyStart(HTTP_OK);
+        }
+        req->WriteReplyChunk(chunk);
+    });
+    auto fail = [req](const std::string& message) {
+        if (!req->IsReplyStarted()) {
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, message);
+        }
+        // The success status is already sent, drop the connection so the reply is seen as incomplete
+        LogPrintf("REST error after the reply was started: %s\n", message);
+        req->WriteReplyAbort();
+        return false;
+    };
+    try {
+        write(writer);
+        writer.Append("\n");
+        writer.Flush();
+    } catch (const UniValue& objError) {
+        return fail(find_value(objError, "message").get_str());
+    } catch (const std::exception& e) {
+        return fail(e.what());
+    }
+    req->WriteReplyEnd();
+    return true;
+}
+
 static RetFormat ParseDataFormat(std::string& param, const std::string& strReq)
 {
     const std::string::size_type pos = strReq.rfind('.');
@@ -139,19 +172,18 @@ static bool rest_headers(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    const CBlockIndex* tip = nullptr;
+    std::shared_ptr<const CChainView> chain_view = GetChainView();
+    if (!chain_view || !chain_view->Tip())
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Chain not loaded");
+    const CBlockIndex* tip = chain_view->Tip();
     std::vector<const CBlockIndex *> headers;
     headers.reserve(count);
-    {
-        LOCK(cs_main);
-        tip = ::ChainActive().Tip();
-        const CBlockIndex* pindex = LookupBlockIndex(hash);
-        while (pindex != nullptr && ::ChainActive().Contains(pindex)) {
-            headers.push_back(pindex);
-            if (headers.size() == (unsigned long)count)
-                break;
-            pindex = ::ChainActive().Next(pindex);
-        }
+    const CBlockIndex* pindex = chain_view->Find(hash);
+    while (pindex != nullptr) {
+        headers.push_back(pindex);
+        if (headers.size() == (unsigned long)count)
+            break;
+        pindex = chain_view->Next(pindex);
     }
 
     switch (rf) {
@@ -208,9 +240,14 @@ static bool rest_block(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
     CBlock block;
-    CBlockIndex* pblockindex = nullptr;
-    CBlockIndex* tip = nullptr;
-    {
+    const CBlockIndex* pblockindex = nullptr;
+    const CBlockIndex* tip = nullptr;
+    std::shared_ptr<const CChainView> chain_view = GetChainView();
+    if (chain_view && !fHavePruned && (pblockindex = chain_view->Find(hash))) {
+        tip = chain_view->Tip();
+        if (!ReadChainViewBlock(block, pblockindex, Params().GetConsensus()))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+    } else {
         LOCK(cs_main);
         tip = ::ChainActive().Tip();
         pblockindex = LookupBlockIndex(hash);
@@ -245,11 +282,9 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RetFormat::JSON: {
-        UniValue objBlock = blockToJSON(block, tip, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTWriteJSON(req, [&](JSONWriter& writer) {
+            blockToJSON(writer, block, tip, pblockindex, showTxDetails);
+        });
     }
 
     default: {
@@ -325,12 +360,9 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RetFormat::JSON: {
-        UniValue mempoolObject = MempoolToJSON(::mempool, true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTWriteJSON(req, [](JSONWriter& writer) {
+            MempoolToJSON(writer, ::mempool, true);
+        });
     }
     default: {
         return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
@@ -590,14 +622,11 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(height_str));
     }
 
-    CBlockIndex* pblockindex = nullptr;
-    {
-        LOCK(cs_main);
-        if (blockheight > ::ChainActive().Height()) {
-            return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
-        }
-        pblockindex = ::ChainActive()[blockheight];
+    std::shared_ptr<const CChainView> chain_view = GetChainView();
+    if (!chain_view || blockheight > chain_view->Height()) {
+        return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
     }
+    const CBlockIndex* pblockindex = (*chain_view)[blockheight];
     switch (rf) {
     case RetFormat::BINARY: {
         CDataStream ss_blockhash(SER_NETWORK, PROTOCOL_VERSION);
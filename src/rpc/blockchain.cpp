@@ -11,14 +11,17 @@
 #include <chainparams.h>
 #include <coins.h>
 #include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <consensus/validation.h>
 #include <core_io.h>
 #include <hash.h>
 #include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
 #include <primitives/transaction.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
@@ -32,6 +35,7 @@
 #include <util/validation.h>
 #include <validation.h>
 #include <validationinterface.h>
+#include <validationstats.h>
 #include <versionbitsinfo.h>
 #include <warnings.h>
 
@@ -122,62 +126,71 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails, bool coinstakeDetails)
+void blockToJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails, bool coinstakeDetails)
 {
     // Serialize passed information without accessing chain state of the active chain!
     AssertLockNotHeld(cs_main); // For performance reasons
 
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", blockindex->GetBlockHash().GetHex());
+    writer.BeginObject();
+    writer.PushKV("hash", blockindex->GetBlockHash().GetHex());
     const CBlockIndex* pnext;
     int confirmations = ComputeNextBlockAndDepth(tip, blockindex, pnext);
-    result.pushKV("confirmations", confirmations);
-    result.pushKV("strippedsize", (int)::GetSerializeSize(block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
-    result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
-    result.pushKV("weight", (int)::GetBlockWeight(block));
-    result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", block.nVersion);
-    result.pushKV("versionHex", strprintf("%08x", block.nVersion));
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    result.pushKV("witnessmerkleroot", block.hashWitnessMerkleRoot.GetHex());
-    UniValue txs(UniValue::VARR);
+    writer.PushKV("confirmations", confirmations);
+    writer.PushKV("strippedsize", (int)::GetSerializeSize(block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    writer.PushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
+    writer.PushKV("weight", (int)::GetBlockWeight(block));
+    writer.PushKV("height", blockindex->nHeight);
+    writer.PushKV("version", block.nVersion);
+    writer.PushKV("versionHex", strprintf("%08x", block.nVersion));
+    writer.PushKV("merkleroot", block.hashMerkleRoot.GetHex());
+    writer.PushKV("witnessmerkleroot", block.hashWitnessMerkleRoot.GetHex());
+    writer.Key("tx");
+    writer.BeginArray();
     for(const auto& tx : block.vtx)
     {
         if(txDetails)
         {
+            // Only one transaction is held as a UniValue at a time
             UniValue objTx(UniValue::VOBJ);
             TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
-            txs.push_back(objTx);
+            writer.Value(objTx);
         }
         else
-            txs.push_back(tx->GetHash().GetHex());
+            writer.Value(tx->GetHash().GetHex());
     }
-    result.pushKV("tx", txs);
-    PushTime(result, "time", block.GetBlockTime());
-    PushTime(result, "mediantime", blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
-    result.pushKV("difficulty", GetDifficulty(blockindex));
-    result.pushKV("chainwork", blockindex->nChainWork.GetHex());
-    result.pushKV("nTx", (uint64_t)blockindex->nTx);
+    writer.EndArray();
+    PushTime(writer, "time", block.GetBlockTime());
+    PushTime(writer, "mediantime", blockindex->GetMedianTimePast());
+    writer.PushKV("nonce", (uint64_t)block.nNonce);
+    writer.PushKV("bits", strprintf("%08x", block.nBits));
+    writer.PushKV("difficulty", GetDifficulty(blockindex));
+    writer.PushKV("chainwork", blockindex->nChainWork.GetHex());
+    writer.PushKV("nTx", (uint64_t)blockindex->nTx);
 
     if (blockindex->pprev)
-        result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+        writer.PushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
     if (pnext)
-        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+        writer.PushKV("nextblockhash", pnext->GetBlockHash().GetHex());
     if (coinstakeDetails && blockindex->pprev) {
-        result.pushKV("blocksig", HexStr(block.vchBlockSig));
-        result.pushKV("prevstakemodifier", blockindex->pprev->bnStakeModifier.GetHex());
+        writer.PushKV("blocksig", HexStr(block.vchBlockSig));
+        writer.PushKV("prevstakemodifier", blockindex->pprev->bnStakeModifier.GetHex());
         uint256 kernelhash, kernelblockhash;
         CAmount kernelvalue;
         CScript kernelscript;
         GetKernelInfo(blockindex, *block.vtx[0], kernelhash, kernelvalue, kernelscript, kernelblockhash);
-        result.pushKV("hashproofofstake", kernelhash.GetHex());
-        result.pushKV("stakekernelvalue", ValueFromAmount(kernelvalue));
-        result.pushKV("stakekernelscript", HexStr(kernelscript.begin(), kernelscript.end()));
-        result.pushKV("stakekernelblockhash", kernelblockhash.GetHex());
+        writer.PushKV("hashproofofstake", kernelhash.GetHex());
+        writer.PushKV("stakekernelvalue", ValueFromAmount(kernelvalue));
+        writer.PushKV("stakekernelscript", HexStr(kernelscript.begin(), kernelscript.end()));
+        writer.PushKV("stakekernelblockhash", kernelblockhash.GetHex());
     }
-    return result;
+    writer.EndObject();
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails, bool coinstakeDetails)
+{
+    JSONWriter writer;
+    blockToJSON(writer, block, tip, blockindex, txDetails, coinstakeDetails);
+    return writer.GetValue();
 }
 
 static UniValue getblockcount(const JSONRPCRequest& request)
@@ -480,33 +493,38 @@ static void entryToJSON(const CTxMemPool& pool, UniValue& info, const CTxMemPool
     info.pushKV("bip125-replaceable", rbfStatus);
 }
 
-UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose)
+void MempoolToJSON(JSONWriter& writer, const CTxMemPool& pool, bool verbose)
 {
     if (verbose) {
         LOCK(pool.cs);
-        UniValue o(UniValue::VOBJ);
+        writer.BeginObject();
         for (const CTxMemPoolEntry& e : pool.mapTx) {
             const uint256& hash = e.GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
             entryToJSON(pool, info, e);
-            // Mempool has unique entries so there is no advantage in using
-            // UniValue::pushKV, which checks if the key already exists in O(N).
-            // UniValue::__pushKV is used instead which currently is O(1).
-            o.__pushKV(hash.ToString(), info);
+            // Mempool has unique entries, JSONWriter adds keys without checking
+            // if they already exist as UniValue::__pushKV does.
+            writer.PushKV(hash.ToString(), info);
         }
-        return o;
+        writer.EndObject();
     } else {
         std::vector<uint256> vtxid;
         pool.queryHashes(vtxid);
 
-        UniValue a(UniValue::VARR);
+        writer.BeginArray();
         for (const uint256& hash : vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+            writer.Value(hash.ToString());
+        writer.EndArray();
     }
 }
 
+UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose)
+{
+    JSONWriter writer;
+    MempoolToJSON(writer, pool, verbose);
+    return writer.GetValue();
+}
+
 static UniValue getrawmempool(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getrawmempool",
@@ -537,7 +555,9 @@ static UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
-    return MempoolToJSON(::mempool, fVerbose);
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        MempoolToJSON(writer, ::mempool, fVerbose);
+    });
 }
 
 static UniValue getmempoolancestors(const JSONRPCRequest& request)
@@ -930,7 +950,9 @@ static UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockToJSON(block, tip, pblockindex, verbosity >= 2, with_coinstakeinfo);
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        blockToJSON(writer, block, tip, pblockindex, verbosity >= 2, with_coinstakeinfo);
+    });
 }
 
 static UniValue pruneblockchain(const JSONRPCRequest& request)
@@ -989,47 +1011,151 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
     return uint64_t(block->nHeight);
 }
 
+CBlockIndex* ParseHashOrHeight(const UniValue& param)
+{
+    AssertLockHeld(cs_main);
+
+    CBlockIndex* pindex;
+    if (param.isNum()) {
+        const int height = param.get_int();
+        const int current_tip = ::ChainActive().Height();
+        if (height < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
+        }
+        if (height > current_tip) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
+        }
+
+        pindex = ::ChainActive()[height];
+    } else {
+        const uint256 hash(ParseHashV(param, "hash_or_height"));
+        pindex = LookupBlockIndex(hash);
+        if (!pindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        if (!::ChainActive().Contains(pindex)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
+        }
+    }
+    return pindex;
+}
+
+CoinStatsHashType ParseHashType(const std::string& hash_type_input)
+{
+    if (hash_type_input == "hash_serialized_2") {
+        return CoinStatsHashType::HASH_SERIALIZED;
+    } else if (hash_type_input == "muhash") {
+        return CoinStatsHashType::MUHASH;
+    } else if (hash_type_input == "none") {
+        return CoinStatsHashType::NONE;
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", hash_type_input));
+}
+
+bool GetUTXOStatsForRPC(CCoinsStats& stats, CoinStatsHashType hash_type, const UniValue& hash_or_height, const UniValue& use_index)
+{
+    const bool index_requested = use_index.isNull() || use_index.get_bool();
+
+    const CBlockIndex* pindex = nullptr;
+    if (!hash_or_height.isNull()) {
+        if (!g_coin_stats_index || !index_requested) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying specific block heights requires coinstatsindex");
+        }
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "hash_serialized_2 hash type cannot be queried for a specific block");
+        }
+        LOCK(cs_main);
+        pindex = ParseHashOrHeight(hash_or_height);
+    }
+
+    // The index can't produce hash_serialized_2, that always requires a scan of the UTXO set
+    if (g_coin_stats_index && index_requested && hash_type != CoinStatsHashType::HASH_SERIALIZED) {
+        g_coin_stats_index->BlockUntilSyncedToCurrentChain();
+        if (!pindex) {
+            LOCK(cs_main);
+            pindex = ::ChainActive().Tip();
+        }
+        if (!g_coin_stats_index->LookUpStats(pindex, stats)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set statistics from coinstatsindex, it may still be syncing");
+        }
+        return true;
+    }
+
+    ::ChainstateActive().ForceFlushStateToDisk();
+    CCoinsView* coins_view = WITH_LOCK(cs_main, return &ChainstateActive().CoinsDB());
+    return GetUTXOStats(coins_view, stats, hash_type);
+}
+
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
-                {},
+                "Note this call may take some time without -coinstatsindex or when using hash_type hash_serialized_2.\n",
+                {
+                    {"hash_type", RPCArg::Type::STR, /* default */ "muhash with coinstatsindex, hash_serialized_2 otherwise", "Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm), 'muhash', 'none'."},
+                    {"hash_or_height", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The block hash or height of the target height (only available with coinstatsindex).", "", {"", "string or numeric"}},
+                    {"use_index", RPCArg::Type::BOOL, /* default */ "true", "Use coinstatsindex, if available."},
+                },
                 RPCResult{
             "{\n"
-            "  \"height\":n,     (numeric) The current block height (index)\n"
-            "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
-            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"height\":n,     (numeric) The block height (index) of the returned statistics\n"
+            "  \"bestblock\": \"hex\",   (string) The hash of the block at which these statistics are calculated\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs (not available when coinstatsindex is used)\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
+            "  \"txouts_blinded\": n,    (numeric) The number of unspent blinded transaction outputs\n"
+            "  \"txouts_anon\": n,       (numeric) The number of anon outputs created, anon outputs are not part of the UTXO set\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
-            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)\n"
+            "  \"muhash\": \"hash\",      (string) The serialized hash (only present if 'muhash' hash_type is chosen)\n"
+            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk (not available when coinstatsindex is used)\n"
+            "  \"total_amount\": x.xxx,  (numeric) The total amount of plain outputs\n"
+            "  \"total_unspendable_amount\": x.xxx, (numeric) The total amount sent to unspendable outputs (only available if coinstatsindex is used)\n"
+            "  \"money_supply\": x.xxx,  (numeric) The money supply recorded in the block index\n"
             "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"none\"")
+            + HelpExampleCli("gettxoutsetinfo", "\"none\" 1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
+            + HelpExampleRpc("gettxoutsetinfo", "\"muhash\", 1000")
                 },
             }.Check(request);
 
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    ::ChainstateActive().ForceFlushStateToDisk();
+    // Default to the hash the index can serve, hash_serialized_2 always needs a scan of the UTXO set
+    const bool index_requested = request.params[2].isNull() || request.params[2].get_bool();
+    const CoinStatsHashType default_hash_type = g_coin_stats_index && index_requested ? CoinStatsHashType::MUHASH : CoinStatsHashType::HASH_SERIALIZED;
+    const CoinStatsHashType hash_type = request.params[0].isNull() ? default_hash_type : ParseHashType(request.params[0].get_str());
 
-    CCoinsView* coins_view = WITH_LOCK(cs_main, return &ChainstateActive().CoinsDB());
-    if (GetUTXOStats(coins_view, stats)) {
+    if (GetUTXOStatsForRPC(stats, hash_type, request.params[1], request.params[2])) {
         ret.pushKV("height", (int64_t)stats.nHeight);
         ret.pushKV("bestblock", stats.hashBlock.GetHex());
-        ret.pushKV("transactions", (int64_t)stats.nTransactions);
+        if (!stats.index_used) {
+            ret.pushKV("transactions", (int64_t)stats.nTransactions);
+        }
         ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
-        if (fParticlMode)
+        if (fParticlMode) {
             ret.pushKV("txouts_blinded", (int64_t)stats.nBlindTransactionOutputs);
+            ret.pushKV("txouts_anon", stats.nAnonOutputs);
+        }
         ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
-        ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
-        ret.pushKV("disk_size", stats.nDiskSize);
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+        }
+        if (hash_type == CoinStatsHashType::MUHASH) {
+            ret.pushKV("muhash", stats.hashSerialized.GetHex());
+        }
+        if (!stats.index_used) {
+            ret.pushKV("disk_size", stats.nDiskSize);
+        }
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+        if (stats.index_used) {
+            ret.pushKV("total_unspendable_amount", ValueFromAmount(stats.nUnspendableAmount));
+        }
+        ret.pushKV("money_supply", ValueFromAmount(stats.nMoneySupply));
     } else {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
@@ -1785,29 +1911,7 @@ static UniValue getblockstats(const JSONRPCRequest& request)
 
     LOCK(cs_main);
 
-    CBlockIndex* pindex;
-    if (request.params[0].isNum()) {
-        const int height = request.params[0].get_int();
-        const int current_tip = ::ChainActive().Height();
-        if (height < 0) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
-        }
-        if (height > current_tip) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
-        }
-
-        pindex = ::ChainActive()[height];
-    } else {
-        const uint256 hash(ParseHashV(request.params[0], "hash_or_height"));
-        pindex = LookupBlockIndex(hash);
-        if (!pindex) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-        }
-        if (!::ChainActive().Contains(pindex)) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
-        }
-    }
-
+    CBlockIndex* pindex = ParseHashOrHeight(request.params[0]);
     assert(pindex != nullptr);
 
     std::set<std::string> stats;
@@ -2016,30 +2120,50 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
-//! Search for a given set of pubkey scripts
-bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
+//! Search for a given set of pubkey scripts, the partitions of the UTXO set are scanned in parallel
+bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
     scan_progress = 0;
     count = 0;
-    while (cursor->Valid()) {
-        COutPoint key;
-        Coin coin;
-        if (!cursor->GetKey(key) || !cursor->GetValue(coin)) return false;
-        if (++count % 8192 == 0) {
-            boost::this_thread::interruption_point();
-            if (should_abort) {
-                // allow to abort the scan via the abort reference
-                return false;
+    std::atomic<int64_t> scanned_count{0};
+    std::atomic<size_t> scanned_partitions{0};
+    std::vector<std::vector<std::pair<COutPoint, Coin>>> found(cursors.size());
+    auto scan = [&](size_t i, CCoinsViewCursor& cursor) {
+        int64_t n = 0;
+        while (cursor.Valid()) {
+            COutPoint key;
+            Coin coin;
+            if (!cursor.GetKey(key) || !cursor.GetValue(coin)) return false;
+            if (++n % 8192 == 0) {
+                scanned_count += 8192;
+                if (should_abort) {
+                    // allow to abort the scan via the abort reference
+                    return false;
+                }
             }
+            if (cursors.size() == 1 && n % 256 == 0) {
+                // update progress reference every 256 item of an unpartitioned scan
+                uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
+                scan_progress = (int)(high * 100.0 / 65536.0 + 0.5);
+            }
+            if (needles.count(coin.out.scriptPubKey)) {
+                found[i].emplace_back(key, std::move(coin));
+            }
+            cursor.Next();
         }
-        if (count % 256 == 0) {
-            // update progress reference every 256 item
-            uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
-            scan_progress = (int)(high * 100.0 / 65536.0 + 0.5);
-        }
-        if (needles.count(coin.out.scriptPubKey)) {
-            out_results.emplace(key, coin);
-        }
-        cursor->Next();
+        scanned_count += n % 8192;
+        // update progress reference with every finished partition
+        scan_progress = (int)(++scanned_partitions * 100.0 / cursors.size() + 0.5);
+        return true;
+    };
+    auto merge = [&](size_t i) {
+        boost::this_thread::interruption_point();
+        out_results.insert(found[i].begin(), found[i].end());
+        found[i].clear();
+    };
+    bool res = ScanCoinsCursors(cursors, scan, merge);
+    count = scanned_count;
+    if (!res) {
+        return false;
     }
     scan_progress = 100;
     return true;
@@ -2179,17 +2303,17 @@ UniValue scantxoutset(const JSONRPCRequest& request)
         g_should_abort_scan = false;
         g_scan_progress = 0;
         int64_t count = 0;
-        std::unique_ptr<CCoinsViewCursor> pcursor;
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
         CBlockIndex* tip;
         {
             LOCK(cs_main);
             ::ChainstateActive().ForceFlushStateToDisk();
-            pcursor = std::unique_ptr<CCoinsViewCursor>(::ChainstateActive().CoinsDB().Cursor());
-            assert(pcursor);
+            cursors = ::ChainstateActive().CoinsDB().PartitionedCursors(GetUTXOScanPartitions());
+            assert(!cursors.empty());
             tip = ::ChainActive().Tip();
             assert(tip);
         }
-        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins);
+        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, cursors, needles, coins);
         result.pushKV("success", res);
         result.pushKV("txouts", count);
         result.pushKV("height", tip->nHeight);
@@ -2295,6 +2419,111 @@ static UniValue getblockfilter(const JSONRPCRequest& request)
     return ret;
 }
 
+static UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"dumptxoutset",
+                "\nWrite a snapshot of the chainstate at the current tip to disk.\n"
+                "The snapshot includes the UTXO set, the anon output table, spent key images and the block index of the active chain.\n"
+                "It can be loaded into an empty datadir with -loadsnapshot.\n",
+                {
+                    {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "Path to the output file. If relative, will be prefixed by datadir."},
+                },
+                RPCResult{
+            "{\n"
+            "  \"coins_written\": n,         (numeric) The number of unspent outputs written\n"
+            "  \"anon_outputs_written\": n,  (numeric) The number of anon outputs written\n"
+            "  \"key_images_written\": n,    (numeric) The number of spent key images written\n"
+            "  \"base_hash\": \"hex\",        (string) The hash of the block at the tip of the chain state\n"
+            "  \"base_height\": n,           (numeric) The height of the block at the tip of the chain state\n"
+            "  \"snapshot_hash\": \"hex\",    (string) The hash committing to the contents of the snapshot\n"
+            "  \"path\": \"str\",             (string) The absolute path that the snapshot was written to\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("dumptxoutset", "utxo.dat")
+            + HelpExampleRpc("dumptxoutset", "utxo.dat")
+                },
+            }.Check(request);
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary path and then move into `path` on completion
+    // to avoid confusion due to an interruption.
+    fs::path temppath = fs::absolute(request.params[0].get_str() + ".incomplete", GetDataDir());
+
+    if (fs::exists(path)) {
+        throw JSONRPCError(
+            RPC_INVALID_PARAMETER,
+            path.string() + " already exists. If you are sure this is what you want, "
+            "move it out of the way first");
+    }
+
+    SnapshotMetadata metadata;
+    std::string error;
+    if (!WriteUTXOSnapshot(::ChainstateActive(), temppath, metadata, error)) {
+        fs::remove(temppath);
+        throw JSONRPCError(RPC_MISC_ERROR, error);
+    }
+    fs::rename(temppath, path);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("coins_written", metadata.m_sections[SNAPSHOT_COINS].m_count);
+    result.pushKV("anon_outputs_written", metadata.m_sections[SNAPSHOT_RCT_OUTPUTS].m_count);
+    result.pushKV("key_images_written", metadata.m_sections[SNAPSHOT_KEY_IMAGES].m_count);
+    result.pushKV("base_hash", metadata.m_base_blockhash.ToString());
+    result.pushKV("base_height", metadata.m_base_height);
+    result.pushKV("snapshot_hash", metadata.m_snapshot_hash.ToString());
+    result.pushKV("path", path.string());
+    return result;
+}
+
+static UniValue getvalidationstats(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getvalidationstats",
+                "\nReturns latency histograms and counters of the stages of block validation since startup or the last reset.\n"
+                "Histogram buckets count the durations below lt_us microseconds, the last bucket is unbounded. Empty buckets are omitted.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Clear the histograms and counters after reading them."},
+                },
+                RPCResult{
+            "{\n"
+            "  \"stages\": {                (json object)\n"
+            "    \"stage\": {               (json object) One of sanity_checks, fork_checks, connect_txns, verify_txins, index_writing, callbacks,\n"
+            "                                load_block, connect_total, flush, write_chainstate, post_connect, connect_block,\n"
+            "                                mlsag_verify, rangeproof_verify, rct_index_write, insight_index_write, cs_index_write, smsg_fee_check\n"
+            "      \"count\": n,             (numeric) Number of times the stage ran\n"
+            "      \"total_us\": n,          (numeric) Total time spent in the stage in microseconds\n"
+            "      \"mean_us\": n,           (numeric) Mean duration in microseconds\n"
+            "      \"max_us\": n,            (numeric) Longest duration in microseconds\n"
+            "      \"histogram\": [          (json array)\n"
+            "        {\n"
+            "          \"lt_us\": n,         (numeric) Upper bound of the bucket in microseconds\n"
+            "          \"count\": n          (numeric) Number of durations in the bucket\n"
+            "        }, ...\n"
+            "      ]\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"counters\": {              (json object)\n"
+            "    \"blocks_connected\": n,    (numeric)\n"
+            "    \"txns_connected\": n,      (numeric)\n"
+            "    \"mlsag_cache_hits\": n,    (numeric) MLSAG signatures found in the proof cache\n"
+            "    \"rangeproof_cache_hits\": n (numeric) Rangeproofs found in the proof cache\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getvalidationstats", "")
+            + HelpExampleCli("getvalidationstats", "true")
+            + HelpExampleRpc("getvalidationstats", "")
+                },
+            }.Check(request);
+
+    bool reset = request.params[0].isNull() ? false : request.params[0].get_bool();
+
+    UniValue result(UniValue::VOBJ);
+    ValidationStatsToJSON(result, reset);
+    return result;
+}
+
 // clang-format off
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
@@ -2315,7 +2544,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type", "hash_or_height", "use_index"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
@@ -2323,6 +2552,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
     { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "blockchain",         "getvalidationstats",     &getvalidationstats,     {"reset"} },
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
@@ -9,6 +9,7 @@
 #include <sync.h>
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 extern RecursiveMutex cs_main;
@@ -16,7 +17,10 @@ extern RecursiveMutex cs_main;
 class CBlock;
 class CBlockIndex;
 class CTxMemPool;
+class JSONWriter;
 class UniValue;
+struct CCoinsStats;
+enum class CoinStatsHashType;
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
 
@@ -33,16 +37,26 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails = false, bool coinstakeDetails = false) LOCKS_EXCLUDED(cs_main);
+void blockToJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails = false, bool coinstakeDetails = false) LOCKS_EXCLUDED(cs_main);
 
 /** Mempool information to JSON */
 UniValue MempoolInfoToJSON(const CTxMemPool& pool);
 
 /** Mempool to JSON */
 UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose = false);
+void MempoolToJSON(JSONWriter& writer, const CTxMemPool& pool, bool verbose = false);
 
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex) LOCKS_EXCLUDED(cs_main);
 
+/** Look up a block on the active chain from a hash or height RPC parameter, throws on failure */
+CBlockIndex* ParseHashOrHeight(const UniValue& param) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+CoinStatsHashType ParseHashType(const std::string& hash_type_input);
+
+/** Get UTXO set statistics from the coinstatsindex if available and requested, else by scanning the chainstate */
+bool GetUTXOStatsForRPC(CCoinsStats& stats, CoinStatsHashType hash_type, const UniValue& hash_or_height, const UniValue& use_index) LOCKS_EXCLUDED(cs_main);
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
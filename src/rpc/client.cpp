@@ -127,6 +127,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "converttopsbt", 2, "iswitness"},
     { "gettxout", 1, "n" },
     { "gettxout", 2, "include_mempool" },
+    { "gettxoutsetinfo", 1, "hash_or_height" },
+    { "gettxoutsetinfo", 2, "use_index" },
+    { "getvalidationstats", 0, "reset" },
     { "gettxoutproof", 0, "txids" },
     { "lockunspent", 0, "unlock" },
     { "lockunspent", 1, "transactions" },
@@ -158,6 +161,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblockhashes", 0 , "high"},
     { "getblockhashes", 1, "low"},
     { "getblockhashes", 2, "options" },
+    { "gettxoutsetinfobyscript", 0, "hash_or_height" },
+    { "gettxoutsetinfobyscript", 1, "use_index" },
     { "getspentinfo", 0, "inputs"},
     { "getaddresstxids", 0, "addresses"},
     { "getaddressbalance", 0, "addresses"},
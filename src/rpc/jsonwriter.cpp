@@ -0,0 +1,147 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonwriter.h>
+
+#include <assert.h>
+
+void JSONWriter::Separate()
+{
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (!m_first.empty()) {
+        if (!m_first.back()) {
+            m_buffer += ',';
+        }
+        m_first.back() = false;
+    }
+};
+
+void JSONWriter::Written()
+{
+    if (m_first.empty()) {
+        m_num_values++;
+    }
+    if (m_sink && m_buffer.size() >= m_chunk_size) {
+        Flush();
+    }
+};
+
+void JSONWriter::Insert(const UniValue& value)
+{
+    if (m_stack.empty()) {
+        m_result = value;
+    } else
+    if (m_stack.back().isObject()) {
+        m_stack.back().__pushKV(m_key, value);
+    } else {
+        m_stack.back().push_back(value);
+    }
+};
+
+void JSONWriter::BeginObject()
+{
+    if (m_sink) {
+        Separate();
+        m_buffer += '{';
+    } else {
+        m_stack.emplace_back(UniValue::VOBJ);
+        m_stack_keys.push_back(m_key);
+    }
+    m_first.push_back(true);
+};
+
+void JSONWriter::EndObject()
+{
+    assert(!m_first.empty());
+    m_first.pop_back();
+    if (m_sink) {
+        m_buffer += '}';
+    } else {
+        assert(m_stack.back().isObject());
+        UniValue value = m_stack.back();
+        m_stack.pop_back();
+        m_key = m_stack_keys.back();
+        m_stack_keys.pop_back();
+        Insert(value);
+    }
+    Written();
+};
+
+void JSONWriter::BeginArray()
+{
+    if (m_sink) {
+        Separate();
+        m_buffer += '[';
+    } else {
+        m_stack.emplace_back(UniValue::VARR);
+        m_stack_keys.push_back(m_key);
+    }
+    m_first.push_back(true);
+};
+
+void JSONWriter::EndArray()
+{
+    assert(!m_first.empty());
+    m_first.pop_back();
+    if (m_sink) {
+        m_buffer += ']';
+    } else {
+        assert(m_stack.back().isArray());
+        UniValue value = m_stack.back();
+        m_stack.pop_back();
+        m_key = m_stack_keys.back();
+        m_stack_keys.pop_back();
+        Insert(value);
+    }
+    Written();
+};
+
+void JSONWriter::Key(const std::string& key)
+{
+    if (m_sink) {
+        assert(!m_first.empty() && !m_after_key);
+        if (!m_first.back()) {
+            m_buffer += ',';
+        }
+        m_first.back() = false;
+        m_buffer += UniValue(key).write();
+        m_buffer += ':';
+        m_after_key = true;
+    } else {
+        m_key = key;
+    }
+};
+
+void JSONWriter::Value(const UniValue& value)
+{
+    if (m_sink) {
+        Separate();
+        m_buffer += value.write();
+    } else {
+        Insert(value);
+    }
+    Written();
+};
+
+void JSONWriter::Append(const std::string& text)
+{
+    if (!m_sink) {
+        return;
+    }
+    m_buffer += text;
+    if (m_buffer.size() >= m_chunk_size) {
+        Flush();
+    }
+};
+
+void JSONWriter::Flush()
+{
+    if (m_sink && !m_buffer.empty()) {
+        m_sink(m_buffer);
+        m_buffer.clear();
+    }
+};
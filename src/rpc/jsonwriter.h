@@ -0,0 +1,83 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_RPC_JSONWRITER_H
+#define PARTICL_RPC_JSONWRITER_H
+
+#include <univalue.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Writes a JSON document a value at a time, either as text passed to a sink in
+ * chunks or as a UniValue for callers without a stream.
+ *
+ * Large results written as text don't need the whole document as a UniValue
+ * and a string at once, the first chunk can be sent while the rest is written.
+ */
+class JSONWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    //! Build the document as a UniValue
+    JSONWriter() {}
+    //! Write the document as text, passing it to sink in chunks of at least chunk_size bytes
+    explicit JSONWriter(Sink sink, size_t chunk_size = DEFAULT_CHUNK_SIZE) : m_sink(std::move(sink)), m_chunk_size(chunk_size) {}
+
+    bool IsStreaming() const { return (bool)m_sink; }
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    //! Set the key of the next value written into an object
+    void Key(const std::string& key);
+    void Value(const UniValue& value);
+
+    void PushKV(const std::string& key, const UniValue& value)
+    {
+        Key(key);
+        Value(value);
+    }
+
+    //! Add text outside the document, to wrap it when streaming
+    void Append(const std::string& text);
+
+    //! Pass the text written so far to the sink
+    void Flush();
+
+    //! Number of complete documents written
+    size_t NumValues() const { return m_num_values; }
+
+    //! The document built, when not streaming
+    const UniValue& GetValue() const { return m_result; }
+
+private:
+    //! Prefix the next value with a separator as needed
+    void Separate();
+    void Written();
+    void Insert(const UniValue& value);
+
+    Sink m_sink;
+    size_t m_chunk_size = DEFAULT_CHUNK_SIZE;
+    std::string m_buffer;
+
+    //! For each open container whether nothing has been written into it yet
+    std::vector<bool> m_first;
+    bool m_after_key = false;
+    size_t m_num_values = 0;
+
+    std::vector<UniValue> m_stack;
+    std::vector<std::string> m_stack_keys;
+    std::string m_key;
+    UniValue m_result;
+};
+
+#endif // PARTICL_RPC_JSONWRITER_H
@@ -340,7 +340,7 @@ UniValue SignTransaction(CMutableTransaction& mtx, const SigningProvider* keysto
         if (coin->second.nType == OUTPUT_CT) {
             amount = 0; // Bypass amount check
             vchAmount.resize(33);
-            memcpy(vchAmount.data(), coin->second.commitment.data, 33);
+            memcpy(vchAmount.data(), coin->second.GetCommitment().data, 33);
         } else {
             throw JSONRPCError(RPC_MISC_ERROR, strprintf("Bad input type: %d", coin->second.nType));
         }
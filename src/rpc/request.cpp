@@ -150,6 +150,63 @@ std::vector<UniValue> JSONRPCProcessBatchReply(const UniValue &in, size_t num)
     return batch;
 }
 
+bool JSONRPCPeekMethod(const std::string& body, std::string& method)
+{
+    // Walk the keys of the top-level object, skipping nested values and the contents of strings
+    int depth = 0;
+    bool in_value = false;
+    std::string key;
+    for (size_t i = 0; i < body.size(); ++i) {
+        char c = body[i];
+        if (c == '"') {
+            if (depth < 1) {
+                return false;
+            }
+            size_t end = i + 1;
+            bool escaped = false;
+            while (end < body.size() && body[end] != '"') {
+                if (body[end] == '\\') {
+                    escaped = true;
+                    ++end;
+                }
+                ++end;
+            }
+            if (end >= body.size()) {
+                return false;
+            }
+            if (depth == 1) {
+                if (!in_value) {
+                    key = escaped ? "" : body.substr(i + 1, end - i - 1);
+                } else if (key == "method") {
+                    // Method names never need escapes
+                    if (escaped || end == i + 1) {
+                        return false;
+                    }
+                    method = body.substr(i + 1, end - i - 1);
+                    return true;
+                }
+            }
+            i = end;
+        } else if (c == '{' || c == '[') {
+            if (depth == 0 && c != '{') {
+                return false;
+            }
+            ++depth;
+        } else if (c == '}' || c == ']') {
+            if (--depth < 1) {
+                return false;
+            }
+        } else if (depth == 1 && c == ':') {
+            in_value = true;
+        } else if (depth == 1 && c == ',') {
+            in_value = false;
+        } else if (depth == 0 && c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            return false;
+        }
+    }
+    return false;
+}
+
 void JSONRPCRequest::parse(const UniValue& valRequest)
 {
     // Parse request
@@ -10,6 +10,8 @@
 
 #include <univalue.h>
 
+class JSONWriter;
+
 UniValue JSONRPCRequestObj(const std::string& strMethod, const UniValue& params, const UniValue& id);
 UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const UniValue& id);
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
@@ -23,6 +25,9 @@ bool GetAuthCookie(std::string *cookie_out);
 void DeleteAuthCookie();
 /** Parse JSON-RPC batch reply into a vector */
 std::vector<UniValue> JSONRPCProcessBatchReply(const UniValue &in, size_t num);
+/** Find the method of a single JSON-RPC request without parsing the whole body,
+ * returns false for batches and for bodies the method can't be read from */
+bool JSONRPCPeekMethod(const std::string& body, std::string& method);
 
 class JSONRPCRequest
 {
@@ -35,6 +40,8 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    //! Streams the result of calls that support it, see WriteRPCResult
+    JSONWriter* replyWriter = nullptr;
 
     JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
     void parse(const UniValue& valRequest);
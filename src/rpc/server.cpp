@@ -6,7 +6,9 @@
 #include <rpc/server.h>
 
 #include <fs.h>
+#include <httpserver.h>
 #include <key_io.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/util.h>
 #include <shutdown.h>
 #include <sync.h>
@@ -209,7 +211,28 @@ static UniValue getrpcinfo(const JSONRPCRequest& request)
             "    \"duration\"     (numeric)  The running time in microseconds\n"
             "   },...\n"
             "  ],\n"
-            " \"logpath\": \"xxx\" (string) The complete file path to the debug log\n"
+            " \"logpath\": \"xxx\", (string) The complete file path to the debug log\n"
+            " \"work_queues\": [  (array) The queues HTTP requests wait in for a worker thread\n"
+            "   {\n"
+            "    \"name\": \"xxx\",    (string) main, or fast for the fast lane\n"
+            "    \"threads\": n,     (numeric) The worker threads of the queue\n"
+            "    \"depth\": n,       (numeric) Requests waiting\n"
+            "    \"peak_depth\": n,  (numeric) Most requests waiting at once\n"
+            "    \"max_depth\": n,   (numeric) Requests waiting before new ones are rejected\n"
+            "    \"methods\": {      (object) Requests by method, REST requests by path and other requests as other\n"
+            "      \"method\": {\n"
+            "        \"queued\": n,      (numeric) Requests waiting\n"
+            "        \"peak_queued\": n, (numeric) Most requests waiting at once\n"
+            "        \"running\": n,     (numeric) Requests running\n"
+            "        \"limit\": n,       (numeric) Most requests running at once\n"
+            "        \"calls\": n,       (numeric) Requests completed\n"
+            "        \"rejected\": n,    (numeric) Requests rejected as the queue was full\n"
+            "        \"wait\": [n,...],  (array) Counts of the times waited, below 1, 4, 16, ... 65536 milliseconds and above\n"
+            "        \"duration\": [n,...] (array) Counts of the times run, bucketed as wait\n"
+            "      },...\n"
+            "    }\n"
+            "   },...\n"
+            " ]\n"
             "}\n"
                 },
                 RPCExamples{
@@ -233,6 +256,38 @@ static UniValue getrpcinfo(const JSONRPCRequest& request)
     UniValue log_path(UniValue::VSTR, path);
     result.pushKV("logpath", log_path);
 
+    UniValue work_queues(UniValue::VARR);
+    for (const HTTPWorkQueueStats& queue : GetHTTPWorkQueueStats()) {
+        UniValue methods(UniValue::VOBJ);
+        for (const auto& c : queue.classes) {
+            const HTTPWorkClassStats& stats = c.second;
+            UniValue wait(UniValue::VARR), duration(UniValue::VARR);
+            for (int i = 0; i < HTTPLatencyHistogram::BUCKETS; ++i) {
+                wait.push_back(stats.wait.counts[i]);
+                duration.push_back(stats.duration.counts[i]);
+            }
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("queued", (uint64_t)stats.queued);
+            entry.pushKV("peak_queued", (uint64_t)stats.peak_queued);
+            entry.pushKV("running", stats.running);
+            entry.pushKV("limit", stats.limit);
+            entry.pushKV("calls", stats.calls);
+            entry.pushKV("rejected", stats.rejected);
+            entry.pushKV("wait", wait);
+            entry.pushKV("duration", duration);
+            methods.pushKV(c.first, entry);
+        }
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("name", queue.name);
+        entry.pushKV("threads", queue.threads);
+        entry.pushKV("depth", (uint64_t)queue.depth);
+        entry.pushKV("peak_depth", (uint64_t)queue.peak_depth);
+        entry.pushKV("max_depth", (uint64_t)queue.max_depth);
+        entry.pushKV("methods", methods);
+        work_queues.push_back(entry);
+    }
+    result.pushKV("work_queues", work_queues);
+
     return result;
 }
 
@@ -466,6 +521,12 @@ std::vector<std::string> CRPCTable::listCommands() const
     return commandList;
 }
 
+bool CRPCTable::hasCommand(const std::string& name) const
+{
+    auto it = mapCommands.find(name);
+    return it != mapCommands.end() && !it->second.empty();
+}
+
 void RPCSetTimerInterfaceIfUnset(RPCTimerInterface *iface)
 {
     if (!timerInterface)
@@ -536,4 +597,13 @@ void PushTime(UniValue &o, const char *name, int64_t nTime)
     };
 };
 
+void PushTime(JSONWriter &writer, const char *name, int64_t nTime)
+{
+    UniValue o(UniValue::VOBJ);
+    PushTime(o, name, nTime);
+    for (size_t i = 0; i < o.size(); ++i) {
+        writer.PushKV(o.getKeys()[i], o.getValues()[i]);
+    }
+};
+
 CRPCTable tableRPC;
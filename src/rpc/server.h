@@ -141,6 +141,8 @@ public:
     */
     std::vector<std::string> listCommands() const;
 
+    /** Whether a command is registered under the name */
+    bool hasCommand(const std::string& name) const;
 
     /**
      * Appends a CRPCCommand to the dispatch table.
@@ -171,6 +173,7 @@ std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
 int RPCSerializationFlags();
 
 void PushTime(UniValue &o, const char *name, int64_t nTime);
+void PushTime(JSONWriter &writer, const char *name, int64_t nTime);
 
 #endif // BITCOIN_RPC_SERVER_H
 
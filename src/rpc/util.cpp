@@ -796,3 +796,14 @@ UniValue GetServicesNames(ServiceFlags services)
 
     return servicesNames;
 }
+
+UniValue WriteRPCResult(const JSONRPCRequest& request, const std::function<void(JSONWriter&)>& write)
+{
+    if (request.replyWriter) {
+        write(*request.replyWriter);
+        return NullUniValue;
+    }
+    JSONWriter writer;
+    write(writer);
+    return writer.GetValue();
+}
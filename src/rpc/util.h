@@ -9,6 +9,7 @@
 #include <outputtype.h>
 #include <pubkey.h>
 #include <protocol.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/protocol.h>
 #include <rpc/request.h>
 #include <script/script.h>
@@ -16,6 +17,7 @@
 #include <script/standard.h>
 #include <univalue.h>
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -96,6 +98,12 @@ std::vector<CScript> EvalDescriptorStringOrObject(const UniValue& scanobject, Fl
 /** Returns, given services flags, a list of humanly readable (known) network services */
 UniValue GetServicesNames(ServiceFlags services);
 
+/**
+ * Write the result of a call into the reply stream of the request when the transport
+ * streams replies and return null, otherwise return the result built as a UniValue.
+ */
+UniValue WriteRPCResult(const JSONRPCRequest& request, const std::function<void(JSONWriter&)>& write);
+
 struct RPCArg {
     enum class Type {
         OBJ,
@@ -587,6 +587,31 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_ec_pubkey_tweak_add(
     const unsigned char *tweak
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3);
 
+/** Tweak one public key by each of n tweaks, the same as calling
+ *  secp256k1_ec_pubkey_tweak_add on n copies of it. The input key is loaded
+ *  once and the results are converted to affine coordinates in batches that
+ *  share a single field inversion.
+ * Returns: the number of valid results.
+ * Args:    ctx:     pointer to a context object initialized for validation
+ *                   (cannot be NULL).
+ * Out:     pubkeys: pointer to an array of n public key objects. A result is
+ *                   zeroed when secp256k1_ec_pubkey_tweak_add would fail for
+ *                   its tweak.
+ *          valid:   pointer to an array of n ints, set to 1 where the public
+ *                   key at the same index is valid and 0 otherwise.
+ * In:      pubkey:  pointer to the public key to tweak.
+ *          tweaks:  pointer to n consecutive 32-byte tweaks.
+ *          n:       the number of tweaks.
+ */
+SECP256K1_API int secp256k1_ec_pubkey_tweak_add_batch(
+    const secp256k1_context* ctx,
+    secp256k1_pubkey *pubkeys,
+    int *valid,
+    const secp256k1_pubkey *pubkey,
+    const unsigned char *tweaks,
+    size_t n
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(4);
+
 /** Tweak a private key by multiplying it by a tweak.
  * Returns: 0 if the tweak was out of range (chance of around 1 in 2^128 for
  *          uniformly random 32-byte arrays, or equal to zero. 1 otherwise.
@@ -538,6 +538,59 @@ int secp256k1_ec_pubkey_tweak_add(const secp256k1_context* ctx, secp256k1_pubkey
     return ret;
 }
 
+int secp256k1_ec_pubkey_tweak_add_batch(const secp256k1_context* ctx, secp256k1_pubkey *pubkeys, int *valid, const secp256k1_pubkey *pubkey, const unsigned char *tweaks, size_t n) {
+    secp256k1_ge p;
+    secp256k1_gej inf;
+    secp256k1_gej pj[32];
+    secp256k1_ge r[32];
+    secp256k1_scalar zero;
+    size_t i, j, chunk;
+    int ret = 0;
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    ARG_CHECK(pubkeys != NULL || n == 0);
+    ARG_CHECK(valid != NULL || n == 0);
+    ARG_CHECK(pubkey != NULL);
+    ARG_CHECK(tweaks != NULL || n == 0);
+
+    if (n == 0) {
+        return 0;
+    }
+    memset(pubkeys, 0, sizeof(*pubkeys) * n);
+    memset(valid, 0, sizeof(*valid) * n);
+    if (!secp256k1_pubkey_load(ctx, &p, pubkey)) {
+        return 0;
+    }
+    secp256k1_gej_set_infinity(&inf);
+    secp256k1_scalar_set_int(&zero, 0);
+
+    for (i = 0; i < n; i += chunk) {
+        chunk = n - i < 32 ? n - i : 32;
+        for (j = 0; j < chunk; j++) {
+            secp256k1_scalar term;
+            int overflow = 0;
+            secp256k1_scalar_set_b32(&term, tweaks + 32 * (i + j), &overflow);
+            if (overflow) {
+                secp256k1_gej_set_infinity(&pj[j]);
+                continue;
+            }
+            /* term*G only uses the generator tables, p is added in affine coordinates */
+            secp256k1_ecmult(&ctx->ecmult_ctx, &pj[j], &inf, &zero, &term);
+            secp256k1_gej_add_ge_var(&pj[j], &pj[j], &p, NULL);
+        }
+        secp256k1_ge_set_all_gej_var(r, pj, chunk);
+        for (j = 0; j < chunk; j++) {
+            if (!r[j].infinity) {
+                secp256k1_pubkey_save(&pubkeys[i + j], &r[j]);
+                valid[i + j] = 1;
+                ret++;
+            }
+        }
+    }
+
+    return ret;
+}
+
 int secp256k1_ec_privkey_tweak_mul(const secp256k1_context* ctx, unsigned char *seckey, const unsigned char *tweak) {
     secp256k1_scalar factor;
     secp256k1_scalar sec;
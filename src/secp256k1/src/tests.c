@@ -3822,6 +3822,47 @@ void run_ec_pubkey_parse_test(void) {
     }
 }
 
+void run_ec_pubkey_tweak_add_batch_test(void) {
+    unsigned char seckey[32];
+    unsigned char tweaks[70 * 32];
+    secp256k1_pubkey pubkey;
+    secp256k1_pubkey expected;
+    secp256k1_pubkey batch[70];
+    int valid[70];
+    secp256k1_scalar s;
+    size_t i;
+    int n_valid = 0;
+
+    random_scalar_order_test(&s);
+    secp256k1_scalar_get_b32(seckey, &s);
+    CHECK(secp256k1_ec_pubkey_create(ctx, &pubkey, seckey) == 1);
+    for (i = 0; i < 70; i++) {
+        random_scalar_order_test(&s);
+        secp256k1_scalar_get_b32(tweaks + 32 * i, &s);
+    }
+    /* An out of range tweak, a zero tweak and the complement of the key */
+    memset(tweaks + 32 * 3, 0xff, 32);
+    memset(tweaks + 32 * 40, 0, 32);
+    secp256k1_scalar_set_b32(&s, seckey, NULL);
+    secp256k1_scalar_negate(&s, &s);
+    secp256k1_scalar_get_b32(tweaks + 32 * 65, &s);
+
+    for (i = 0; i < 70; i++) {
+        int ok;
+        expected = pubkey;
+        ok = secp256k1_ec_pubkey_tweak_add(ctx, &expected, tweaks + 32 * i);
+        n_valid += ok;
+        CHECK(ok == (i != 3 && i != 65));
+    }
+    CHECK(secp256k1_ec_pubkey_tweak_add_batch(ctx, batch, valid, &pubkey, tweaks, 70) == n_valid);
+    for (i = 0; i < 70; i++) {
+        expected = pubkey;
+        CHECK(valid[i] == secp256k1_ec_pubkey_tweak_add(ctx, &expected, tweaks + 32 * i));
+        CHECK(memcmp(&batch[i], &expected, sizeof(expected)) == 0);
+    }
+    CHECK(secp256k1_ec_pubkey_tweak_add_batch(ctx, batch, valid, &pubkey, tweaks, 0) == 0);
+}
+
 void run_eckey_edge_case_test(void) {
     const unsigned char orderc[32] = {
         0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -5251,6 +5292,7 @@ int main(int argc, char **argv) {
 
     /* EC key edge cases */
     run_eckey_edge_case_test();
+    run_ec_pubkey_tweak_add_batch_test();
 
 #ifdef ENABLE_MODULE_ECDH
     /* ecdh tests */
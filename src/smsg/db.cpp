@@ -11,6 +11,9 @@
 #include <leveldb/db.h>
 #include <string.h>
 
+#include <compat/byteswap.h>
+#include <crypto/common.h>
+
 namespace smsg {
 
 const std::string DBK_PUBLICKEY     = "pk";
@@ -18,11 +21,71 @@ const std::string DBK_SECRETKEY     = "sk";
 const std::string DBK_INBOX         = "IM";
 const std::string DBK_OUTBOX        = "SM";
 const std::string DBK_QUEUED        = "QM";
+const std::string DBK_FUNDING       = "FM";
 const std::string DBK_PURGED_TOKEN  = "pm";
+const std::string DBK_INBOX_INDEX   = "ix";
+const std::string DBK_INBOX_UNREAD  = "iu";
+const std::string DBK_INBOX_READ    = "ir";
+const std::string DBK_INBOX_INDEX_VERSION = "iv";
 
 CCriticalSection cs_smsgDB;
 leveldb::DB *smsgDB = nullptr;
 
+static bool IsInboxKey(const uint8_t *chKey)
+{
+    return memcmp(chKey, DBK_INBOX.data(), 2) == 0;
+};
+
+static void GetInboxIndexKey(const uint8_t *chKey, const CKeyID &addrTo, bool fRead, int64_t timeReceived, uint8_t *chIndexKey)
+{
+    // Keys of each address and read status sort by the big endian time received, then by message key
+    memcpy(chIndexKey, DBK_INBOX_INDEX.data(), 2);
+    memcpy(chIndexKey+2, addrTo.begin(), 20);
+    chIndexKey[22] = fRead ? 1 : 0;
+    WriteBE64(chIndexKey+23, timeReceived);
+    memcpy(chIndexKey+31, chKey+2, 28);
+};
+
+static void GetInboxTimeKey(const uint8_t *chKey, bool fRead, int64_t timeReceived, uint8_t *chTimeKey)
+{
+    memcpy(chTimeKey, (fRead ? DBK_INBOX_READ : DBK_INBOX_UNREAD).data(), 2);
+    WriteBE64(chTimeKey+2, timeReceived);
+    memcpy(chTimeKey+10, chKey+2, 28);
+};
+
+static void PutInboxIndex(leveldb::WriteBatch *pbatch, const uint8_t *chKey, const SecMsgStored &smsgStored)
+{
+    if (smsgStored.vchMessage.size() < SMSG_HDR_LEN) {
+        return;
+    }
+    const SecureMessage *psmsg = (const SecureMessage*) smsgStored.vchMessage.data();
+
+    SecMsgIndexEntry entry;
+    entry.timeReceived = smsgStored.timeReceived;
+    entry.status = smsgStored.status;
+    entry.timeSent = psmsg->timestamp;
+    entry.ttl = psmsg->m_ttl;
+    entry.version[0] = psmsg->version[0];
+    entry.version[1] = psmsg->version[1];
+    entry.nPayload = smsgStored.vchMessage.size() - SMSG_HDR_LEN;
+
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << entry;
+
+    // Status is the only field expected to change when a stored message is rewritten
+    uint8_t chIndexKey[SMSG_INBOX_INDEX_KEY_LEN];
+    GetInboxIndexKey(chKey, smsgStored.addrTo, !entry.IsRead(), entry.timeReceived, chIndexKey);
+    pbatch->Delete(leveldb::Slice((const char*)chIndexKey, SMSG_INBOX_INDEX_KEY_LEN));
+    GetInboxIndexKey(chKey, smsgStored.addrTo, entry.IsRead(), entry.timeReceived, chIndexKey);
+    pbatch->Put(leveldb::Slice((const char*)chIndexKey, SMSG_INBOX_INDEX_KEY_LEN), ssValue.str());
+
+    uint8_t chTimeKey[SMSG_INBOX_TIME_KEY_LEN];
+    GetInboxTimeKey(chKey, !entry.IsRead(), entry.timeReceived, chTimeKey);
+    pbatch->Delete(leveldb::Slice((const char*)chTimeKey, SMSG_INBOX_TIME_KEY_LEN));
+    GetInboxTimeKey(chKey, entry.IsRead(), entry.timeReceived, chTimeKey);
+    pbatch->Put(leveldb::Slice((const char*)chTimeKey, SMSG_INBOX_TIME_KEY_LEN), leveldb::Slice());
+};
+
 bool SecMsgDB::Open(const char *pszMode)
 {
     if (smsgDB) {
@@ -422,14 +485,21 @@ bool SecMsgDB::WriteSmesg(const uint8_t *chKey, SecMsgStored &smsgStored)
     CDataStream ssValue(SER_DISK, CLIENT_VERSION);
     ssValue << smsgStored;
 
+    // Write the message and its index entry together
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch *pbatch = activeBatch ? activeBatch : &batch;
+    pbatch->Put(ssKey.str(), ssValue.str());
+    if (IsInboxKey(chKey)) {
+        PutInboxIndex(pbatch, chKey, smsgStored);
+    }
+
     if (activeBatch) {
-        activeBatch->Put(ssKey.str(), ssValue.str());
         return true;
     }
 
     leveldb::WriteOptions writeOptions;
     writeOptions.sync = true;
-    leveldb::Status s = pdb->Put(writeOptions, ssKey.str(), ssValue.str());
+    leveldb::Status s = pdb->Write(writeOptions, &batch);
     if (!s.ok()) {
         return error("SecMsgDB write failed: %s\n", s.ToString());
     }
@@ -461,6 +531,14 @@ bool SecMsgDB::ExistsSmesg(const uint8_t *chKey)
 
 bool SecMsgDB::EraseSmesg(const uint8_t *chKey)
 {
+    if (IsInboxKey(chKey)) {
+        // Need the stored message to find the index entry
+        SecMsgStored smsgStored;
+        if (ReadSmesg(chKey, smsgStored)) {
+            return EraseSmesg(chKey, smsgStored);
+        }
+    }
+
     CDataStream ssKey(SER_DISK, CLIENT_VERSION);
     ssKey.write((const char*)chKey, 30);
 
@@ -479,6 +557,264 @@ bool SecMsgDB::EraseSmesg(const uint8_t *chKey)
     return error("SecMsgDB erase failed: %s\n", s.ToString());
 };
 
+bool SecMsgDB::EraseSmesg(const uint8_t *chKey, const SecMsgStored &smsgStored)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey.write((const char*)chKey, 30);
+
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch *pbatch = activeBatch ? activeBatch : &batch;
+    pbatch->Delete(ssKey.str());
+    if (IsInboxKey(chKey)) {
+        uint8_t chIndexKey[SMSG_INBOX_INDEX_KEY_LEN];
+        uint8_t chTimeKey[SMSG_INBOX_TIME_KEY_LEN];
+        for (bool fRead : {false, true}) {
+            GetInboxIndexKey(chKey, smsgStored.addrTo, fRead, smsgStored.timeReceived, chIndexKey);
+            pbatch->Delete(leveldb::Slice((const char*)chIndexKey, SMSG_INBOX_INDEX_KEY_LEN));
+            GetInboxTimeKey(chKey, fRead, smsgStored.timeReceived, chTimeKey);
+            pbatch->Delete(leveldb::Slice((const char*)chTimeKey, SMSG_INBOX_TIME_KEY_LEN));
+        }
+    }
+
+    if (activeBatch) {
+        return true;
+    }
+
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = true;
+    leveldb::Status s = pdb->Write(writeOptions, &batch);
+
+    if (s.ok()) {
+        return true;
+    }
+    return error("SecMsgDB erase failed: %s\n", s.ToString());
+};
+
+bool SecMsgIndexEntry::IsRead() const
+{
+    return !(status & SMSG_MASK_UNREAD);
+};
+
+bool SecMsgDB::ReadInboxIndexVersion(int &nVersion)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    std::string strValue;
+    leveldb::Status s = pdb->Get(leveldb::ReadOptions(), DBK_INBOX_INDEX_VERSION, &strValue);
+    if (!s.ok()) {
+        if (s.IsNotFound()) {
+            return false;
+        }
+        return error("LevelDB read failure: %s\n", s.ToString());
+    }
+
+    try {
+        CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> nVersion;
+    } catch (std::exception &e) {
+        LogPrintf("%s unserialize threw: %s.\n", __func__, e.what());
+        return false;
+    };
+
+    return true;
+};
+
+bool SecMsgDB::WriteInboxIndexVersion(int nVersion)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << nVersion;
+
+    if (activeBatch) {
+        activeBatch->Put(DBK_INBOX_INDEX_VERSION, ssValue.str());
+        return true;
+    }
+
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = true;
+    leveldb::Status s = pdb->Put(writeOptions, DBK_INBOX_INDEX_VERSION, ssValue.str());
+    if (!s.ok()) {
+        return error("%s failed: %s\n", __func__, s.ToString());
+    }
+
+    return true;
+};
+
+bool SecMsgDB::WriteInboxIndex(const uint8_t *chKey, const SecMsgStored &smsgStored)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch *pbatch = activeBatch ? activeBatch : &batch;
+    PutInboxIndex(pbatch, chKey, smsgStored);
+
+    if (activeBatch) {
+        return true;
+    }
+
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = true;
+    leveldb::Status s = pdb->Write(writeOptions, &batch);
+    if (!s.ok()) {
+        return error("%s failed: %s\n", __func__, s.ToString());
+    }
+
+    return true;
+};
+
+bool SecMsgDB::ClearInboxIndex()
+{
+    if (!pdb) {
+        return false;
+    }
+
+    leveldb::WriteBatch batch;
+    leveldb::WriteBatch *pbatch = activeBatch ? activeBatch : &batch;
+
+    // Clear keys of any size, the key layout changes with the index version
+    leveldb::Iterator *it = pdb->NewIterator(leveldb::ReadOptions());
+    for (const auto &prefix : {DBK_INBOX_INDEX, DBK_INBOX_UNREAD, DBK_INBOX_READ}) {
+        for (it->Seek(prefix); it->Valid(); it->Next()) {
+            if (it->key().size() < 2
+                || memcmp(it->key().data(), prefix.data(), 2) != 0) {
+                break;
+            }
+            pbatch->Delete(it->key());
+        }
+    }
+    delete it;
+    pbatch->Delete(DBK_INBOX_INDEX_VERSION);
+
+    if (activeBatch) {
+        return true;
+    }
+
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = true;
+    leveldb::Status s = pdb->Write(writeOptions, &batch);
+    if (!s.ok()) {
+        return error("%s failed: %s\n", __func__, s.ToString());
+    }
+
+    return true;
+};
+
+bool SecMsgDB::CountInboxIndex(const CKeyID *pAddrTo, std::map<CKeyID, SecMsgIndexCount> &mCounts)
+{
+    if (!pdb) {
+        return false;
+    }
+
+    std::string seek_key = DBK_INBOX_INDEX;
+    if (pAddrTo) {
+        seek_key.append((const char*)pAddrTo->begin(), 20);
+    }
+
+    CKeyID addrTo;
+    leveldb::Iterator *it = pdb->NewIterator(leveldb::ReadOptions());
+    for (it->Seek(seek_key); it->Valid(); it->Next()) {
+        const uint8_t *p = (const uint8_t*)it->key().data();
+        if (it->key().size() != SMSG_INBOX_INDEX_KEY_LEN
+            || memcmp(p, seek_key.data(), seek_key.size()) != 0) {
+            break;
+        }
+        memcpy(addrTo.begin(), p+2, 20);
+        SecMsgIndexCount &count = mCounts[addrTo];
+        count.nTotal++;
+        if (p[22] == 0) {
+            count.nUnread++;
+        }
+    }
+    delete it;
+
+    return true;
+};
+
+SecMsgInboxCursor::SecMsgInboxCursor(SecMsgDB &db, const CKeyID *pAddrTo, bool fUnreadOnly, const uint8_t *pAfterMsgId, int64_t nAfterTimeReceived)
+{
+    std::vector<std::string> vPrefixes;
+    if (pAddrTo) {
+        std::string prefix = DBK_INBOX_INDEX;
+        prefix.append((const char*)pAddrTo->begin(), 20);
+        vPrefixes.push_back(prefix + '\0');
+        if (!fUnreadOnly) {
+            vPrefixes.push_back(prefix + '\1');
+        }
+    } else {
+        vPrefixes.push_back(DBK_INBOX_UNREAD);
+        if (!fUnreadOnly) {
+            vPrefixes.push_back(DBK_INBOX_READ);
+        }
+    }
+
+    if (!db.pdb) {
+        return;
+    }
+    for (const auto &prefix : vPrefixes) {
+        Range r;
+        r.it = db.pdb->NewIterator(leveldb::ReadOptions());
+        r.prefix = prefix;
+        if (pAfterMsgId) {
+            std::string seek_key = prefix;
+            uint8_t chTime[8];
+            WriteBE64(chTime, nAfterTimeReceived);
+            seek_key.append((const char*)chTime, 8);
+            seek_key.append((const char*)pAfterMsgId, 28);
+            r.it->Seek(seek_key);
+            if (r.it->Valid() && r.it->key() == seek_key) {
+                r.it->Next();
+            }
+        } else {
+            r.it->Seek(prefix);
+        }
+        m_ranges.push_back(r);
+    }
+};
+
+SecMsgInboxCursor::~SecMsgInboxCursor()
+{
+    for (auto &r : m_ranges) {
+        delete r.it;
+    }
+};
+
+bool SecMsgInboxCursor::Valid(const Range &r) const
+{
+    return r.it->Valid()
+        && r.it->key().size() == r.prefix.size() + 36
+        && memcmp(r.it->key().data(), r.prefix.data(), r.prefix.size()) == 0;
+};
+
+bool SecMsgInboxCursor::Next(uint8_t *chKey)
+{
+    // Each range ends with the 8 byte time received and the 28 byte message id, take the lowest
+    Range *pNext = nullptr;
+    for (auto &r : m_ranges) {
+        if (!Valid(r)) {
+            continue;
+        }
+        if (!pNext
+            || memcmp(r.it->key().data() + r.prefix.size(), pNext->it->key().data() + pNext->prefix.size(), 36) < 0) {
+            pNext = &r;
+        }
+    }
+    if (!pNext) {
+        return false;
+    }
+
+    memcpy(chKey, DBK_INBOX.data(), 2);
+    memcpy(chKey+2, pNext->it->key().data() + pNext->prefix.size() + 8, 28);
+    pNext->it->Next();
+    return true;
+};
+
 bool SecMsgDB::ReadPurged(const uint8_t *chKey, SecMsgPurged &smsgPurged)
 {
     if (!pdb) {
@@ -11,6 +11,9 @@
 #include <sync.h>
 #include <pubkey.h>
 
+#include <map>
+#include <vector>
+
 class CDataStream;
 
 namespace smsg {
@@ -27,7 +30,60 @@ extern const std::string DBK_SECRETKEY;
 extern const std::string DBK_INBOX;
 extern const std::string DBK_OUTBOX;
 extern const std::string DBK_QUEUED;
+extern const std::string DBK_FUNDING;
 extern const std::string DBK_PURGED_TOKEN;
+extern const std::string DBK_INBOX_INDEX;
+extern const std::string DBK_INBOX_UNREAD;
+extern const std::string DBK_INBOX_READ;
+extern const std::string DBK_INBOX_INDEX_VERSION;
+
+const int SMSG_INBOX_INDEX_VERSION = 3;
+const size_t SMSG_INBOX_INDEX_KEY_LEN = 2 + 20 + 1 + 8 + 28; // prefix, addrTo, read, time received, timestamp + msgid
+const size_t SMSG_INBOX_TIME_KEY_LEN = 2 + 8 + 28; // prefix by read status, time received, timestamp + msgid
+
+/** Inbox index value, the stored message metadata cached beside the index key. */
+class SecMsgIndexEntry
+{
+public:
+    int64_t timeReceived = 0;
+    uint8_t status = 0;
+    int64_t timeSent = 0;
+    uint32_t ttl = 0;
+    uint8_t version[2] = {0, 0};
+    uint32_t nPayload = 0;
+
+    bool IsRead() const;
+
+    template<typename Stream>
+    void Serialize(Stream &s) const
+    {
+        s << timeReceived;
+        s << status;
+        s << timeSent;
+        s << ttl;
+        s << version[0];
+        s << version[1];
+        s << nPayload;
+    };
+    template <typename Stream>
+    void Unserialize(Stream &s)
+    {
+        s >> timeReceived;
+        s >> status;
+        s >> timeSent;
+        s >> ttl;
+        s >> version[0];
+        s >> version[1];
+        s >> nPayload;
+    };
+};
+
+class SecMsgIndexCount
+{
+public:
+    size_t nTotal = 0;
+    size_t nUnread = 0;
+};
 
 class SecMsgDB
 {
@@ -66,6 +122,13 @@ public:
     bool WriteSmesg(const uint8_t *chKey, SecMsgStored &smsgStored);
     bool ExistsSmesg(const uint8_t *chKey);
     bool EraseSmesg(const uint8_t *chKey);
+    bool EraseSmesg(const uint8_t *chKey, const SecMsgStored &smsgStored);
+
+    bool ReadInboxIndexVersion(int &nVersion);
+    bool WriteInboxIndexVersion(int nVersion);
+    bool WriteInboxIndex(const uint8_t *chKey, const SecMsgStored &smsgStored);
+    bool ClearInboxIndex();
+    bool CountInboxIndex(const CKeyID *pAddrTo, std::map<CKeyID, SecMsgIndexCount> &mCounts);
 
 
     bool ReadPurged(const uint8_t *chKey, SecMsgPurged &smsgPurged);
@@ -79,6 +142,33 @@ public:
     leveldb::WriteBatch *activeBatch;
 };
 
+/** Walks inbox message keys in order of time received without reading the messages.
+ *
+ * Messages of one address are read from the index, each read status is a
+ * contiguous range and both ranges are merged for all messages. Messages of
+ * all addresses are read from a second index split by read status the same way.
+ */
+class SecMsgInboxCursor
+{
+public:
+    /** List messages sent to pAddrTo, or to all addresses if null, after message pAfterMsgId (timestamp + msgid, 28 bytes)
+     *  received at nAfterTimeReceived if set. */
+    SecMsgInboxCursor(SecMsgDB &db, const CKeyID *pAddrTo, bool fUnreadOnly, const uint8_t *pAfterMsgId = nullptr, int64_t nAfterTimeReceived = 0);
+    ~SecMsgInboxCursor();
+
+    /** Set chKey to the key of the next inbox message, false at the end. */
+    bool Next(uint8_t *chKey);
+
+private:
+    struct Range {
+        leveldb::Iterator *it;
+        std::string prefix;
+    };
+    bool Valid(const Range &r) const;
+
+    std::vector<Range> m_ranges;
+};
+
 } // namespace smsg
 
 #endif // PARTICL_SMSG_DB_H
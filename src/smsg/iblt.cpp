@@ -0,0 +1,188 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <smsg/iblt.h>
+
+#include <xxhash/xxhash.h>
+
+namespace smsg {
+
+uint32_t IBLTKeyCheck(const SecMsgIBLT::Key &key)
+{
+    return XXH32(key.data, SMSG_IBLT_KEY_LEN, 0x11b17);
+};
+
+bool SecMsgIBLT::Cell::IsEmpty() const
+{
+    static const Key null_key;
+    return count == 0 && check_sum == 0 && key_sum == null_key;
+};
+
+bool SecMsgIBLT::Cell::IsPure() const
+{
+    return (count == 1 || count == -1) && check_sum == IBLTKeyCheck(key_sum);
+};
+
+SecMsgIBLT::SecMsgIBLT(size_t num_cells)
+{
+    // Cells are split into a subtable per hash function
+    num_cells = ((num_cells + SMSG_IBLT_NUM_HASHES - 1) / SMSG_IBLT_NUM_HASHES) * SMSG_IBLT_NUM_HASHES;
+    m_cells.resize(num_cells);
+};
+
+size_t SecMsgIBLT::CellsForDifference(size_t num_diff)
+{
+    // Small tables need more overhead than the asymptotic ~1.23x for 3 hash functions to peel reliably
+    size_t num_cells = num_diff * 2 + 16;
+    return ((num_cells + SMSG_IBLT_NUM_HASHES - 1) / SMSG_IBLT_NUM_HASHES) * SMSG_IBLT_NUM_HASHES;
+};
+
+size_t SecMsgIBLT::GetIndex(const Key &key, size_t k) const
+{
+    size_t subtable_size = m_cells.size() / SMSG_IBLT_NUM_HASHES;
+    return k * subtable_size + XXH32(key.data, SMSG_IBLT_KEY_LEN, k + 1) % subtable_size;
+};
+
+bool SecMsgIBLT::IsPureAt(size_t c) const
+{
+    // A corrupt or hostile table can hold a key with a valid checksum in a cell the key doesn't map to
+    const Cell &cell = m_cells[c];
+    return cell.IsPure() && GetIndex(cell.key_sum, c / (m_cells.size() / SMSG_IBLT_NUM_HASHES)) == c;
+};
+
+void SecMsgIBLT::Update(const Key &key, int32_t n)
+{
+    if (m_cells.empty()) {
+        return;
+    }
+    uint32_t check = IBLTKeyCheck(key);
+    for (size_t k = 0; k < SMSG_IBLT_NUM_HASHES; ++k) {
+        Cell &cell = m_cells[GetIndex(key, k)];
+        cell.count += n;
+        for (size_t i = 0; i < SMSG_IBLT_KEY_LEN; ++i) {
+            cell.key_sum.data[i] ^= key.data[i];
+        }
+        cell.check_sum ^= check;
+    }
+};
+
+void SecMsgIBLT::Insert(const Key &key)
+{
+    Update(key, 1);
+};
+
+void SecMsgIBLT::Erase(const Key &key)
+{
+    Update(key, -1);
+};
+
+bool SecMsgIBLT::Subtract(const SecMsgIBLT &other)
+{
+    if (other.m_cells.size() != m_cells.size()) {
+        return false;
+    }
+    for (size_t c = 0; c < m_cells.size(); ++c) {
+        Cell &cell = m_cells[c];
+        const Cell &cell_other = other.m_cells[c];
+        cell.count -= cell_other.count;
+        for (size_t i = 0; i < SMSG_IBLT_KEY_LEN; ++i) {
+            cell.key_sum.data[i] ^= cell_other.key_sum.data[i];
+        }
+        cell.check_sum ^= cell_other.check_sum;
+    }
+    return true;
+};
+
+bool SecMsgIBLT::Decode(std::vector<Key> &vHave, std::vector<Key> &vMissing) const
+{
+    SecMsgIBLT peel(*this);
+
+    std::vector<size_t> vPure;
+    for (size_t c = 0; c < peel.m_cells.size(); ++c) {
+        if (peel.IsPureAt(c)) {
+            vPure.push_back(c);
+        }
+    }
+
+    while (!vPure.empty()) {
+        size_t c = vPure.back();
+        vPure.pop_back();
+
+        const Cell &cell = peel.m_cells[c];
+        if (!peel.IsPureAt(c)) {
+            continue; // Cell changed since it was queued
+        }
+        // Each cell holds at most one recovered key, more means the table is corrupt and may never finish peeling
+        if (vHave.size() + vMissing.size() >= peel.m_cells.size()) {
+            return false;
+        }
+
+        Key key = cell.key_sum;
+        int32_t count = cell.count;
+        if (count > 0) {
+            vHave.push_back(key);
+        } else {
+            vMissing.push_back(key);
+        }
+        peel.Update(key, -count);
+
+        for (size_t k = 0; k < SMSG_IBLT_NUM_HASHES; ++k) {
+            size_t i = peel.GetIndex(key, k);
+            if (peel.IsPureAt(i)) {
+                vPure.push_back(i);
+            }
+        }
+    }
+
+    for (const auto &cell : peel.m_cells) {
+        if (!cell.IsEmpty()) {
+            return false;
+        }
+    }
+    return true;
+};
+
+void SecMsgIBLT::Serialize(std::vector<uint8_t> &vchOut) const
+{
+    size_t ofs = vchOut.size();
+    vchOut.resize(ofs + SerializeSize());
+
+    uint8_t *p = &vchOut[ofs];
+    uint32_t num_cells = m_cells.size();
+    memcpy(p, &num_cells, 4);
+    p += 4;
+    for (const auto &cell : m_cells) {
+        memcpy(p, &cell.count, 4);
+        memcpy(p+4, cell.key_sum.data, SMSG_IBLT_KEY_LEN);
+        memcpy(p+4+SMSG_IBLT_KEY_LEN, &cell.check_sum, 4);
+        p += SMSG_IBLT_CELL_LEN;
+    }
+};
+
+bool SecMsgIBLT::Unserialize(const uint8_t *p, size_t nBytes, size_t max_cells)
+{
+    if (nBytes < 4) {
+        return false;
+    }
+    uint32_t num_cells;
+    memcpy(&num_cells, p, 4);
+    if (num_cells < SMSG_IBLT_NUM_HASHES
+        || num_cells % SMSG_IBLT_NUM_HASHES != 0
+        || num_cells > max_cells
+        || nBytes != 4 + num_cells * SMSG_IBLT_CELL_LEN) {
+        return false;
+    }
+    p += 4;
+
+    m_cells.resize(num_cells);
+    for (auto &cell : m_cells) {
+        memcpy(&cell.count, p, 4);
+        memcpy(cell.key_sum.data, p+4, SMSG_IBLT_KEY_LEN);
+        memcpy(&cell.check_sum, p+4+SMSG_IBLT_KEY_LEN, 4);
+        p += SMSG_IBLT_CELL_LEN;
+    }
+    return true;
+};
+
+} // namespace smsg
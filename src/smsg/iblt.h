@@ -0,0 +1,97 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_SMSG_IBLT_H
+#define PARTICL_SMSG_IBLT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace smsg {
+
+const size_t SMSG_IBLT_KEY_LEN = 16;        // SecMsgToken timestamp 8 + sample 8
+const size_t SMSG_IBLT_CELL_LEN = 4 + SMSG_IBLT_KEY_LEN + 4;
+const size_t SMSG_IBLT_NUM_HASHES = 3;
+
+/** Invertible bloom lookup table over fixed size bucket token keys.
+ *
+ * Two peers each insert their token set into a table of the same size, one
+ * table is subtracted from the other and the symmetric difference of the sets
+ * is recovered by peeling, as long as the table has roughly 2 cells per
+ * differing token.
+ */
+class SecMsgIBLT
+{
+public:
+    class Key
+    {
+    public:
+        Key() { memset(data, 0, SMSG_IBLT_KEY_LEN); };
+        Key(int64_t timestamp, const uint8_t *sample)
+        {
+            memcpy(data, &timestamp, 8);
+            memcpy(data+8, sample, 8);
+        };
+
+        int64_t GetTimestamp() const
+        {
+            int64_t timestamp;
+            memcpy(&timestamp, data, 8);
+            return timestamp;
+        };
+        const uint8_t *GetSample() const { return data+8; };
+
+        bool operator <(const Key &y) const { return memcmp(data, y.data, SMSG_IBLT_KEY_LEN) < 0; };
+        bool operator ==(const Key &y) const { return memcmp(data, y.data, SMSG_IBLT_KEY_LEN) == 0; };
+
+        uint8_t data[SMSG_IBLT_KEY_LEN];
+    };
+
+    explicit SecMsgIBLT(size_t num_cells = 0);
+
+    /** Number of cells needed to recover an expected difference of num_diff tokens. */
+    static size_t CellsForDifference(size_t num_diff);
+
+    size_t Size() const { return m_cells.size(); };
+    size_t SerializeSize() const { return 4 + m_cells.size() * SMSG_IBLT_CELL_LEN; };
+
+    void Insert(const Key &key);
+    void Erase(const Key &key);
+
+    /** Subtract other from this table, fails if the tables differ in size. */
+    bool Subtract(const SecMsgIBLT &other);
+
+    /** Peel a subtracted table, keys only in this table are placed in vHave, keys only in the subtracted table in vMissing.
+     *  Returns false if the table could not be fully decoded, vHave and vMissing must then be ignored. */
+    bool Decode(std::vector<Key> &vHave, std::vector<Key> &vMissing) const;
+
+    void Serialize(std::vector<uint8_t> &vchOut) const;
+    bool Unserialize(const uint8_t *p, size_t nBytes, size_t max_cells);
+
+private:
+    class Cell
+    {
+    public:
+        int32_t count = 0;
+        Key key_sum;
+        uint32_t check_sum = 0;
+
+        bool IsEmpty() const;
+        bool IsPure() const;
+    };
+
+    /** Cell c holds a single key with a valid checksum and c is one of the key's cells. */
+    bool IsPureAt(size_t c) const;
+    void Update(const Key &key, int32_t n);
+    size_t GetIndex(const Key &key, size_t k) const;
+
+    std::vector<Cell> m_cells;
+};
+
+uint32_t IBLTKeyCheck(const SecMsgIBLT::Key &key);
+
+} // namespace smsg
+
+#endif // PARTICL_SMSG_IBLT_H
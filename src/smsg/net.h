@@ -19,6 +19,7 @@ extern const char *HAVE;
 extern const char *WANT;
 extern const char *MSG;
 extern const char *IGNORING;
+extern const char *RECON;
 };
 
 class PeerBucket
@@ -40,6 +41,9 @@ public:
     uint16_t m_num_want_sent = 0;
     uint16_t m_receive_counter = 0;
     uint16_t m_ignored_counter = 0;
+    uint32_t m_num_recon_sent = 0;
+    uint32_t m_num_recon_decoded = 0;
+    uint32_t m_num_recon_failed = 0;
     bool fEnabled = false;
     int m_version = 0;
     std::map<int64_t, PeerBucket> m_buckets;
@@ -758,6 +758,7 @@ static UniValue smsgsend(const JSONRPCRequest &request)
                             {"ttl_is_seconds", RPCArg::Type::BOOL, /* default */ "false", "If true days_retention parameter is interpreted as seconds to live."},
                             {"fund_from_rct", RPCArg::Type::BOOL, /* default */ "false", "Fund message from anon balance."},
                             {"rct_ring_size", RPCArg::Type::NUM, /* default */ strprintf("%d", DEFAULT_RING_SIZE), "Ring size to use with fund_from_rct."},
+                            {"fund_batch", RPCArg::Type::BOOL, /* default */ "-smsgfundbatch", "Queue paid message to be funded in a batch with other queued messages."},
                         },
                         "options"},
                     {"coin_control", RPCArg::Type::OBJ, /* default */ "", "",
@@ -788,9 +789,9 @@ static UniValue smsgsend(const JSONRPCRequest &request)
                 },
                 RPCResult{
             "{\n"
-            "  \"result\": \"Sent\"/\"Not Sent\"       (string) address of public key\n"
+            "  \"result\": \"Sent\"/\"Not Sent\"/\"Queued for funding\" (string) address of public key\n"
             "  \"msgid\": \"...\"                    (string) if sent, a message identifier\n"
-            "  \"txid\": \"...\"                     (string) if paid_msg the txnid of the funding txn\n"
+            "  \"txid\": \"...\"                     (string) if paid_msg the txnid of the funding txn, unset if queued for funding\n"
             "  \"fee\": n                          (amount) if paid_msg the fee paid\n"
             "}\n"
                 },
@@ -822,6 +823,7 @@ static UniValue smsgsend(const JSONRPCRequest &request)
     bool ttl_in_seconds = false;
     bool fund_from_rct = false;
     size_t rct_ring_size = DEFAULT_RING_SIZE;
+    bool fund_batch = smsgModule.m_fund_batch;
 
     UniValue options = request.params[6];
     if (options.isObject()) {
@@ -834,6 +836,7 @@ static UniValue smsgsend(const JSONRPCRequest &request)
             {"ttl_is_seconds",    UniValueType(UniValue::VBOOL)},
             {"fund_from_rct",     UniValueType(UniValue::VBOOL)},
             {"rct_ring_size",     UniValueType(UniValue::VNUM)},
+            {"fund_batch",        UniValueType(UniValue::VBOOL)},
         }, true, false);
         if (!options["fromfile"].isNull()) {
             fFromFile = options["fromfile"].get_bool();
@@ -856,6 +859,9 @@ static UniValue smsgsend(const JSONRPCRequest &request)
         if (!options["rct_ring_size"].isNull()) {
             rct_ring_size = options["rct_ring_size"].get_int();
         }
+        if (!options["fund_batch"].isNull()) {
+            fund_batch = options["fund_batch"].get_bool();
+        }
     }
 
     if (fFromFile && fDecodeHex) {
@@ -907,11 +913,14 @@ static UniValue smsgsend(const JSONRPCRequest &request)
         }
         UniValue uv_cctl = request.params[7];
         if (uv_cctl.isObject()) {
+            if (fund_batch && !fTestFee) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Can't use coin_control with fund_batch.");
+            }
             ReadCoinControlOptions(uv_cctl, pw, cctl);
         }
     }
     if (smsgModule.Send(kiFrom, kiTo, msg, smsgOut, sError, fPaid, nRetention, fTestFee, &nFee, &nTxBytes,
-                        fFromFile, submit_msg, save_msg, fund_from_rct, rct_ring_size, &cctl) != 0) {
+                        fFromFile, submit_msg, save_msg, fund_from_rct, rct_ring_size, &cctl, fund_batch) != 0) {
 #else
     if (smsgModule.Send(kiFrom, kiTo, msg, smsgOut, sError, fPaid, nRetention, fTestFee, &nFee, &nTxBytes,
                         fFromFile, submit_msg, save_msg) != 0) {
@@ -919,7 +928,8 @@ static UniValue smsgsend(const JSONRPCRequest &request)
         result.pushKV("result", "Send failed.");
         result.pushKV("error", sError);
     } else {
-        result.pushKV("result", (!submit_msg || fTestFee) ? "Not Sent." : "Sent.");
+        bool queued_for_funding = fPaid && fund_batch && !fTestFee;
+        result.pushKV("result", (!submit_msg || fTestFee) ? "Not Sent." : queued_for_funding ? "Queued for funding." : "Sent.");
 
         if (!fTestFee) {
             result.pushKV("msgid", HexStr(smsgModule.GetMsgID(smsgOut)));
@@ -930,6 +940,9 @@ static UniValue smsgsend(const JSONRPCRequest &request)
                                  HexStr(smsgOut.pPayload, smsgOut.pPayload + smsgOut.nPayload));
         }
 
+        if (queued_for_funding) {
+            result.pushKV("funding", "queued");
+        } else
         if (fPaid) {
             if (!fTestFee) {
                 uint256 txid;
@@ -988,12 +1001,16 @@ static UniValue smsginbox(const JSONRPCRequest &request)
                 "\nDecrypt and display received messages.\n"
                 "Warning: clear will delete all messages.\n",
                 {
-                    {"mode", RPCArg::Type::STR, /* default */ "unread", "\"all|unread|clear\" List all messages, unread messages or clear all messages."},
+                    {"mode", RPCArg::Type::STR, /* default */ "unread", "\"all|unread|count|clear\" List all messages, unread messages, count messages or clear all messages."},
                     {"filter", RPCArg::Type::STR, /* default */ "", "Filter messages when in list mode. Applied to from, to and text fields."},
                     {"options", RPCArg::Type::OBJ, /* default */ "", "",
                         {
                             {"updatestatus", RPCArg::Type::BOOL, /* default */ "true", "Update read status if true."},
                             {"encoding", RPCArg::Type::STR, /* default */ "text", "Display message data in encoding, values: \"text\", \"hex\", \"none\"."},
+                            {"address", RPCArg::Type::STR, /* default */ "", "Only list or count messages sent to address."},
+                            {"offset", RPCArg::Type::NUM, /* default */ "0", "Skip the first offset messages matching filter."},
+                            {"limit", RPCArg::Type::NUM, /* default */ "0", "List at most limit messages, 0 for no limit."},
+                            {"after", RPCArg::Type::STR, /* default */ "", "List messages received after the message with this msgid, pages without stepping over offset messages."},
                         },
                         "options"},
                 },
@@ -1022,14 +1039,51 @@ static UniValue smsginbox(const JSONRPCRequest &request)
 
     std::string sEnc = "text";
     bool update_status = true;
+    bool fAddrTo = false;
+    CKeyID addrTo;
+    int offset = 0, limit = 0;
+    std::vector<uint8_t> vchAfter;
     if (request.params[2].isObject()) {
         UniValue options = request.params[2].get_obj();
+        RPCTypeCheckObj(options,
+            {
+                {"updatestatus", UniValueType(UniValue::VBOOL)},
+                {"encoding", UniValueType(UniValue::VSTR)},
+                {"address", UniValueType(UniValue::VSTR)},
+                {"offset", UniValueType(UniValue::VNUM)},
+                {"limit", UniValueType(UniValue::VNUM)},
+                {"after", UniValueType(UniValue::VSTR)},
+            }, true, false);
         if (options["updatestatus"].isBool()) {
             update_status = options["updatestatus"].get_bool();
         }
         if (options["encoding"].isStr()) {
             sEnc = options["encoding"].get_str();
         }
+        if (options["address"].isStr()) {
+            CTxDestination dest = DecodeDestination(options["address"].get_str());
+            if (dest.type() != typeid(PKHash)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address.");
+            }
+            addrTo = CKeyID(boost::get<PKHash>(dest));
+            fAddrTo = true;
+        }
+        if (options["offset"].isNum()) {
+            offset = options["offset"].get_int();
+        }
+        if (options["limit"].isNum()) {
+            limit = options["limit"].get_int();
+        }
+        if (offset < 0 || limit < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "offset and limit must be positive.");
+        }
+        if (options["after"].isStr()) {
+            std::string sAfter = options["after"].get_str();
+            if (!IsHex(sAfter) || sAfter.size() != 56) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "after must be a 28 byte hex msgid.");
+            }
+            vchAfter = ParseHex(sAfter);
+        }
     }
 
     UniValue result(UniValue::VOBJ);
@@ -1048,9 +1102,10 @@ static UniValue smsginbox(const JSONRPCRequest &request)
         if (mode == "clear") {
             dbInbox.TxnBegin();
 
+            smsg::SecMsgStored smsgStored;
             leveldb::Iterator *it = dbInbox.pdb->NewIterator(leveldb::ReadOptions());
-            while (dbInbox.NextSmesgKey(it, smsg::DBK_INBOX, chKey)) {
-                dbInbox.EraseSmesg(chKey);
+            while (dbInbox.NextSmesg(it, smsg::DBK_INBOX, chKey, smsgStored)) {
+                dbInbox.EraseSmesg(chKey, smsgStored);
                 nMessages++;
             }
             delete it;
@@ -1058,21 +1113,67 @@ static UniValue smsginbox(const JSONRPCRequest &request)
 
             result.pushKV("result", strprintf("Deleted %u messages.", nMessages));
         } else
+        if (mode == "count") {
+            std::map<CKeyID, smsg::SecMsgIndexCount> mCounts;
+            if (!dbInbox.CountInboxIndex(fAddrTo ? &addrTo : nullptr, mCounts)) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "CountInboxIndex failed.");
+            }
+
+            size_t nTotal = 0, nUnread = 0;
+            UniValue addressList(UniValue::VARR);
+            for (const auto &mi : mCounts) {
+                UniValue objA(UniValue::VOBJ);
+                objA.pushKV("address", EncodeDestination(PKHash(mi.first)));
+                objA.pushKV("total", (int)mi.second.nTotal);
+                objA.pushKV("unread", (int)mi.second.nUnread);
+                addressList.push_back(objA);
+                nTotal += mi.second.nTotal;
+                nUnread += mi.second.nUnread;
+            }
+
+            result.pushKV("total", (int)nTotal);
+            result.pushKV("unread", (int)nUnread);
+            result.pushKV("addresses", addressList);
+        } else
         if (mode == "all"
             || mode == "unread") {
             int fCheckReadStatus = mode == "unread" ? 1 : 0;
 
             smsg::SecMsgStored smsgStored;
+            int64_t nAfterTimeReceived = 0;
+            if (!vchAfter.empty()) {
+                memcpy(chKey, smsg::DBK_INBOX.data(), 2);
+                memcpy(chKey+2, vchAfter.data(), 28);
+                if (!dbInbox.ReadSmesg(chKey, smsgStored)) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "after message not found.");
+                }
+                nAfterTimeReceived = smsgStored.timeReceived;
+            }
+
+            // Walk message keys in order of time received from the index, only messages listed are read and decrypted
+            smsg::SecMsgInboxCursor cursor(dbInbox, fAddrTo ? &addrTo : nullptr, fCheckReadStatus, vchAfter.empty() ? nullptr : vchAfter.data(), nAfterTimeReceived);
+
             smsg::MessageData msg;
 
-            dbInbox.TxnBegin();
+            // Read status updates are batched separately, reads from dbInbox don't need to scan the batch
+            smsg::SecMsgDB dbUpdate;
+            if (!dbUpdate.Open("cr+")) {
+                throw std::runtime_error("Could not open DB.");
+            }
+            dbUpdate.TxnBegin();
 
-            leveldb::Iterator *it = dbInbox.pdb->NewIterator(leveldb::ReadOptions());
             UniValue messageList(UniValue::VARR);
 
-            while (dbInbox.NextSmesg(it, smsg::DBK_INBOX, chKey, smsgStored)) {
-                if (fCheckReadStatus
-                    && !(smsgStored.status & SMSG_MASK_UNREAD)) {
+            int nSkipped = 0;
+            while (cursor.Next(chKey)) {
+                if (limit > 0 && (int)nMessages >= limit) {
+                    break;
+                }
+                if (filter.size() == 0 && nSkipped < offset) {
+                    nSkipped++;
+                    continue;
+                }
+                if (!dbInbox.ReadSmesg(chKey, smsgStored)) {
                     continue;
                 }
                 uint8_t *pHeader = &smsgStored.vchMessage[0];
@@ -1093,6 +1194,10 @@ static UniValue smsginbox(const JSONRPCRequest &request)
                             part::stringsMatchI(sText, filter, 3))) {
                         continue;
                     }
+                    if (filter.size() > 0 && nSkipped < offset) {
+                        nSkipped++;
+                        continue;
+                    }
 
                     PushTime(objM, "received", smsgStored.timeReceived);
                     PushTime(objM, "sent", msg.timestamp);
@@ -1107,6 +1212,16 @@ static UniValue smsginbox(const JSONRPCRequest &request)
                     uint32_t nPayload = smsgStored.vchMessage.size() - smsg::SMSG_HDR_LEN;
                     objM.pushKV("payloadsize", (int)nPayload);
 
+                    uint256 txid;
+                    if (psmsg->IsPaidVersion()
+                        && smsg::GetFundingTxid(pHeader + smsg::SMSG_HDR_LEN, nPayload, txid)) {
+                        if (txid.IsNull()) {
+                            objM.pushKV("funding", "queued");
+                        } else {
+                            objM.pushKV("txid", txid.ToString());
+                        }
+                    }
+
                     objM.pushKV("from", msg.sFromAddress);
                     objM.pushKV("to", sAddrTo);
                     if (sEnc == "none") {
@@ -1133,18 +1248,17 @@ static UniValue smsginbox(const JSONRPCRequest &request)
                 // Only set 'read' status if the message decrypted successfully and update_status is set
                 if (fCheckReadStatus && rv == 0 && update_status) {
                     smsgStored.status &= ~SMSG_MASK_UNREAD;
-                    dbInbox.WriteSmesg(chKey, smsgStored);
+                    dbUpdate.WriteSmesg(chKey, smsgStored);
                 }
                 nMessages++;
             }
-            delete it;
-            dbInbox.TxnCommit();
+            dbUpdate.TxnCommit();
 
             result.pushKV("messages", messageList);
             result.pushKV("result", strprintf("%u", nMessages));
         } else {
             result.pushKV("result", "Unknown Mode.");
-            result.pushKV("expected", "all|unread|clear.");
+            result.pushKV("expected", "all|unread|count|clear.");
         }
     } // cs_smsgDB
 
@@ -1163,6 +1277,7 @@ static UniValue smsgoutbox(const JSONRPCRequest &request)
                         {
                             {"encoding", RPCArg::Type::STR, /* default */ "text", "Display message data in encoding, values: \"text\", \"hex\", \"none\"."},
                             {"sending", RPCArg::Type::BOOL, /* default */ "false", "Display messages in sending queue."},
+                            {"funding", RPCArg::Type::BOOL, /* default */ "false", "Display paid messages waiting to be funded in a batch."},
                         },
                         "options"},
                 },
@@ -1174,6 +1289,9 @@ static UniValue smsgoutbox(const JSONRPCRequest &request)
             "  \"from\": \"str\"                     (string) Address the message was sent from\n"
             "  \"to\": \"str\"                       (string) Address the message was sent to\n"
             "  \"text\": \"str\"                     (string) Message text\n"
+            "  \"txid\": \"str\"                     (string) If paid, the txnid of the funding txn\n"
+            "  \"funding\": \"str\"                  (string) If paid and the funding txn is not yet created: \"queued\", or \"failed\" if the message was dropped from the funding queue\n"
+            "  \"funding_attempts\": n             (numeric) With funding, the number of failed attempts to fund the message\n"
             "}\n"
                 },
                 RPCExamples{""},
@@ -1187,6 +1305,7 @@ static UniValue smsgoutbox(const JSONRPCRequest &request)
     std::string filter = request.params[1].isStr() ? request.params[1].get_str() : "";
 
     bool show_sending = false;
+    bool show_funding = false;
     std::string sEnc = "text";
     if (request.params[2].isObject()) {
         UniValue options = request.params[2].get_obj();
@@ -1196,6 +1315,12 @@ static UniValue smsgoutbox(const JSONRPCRequest &request)
         if (options["sending"].isBool()) {
             show_sending = options["sending"].get_bool();
         }
+        if (options["funding"].isBool()) {
+            show_funding = options["funding"].get_bool();
+        }
+    }
+    if (show_sending && show_funding) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Can't use sending with funding.");
     }
 
     UniValue result(UniValue::VOBJ);
@@ -1213,7 +1338,7 @@ static UniValue smsgoutbox(const JSONRPCRequest &request)
 
         uint32_t nMessages = 0;
 
-        std::string db_prefix = show_sending ? smsg::DBK_QUEUED : smsg::DBK_OUTBOX;
+        std::string db_prefix = show_sending ? smsg::DBK_QUEUED : show_funding ? smsg::DBK_FUNDING : smsg::DBK_OUTBOX;
         if (mode == "clear") {
             dbOutbox.TxnBegin();
 
@@ -1241,6 +1366,9 @@ static UniValue smsgoutbox(const JSONRPCRequest &request)
                 UniValue objM(UniValue::VOBJ);
                 objM.pushKV("msgid", HexStr(&chKey[2], &chKey[2] + 28)); // timestamp+hash
                 objM.pushKV("version", strprintf("%02x%02x", psmsg->version[0], psmsg->version[1]));
+                if (show_funding) {
+                    objM.pushKV("funding_attempts", smsgStored.status >> SMSG_FUND_ATTEMPTS_SHIFT);
+                }
 
                 uint32_t nPayload = smsgStored.vchMessage.size() - smsg::SMSG_HDR_LEN;
                 int rv = smsgModule.Decrypt(false, smsgStored.addrOutbox, pHeader, pHeader + smsg::SMSG_HDR_LEN, nPayload, msg);
@@ -1266,6 +1394,16 @@ static UniValue smsgoutbox(const JSONRPCRequest &request)
                     uint32_t nPayload = smsgStored.vchMessage.size() - smsg::SMSG_HDR_LEN;
                     objM.pushKV("payloadsize", (int)nPayload);
 
+                    uint256 txid;
+                    if (psmsg->IsPaidVersion()
+                        && smsg::GetFundingTxid(pHeader + smsg::SMSG_HDR_LEN, nPayload, txid)) {
+                        if (txid.IsNull()) {
+                            objM.pushKV("funding", (smsgStored.status & SMSG_MASK_FUND_FAILED) ? "failed" : "queued");
+                        } else {
+                            objM.pushKV("txid", txid.ToString());
+                        }
+                    }
+
                     objM.pushKV("from", msg.sFromAddress);
                     objM.pushKV("to", sAddrTo);
                     if (sEnc == "none") {
@@ -2071,6 +2209,7 @@ static UniValue smsggetinfo(const JSONRPCRequest &request)
             "{\n"
             "  \"enabled\": true|false,         (boolean) if SMSG is enabled or not\n"
             "  \"wallet\": \"...\"              (string) name of the currently active wallet or \"None set\"\n"
+            "  \"funding\": {...}                 (object) batched paid message funding state\n"
             "}\n"
                 },
                 RPCExamples{
@@ -2085,6 +2224,32 @@ static UniValue smsggetinfo(const JSONRPCRequest &request)
     obj.pushKV("enabled", smsg::fSecMsgEnabled);
     if (smsg::fSecMsgEnabled) {
         obj.pushKV("active_wallet", smsgModule.GetWalletName());
+
+        size_t num_funding = 0;
+        {
+            LOCK(smsg::cs_smsgDB);
+            smsg::SecMsgDB db;
+            if (db.Open("cr+")) {
+                uint8_t chKey[30];
+                leveldb::Iterator *it = db.pdb->NewIterator(leveldb::ReadOptions());
+                while (db.NextSmesgKey(it, smsg::DBK_FUNDING, chKey)) {
+                    num_funding++;
+                }
+                delete it;
+            }
+        }
+        UniValue funding(UniValue::VOBJ);
+        funding.pushKV("batch_default", smsgModule.m_fund_batch);
+        funding.pushKV("batch_size", (int)smsgModule.m_fund_batch_size);
+        funding.pushKV("batch_delay", smsgModule.m_fund_batch_delay);
+        funding.pushKV("queued", (int)num_funding);
+        {
+            LOCK(smsgModule.cs_smsg);
+            if (!smsgModule.m_fund_batch_last_error.empty()) {
+                funding.pushKV("last_error", smsgModule.m_fund_batch_last_error);
+            }
+        }
+        obj.pushKV("funding", funding);
 #ifdef ENABLE_WALLET
         UniValue wallet_names(UniValue::VARR);
         for (const auto &pw : smsgModule.m_vpwallets) {
@@ -36,6 +36,7 @@ Notes:
 #include <validationinterface.h>
 #include <smsg/crypter.h>
 #include <smsg/db.h>
+#include <smsg/iblt.h>
 #include <sync.h>
 #include <random.h>
 #include <chain.h>
@@ -79,9 +80,10 @@ const char *HAVE="smsgHave";
 const char *WANT="smsgWant";
 const char *MSG="smsgMsg";
 const char *IGNORING="smsgIgnore";
+const char *RECON="smsgRecon";
 
 const static std::string allTypes[] = {
-    PING, PONG, DISABLED, INV, SHOW, HAVE, WANT, MSG, IGNORING
+    PING, PONG, DISABLED, INV, SHOW, HAVE, WANT, MSG, IGNORING, RECON
 };
 } // namespace SMSGMsgType
 
@@ -314,6 +316,8 @@ void ThreadSecureMsgPow()
     while (fSecMsgEnabled) {
         // Sleep at end, then fSecMsgEnabled is tested on wake
 
+        smsgModule.ProcessFundingQueue();
+
         SecMsgDB dbOutbox;
         leveldb::Iterator *it;
         {
@@ -440,6 +444,9 @@ void AddOptions()
     gArgs.AddArg("-smsgsaddnewkeys", "Scan for incoming messages on new wallet keys. (default: false)", ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     gArgs.AddArg("-smsgbantime=<n>", strprintf("Number of seconds to ignore misbehaving peers for (default: %u)", SMSG_DEFAULT_BANTIME), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     gArgs.AddArg("-smsgmaxreceive=<n>", strprintf("Max number of data messages to tolerate from peers, counter decreases over time (default: %u)", SMSG_DEFAULT_MAXRCV), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    gArgs.AddArg("-smsgfundbatch", strprintf("Queue paid messages and fund them in batches by default. (default: %u)", DEFAULT_SMSG_FUND_BATCH), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    gArgs.AddArg("-smsgfundbatchsize=<n>", strprintf("Max number of queued paid messages to fund with one transaction (default: %u)", SMSG_DEFAULT_FUND_BATCH_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
+    gArgs.AddArg("-smsgfundbatchdelay=<n>", strprintf("Max number of seconds a paid message waits in the funding queue (default: %u)", SMSG_DEFAULT_FUND_BATCH_DELAY), ArgsManager::ALLOW_ANY, OptionsCategory::SMSG);
     gArgs.AddArg("-smsgsregtestadjust", "Adjust durations in regtest (default: true)", ArgsManager::ALLOW_ANY, OptionsCategory::HIDDEN);
     return;
 };
@@ -661,6 +668,48 @@ int CSMSG::BuildPurgedSets()
     return SMSG_NO_ERROR;
 };
 
+int CSMSG::BuildInboxIndex()
+{
+    LogPrint(BCLog::SMSG, "%s\n", __func__);
+    LOCK(cs_smsgDB);
+
+    SecMsgDB db;
+    if (!db.Open("cr+")) {
+        return SMSG_GENERAL_ERROR;
+    }
+
+    int nVersion;
+    if (db.ReadInboxIndexVersion(nVersion) && nVersion == SMSG_INBOX_INDEX_VERSION) {
+        return SMSG_NO_ERROR;
+    }
+
+    LogPrintf("Building smsg inbox index.\n");
+    if (!db.ClearInboxIndex()) {
+        return SMSG_GENERAL_ERROR;
+    }
+
+    size_t nIndexed = 0;
+    uint8_t chKey[30];
+    SecMsgStored smsgStored;
+    db.TxnBegin();
+    leveldb::Iterator *it = db.pdb->NewIterator(leveldb::ReadOptions());
+    while (db.NextSmesg(it, DBK_INBOX, chKey, smsgStored)) {
+        db.WriteInboxIndex(chKey, smsgStored);
+        if (++nIndexed % 1000 == 0) {
+            db.TxnCommit();
+            db.TxnBegin();
+        }
+    }
+    delete it;
+    db.WriteInboxIndexVersion(SMSG_INBOX_INDEX_VERSION);
+    if (!db.TxnCommit()) {
+        return SMSG_GENERAL_ERROR;
+    }
+
+    LogPrintf("Indexed %u inbox messages.\n", nIndexed);
+    return SMSG_NO_ERROR;
+};
+
 int CSMSG::AddWalletAddresses()
 {
     LogPrint(BCLog::SMSG, "%s\n", __func__);
@@ -892,6 +941,9 @@ bool CSMSG::Start(std::shared_ptr<CWallet> pwalletIn, std::vector<std::shared_pt
     }
 
     m_smsg_max_receive_count = gArgs.GetArg("-smsgmaxreceive", SMSG_DEFAULT_MAXRCV);
+    m_fund_batch = gArgs.GetBoolArg("-smsgfundbatch", DEFAULT_SMSG_FUND_BATCH);
+    m_fund_batch_size = std::max((int64_t)1, gArgs.GetArg("-smsgfundbatchsize", SMSG_DEFAULT_FUND_BATCH_SIZE));
+    m_fund_batch_delay = std::max((int64_t)0, gArgs.GetArg("-smsgfundbatchdelay", SMSG_DEFAULT_FUND_BATCH_DELAY));
 
 #ifdef ENABLE_WALLET
     UnloadAllWallets();
@@ -958,6 +1010,11 @@ bool CSMSG::Start(std::shared_ptr<CWallet> pwalletIn, std::vector<std::shared_pt
         return error("%s: Could not load purged sets, secure messaging disabled.", __func__);
     }
 
+    if (BuildInboxIndex() != 0) {
+        Disable();
+        return error("%s: Could not build inbox index, secure messaging disabled.", __func__);
+    }
+
     start_time = GetAdjustedTime();
 
     threadGroupSmsg.create_thread(boost::bind(&TraceThread<void (*)()>, "smsg", &ThreadSecureMsg));
@@ -1195,6 +1252,9 @@ void CSMSG::GetNodesStats(int node_id, UniValue &result)
         obj.pushKV("ignoreuntil", pnode->smsgData.ignoreUntil);
         obj.pushKV("misbehaving", (int) pnode->smsgData.misbehaving);
         obj.pushKV("numwantsent", (int) pnode->smsgData.m_num_want_sent);
+        obj.pushKV("numreconsent", (int) pnode->smsgData.m_num_recon_sent);
+        obj.pushKV("numrecondecoded", (int) pnode->smsgData.m_num_recon_decoded);
+        obj.pushKV("numreconfailed", (int) pnode->smsgData.m_num_recon_failed);
         obj.pushKV("receivecounter", (int) pnode->smsgData.m_receive_counter);
         obj.pushKV("ignoredcounter", (int) pnode->smsgData.m_ignored_counter);
         obj.pushKV("num_pending_inv", (int) pnode->smsgData.m_buckets.size());
@@ -1435,72 +1495,11 @@ int CSMSG::ReceiveData(CNode *pfrom, const std::string &strCommand, CDataStream
 
         LogPrint(BCLog::SMSG, "Peer %d requests contents of %u buckets.\n", pfrom->GetId(), nBuckets);
 
-        std::map<int64_t, SecMsgBucket>::iterator itb;
-        std::set<SecMsgToken>::iterator it;
-
-        std::vector<uint8_t> vchDataOut;
         int64_t time;
         uint8_t *pIn = &vchData[4];
         for (uint32_t i = 0; i < nBuckets; ++i, pIn += 8) {
             memcpy(&time, pIn, 8);
-
-            int64_t last_shown = 0;
-            {
-                LOCK(pfrom->smsgData.cs_smsg_net);
-                auto it = pfrom->smsgData.m_buckets_last_shown.find(time);
-                if (it != pfrom->smsgData.m_buckets_last_shown.end()) {
-                    last_shown = it->second;
-                }
-            }
-
-            {
-                LOCK(cs_smsg);
-                itb = buckets.find(time);
-                if (itb == buckets.end()) {
-                    LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", time);
-                    continue;
-                }
-
-                std::set<SecMsgToken> &tokenSet = itb->second.setTokens;
-
-                try { vchDataOut.resize(8 + 16 * tokenSet.size());
-                } catch (std::exception &e) {
-                    LogPrintf("vchDataOut.resize %u threw: %s.\n", 8 + 16 * tokenSet.size(), e.what());
-                    continue;
-                }
-                memcpy(&vchDataOut[0], &time, 8);
-
-                int64_t now = GetAdjustedTime();
-                size_t nMessages = 0;
-                uint8_t *p = &vchDataOut[8];
-                for (it = tokenSet.begin(); it != tokenSet.end(); ++it) {
-                    if (it->timestamp + it->ttl < now) {
-                        continue;
-                    }
-                    if (time + it->m_changed < last_shown) {
-                        continue;
-                    }
-                    memcpy(p, &it->timestamp, 8);
-                    memcpy(p+8, &it->sample, 8);
-
-                    p += 16;
-                    nMessages++;
-                }
-                if (nMessages != tokenSet.size()) {
-                    try { vchDataOut.resize(8 + 16 * nMessages);
-                    } catch (std::exception &e) {
-                        LogPrintf("vchDataOut.resize %u threw: %s.\n", 8 + 16 * nMessages, e.what());
-                        continue;
-                    }
-                }
-            }
-            {
-                LOCK(pfrom->smsgData.cs_smsg_net);
-                pfrom->smsgData.m_buckets_last_shown[time] = now;
-            }
-
-            g_connman->PushMessage(pfrom,
-                CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::HAVE, vchDataOut));
+            ShowBucket(pfrom, time);
         }
     } else
     if (strCommand == SMSGMsgType::HAVE) {
@@ -1508,93 +1507,13 @@ int CSMSG::ReceiveData(CNode *pfrom, const std::string &strCommand, CDataStream
         std::vector<uint8_t> vchData;
         vRecv >> vchData;
 
-        if (vchData.size() < 8) {
-            return SMSG_GENERAL_ERROR;
-        }
-
-        int n = (vchData.size() - 8) / 16;
-
-        int64_t time;
-        memcpy(&time, &vchData[0], 8);
-
-        // Check time valid:
-        int64_t now = GetAdjustedTime();
-        if (time < now - SMSG_RETENTION) {
-            LogPrint(BCLog::SMSG, "Not interested in peer %d bucket %d, has expired.\n", pfrom->GetId(), time);
-            return SMSG_GENERAL_ERROR;
-        }
-        if (time > now + SMSG_TIME_LEEWAY) {
-            LogPrint(BCLog::SMSG, "Not interested in peer %d bucket %d, in the future.\n", pfrom->GetId(), time);
-            Misbehaving(pfrom->GetId(), 1);
-            return SMSG_GENERAL_ERROR;
-        }
-
-        std::vector<uint8_t> vchDataOut;
-
-        {
-            LOCK(cs_smsg);
-            m_show_requests.erase(time);
-
-            if (pfrom->smsgData.m_num_want_sent >= MAX_WANT_SENT) {
-                LogPrint(BCLog::SMSG, "Too many messages already requested from peer: %d, %d.\n", pfrom->GetId(), pfrom->smsgData.m_num_want_sent);
-                return SMSG_NO_ERROR;
-            }
-
-            SecMsgBucket &bucket = buckets[time];
-            if (bucket.nLockCount > 0) {
-                LogPrint(BCLog::SMSG, "Bucket %d lock count %u, waiting for message data from peer %u.\n", time, bucket.nLockCount, bucket.nLockPeerId);
-                return SMSG_GENERAL_ERROR;
-            }
-
-            LogPrint(BCLog::SMSG, "Sifting through bucket %d.\n", time);
-
-            vchDataOut.resize(8);
-            memcpy(&vchDataOut[0], &vchData[0], 8);
-
-            std::set<SecMsgToken> &tokenSet = bucket.setTokens;
-            SecMsgToken token;
-            SecMsgPurged purgedToken;
-            uint8_t *p = &vchData[8];
-
-            for (int i = 0; i < n; ++i, p += 16) {
-                memcpy(&token.timestamp, p, 8);
-                memcpy(&token.sample, p+8, 8);
-
-                if (setPurgedTimestamps.find(token.timestamp) != setPurgedTimestamps.end()) {
-                    memcpy(&purgedToken.timestamp, p, 8);
-                    memcpy(&purgedToken.sample, p+8, 8);
-                    if (setPurged.find(purgedToken) != setPurged.end()) {
-                        continue;
-                    }
-                }
-
-                std::set<SecMsgToken>::const_iterator it = tokenSet.find(token);
-                if (it == tokenSet.end()) {
-                    int nd = vchDataOut.size();
-                    try {
-                        vchDataOut.resize(nd + 16);
-                    } catch (std::exception &e) {
-                        LogPrintf("vchDataOut.resize %d threw: %s.\n", nd + 16, e.what());
-                        continue;
-                    }
-
-                    memcpy(&vchDataOut[nd], p, 16);
-                }
-            }
+        return ProcessHave(pfrom, vchData);
+    } else
+    if (strCommand == SMSGMsgType::RECON) {
+        std::vector<uint8_t> vchData;
+        vRecv >> vchData;
 
-            if (vchDataOut.size() > 8) {
-                size_t n_messages = (vchDataOut.size() - 8) / 16;
-                pfrom->smsgData.m_num_want_sent += n_messages;
-                if (LogAcceptCategory(BCLog::SMSG)) {
-                    LogPrintf("Asking peer for %u messages.\n", n_messages);
-                    LogPrintf("Locking bucket %u for peer %d.\n", time, pfrom->GetId());
-                }
-                bucket.nLockCount   = 3; // lock this bucket for at most 3 * SMSG_THREAD_DELAY seconds, unset when peer sends smsgMsg
-                bucket.nLockPeerId  = pfrom->GetId();
-                g_connman->PushMessage(pfrom,
-                    CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::WANT, vchDataOut));
-            }
-        } // cs_smsg
+        return ProcessRecon(pfrom, vchData);
     } else
     if (strCommand == SMSGMsgType::WANT) {
         std::vector<uint8_t> vchData;
@@ -1737,6 +1656,294 @@ int CSMSG::ReceiveData(CNode *pfrom, const std::string &strCommand, CDataStream
     return SMSG_NO_ERROR;
 };
 
+bool CSMSG::ShowBucket(CNode *pfrom, int64_t time)
+{
+    // Send all message tokens in bucket not already shown to peer, in smsgHave
+    int64_t last_shown = 0;
+    {
+        LOCK(pfrom->smsgData.cs_smsg_net);
+        auto it = pfrom->smsgData.m_buckets_last_shown.find(time);
+        if (it != pfrom->smsgData.m_buckets_last_shown.end()) {
+            last_shown = it->second;
+        }
+    }
+
+    std::vector<uint8_t> vchDataOut;
+    int64_t now = GetAdjustedTime();
+    {
+        LOCK(cs_smsg);
+        auto itb = buckets.find(time);
+        if (itb == buckets.end()) {
+            LogPrint(BCLog::SMSG, "Don't have bucket %d.\n", time);
+            return false;
+        }
+
+        std::set<SecMsgToken> &tokenSet = itb->second.setTokens;
+
+        try { vchDataOut.resize(8 + 16 * tokenSet.size());
+        } catch (std::exception &e) {
+            LogPrintf("vchDataOut.resize %u threw: %s.\n", 8 + 16 * tokenSet.size(), e.what());
+            return false;
+        }
+        memcpy(&vchDataOut[0], &time, 8);
+
+        size_t nMessages = 0;
+        uint8_t *p = &vchDataOut[8];
+        for (auto it = tokenSet.begin(); it != tokenSet.end(); ++it) {
+            if (it->timestamp + it->ttl < now) {
+                continue;
+            }
+            if (time + it->m_changed < last_shown) {
+                continue;
+            }
+            memcpy(p, &it->timestamp, 8);
+            memcpy(p+8, &it->sample, 8);
+
+            p += 16;
+            nMessages++;
+        }
+        if (nMessages != tokenSet.size()) {
+            try { vchDataOut.resize(8 + 16 * nMessages);
+            } catch (std::exception &e) {
+                LogPrintf("vchDataOut.resize %u threw: %s.\n", 8 + 16 * nMessages, e.what());
+                return false;
+            }
+        }
+    }
+    {
+        LOCK(pfrom->smsgData.cs_smsg_net);
+        pfrom->smsgData.m_buckets_last_shown[time] = now;
+    }
+
+    g_connman->PushMessage(pfrom,
+        CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::HAVE, vchDataOut));
+    return true;
+};
+
+int CSMSG::ProcessHave(CNode *pfrom, const std::vector<uint8_t> &vchData)
+{
+    // Request messages listed in vchData (bucket time + tokens) that this node doesn't have
+    if (vchData.size() < 8) {
+        return SMSG_GENERAL_ERROR;
+    }
+
+    int n = (vchData.size() - 8) / 16;
+
+    int64_t time;
+    memcpy(&time, &vchData[0], 8);
+
+    // Check time valid:
+    int64_t now = GetAdjustedTime();
+    if (time < now - SMSG_RETENTION) {
+        LogPrint(BCLog::SMSG, "Not interested in peer %d bucket %d, has expired.\n", pfrom->GetId(), time);
+        return SMSG_GENERAL_ERROR;
+    }
+    if (time > now + SMSG_TIME_LEEWAY) {
+        LogPrint(BCLog::SMSG, "Not interested in peer %d bucket %d, in the future.\n", pfrom->GetId(), time);
+        Misbehaving(pfrom->GetId(), 1);
+        return SMSG_GENERAL_ERROR;
+    }
+
+    std::vector<uint8_t> vchDataOut;
+
+    {
+        LOCK(cs_smsg);
+        m_show_requests.erase(time);
+
+        if (pfrom->smsgData.m_num_want_sent >= MAX_WANT_SENT) {
+            LogPrint(BCLog::SMSG, "Too many messages already requested from peer: %d, %d.\n", pfrom->GetId(), pfrom->smsgData.m_num_want_sent);
+            return SMSG_NO_ERROR;
+        }
+
+        SecMsgBucket &bucket = buckets[time];
+        if (bucket.nLockCount > 0) {
+            LogPrint(BCLog::SMSG, "Bucket %d lock count %u, waiting for message data from peer %u.\n", time, bucket.nLockCount, bucket.nLockPeerId);
+            return SMSG_GENERAL_ERROR;
+        }
+
+        LogPrint(BCLog::SMSG, "Sifting through bucket %d.\n", time);
+
+        vchDataOut.resize(8);
+        memcpy(&vchDataOut[0], &vchData[0], 8);
+
+        std::set<SecMsgToken> &tokenSet = bucket.setTokens;
+        SecMsgToken token;
+        SecMsgPurged purgedToken;
+        const uint8_t *p = &vchData[8];
+
+        for (int i = 0; i < n; ++i, p += 16) {
+            memcpy(&token.timestamp, p, 8);
+            memcpy(&token.sample, p+8, 8);
+
+            if (setPurgedTimestamps.find(token.timestamp) != setPurgedTimestamps.end()) {
+                memcpy(&purgedToken.timestamp, p, 8);
+                memcpy(&purgedToken.sample, p+8, 8);
+                if (setPurged.find(purgedToken) != setPurged.end()) {
+                    continue;
+                }
+            }
+
+            std::set<SecMsgToken>::const_iterator it = tokenSet.find(token);
+            if (it == tokenSet.end()) {
+                int nd = vchDataOut.size();
+                try {
+                    vchDataOut.resize(nd + 16);
+                } catch (std::exception &e) {
+                    LogPrintf("vchDataOut.resize %d threw: %s.\n", nd + 16, e.what());
+                    continue;
+                }
+
+                memcpy(&vchDataOut[nd], p, 16);
+            }
+        }
+
+        if (vchDataOut.size() > 8) {
+            size_t n_messages = (vchDataOut.size() - 8) / 16;
+            pfrom->smsgData.m_num_want_sent += n_messages;
+            if (LogAcceptCategory(BCLog::SMSG)) {
+                LogPrintf("Asking peer for %u messages.\n", n_messages);
+                LogPrintf("Locking bucket %u for peer %d.\n", time, pfrom->GetId());
+            }
+            bucket.nLockCount   = 3; // lock this bucket for at most 3 * SMSG_THREAD_DELAY seconds, unset when peer sends smsgMsg
+            bucket.nLockPeerId  = pfrom->GetId();
+            g_connman->PushMessage(pfrom,
+                CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::WANT, vchDataOut));
+        }
+    } // cs_smsg
+
+    return SMSG_NO_ERROR;
+};
+
+static void InsertActiveTokens(const std::set<SecMsgToken> &tokenSet, int64_t now, SecMsgIBLT &iblt)
+{
+    for (const auto &token : tokenSet) {
+        if (token.timestamp + token.ttl < now) {
+            continue;
+        }
+        iblt.Insert(SecMsgIBLT::Key(token.timestamp, token.sample));
+    }
+};
+
+int CSMSG::ProcessRecon(CNode *pfrom, const std::vector<uint8_t> &vchData)
+{
+    /*
+        smsgRecon = bucket time + IBLT of the peer's active tokens in the bucket.
+        Subtract the IBLT of this node's tokens and decode the difference:
+            tokens only this node has are sent in smsgHave,
+            tokens only the peer has are requested as if the peer had sent them in smsgHave.
+        If the difference can't be decoded fall back to showing the full bucket.
+    */
+    if (vchData.size() < 8) {
+        return SMSG_GENERAL_ERROR;
+    }
+
+    int64_t time;
+    memcpy(&time, &vchData[0], 8);
+
+    int64_t now = GetAdjustedTime();
+    if (time % SMSG_BUCKET_LEN
+        || time < now - SMSG_RETENTION - SMSG_TIME_LEEWAY
+        || time > now + SMSG_TIME_LEEWAY) {
+        LogPrint(BCLog::SMSG, "Peer %d sent smsgRecon for invalid bucket %d.\n", pfrom->GetId(), time);
+        SmsgMisbehaving(pfrom, 1);
+        return SMSG_GENERAL_ERROR;
+    }
+
+    SecMsgIBLT iblt_peer;
+    if (!iblt_peer.Unserialize(&vchData[8], vchData.size() - 8, SMSG_RECON_MAX_CELLS)) {
+        LogPrint(BCLog::SMSG, "Peer %d sent invalid smsgRecon.\n", pfrom->GetId());
+        SmsgMisbehaving(pfrom, 10);
+        return SMSG_GENERAL_ERROR;
+    }
+
+    bool fDecoded = false;
+    std::vector<SecMsgIBLT::Key> vHave, vMissing;
+    {
+        LOCK(cs_smsg);
+        auto itb = buckets.find(time);
+        SecMsgIBLT iblt(iblt_peer.Size());
+        if (itb != buckets.end()) {
+            InsertActiveTokens(itb->second.setTokens, now, iblt);
+        }
+        fDecoded = iblt.Subtract(iblt_peer) && iblt.Decode(vHave, vMissing);
+    }
+
+    {
+        LOCK(pfrom->smsgData.cs_smsg_net);
+        if (fDecoded) {
+            pfrom->smsgData.m_num_recon_decoded++;
+        } else {
+            pfrom->smsgData.m_num_recon_failed++;
+        }
+    }
+
+    if (!fDecoded) {
+        LogPrint(BCLog::SMSG, "Could not decode smsgRecon from peer %d for bucket %d, showing full bucket.\n", pfrom->GetId(), time);
+        if (!ShowBucket(pfrom, time)) {
+            // Reply so peer doesn't wait for the show request to time out
+            std::vector<uint8_t> vchDataOut(8);
+            memcpy(&vchDataOut[0], &time, 8);
+            g_connman->PushMessage(pfrom,
+                CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::HAVE, vchDataOut));
+        }
+        return SMSG_NO_ERROR;
+    }
+
+    LogPrint(BCLog::SMSG, "Reconciled bucket %d with peer %d, have %u, missing %u.\n", time, pfrom->GetId(), vHave.size(), vMissing.size());
+
+    std::vector<uint8_t> vchDataOut(8 + 16 * vHave.size());
+    memcpy(&vchDataOut[0], &time, 8);
+    for (size_t i = 0; i < vHave.size(); ++i) {
+        memcpy(&vchDataOut[8 + i * 16], vHave[i].data, 16);
+    }
+    g_connman->PushMessage(pfrom,
+        CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::HAVE, vchDataOut));
+
+    if (vMissing.size() > 0) {
+        std::vector<uint8_t> vchMissing(8 + 16 * vMissing.size());
+        memcpy(&vchMissing[0], &time, 8);
+        for (size_t i = 0; i < vMissing.size(); ++i) {
+            memcpy(&vchMissing[8 + i * 16], vMissing[i].data, 16);
+        }
+        ProcessHave(pfrom, vchMissing);
+    }
+
+    return SMSG_NO_ERROR;
+};
+
+bool CSMSG::SendRecon(CNode *pto, int64_t time, const SecMsgBucket &bucket, const PeerBucket &peer_bucket)
+{
+    /*
+        Send an IBLT of this node's active tokens in place of requesting the full token list,
+        when the peer supports it and the table is smaller than the list the peer would send.
+        Should have LOCK(cs_smsg) and LOCK(pto->smsgData.cs_smsg_net)
+    */
+    if (pto->smsgData.m_version < SMSG_VERSION_RECON
+        || bucket.nActive < SMSG_RECON_MIN_TOKENS) {
+        return false;
+    }
+
+    size_t num_diff = bucket.nActive > peer_bucket.m_active ? bucket.nActive - peer_bucket.m_active : peer_bucket.m_active - bucket.nActive;
+    size_t num_cells = SecMsgIBLT::CellsForDifference(num_diff + SMSG_RECON_MIN_DIFF);
+    if (num_cells > SMSG_RECON_MAX_CELLS
+        || num_cells * SMSG_IBLT_CELL_LEN >= (size_t)peer_bucket.m_active * 16) {
+        return false;
+    }
+
+    SecMsgIBLT iblt(num_cells);
+    InsertActiveTokens(bucket.setTokens, GetAdjustedTime(), iblt);
+
+    std::vector<uint8_t> vchData(8);
+    memcpy(&vchData[0], &time, 8);
+    iblt.Serialize(vchData);
+
+    LogPrint(BCLog::SMSG, "Sending smsgRecon for bucket %d to peer %d, %u cells.\n", time, pto->GetId(), iblt.Size());
+    g_connman->PushMessage(pto,
+        CNetMsgMaker(INIT_PROTO_VERSION).Make(SMSGMsgType::RECON, vchData));
+    pto->smsgData.m_num_recon_sent++;
+    return true;
+};
+
 bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
 {
     /*
@@ -1869,6 +2076,10 @@ bool CSMSG::SendData(CNode *pto, bool fSendTrickle)
                 if (it_lb != buckets.end() &&
                     (it_lb->second.nActive > bkt.m_active || (it_lb->second.nActive == bkt.m_active && it_lb->second.hash == bkt.m_hash))) {
                     LogPrint(BCLog::SMSG, "Not requesting list of bucket %d.\n", it->first);
+                } else
+                if (it_lb != buckets.end() && SendRecon(pto, it->first, it_lb->second, bkt)) {
+                    nBucketsContestReq++;
+                    m_show_requests[it->first] = now + 10;
                 } else {
                     LogPrint(BCLog::SMSG, "Requesting list of bucket %d from peer %d.\n", it->first, pto->GetId());
                     size_t sz = vchData.size();
@@ -3891,7 +4102,7 @@ int CSMSG::Import(SecureMessage *psmsg, std::string &sError, bool setread, bool
 
 int CSMSG::Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
     SecureMessage &smsg, std::string &sError, bool fPaid,
-    size_t nRetention, bool fTestFee, CAmount *nFee, size_t *nTxBytes, bool fFromFile, bool submit_msg, bool add_to_outbox, bool fund_from_rct, size_t nRingSize, CCoinControl *coin_control)
+    size_t nRetention, bool fTestFee, CAmount *nFee, size_t *nTxBytes, bool fFromFile, bool submit_msg, bool add_to_outbox, bool fund_from_rct, size_t nRingSize, CCoinControl *coin_control, bool fund_batch)
 {
     /* Encrypt secure message, and place it on the network
         Make a copy of the message to sender's first address and place in send queue db
@@ -3965,6 +4176,14 @@ int CSMSG::Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
         GetPowHash(&smsg, smsg.pPayload, hash_bytes, msg_hash);
         memcpy(smsg.hash, msg_hash.begin(), 4);
     }
+    bool queue_for_funding = fPaid && fund_batch && !fTestFee;
+    if (queue_for_funding) {
+        if (!submit_msg) {
+            return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Batched funding requires submitmsg.");
+        }
+        // Funding txid is set when the batch is funded
+        memset(smsg.pPayload+(smsg.nPayload-32), 0, 32);
+    } else
     if (fPaid) {
         if (0 != FundMsg(smsg, sError, fTestFee, nFee, nTxBytes, fund_from_rct, nRingSize, coin_control)) {
             return errorN(SMSG_FUND_FAILED, "%s: SecureMsgFund failed %s.", __func__, sError);
@@ -3978,6 +4197,12 @@ int CSMSG::Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
     uint160 msgId;
     HashMsg(smsg, smsg.pPayload, smsg.nPayload-(fPaid ? 32 : 0), msgId);
 
+    if (queue_for_funding) {
+        // ThreadSecureMsgPow funds the queued messages and moves them to the send queue
+        if ((rv = QueueForFunding(smsg, addressTo, fund_from_rct, nRingSize, sError)) != SMSG_NO_ERROR) {
+            return rv;
+        }
+    } else
     if (submit_msg) {
         // Place message in send queue, proof of work will happen in a thread.
         uint8_t chKey[30];
@@ -4135,7 +4360,16 @@ int CSMSG::HashMsg(const SecureMessage &smsg, const uint8_t *pPayload, uint32_t
 
 int CSMSG::FundMsg(SecureMessage &smsg, std::string &sError, bool fTestFee, CAmount *nFee, size_t *nTxBytes, bool fund_from_rct, size_t nRingSize, CCoinControl *coin_control)
 {
+    std::vector<SecureMessage*> vpsmsg(1, &smsg);
+    return FundMsgs(vpsmsg, sError, fTestFee, nFee, nTxBytes, fund_from_rct, nRingSize, coin_control);
+};
+
+int CSMSG::FundMsgs(std::vector<SecureMessage*> &vpsmsg, std::string &sError, bool fTestFee, CAmount *nFee, size_t *nTxBytes, bool fund_from_rct, size_t nRingSize, CCoinControl *coin_control,
+    const std::function<bool(const uint256&)> &record_txid)
+{
+    // Fund all messages in vpsmsg with a single transaction
     // smsg.pPayload must have smsg.nPayload + 32 bytes allocated
+    // record_txid is called with the txid before the txn is added to the wallet, the txn is dropped if it returns false
 #ifdef ENABLE_WALLET
     assert(coin_control);
 
@@ -4143,24 +4377,31 @@ int CSMSG::FundMsg(SecureMessage &smsg, std::string &sError, bool fTestFee, CAmo
         return SMSG_WALLET_UNSET;
     }
 
-    if (smsg.version[0] != 3) {
-        return errorN(SMSG_UNKNOWN_VERSION, sError, __func__, "Bad message version.");
+    if (vpsmsg.empty()) {
+        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "No messages to fund.");
     }
-
-    size_t nDaysRetention = smsg.m_ttl / SMSG_SECONDS_IN_DAY;
-    if (nDaysRetention < 1 || nDaysRetention > 31) {
-        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Bad message ttl.");
+    if (vpsmsg.size() > GetFundBatchCapacity(fund_from_rct)) {
+        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Too many messages for one funding transaction.");
     }
 
-    uint256 txfundId;
-    uint160 msgId;
-    CMutableTransaction txFund;
+    std::vector<uint160> vMsgIds(vpsmsg.size());
+    for (size_t i = 0; i < vpsmsg.size(); ++i) {
+        const SecureMessage &smsg = *vpsmsg[i];
+        if (smsg.version[0] != 3) {
+            return errorN(SMSG_UNKNOWN_VERSION, sError, __func__, "Bad message version.");
+        }
 
-    if (0 != HashMsg(smsg, smsg.pPayload, smsg.nPayload-32, msgId)) {
-        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Message hash failed.");
+        size_t nDaysRetention = smsg.m_ttl / SMSG_SECONDS_IN_DAY;
+        if (nDaysRetention < 1 || nDaysRetention > 31) {
+            return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Bad message ttl.");
+        }
+
+        if (0 != HashMsg(smsg, smsg.pPayload, smsg.nPayload-32, vMsgIds[i])) {
+            return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Message hash failed.");
+        }
     }
 
-    size_t nMsgBytes = SMSG_HDR_LEN + smsg.nPayload;
+    uint256 txfundId;
     CAmount nFeeRet;
     OutputTypes fund_from = fund_from_rct ? OUTPUT_RINGCT : OUTPUT_STANDARD;
     {
@@ -4170,38 +4411,60 @@ int CSMSG::FundMsg(SecureMessage &smsg, std::string &sError, bool fTestFee, CAmo
         const Consensus::Params &consensusParams = Params().GetConsensus();
         coin_control->m_feerate = CFeeRate(consensusParams.smsg_fee_funding_tx_per_k);
         coin_control->fOverrideFeeRate = true;
-        coin_control->m_extrafee = ((locked_chain->getSmsgFeeRate(nullptr) * nMsgBytes) / 1000) * nDaysRetention;
-        assert(coin_control->m_extrafee <= std::numeric_limits<uint32_t>::max());
-        uint32_t msgFee = coin_control->m_extrafee;
+        coin_control->m_extrafee = 0;
 
+        // Each DO_FUND_MSG output holds up to SMSG_FUND_PAIRS_PER_OUTPUT (msgid, fee) pairs
         std::vector<CTempRecipient> vec_send;
-        CTransactionRecord rtx;
-        CTempRecipient tr;
-        tr.nType = OUTPUT_DATA;
-        tr.vData.resize(25); // 4 byte fee, max 42.94967295
-        tr.vData[0] = DO_FUND_MSG;
-        memcpy(&tr.vData[1], msgId.begin(), 20);
-        memcpy(&tr.vData[21], &msgFee, 4);
-        vec_send.push_back(tr);
+        int64_t nMsgFeePerKPerDay = locked_chain->getSmsgFeeRate(nullptr);
+        for (size_t i = 0; i < vpsmsg.size(); ++i) {
+            const SecureMessage &smsg = *vpsmsg[i];
+            size_t nMsgBytes = SMSG_HDR_LEN + smsg.nPayload;
+            size_t nDaysRetention = smsg.m_ttl / SMSG_SECONDS_IN_DAY;
+            CAmount nMsgFee = ((nMsgFeePerKPerDay * nMsgBytes) / 1000) * nDaysRetention;
+            assert(nMsgFee <= std::numeric_limits<uint32_t>::max());
+            uint32_t msgFee = nMsgFee;
+            coin_control->m_extrafee += nMsgFee;
+
+            if (i % SMSG_FUND_PAIRS_PER_OUTPUT == 0) {
+                CTempRecipient tr;
+                tr.nType = OUTPUT_DATA;
+                tr.vData.push_back(DO_FUND_MSG);
+                vec_send.push_back(tr);
+            }
+            std::vector<uint8_t> &vData = vec_send.back().vData;
+            size_t ofs = vData.size();
+            vData.resize(ofs + SMSG_FUND_PAIR_LEN); // 4 byte fee, max 42.94967295
+            memcpy(&vData[ofs], vMsgIds[i].begin(), 20);
+            memcpy(&vData[ofs+20], &msgFee, 4);
+        }
+
+        // Every data output after the first must be matched by a standard output, pair them with a single OP_RETURN
+        CTempRecipient tr_op_return;
+        tr_op_return.nType = OUTPUT_STANDARD;
+        tr_op_return.fScriptSet = true;
+        tr_op_return.scriptPubKey.resize(1);
+        tr_op_return.scriptPubKey[0] = OP_RETURN;
+        bool need_op_return = vec_send.size() > 1;
 
         CHDWallet *const pw = GetParticlWallet(pactive_wallet.get());
         CTransactionRef tx_new;
         CWalletTx wtx(pactive_wallet.get(), tx_new);
+        CTransactionRecord rtx;
 
         if (fund_from == OUTPUT_STANDARD) {
+            if (need_op_return) {
+                vec_send.push_back(tr_op_return);
+            }
             if (0 != pw->AddStandardInputs(*locked_chain, wtx, rtx, vec_send, !fTestFee, nFeeRet, coin_control, sError)) {
                 return SMSG_FUND_FAILED;
             }
         } else
         if (fund_from == OUTPUT_RINGCT) {
-            const Consensus::Params &consensusParams = Params().GetConsensus();
             if (consensusParams.extra_dataoutput_time > GetAdjustedTime()) {
-                tr.nType = OUTPUT_STANDARD;
-                tr.fScriptSet = true;
-                tr.scriptPubKey.resize(1);
-                tr.scriptPubKey[0] = OP_RETURN;
-                tr.vData.clear();
-                vec_send.push_back(tr);
+                need_op_return = true;
+            }
+            if (need_op_return) {
+                vec_send.push_back(tr_op_return);
             }
             size_t nInputsPerSig = 1;
             if (0 != pw->AddAnonInputs(*locked_chain, wtx, rtx, vec_send, !fTestFee, nRingSize, nInputsPerSig, nFeeRet, coin_control, sError)) {
@@ -4227,21 +4490,342 @@ int CSMSG::FundMsg(SecureMessage &smsg, std::string &sError, bool fTestFee, CAmo
         if (!pactive_wallet->GetBroadcastTransactions()) {
             return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Broadcast transactions disabled.");
         }
+        if (record_txid && !record_txid(txfundId)) {
+            return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Could not record funding txid.");
+        }
 
+        // Add the txn to the wallet before it's broadcast, after a restart pending messages are only
+        // funded again if the txn is missing from the wallet or abandoned
         wtx.BindWallet(pactive_wallet.get());
+        if (!pactive_wallet->AddToWallet(wtx)) {
+            return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Could not add the funding txn to the wallet.");
+        }
+        auto mi = pactive_wallet->mapWallet.find(txfundId);
         std::string err_string;
-        if (!wtx.SubmitMemoryPoolAndRelay(err_string, true, *locked_chain, m_absurd_smsg_fee)) {
+        if (mi == pactive_wallet->mapWallet.end()
+            || !mi->second.SubmitMemoryPoolAndRelay(err_string, true, *locked_chain, m_absurd_smsg_fee)) {
+            pactive_wallet->AbandonTransaction(*locked_chain, txfundId);
             return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Transaction cannot be broadcast immediately: %s.", err_string);
         }
-        pactive_wallet->AddToWallet(wtx);
     }
-    memcpy(smsg.pPayload+(smsg.nPayload-32), txfundId.begin(), 32);
+    for (auto *psmsg : vpsmsg) {
+        memcpy(psmsg->pPayload+(psmsg->nPayload-32), txfundId.begin(), 32);
+    }
 #else
     return SMSG_WALLET_UNSET;
 #endif
     return SMSG_NO_ERROR;
 };
 
+size_t CSMSG::GetFundBatchCapacity(bool fund_from_rct) const
+{
+    // Consensus allows one data output per standard output plus one, and policy only one OP_RETURN per txn.
+    // Anon funding txns carry a DO_FEE output, before extra_dataoutput_time that uses the OP_RETURN slot.
+    if (fund_from_rct && Params().GetConsensus().extra_dataoutput_time > GetAdjustedTime()) {
+        return SMSG_FUND_PAIRS_PER_OUTPUT;
+    }
+    return SMSG_FUND_PAIRS_PER_OUTPUT * 2;
+};
+
+int CSMSG::QueueForFunding(const SecureMessage &smsg, const CKeyID &addressTo, bool fund_from_rct, size_t nRingSize, std::string &sError)
+{
+    if (!smsg.IsPaidVersion()) {
+        return errorN(SMSG_UNKNOWN_VERSION, sError, __func__, "Bad message version.");
+    }
+    if (nRingSize > std::numeric_limits<uint16_t>::max()) {
+        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Bad ring size.");
+    }
+
+    uint160 msgId;
+    if (0 != HashMsg(smsg, smsg.pPayload, smsg.nPayload-32, msgId)) {
+        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Message hash failed.");
+    }
+
+    uint8_t chKey[30];
+    int64_t timestamp_be = bswap_64(smsg.timestamp);
+    memcpy(&chKey[0], DBK_FUNDING.data(), 2);
+    memcpy(&chKey[2], &timestamp_be, 8);
+    memcpy(&chKey[10], msgId.begin(), 20);
+
+    SecMsgStored smsgFQ;
+    smsgFQ.timeReceived  = GetTime();
+    smsgFQ.status        = fund_from_rct ? SMSG_MASK_FUND_RCT : 0;
+    smsgFQ.folderId      = fund_from_rct ? nRingSize : 0;
+    smsgFQ.addrTo        = addressTo;
+
+    try { smsgFQ.vchMessage.resize(SMSG_HDR_LEN + smsg.nPayload); } catch (std::exception &e) {
+        LogPrintf("smsgFQ.vchMessage.resize %u threw: %s.\n", SMSG_HDR_LEN + smsg.nPayload, e.what());
+        sError = "Could not allocate memory.";
+        return SMSG_ALLOCATE_FAILED;
+    }
+    memcpy(&smsgFQ.vchMessage[0], smsg.data(), SMSG_HDR_LEN);
+    memcpy(&smsgFQ.vchMessage[SMSG_HDR_LEN], smsg.pPayload, smsg.nPayload);
+
+    LOCK(cs_smsgDB);
+    SecMsgDB dbFundQueue;
+    if (!dbFundQueue.Open("cw")
+        || !dbFundQueue.WriteSmesg(chKey, smsgFQ)) {
+        return errorN(SMSG_GENERAL_ERROR, sError, __func__, "Write to funding queue failed.");
+    }
+
+    LogPrint(BCLog::SMSG, "Secure message %s queued for funding.\n", msgId.ToString());
+    return SMSG_NO_ERROR;
+};
+
+int CSMSG::ProcessFundingQueue(bool fFlush)
+{
+    // Fund queued paid messages in batches, move funded messages to the send queue.
+    // Messages are marked pending with the txid before the funding txn is added to the wallet, pending
+    // messages with the txn in the wallet are moved to the send queue without being funded again.
+    // Failed batches are retried with backoff, messages are dropped after SMSG_FUND_MAX_ATTEMPTS and
+    // their outbox copies marked as failed.
+    // Returns the number of messages funded.
+#ifdef ENABLE_WALLET
+    struct QueuedMsg {
+        std::vector<uint8_t> vchKey;
+        SecMsgStored stored;
+    };
+    std::vector<QueuedMsg> vQueuedAll;
+    std::map<uint256, std::vector<QueuedMsg> > mapPending; // funding txid
+
+    if (!pactive_wallet) {
+        return 0;
+    }
+
+    int64_t now = GetTime();
+    {
+        LOCK(cs_smsgDB);
+        SecMsgDB dbFundQueue;
+        if (!dbFundQueue.Open("cr+")) {
+            return 0;
+        }
+
+        uint8_t chKey[30];
+        SecMsgStored smsgStored;
+        leveldb::Iterator *it = dbFundQueue.pdb->NewIterator(leveldb::ReadOptions());
+        while (dbFundQueue.NextSmesg(it, DBK_FUNDING, chKey, smsgStored)) {
+            QueuedMsg qm;
+            qm.vchKey.assign(chKey, chKey + 30);
+            qm.stored = smsgStored;
+
+            uint256 txid;
+            if ((smsgStored.status & SMSG_MASK_FUND_PENDING)
+                && smsgStored.vchMessage.size() >= SMSG_HDR_LEN + 32
+                && GetFundingTxid(&smsgStored.vchMessage[SMSG_HDR_LEN], smsgStored.vchMessage.size() - SMSG_HDR_LEN, txid)) {
+                mapPending[txid].push_back(std::move(qm));
+            } else {
+                vQueuedAll.push_back(std::move(qm));
+            }
+        }
+        delete it;
+    }
+
+    // Drop retry times of messages no longer in the queue
+    std::map<std::vector<uint8_t>, int64_t> retry_time;
+    for (const auto &qm : vQueuedAll) {
+        auto mi = m_fund_retry_time.find(qm.vchKey);
+        if (mi != m_fund_retry_time.end()) {
+            retry_time.insert(*mi);
+        }
+    }
+    m_fund_retry_time.swap(retry_time);
+
+    // Move messages funded by txn txfundId to the send queue and set the funding txid on the outbox copies
+    auto move_funded = [&](std::vector<QueuedMsg> &vQueued, size_t k, size_t nEnd, const uint256 &txfundId) {
+        LOCK(cs_smsgDB);
+        SecMsgDB db;
+        if (!db.Open("cw")) {
+            return false;
+        }
+        db.TxnBegin();
+        for (size_t i = k; i < nEnd; ++i) {
+            m_fund_retry_time.erase(vQueued[i].vchKey);
+            uint8_t *chKey = vQueued[i].vchKey.data();
+            db.EraseSmesg(chKey);
+
+            SecMsgStored &smsgSQ = vQueued[i].stored;
+            smsgSQ.status = 0;
+            smsgSQ.folderId = 0;
+            memcpy(&chKey[0], DBK_QUEUED.data(), 2);
+            db.WriteSmesg(chKey, smsgSQ);
+
+            // Set funding txid on the outbox copy
+            SecMsgStored smsgOutbox;
+            memcpy(&chKey[0], DBK_OUTBOX.data(), 2);
+            if (db.ReadSmesg(chKey, smsgOutbox)
+                && smsgOutbox.vchMessage.size() >= SMSG_HDR_LEN + 32) {
+                memcpy(&smsgOutbox.vchMessage[smsgOutbox.vchMessage.size()-32], txfundId.begin(), 32);
+                db.WriteSmesg(chKey, smsgOutbox);
+                NotifySecMsgOutboxChanged(smsgOutbox);
+            }
+        }
+        return db.TxnCommit();
+    };
+
+    int nFunded = 0;
+    for (auto &mp : mapPending) {
+        bool fInWallet = false;
+        {
+            auto locked_chain = pactive_wallet->chain().lock();
+            LOCK(pactive_wallet->cs_wallet);
+            const CWalletTx *pwtx = pactive_wallet->GetWalletTx(mp.first);
+            fInWallet = pwtx && !pwtx->isAbandoned() && pwtx->GetDepthInMainChain(*locked_chain) >= 0;
+        }
+        if (fInWallet) {
+            LogPrint(BCLog::SMSG, "Found funding txn %s for %d pending messages.\n", mp.first.ToString(), mp.second.size());
+            if (move_funded(mp.second, 0, mp.second.size(), mp.first)) {
+                nFunded += mp.second.size();
+            }
+            continue;
+        }
+        // The funding txn was not broadcast, fund the messages again
+        LogPrintf("%s: Funding txn %s for %d pending messages not found in wallet.\n", __func__, mp.first.ToString(), mp.second.size());
+        for (auto &qm : mp.second) {
+            qm.stored.status &= ~SMSG_MASK_FUND_PENDING;
+            vQueuedAll.push_back(std::move(qm));
+        }
+    }
+
+    std::map<std::pair<bool, uint16_t>, std::vector<QueuedMsg> > mapBatches; // (fund_from_rct, ring size)
+    bool fDue = fFlush;
+    size_t nQueued = 0;
+    for (auto &qm : vQueuedAll) {
+        auto mi = m_fund_retry_time.find(qm.vchKey);
+        if (mi != m_fund_retry_time.end() && mi->second > now) {
+            continue;
+        }
+        if (qm.stored.timeReceived + m_fund_batch_delay <= now) {
+            fDue = true;
+        }
+        bool fund_from_rct = qm.stored.status & SMSG_MASK_FUND_RCT;
+        mapBatches[std::make_pair(fund_from_rct, qm.stored.folderId)].push_back(std::move(qm));
+        nQueued++;
+    }
+
+    if (nQueued == 0 || (!fDue && nQueued < m_fund_batch_size)) {
+        return nFunded;
+    }
+
+    // Count a failed attempt, set the retry time or drop the messages after SMSG_FUND_MAX_ATTEMPTS
+    auto record_failure = [&](std::vector<QueuedMsg> &vQueued, size_t k, size_t nEnd) {
+        size_t nDropped = 0;
+        LOCK(cs_smsgDB);
+        SecMsgDB db;
+        if (!db.Open("cw")) {
+            return nDropped;
+        }
+        db.TxnBegin();
+        for (size_t i = k; i < nEnd; ++i) {
+            SecMsgStored &stored = vQueued[i].stored;
+            uint32_t nAttempts = (stored.status >> SMSG_FUND_ATTEMPTS_SHIFT) + 1;
+            if (nAttempts >= SMSG_FUND_MAX_ATTEMPTS) {
+                LogPrintf("%s: Dropping message %s from the funding queue after %d failed attempts.\n",
+                    __func__, HexStr(&vQueued[i].vchKey[2], &vQueued[i].vchKey[2] + 28), nAttempts);
+                db.EraseSmesg(vQueued[i].vchKey.data());
+                m_fund_retry_time.erase(vQueued[i].vchKey);
+                nDropped++;
+
+                // The outbox copy keeps a null funding txid, mark it so it isn't shown as queued
+                uint8_t chKey[30];
+                memcpy(chKey, vQueued[i].vchKey.data(), 30);
+                memcpy(&chKey[0], DBK_OUTBOX.data(), 2);
+                SecMsgStored smsgOutbox;
+                if (db.ReadSmesg(chKey, smsgOutbox)) {
+                    smsgOutbox.status |= SMSG_MASK_FUND_FAILED;
+                    db.WriteSmesg(chKey, smsgOutbox);
+                    NotifySecMsgOutboxChanged(smsgOutbox);
+                }
+                continue;
+            }
+            stored.status = (stored.status & SMSG_MASK_FUND_RCT) | (nAttempts << SMSG_FUND_ATTEMPTS_SHIFT);
+            db.WriteSmesg(vQueued[i].vchKey.data(), stored);
+            int64_t nDelay = std::min((int64_t)SMSG_FUND_RETRY_DELAY << (nAttempts - 1), (int64_t)SMSG_FUND_RETRY_DELAY_MAX);
+            m_fund_retry_time[vQueued[i].vchKey] = now + nDelay;
+        }
+        db.TxnCommit();
+        return nDropped;
+    };
+
+    for (auto &mb : mapBatches) {
+        bool fund_from_rct = mb.first.first;
+        size_t nRingSize = mb.first.second;
+        size_t nBatchSize = std::max((size_t)1, std::min(m_fund_batch_size, GetFundBatchCapacity(fund_from_rct)));
+
+        std::vector<QueuedMsg> &vQueued = mb.second;
+        for (size_t k = 0; k < vQueued.size(); k += nBatchSize) {
+            size_t nEnd = std::min(k + nBatchSize, vQueued.size());
+
+            // SecureMessage owns pPayload, point it at the stored data and release before destruction
+            std::vector<SecureMessage> vsmsg(nEnd - k);
+            std::vector<SecureMessage*> vpsmsg;
+            for (size_t i = k; i < nEnd; ++i) {
+                SecureMessage &smsg = vsmsg[i - k];
+                std::vector<uint8_t> &vchMessage = vQueued[i].stored.vchMessage;
+                memcpy(smsg.data(), vchMessage.data(), SMSG_HDR_LEN);
+                smsg.nPayload = vchMessage.size() - SMSG_HDR_LEN;
+                smsg.pPayload = &vchMessage[SMSG_HDR_LEN];
+                vpsmsg.push_back(&smsg);
+            }
+
+            // Mark the messages pending before the txn is broadcast, a restart after the broadcast must not fund them again
+            auto record_txid = [&](const uint256 &txid) {
+                LOCK(cs_smsgDB);
+                SecMsgDB db;
+                if (!db.Open("cw")) {
+                    return false;
+                }
+                db.TxnBegin();
+                for (size_t i = k; i < nEnd; ++i) {
+                    SecMsgStored smsgPending = vQueued[i].stored;
+                    smsgPending.status |= SMSG_MASK_FUND_PENDING;
+                    memcpy(&smsgPending.vchMessage[smsgPending.vchMessage.size()-32], txid.begin(), 32);
+                    if (!db.WriteSmesg(vQueued[i].vchKey.data(), smsgPending)) {
+                        db.TxnAbort();
+                        return false;
+                    }
+                }
+                return db.TxnCommit();
+            };
+
+            CCoinControl coin_control;
+            std::string sError;
+            int rv = FundMsgs(vpsmsg, sError, false, nullptr, nullptr, fund_from_rct, nRingSize, &coin_control, record_txid);
+            for (auto &smsg : vsmsg) {
+                smsg.pPayload = nullptr;
+            }
+            if (rv != SMSG_NO_ERROR) {
+                LogPrintf("%s: Funding %d queued messages failed: %s\n", __func__, nEnd - k, sError);
+                size_t nDropped = record_failure(vQueued, k, nEnd);
+                LOCK(cs_smsg);
+                m_fund_batch_last_error = sError;
+                if (nDropped > 0) {
+                    m_fund_batch_last_error += strprintf(" Dropped %d messages after %d attempts.", nDropped, SMSG_FUND_MAX_ATTEMPTS);
+                }
+                continue;
+            }
+
+            uint256 txfundId;
+            const std::vector<uint8_t> &vchFunded = vQueued[k].stored.vchMessage;
+            GetFundingTxid(&vchFunded[SMSG_HDR_LEN], vchFunded.size() - SMSG_HDR_LEN, txfundId);
+            LogPrint(BCLog::SMSG, "Funded %d messages in txn %s.\n", nEnd - k, txfundId.ToString());
+            {
+                LOCK(cs_smsg);
+                m_fund_batch_last_error.clear();
+            }
+
+            // Messages left pending if this fails are moved on the next call
+            if (move_funded(vQueued, k, nEnd, txfundId)) {
+                nFunded += nEnd - k;
+            }
+        }
+    }
+
+    return nFunded;
+#else
+    return 0;
+#endif
+};
+
 std::vector<uint8_t> CSMSG::GetMsgID(const SecureMessage *psmsg, const uint8_t *pPayload)
 {
     std::vector<uint8_t> rv(28);
@@ -20,11 +20,13 @@ class CDataStream;
 class CWallet;
 class CCoinControl;
 class CNode;
+class PeerBucket;
 typedef int64_t NodeId;
 
 namespace smsg {
 
-const int SMSG_VERSION = 1;
+const int SMSG_VERSION = 2;
+const int SMSG_VERSION_RECON = 2;       // Peers understand smsgRecon
 
 enum SecureMessageCodes {
     SMSG_NO_ERROR = 0,
@@ -82,6 +84,19 @@ const uint32_t SMSG_TIME_IGNORE    = 90;                // seconds a peer is ign
 const uint32_t SMSG_DEFAULT_BANTIME = 8 * 60 * 60;
 const uint32_t SMSG_DEFAULT_MAXRCV = 4000;
 
+const uint32_t SMSG_RECON_MIN_TOKENS = 32;              // Smaller buckets are shown in full
+const uint32_t SMSG_RECON_MIN_DIFF = 16;                // Added to the difference in active message counts to size the table
+const uint32_t SMSG_RECON_MAX_CELLS = 4002;
+
+const uint32_t SMSG_FUND_PAIR_LEN  = 24;                // msgid 20 + fee 4
+const uint32_t SMSG_FUND_PAIRS_PER_OUTPUT = 3;          // (MAX_DATA_OUTPUT_SIZE - 1) / SMSG_FUND_PAIR_LEN
+const uint32_t SMSG_DEFAULT_FUND_BATCH_SIZE = 6;        // max messages funded by one batched funding txn
+const uint32_t SMSG_DEFAULT_FUND_BATCH_DELAY = 30;      // seconds a message may wait in the funding queue
+const uint32_t SMSG_FUND_RETRY_DELAY = 60;              // seconds before a failed batch is retried, doubled per attempt
+const uint32_t SMSG_FUND_RETRY_DELAY_MAX = 3600;
+const uint32_t SMSG_FUND_MAX_ATTEMPTS = 5;              // failed funding attempts before a message is dropped from the queue
+const bool DEFAULT_SMSG_FUND_BATCH = false;
+
 const uint32_t SMSG_MAX_MSG_BYTES  = 24000;             // the user input part
 const uint32_t SMSG_MAX_AMSG_BYTES = 512;               // the user input part (ANON)
 const uint32_t SMSG_MAX_MSG_BYTES_PAID = 512 * 1024;    // the user input part (Paid)
@@ -95,6 +110,10 @@ static const int MIN_SMSG_PROTO_VERSION = 90010;
 extern const std::string STORE_DIR;
 
 #define SMSG_MASK_UNREAD (1 << 0)
+#define SMSG_MASK_FUND_RCT (1 << 1) // Funding queue only, fund from anon balance, ring size in folderId
+#define SMSG_MASK_FUND_PENDING (1 << 2) // Funding queue only, funding txn created, txid in payload
+#define SMSG_MASK_FUND_FAILED (1 << 3) // Outbox only, the message was dropped from the funding queue unfunded
+#define SMSG_FUND_ATTEMPTS_SHIFT 4 // Funding queue only, failed funding attempts in the high bits of status
 
 class SecMsgStored;
 
@@ -387,6 +406,7 @@ class CSMSG
 public:
     int BuildBucketSet();
     int BuildPurgedSets();
+    int BuildInboxIndex();
     int AddWalletAddresses();
     int LoadKeyStore();
 
@@ -411,6 +431,10 @@ public:
 
     int ReceiveData(CNode *pfrom, const std::string &strCommand, CDataStream &vRecv);
     bool SendData(CNode *pto, bool fSendTrickle);
+    bool ShowBucket(CNode *pfrom, int64_t time);
+    int ProcessHave(CNode *pfrom, const std::vector<uint8_t> &vchData);
+    int ProcessRecon(CNode *pfrom, const std::vector<uint8_t> &vchData);
+    bool SendRecon(CNode *pto, int64_t time, const SecMsgBucket &bucket, const PeerBucket &peer_bucket);
 
     bool ScanBlock(const CBlock &block);
     bool ScanChainForPublicKeys(CBlockIndex *pindexStart);
@@ -458,11 +482,17 @@ public:
 
     int Send(CKeyID &addressFrom, CKeyID &addressTo, std::string &message,
         SecureMessage &smsg, std::string &sError, bool fPaid, size_t nRetention,
-        bool fTestFee=false, CAmount *nFee=nullptr, size_t *nTxBytes=nullptr, bool fFromFile=false, bool submit_msg=true, bool add_to_outbox=true, bool fund_from_rct=false, size_t nRingSize=5, CCoinControl *coin_control=nullptr);
+        bool fTestFee=false, CAmount *nFee=nullptr, size_t *nTxBytes=nullptr, bool fFromFile=false, bool submit_msg=true, bool add_to_outbox=true, bool fund_from_rct=false, size_t nRingSize=5, CCoinControl *coin_control=nullptr, bool fund_batch=false);
 
     bool GetPowHash(const SecureMessage *psmsg, const uint8_t *pPayload, uint32_t nPayload, uint256 &hash);
     int HashMsg(const SecureMessage &smsg, const uint8_t *pPayload, uint32_t nPayload, uint160 &hash);
     int FundMsg(SecureMessage &smsg, std::string &sError, bool fTestFee, CAmount *nFee, size_t *nTxBytes, bool fund_from_rct, size_t nRingSize, CCoinControl *coin_control);
+    int FundMsgs(std::vector<SecureMessage*> &vpsmsg, std::string &sError, bool fTestFee, CAmount *nFee, size_t *nTxBytes, bool fund_from_rct, size_t nRingSize, CCoinControl *coin_control,
+        const std::function<bool(const uint256&)> &record_txid = nullptr);
+
+    size_t GetFundBatchCapacity(bool fund_from_rct) const;
+    int QueueForFunding(const SecureMessage &smsg, const CKeyID &addressTo, bool fund_from_rct, size_t nRingSize, std::string &sError);
+    int ProcessFundingQueue(bool fFlush=false);
 
     std::vector<uint8_t> GetMsgID(const SecureMessage *psmsg, const uint8_t *pPayload);
     std::vector<uint8_t> GetMsgID(const SecureMessage &smsg);
@@ -497,6 +527,12 @@ public:
     CAmount m_absurd_smsg_fee = 500 * COIN;
     uint16_t m_smsg_max_receive_count = SMSG_DEFAULT_MAXRCV;
 
+    bool m_fund_batch = DEFAULT_SMSG_FUND_BATCH;
+    size_t m_fund_batch_size = SMSG_DEFAULT_FUND_BATCH_SIZE;
+    int64_t m_fund_batch_delay = SMSG_DEFAULT_FUND_BATCH_DELAY;
+    std::string m_fund_batch_last_error;
+    std::map<std::vector<uint8_t>, int64_t> m_fund_retry_time; // funding queue key -> earliest retry, ProcessFundingQueue only
+
     std::map<int64_t, int64_t> m_show_requests;
 };
 
@@ -5,14 +5,17 @@
 #include <attributes.h>
 #include <clientversion.h>
 #include <coins.h>
+#include <node/coinstats.h>
 #include <script/standard.h>
 #include <streams.h>
 #include <test/setup_common.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
 
 #include <map>
+#include <numeric>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -534,6 +537,42 @@ BOOST_AUTO_TEST_CASE(ccoins_serialization)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_commitment)
+{
+    Coin plain(CTxOut(1, CScript() << OP_TRUE), 1, false);
+    size_t plain_usage = plain.DynamicMemoryUsage();
+    for (size_t i = 0; i < 33; ++i) {
+        BOOST_CHECK_EQUAL(plain.GetCommitment().data[i], 0);
+    }
+
+    secp256k1_pedersen_commitment commitment;
+    for (size_t i = 0; i < 33; ++i) {
+        commitment.data[i] = i + 1;
+    }
+    Coin ct(plain);
+    ct.nType = OUTPUT_CT;
+    ct.SetCommitment(commitment);
+    BOOST_CHECK(ct.DynamicMemoryUsage() > plain_usage);
+    BOOST_CHECK(memcmp(ct.GetCommitment().data, commitment.data, 33) == 0);
+
+    // Copies must not share the out of line commitment
+    Coin ct_copy(ct);
+    ct.SetCommitment(plain.GetCommitment());
+    BOOST_CHECK(memcmp(ct_copy.GetCommitment().data, commitment.data, 33) == 0);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << ct_copy;
+    Coin ct_read;
+    ss >> ct_read;
+    BOOST_CHECK_EQUAL(ct_read.nType, OUTPUT_CT);
+    BOOST_CHECK(memcmp(ct_read.GetCommitment().data, commitment.data, 33) == 0);
+
+    ct_read = plain;
+    BOOST_CHECK_EQUAL(ct_read.DynamicMemoryUsage(), plain_usage);
+    ct_copy.Clear();
+    BOOST_CHECK_EQUAL(ct_copy.DynamicMemoryUsage(), 0U);
+}
+
 const static COutPoint OUTPOINT;
 const static CAmount PRUNED = -1;
 const static CAmount ABSENT = -2;
@@ -864,4 +903,71 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(coins_partitioned_cursors)
+{
+    CCoinsViewDB db(GetDataDir() / "partitioned_coins", 1 << 20, true, false);
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < 2000; ++i) {
+            uint256 txid = InsecureRand256();
+            if (i % 200 == 0) {
+                // Include the boundaries of the ranges
+                *txid.begin() = (unsigned char)(i % 400 == 0 ? 0x00 : 0xff);
+            }
+            for (uint32_t n = 0; n < 1 + InsecureRandRange(3); ++n) {
+                Coin coin(CTxOut(InsecureRandRange(1000000), CScript() << OP_TRUE), 1 + InsecureRandRange(1000), false);
+                cache.AddCoin(COutPoint(txid, n), std::move(coin), false);
+            }
+        }
+        cache.SetBestBlock(InsecureRand256(), 1000);
+        BOOST_CHECK(cache.Flush());
+    }
+
+    std::vector<COutPoint> expected;
+    std::unique_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint key;
+        BOOST_CHECK(pcursor->GetKey(key));
+        expected.push_back(key);
+    }
+
+    for (size_t n_partitions : {1, 3, 16, 256, 1000}) {
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors = db.PartitionedCursors(n_partitions);
+        BOOST_CHECK_EQUAL(cursors.size(), std::min<size_t>(n_partitions, 256));
+        std::vector<COutPoint> keys;
+        for (const auto& cursor : cursors) {
+            BOOST_CHECK(cursor->GetBestBlock() == db.GetBestBlock());
+            for (; cursor->Valid(); cursor->Next()) {
+                COutPoint key;
+                BOOST_CHECK(cursor->GetKey(key));
+                keys.push_back(key);
+            }
+        }
+        BOOST_CHECK(keys == expected);
+    }
+
+    // The merge runs in partition order however the scans are scheduled
+    gArgs.ForceSetArg("-utxoscanthreads", "4");
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors = db.PartitionedCursors(64);
+    std::vector<size_t> scanned(cursors.size(), 0);
+    std::vector<size_t> merged;
+    size_t total = 0;
+    BOOST_CHECK(ScanCoinsCursors(cursors,
+        [&](size_t i, CCoinsViewCursor& cursor) {
+            for (; cursor.Valid(); cursor.Next()) {
+                scanned[i]++;
+            }
+            return true;
+        },
+        [&](size_t i) {
+            merged.push_back(i);
+            total += scanned[i];
+        }));
+    std::vector<size_t> in_order(cursors.size());
+    std::iota(in_order.begin(), in_order.end(), 0);
+    BOOST_CHECK(merged == in_order);
+    BOOST_CHECK_EQUAL(total, expected.size());
+    gArgs.ForceSetArg("-utxoscanthreads", "0");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
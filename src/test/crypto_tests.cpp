@@ -9,11 +9,13 @@
 #include <crypto/hkdf_sha256_32.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/muhash.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
 #include <random.h>
+#include <streams.h>
 #include <util/strencodings.h>
 #include <test/setup_common.h>
 
@@ -749,4 +751,115 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(sha512_batch)
+{
+    // Lengths around the padding boundaries, after prefixes that leave the buffer partially filled
+    const size_t lens[] = {0, 4, 32, 64, 111, 112, 127, 128, 129, 200, 300};
+    const size_t prefixes[] = {0, 33, 100, 128};
+    std::vector<unsigned char> in(300 * 19), out1(64 * 19), out2(64 * 19);
+    for (auto& c : in) {
+        c = InsecureRandBits(8);
+    }
+    for (size_t prefix : prefixes) {
+        CSHA512 sha;
+        CHMAC_SHA512 hmac(in.data(), 32);
+        sha.Write(in.data(), prefix);
+        hmac.Write(in.data(), prefix);
+        for (size_t len : lens) {
+            for (size_t count = 0; count <= 19; count += 3) {
+                for (size_t j = 0; j < count; ++j) {
+                    CSHA512(sha).Write(in.data() + j * len, len).Finalize(out1.data() + 64 * j);
+                }
+                sha.FinalizeBatch(in.data(), len, count, out2.data());
+                BOOST_CHECK(memcmp(out1.data(), out2.data(), 64 * count) == 0);
+
+                for (size_t j = 0; j < count; ++j) {
+                    CHMAC_SHA512(hmac).Write(in.data() + j * len, len).Finalize(out1.data() + 64 * j);
+                }
+                hmac.FinalizeBatch(in.data(), len, count, out2.data());
+                BOOST_CHECK(memcmp(out1.data(), out2.data(), 64 * count) == 0);
+            }
+        }
+    }
+}
+
+static MuHash3072 FromInt(unsigned char i) {
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(Span<const unsigned char>(tmp, 32));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 out;
+
+    for (int iter = 0; iter < 10; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = InsecureRandBits(3);
+        }
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= FromInt(t & 3);
+                } else {
+                    acc *= FromInt(t & 3);
+                }
+            }
+            acc.Finalize(out);
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+
+        MuHash3072 x = FromInt(InsecureRandBits(4)); // x=X
+        MuHash3072 y = FromInt(InsecureRandBits(4)); // x=X, y=Y
+        MuHash3072 z; // x=X, y=Y, z=1
+        z *= x; // x=X, y=Y, z=X
+        z *= y; // x=X, y=Y, z=X*Y
+        y *= x; // x=X, y=Y*X, z=X*Y
+        z /= y; // x=X, y=Y*X, z=1
+        z.Finalize(out);
+
+        uint256 out2;
+        MuHash3072 a;
+        a.Finalize(out2);
+
+        BOOST_CHECK_EQUAL(out, out2);
+    }
+
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    acc.Finalize(out);
+    BOOST_CHECK_EQUAL(out, uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+
+    MuHash3072 acc2 = FromInt(0);
+    unsigned char tmp[32] = {1, 0};
+    acc2.Insert(Span<const unsigned char>(tmp, 32));
+    unsigned char tmp2[32] = {2, 0};
+    acc2.Remove(Span<const unsigned char>(tmp2, 32));
+    acc2.Finalize(out);
+    BOOST_CHECK_EQUAL(out, uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+
+    // Serialization round trip keeps the running numerator and denominator
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    MuHash3072 serchk = FromInt(1);
+    serchk /= FromInt(2);
+    ss << serchk;
+    MuHash3072 serchk_read;
+    ss >> serchk_read;
+    serchk *= FromInt(0);
+    serchk_read *= FromInt(0);
+    uint256 out_read;
+    serchk.Finalize(out);
+    serchk_read.Finalize(out_read);
+    BOOST_CHECK_EQUAL(out, out_read);
+    BOOST_CHECK_EQUAL(out, uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -546,6 +546,37 @@ BOOST_AUTO_TEST_CASE(extkey_regtest_keys)
     SelectParams(CBaseChainParams::MAIN);
 }
 
+BOOST_AUTO_TEST_CASE(extkey_derive_keys)
+{
+    CExtKey ev;
+    ev.SetSeed(ParseHex("000102030405060708090a0b0c0d0e0f").data(), 16);
+
+    CStoredExtKey sek;
+    sek.kp = CExtKeyPair(ev);
+
+    // Single thread, several threads and a range crossing the batch size
+    for (int nThreads : {1, 4}) {
+        uint32_t nFirst = 7, nCount = 2 * DERIVE_KEYS_PER_THREAD + 3;
+        std::vector<CPubKey> vKeys;
+        BOOST_CHECK(0 == sek.DeriveKeys(vKeys, nFirst, nCount, nThreads));
+        BOOST_CHECK(vKeys.size() == nCount);
+        for (uint32_t k = 0; k < nCount; ++k) {
+            CPubKey pk;
+            uint32_t nChildOut = 0;
+            BOOST_CHECK(0 == sek.DeriveKey(pk, nFirst + k, nChildOut, false));
+            BOOST_CHECK(nChildOut == nFirst + k);
+            BOOST_CHECK(vKeys[k] == pk);
+        }
+    }
+
+    std::vector<CPubKey> vKeys;
+    BOOST_CHECK(0 == sek.DeriveKeys(vKeys, 0, 0));
+    BOOST_CHECK(vKeys.empty());
+    BOOST_CHECK(0 != sek.DeriveKeys(vKeys, (1u << 31) - 1, 2));
+    BOOST_CHECK(0 == sek.DeriveKeys(vKeys, (1u << 31) - 1, 1));
+    BOOST_CHECK(vKeys.size() == 1 && vKeys[0].IsValid());
+}
+
 BOOST_AUTO_TEST_CASE(extkey_account)
 {
     CExtKeyAccount eka;
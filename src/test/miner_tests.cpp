@@ -6,6 +6,7 @@
 #include <coins.h>
 #include <consensus/consensus.h>
 #include <consensus/merkle.h>
+#include <consensus/validation.h>
 #include <consensus/tx_verify.h>
 #include <miner.h>
 #include <key/extkey.h>
@@ -18,6 +19,7 @@
 #include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <test/setup_common.h>
 
@@ -525,4 +527,92 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_FIXTURE_TEST_CASE(BlockTemplateCache_matches_selection, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Mature a few more coinbases to spend
+    for (int i = 0; i < 5; ++i) {
+        CreateAndProcessBlock({}, scriptPubKey);
+    }
+
+    g_block_template_cache = MakeUnique<BlockTemplateCache>(chainparams);
+    RegisterValidationInterface(g_block_template_cache.get());
+
+    auto spend = [&](const CTransactionRef& prev, CAmount fee) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(prev->GetHash(), 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = prev->vout[0].nValue - fee;
+        tx.vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        CAmount amount = prev->vout[0].nValue;
+        std::vector<uint8_t> vchAmount(8);
+        memcpy(vchAmount.data(), &amount, 8);
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, vchAmount, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+
+        CTransactionRef ptx = MakeTransactionRef(tx);
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, ptx, nullptr /* pfMissingInputs */,
+            nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */));
+        return ptx;
+    };
+
+    // A template taken from the cache must hold the same transactions as a fresh selection
+    auto check_cached_template = [&]() {
+        SyncWithValidationInterfaceQueue();
+        std::unique_ptr<CBlockTemplate> cached = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey);
+        std::unique_ptr<BlockTemplateCache> cache = std::move(g_block_template_cache);
+        std::unique_ptr<CBlockTemplate> fresh = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey);
+        g_block_template_cache = std::move(cache);
+
+        std::set<uint256> cached_txids, fresh_txids;
+        for (size_t i = 1; i < cached->block.vtx.size(); ++i) {
+            cached_txids.insert(cached->block.vtx[i]->GetHash());
+        }
+        for (size_t i = 1; i < fresh->block.vtx.size(); ++i) {
+            fresh_txids.insert(fresh->block.vtx[i]->GetHash());
+        }
+        BOOST_CHECK_EQUAL(cached->block.vtx.size(), fresh->block.vtx.size());
+        BOOST_CHECK(cached_txids == fresh_txids);
+        BOOST_CHECK_EQUAL(cached->vTxFees[0], fresh->vTxFees[0]);
+        return cached_txids.size();
+    };
+
+    // The first request builds the selection
+    std::vector<CTransactionRef> parents;
+    for (int i = 0; i < 4; ++i) {
+        parents.push_back(spend(m_coinbase_txns[i], 10000 * (i + 1)));
+    }
+    BOOST_CHECK_EQUAL(check_cached_template(), 4U);
+
+    // Children of selected transactions are appended
+    spend(parents[0], 20000);
+    spend(parents[2], 50000);
+    BOOST_CHECK_EQUAL(check_cached_template(), 6U);
+
+    // A free parent paid for by its child marks the selection stale, it's rebuilt after the interval
+    CTransactionRef free_parent = spend(m_coinbase_txns[4], 0);
+    spend(free_parent, 100000);
+    MilliSleep(TEMPLATE_CACHE_REBUILD_INTERVAL);
+    BOOST_CHECK_EQUAL(check_cached_template(), 8U);
+
+    // A new tip drops the transactions in the block
+    CMutableTransaction mined(*parents[1]);
+    CreateAndProcessBlock({mined}, scriptPubKey);
+    BOOST_CHECK_EQUAL(check_cached_template(), 7U);
+
+    SyncWithValidationInterfaceQueue();
+    UnregisterValidationInterface(g_block_template_cache.get());
+    g_block_template_cache.reset();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -131,6 +131,60 @@ BOOST_AUTO_TEST_CASE(particlchain_test)
     txnSpend.nVersion = PARTICL_BLOCK_VERSION;
 }
 
+BOOST_AUTO_TEST_CASE(txout_arena)
+{
+    CMutableTransaction txn;
+    txn.nVersion = PARTICL_TXN_VERSION;
+    txn.SetType(TXN_STANDARD);
+    txn.nLockTime = 0;
+    txn.vin.push_back(CTxIn(COutPoint(InsecureRand256(), 0)));
+
+    std::vector<uint8_t> vData = {DO_FEE, 0x01};
+    txn.vpout.push_back(MAKE_OUTPUT<CTxOutData>(vData));
+    for (size_t k = 0; k < CTxOutArena::MAX_CHUNK_SLOTS + 10; ++k) {
+        if (k % 2) {
+            OUTPUT_PTR<CTxOutCT> out = MAKE_OUTPUT<CTxOutCT>();
+            memset(out->commitment.data, k & 0xFF, 33);
+            out->vRangeproof.resize(k);
+            out->scriptPubKey = CScript() << OP_RETURN << k;
+            txn.vpout.push_back(out);
+        } else {
+            txn.vpout.push_back(MAKE_OUTPUT<CTxOutStandard>(k, CScript() << OP_TRUE << k));
+        }
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << txn;
+    CTransaction txOut(deserialize, ss);
+
+    BOOST_REQUIRE(txOut.vpout.size() == txn.vpout.size());
+    BOOST_CHECK(txOut.GetHash() == txn.GetHash());
+    CAmount nFee;
+    BOOST_CHECK(txOut.vpout[0]->GetCTFee(nFee) && nFee == 1);
+    for (size_t k = 1; k < txOut.vpout.size(); ++k) {
+        BOOST_CHECK(txOut.vpout[k]->nVersion == txn.vpout[k]->nVersion);
+        if (txOut.vpout[k]->IsType(OUTPUT_CT)) {
+            BOOST_CHECK(memcmp(txOut.vpout[k]->GetPCommitment()->data, txn.vpout[k]->GetPCommitment()->data, 33) == 0);
+            BOOST_CHECK(*txOut.vpout[k]->GetPRangeproof() == *txn.vpout[k]->GetPRangeproof());
+        } else {
+            BOOST_CHECK(txOut.vpout[k]->GetValue() == txn.vpout[k]->GetValue());
+        }
+    }
+
+    // Outputs share the arena, which lives until the last output is released
+    CTxOutBaseRef out_last;
+    {
+        CDataStream ssTmp(SER_NETWORK, PROTOCOL_VERSION);
+        ssTmp << txn;
+        CTransaction txTmp(deserialize, ssTmp);
+        out_last = txTmp.vpout.back();
+        BOOST_CHECK(out_last.use_count() > 1);
+    }
+    BOOST_CHECK(out_last.use_count() == 1);
+    BOOST_REQUIRE(out_last->IsType(OUTPUT_CT));
+    BOOST_CHECK(memcmp(out_last->GetPCommitment()->data, txn.vpout.back()->GetPCommitment()->data, 33) == 0);
+}
+
 BOOST_AUTO_TEST_CASE(varints)
 {
     // encode
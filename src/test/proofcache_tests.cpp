@@ -0,0 +1,41 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <proofcache.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(proofcache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(proofcache_entries)
+{
+    const uint256 wtxid = InsecureRand256();
+    const std::vector<uint8_t> ring_a(33 * 6, 0x02), ring_b(33 * 6, 0x03);
+
+    uint256 entry, entry_type, entry_index, entry_ring_a, entry_ring_b;
+    ComputeProofCacheEntry(entry, wtxid, PROOF_RANGEPROOF, 0);
+    ComputeProofCacheEntry(entry_type, wtxid, PROOF_BULLETPROOF, 0);
+    ComputeProofCacheEntry(entry_index, wtxid, PROOF_RANGEPROOF, 1);
+    ComputeProofCacheEntry(entry_ring_a, wtxid, PROOF_MLSAG, 0, ring_a.data(), ring_a.size());
+    ComputeProofCacheEntry(entry_ring_b, wtxid, PROOF_MLSAG, 0, ring_b.data(), ring_b.size());
+    BOOST_CHECK(entry != entry_type);
+    BOOST_CHECK(entry != entry_index);
+    BOOST_CHECK(entry_ring_a != entry_ring_b);
+
+    BOOST_CHECK(!ProofCacheContains(entry, false));
+    ProofCacheInsert(entry);
+    ProofCacheInsert(entry_ring_a);
+    BOOST_CHECK(ProofCacheContains(entry, false));
+    BOOST_CHECK(!ProofCacheContains(entry_type, false));
+    BOOST_CHECK(!ProofCacheContains(entry_index, false));
+    BOOST_CHECK(ProofCacheContains(entry_ring_a, false));
+    BOOST_CHECK(!ProofCacheContains(entry_ring_b, false));
+
+    // Erased entries are only marked for collection and are still found until overwritten
+    BOOST_CHECK(ProofCacheContains(entry, true));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include <rpc/server.h>
 #include <rpc/client.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/util.h>
 #include <rpc/rpcutil.h>
 
@@ -419,4 +420,79 @@ BOOST_AUTO_TEST_CASE(rpc_getblockstats_calculate_percentiles_by_weight)
     }
 }
 
+BOOST_AUTO_TEST_CASE(rpc_peek_method)
+{
+    std::string method;
+    BOOST_CHECK(JSONRPCPeekMethod("{\"method\":\"getblockcount\",\"params\":[]}", method));
+    BOOST_CHECK_EQUAL(method, "getblockcount");
+    BOOST_CHECK(JSONRPCPeekMethod(" {\"jsonrpc\": \"1.0\", \"id\": 1, \"method\" : \"uptime\"}", method));
+    BOOST_CHECK_EQUAL(method, "uptime");
+
+    // Keys and strings of nested values are skipped
+    BOOST_CHECK(JSONRPCPeekMethod("{\"params\":[{\"method\":\"uptime\"},\"\\\"method\\\":\\\"uptime\\\"\"],\"method\":\"getblock\"}", method));
+    BOOST_CHECK_EQUAL(method, "getblock");
+    BOOST_CHECK(JSONRPCPeekMethod("{\"id\":\"method\",\"method\":\"getblock\"}", method));
+    BOOST_CHECK_EQUAL(method, "getblock");
+
+    BOOST_CHECK(!JSONRPCPeekMethod("[{\"method\":\"getblockcount\"}]", method));
+    BOOST_CHECK(!JSONRPCPeekMethod("{\"method\":5}", method));
+    BOOST_CHECK(!JSONRPCPeekMethod("{\"method\":\"\"}", method));
+    BOOST_CHECK(!JSONRPCPeekMethod("{\"method\":\"get\\u0062lock\"}", method));
+    BOOST_CHECK(!JSONRPCPeekMethod("{\"params\":[1,2],\"method\":\"getbl", method));
+    BOOST_CHECK(!JSONRPCPeekMethod("\"method\"", method));
+    BOOST_CHECK(!JSONRPCPeekMethod("", method));
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_writer)
+{
+    auto write = [](JSONWriter& writer) {
+        writer.BeginObject();
+        writer.PushKV("a", 1);
+        writer.PushKV("b\"", "x");
+        writer.Key("c");
+        writer.BeginArray();
+        for (int i = 0; i < 100; ++i) {
+            UniValue o(UniValue::VOBJ);
+            o.pushKV("i", i);
+            writer.Value(o);
+        }
+        writer.BeginArray();
+        writer.EndArray();
+        writer.BeginObject();
+        writer.EndObject();
+        writer.EndArray();
+        writer.PushKV("d", NullUniValue);
+        writer.EndObject();
+    };
+
+    JSONWriter tree;
+    write(tree);
+    BOOST_CHECK_EQUAL(tree.NumValues(), 1U);
+    BOOST_CHECK_EQUAL(tree.GetValue()["c"].size(), 102U);
+    BOOST_CHECK_EQUAL(tree.GetValue()["b\""].get_str(), "x");
+
+    // Streamed text matches the tree as written by UniValue
+    std::string text;
+    std::vector<size_t> chunks;
+    JSONWriter stream([&](const std::string& chunk) {
+        text += chunk;
+        chunks.push_back(chunk.size());
+    }, 64);
+    stream.Append("{\"result\":");
+    write(stream);
+    BOOST_CHECK_EQUAL(stream.NumValues(), 1U);
+    stream.Append("}");
+    stream.Flush();
+    BOOST_CHECK_EQUAL(text, "{\"result\":" + tree.GetValue().write() + "}");
+    BOOST_CHECK(chunks.size() > 1);
+    for (size_t i = 0; i + 1 < chunks.size(); ++i) {
+        BOOST_CHECK(chunks[i] >= 64);
+    }
+
+    // Text added around the document doesn't count as a result
+    JSONWriter unused([](const std::string&) {});
+    unused.Append("{\"result\":");
+    BOOST_CHECK_EQUAL(unused.NumValues(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -10,11 +10,13 @@
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
+#include <crypto/sha512.h>
 #include <init.h>
 #include <miner.h>
 #include <net.h>
 #include <noui.h>
 #include <pow.h>
+#include <proofcache.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
 #include <script/sigcache.h>
@@ -56,11 +58,13 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName, bool fParticl
     InitLogging();
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    SHA512AutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitProofCache();
     fCheckBlockIndex = true;
 
     static bool noui_connected = false;
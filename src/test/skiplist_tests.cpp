@@ -188,4 +188,75 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_edge_test)
     BOOST_CHECK(ret2->nTimeMax >= 200 && ret2->nHeight == 4);
 }
 
+BOOST_AUTO_TEST_CASE(chainview_test)
+{
+    // A main chain and a branch forking off at height 3000
+    const int main_length = 5000, fork_height = 3000, branch_length = 2500;
+    std::vector<uint256> vHashMain(main_length), vHashBranch(branch_length);
+    std::vector<CBlockIndex> vBlocksMain(main_length), vBlocksBranch(branch_length);
+    for (int i = 0; i < main_length; i++) {
+        vHashMain[i] = InsecureRand256();
+        vBlocksMain[i].nHeight = i;
+        vBlocksMain[i].pprev = i ? &vBlocksMain[i - 1] : nullptr;
+        vBlocksMain[i].phashBlock = &vHashMain[i];
+        vBlocksMain[i].BuildSkip();
+    }
+    for (int i = 0; i < branch_length; i++) {
+        vHashBranch[i] = InsecureRand256();
+        vBlocksBranch[i].nHeight = fork_height + 1 + i;
+        vBlocksBranch[i].pprev = i ? &vBlocksBranch[i - 1] : &vBlocksMain[fork_height];
+        vBlocksBranch[i].phashBlock = &vHashBranch[i];
+        vBlocksBranch[i].BuildSkip();
+    }
+
+    const int num_views = CChainView::NumViews();
+    CChain chain;
+    chain.SetTip(&vBlocksMain[main_length - 2]);
+    CChainView view_first(chain, nullptr, nullptr);
+    chain.SetTip(&vBlocksMain[main_length - 1]);
+    CChainView view_main(chain, &view_first, nullptr);
+    BOOST_CHECK_EQUAL(view_main.Height(), main_length - 1);
+    BOOST_CHECK(view_main.Tip() == &vBlocksMain[main_length - 1]);
+    for (int i = 0; i < main_length; i++) {
+        BOOST_CHECK(view_main[i] == &vBlocksMain[i]);
+        BOOST_CHECK(view_main.Find(vHashMain[i]) == &vBlocksMain[i]);
+    }
+    BOOST_CHECK(view_main[main_length] == nullptr);
+    BOOST_CHECK(view_main.Find(vHashBranch[0]) == nullptr);
+    BOOST_CHECK(view_main.Next(&vBlocksMain[main_length - 1]) == nullptr);
+    BOOST_CHECK(view_main.Next(&vBlocksMain[fork_height]) == &vBlocksMain[fork_height + 1]);
+
+    // Reorg to the branch, the earlier view must not change
+    chain.SetTip(&vBlocksBranch[branch_length - 1]);
+    CChainView view_branch(chain, &view_main, nullptr);
+    BOOST_CHECK_EQUAL(view_branch.Height(), fork_height + branch_length);
+    for (int i = 0; i <= fork_height; i++) {
+        BOOST_CHECK(view_branch[i] == &vBlocksMain[i]);
+        BOOST_CHECK(view_branch.Find(vHashMain[i]) == &vBlocksMain[i]);
+    }
+    for (int i = fork_height + 1; i < main_length; i++) {
+        BOOST_CHECK(view_branch.Find(vHashMain[i]) == nullptr);
+        BOOST_CHECK(!view_branch.Contains(&vBlocksMain[i]));
+        BOOST_CHECK(view_main.Find(vHashMain[i]) == &vBlocksMain[i]);
+    }
+    for (int i = 0; i < branch_length; i++) {
+        BOOST_CHECK(view_branch[fork_height + 1 + i] == &vBlocksBranch[i]);
+        BOOST_CHECK(view_branch.Find(vHashBranch[i]) == &vBlocksBranch[i]);
+        BOOST_CHECK(view_main.Find(vHashBranch[i]) == nullptr);
+    }
+    BOOST_CHECK(view_branch.Next(&vBlocksMain[fork_height]) == &vBlocksBranch[0]);
+
+    // And back again
+    chain.SetTip(&vBlocksMain[main_length - 1]);
+    CChainView view_back(chain, &view_branch, nullptr);
+    for (int i = 0; i < main_length; i++) {
+        BOOST_CHECK(view_back.Find(vHashMain[i]) == &vBlocksMain[i]);
+    }
+    for (int i = 0; i < branch_length; i++) {
+        BOOST_CHECK(view_back.Find(vHashBranch[i]) == nullptr);
+    }
+    // Live views are counted so the block index isn't unloaded under one
+    BOOST_CHECK_EQUAL(CChainView::NumViews(), num_views + 4);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
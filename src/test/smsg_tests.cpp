@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <smsg/smessage.h>
+#include <smsg/iblt.h>
 
 #include <test/setup_common.h>
 #include <net.h>
@@ -37,6 +38,86 @@ BOOST_AUTO_TEST_CASE(smsg_test_ckeyId_inits_null)
     BOOST_CHECK(k.IsNull());
 }
 
+BOOST_AUTO_TEST_CASE(smsg_test_iblt)
+{
+    using smsg::SecMsgIBLT;
+
+    // Fixed samples, peeling can fail with low probability for random keys
+    std::vector<SecMsgIBLT::Key> vKeys;
+    for (uint64_t i = 0; i < 400; ++i) {
+        uint64_t sample = (i + 1) * 0x9e3779b97f4a7c15;
+        vKeys.emplace_back(1560000000 + i, (const uint8_t*)&sample);
+    }
+
+    // Tables share 350 keys, 20 only in a, 30 only in b
+    size_t num_cells = SecMsgIBLT::CellsForDifference(50);
+    SecMsgIBLT a(num_cells), b(num_cells);
+    for (size_t i = 0; i < 370; ++i) {
+        a.Insert(vKeys[i]);
+    }
+    for (size_t i = 20; i < 400; ++i) {
+        b.Insert(vKeys[i]);
+    }
+
+    std::vector<uint8_t> vchData;
+    b.Serialize(vchData);
+    BOOST_CHECK(vchData.size() == b.SerializeSize());
+
+    SecMsgIBLT c;
+    BOOST_CHECK(!c.Unserialize(vchData.data(), vchData.size() - 1, 4002));
+    BOOST_CHECK(!c.Unserialize(vchData.data(), vchData.size(), num_cells - 3));
+    BOOST_REQUIRE(c.Unserialize(vchData.data(), vchData.size(), 4002));
+    BOOST_CHECK(c.Size() == num_cells);
+
+    BOOST_REQUIRE(a.Subtract(c));
+    std::vector<SecMsgIBLT::Key> vHave, vMissing;
+    BOOST_REQUIRE(a.Decode(vHave, vMissing));
+    BOOST_CHECK(vHave.size() == 20);
+    BOOST_CHECK(vMissing.size() == 30);
+
+    std::set<SecMsgIBLT::Key> setHave(vHave.begin(), vHave.end()), setMissing(vMissing.begin(), vMissing.end());
+    for (size_t i = 0; i < 20; ++i) {
+        BOOST_CHECK(setHave.count(vKeys[i]));
+    }
+    for (size_t i = 370; i < 400; ++i) {
+        BOOST_CHECK(setMissing.count(vKeys[i]));
+    }
+
+    // Difference too large for the table
+    SecMsgIBLT d(SecMsgIBLT::CellsForDifference(0)), e(SecMsgIBLT::CellsForDifference(0));
+    for (size_t i = 0; i < 200; ++i) {
+        d.Insert(vKeys[i]);
+    }
+    BOOST_REQUIRE(d.Subtract(e));
+    vHave.clear();
+    vMissing.clear();
+    BOOST_CHECK(!d.Decode(vHave, vMissing));
+
+    SecMsgIBLT f(num_cells + 3);
+    BOOST_CHECK(!f.Subtract(c));
+
+    // A single key with a valid checksum placed in any one cell must not decode, or peel forever
+    SecMsgIBLT g(SecMsgIBLT::CellsForDifference(0));
+    vchData.clear();
+    g.Serialize(vchData);
+    int32_t count = 1;
+    uint32_t check = smsg::IBLTKeyCheck(vKeys[0]);
+    for (size_t i = 0; i < g.Size(); ++i) {
+        std::vector<uint8_t> vchForged = vchData;
+        uint8_t *p = &vchForged[4 + i * smsg::SMSG_IBLT_CELL_LEN];
+        memcpy(p, &count, 4);
+        memcpy(p+4, vKeys[0].data, smsg::SMSG_IBLT_KEY_LEN);
+        memcpy(p+4+smsg::SMSG_IBLT_KEY_LEN, &check, 4);
+
+        SecMsgIBLT h;
+        BOOST_REQUIRE(h.Unserialize(vchForged.data(), vchForged.size(), 4002));
+        vHave.clear();
+        vMissing.clear();
+        BOOST_CHECK(!h.Decode(vHave, vMissing));
+        BOOST_CHECK(vHave.size() + vMissing.size() <= h.Size());
+    }
+}
+
 #ifdef ENABLE_WALLET
 
 void CheckValid(smsg::SecureMessage &smsg, CKeyID &kFrom, CKeyID &kTo, bool expect_pass)
@@ -17,6 +17,7 @@
 #include <insight/insight.h>
 #include <chainparams.h>
 
+#include <algorithm>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -162,6 +163,27 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
+bool CCoinsViewDB::WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin> >& coins, const uint256& hashBlock)
+{
+    CDBBatch batch(db);
+    // Keep the database marked as mid transition until the whole snapshot is written,
+    // an interrupted load can't be mistaken for a usable chainstate.
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, uint256()});
+    for (const auto& it : coins) {
+        batch.Write(CoinEntry(&it.first), it.second);
+    }
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::FinishSnapshot(const uint256& hashBlock)
+{
+    CDBBatch batch(db);
+    batch.Erase(DB_HEAD_BLOCKS);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+    return db.WriteBatch(batch, true);
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, bool compression, int maxOpenFiles) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe, false, compression, maxOpenFiles)
 {
 }
@@ -193,14 +215,46 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
        that restriction.  */
     i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
+    i->CacheKey();
+    return i;
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewDB::PartitionedCursors(size_t n_partitions) const
+{
+    n_partitions = std::max<size_t>(1, std::min<size_t>(n_partitions, 256));
+
+    // Separate iterators would each see the state at the time they were created
+    std::shared_ptr<const CDBSnapshot> snapshot = db.GetSnapshot();
+    uint256 hashBestChain;
+    if (!db.Read(DB_BEST_BLOCK, hashBestChain, snapshot.get())) {
+        hashBestChain.SetNull();
+    }
+
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    for (size_t k = 0; k < n_partitions; ++k) {
+        int begin_byte = (int)(k * 256 / n_partitions);
+        int end_byte = (int)((k + 1) * 256 / n_partitions);
+        CCoinsViewDBCursor *i = new CCoinsViewDBCursor(snapshot, const_cast<CDBWrapper&>(db).NewIterator(snapshot.get()), hashBestChain, end_byte);
+        cursors.emplace_back(i);
+
+        COutPoint start;
+        *start.hash.begin() = (unsigned char)begin_byte;
+        start.n = 0;
+        i->pcursor->Seek(CoinEntry(&start));
+        i->CacheKey();
+    }
+    return cursors;
+}
+
+void CCoinsViewDBCursor::CacheKey()
+{
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) ||
+        (m_end_byte < 256 && *keyTmp.second.hash.begin() >= m_end_byte)) {
+        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
     } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+        keyTmp.first = entry.key;
     }
-    return i;
 }
 
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
@@ -231,12 +285,7 @@ bool CCoinsViewDBCursor::Valid() const
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
-    CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
-    } else {
-        keyTmp.first = entry.key;
-    }
+    CacheKey();
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -251,8 +300,8 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value, const CDBSnapshot *snapshot) {
+    return Read(std::make_pair(DB_SPENTINDEX, key), value, snapshot);
 }
 
 bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
@@ -280,8 +329,9 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
-    const std::unique_ptr<CDBIterator> pcursor(NewIterator());
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CDBSnapshot *snapshot) {
+    const std::unique_ptr<CDBIterator> pcursor(NewIterator(snapshot));
 
     pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
 
@@ -320,8 +370,8 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
-    const std::unique_ptr<CDBIterator> pcursor(NewIterator());
+                                    int start, int end, const CDBSnapshot *snapshot) {
+    const std::unique_ptr<CDBIterator> pcursor(NewIterator(snapshot));
 
     if (start > 0 && end > 0) {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
@@ -358,37 +408,20 @@ bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex)
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes)
+bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<std::pair<uint256, unsigned int> > &hashes, const CDBSnapshot *snapshot)
 {
-    const std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    const std::unique_ptr<CDBIterator> pcursor(NewIterator(snapshot));
 
     pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
 
-    if (fActiveOnly) {
-        LockAssertion lock(::cs_main); // cs_main is locked before GetTimestampIndex if fActiveOnly
-        while (pcursor->Valid()) {
-            boost::this_thread::interruption_point();
-            std::pair<char, CTimestampIndexKey> key;
-            if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
-                if (HashOnchainActive(key.second.blockHash)) {
-                    hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
-                }
-                pcursor->Next();
-            } else {
-                break;
-            }
-        }
-    } else {
-        // Otherwise get: requires holding mutex
-        while (pcursor->Valid()) {
-            boost::this_thread::interruption_point();
-            std::pair<char, CTimestampIndexKey> key;
-            if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
-                hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
-                pcursor->Next();
-            } else {
-                break;
-            }
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
+            hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
+            pcursor->Next();
+        } else {
+            break;
         }
     }
 
@@ -489,6 +522,15 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
     return true;
 }
 
+bool CBlockTreeDB::WriteSnapshotBlockIndex(const std::vector<std::pair<uint256, CDiskBlockIndex> >& entries)
+{
+    CDBBatch batch(*this);
+    for (const auto& it : entries) {
+        batch.Write(std::make_pair(DB_BLOCK_INDEX, it.first), it.second);
+    }
+    return WriteBatch(batch);
+}
+
 bool CBlockTreeDB::ReadRCTOutput(int64_t i, CAnonOutput &ao)
 {
     return Read(std::make_pair(DB_RCTOUTPUT, i), ao);
@@ -69,10 +69,16 @@ public:
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    //! Split the coins by the first byte of the txid, all cursors share one database snapshot
+    std::vector<std::unique_ptr<CCoinsViewCursor>> PartitionedCursors(size_t n_partitions) const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    //! Write coins loaded from a snapshot, the database is marked as in transition to hashBlock until FinishSnapshot is called.
+    bool WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin> >& coins, const uint256& hashBlock);
+    bool FinishSnapshot(const uint256& hashBlock);
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -91,8 +97,16 @@ public:
 private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
         CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(std::shared_ptr<const CDBSnapshot> snapshot, CDBIterator* pcursorIn, const uint256 &hashBlockIn, int end_byte):
+        CCoinsViewCursor(hashBlockIn), m_snapshot(std::move(snapshot)), pcursor(pcursorIn), m_end_byte(end_byte) {}
+    //! Declared before pcursor so the snapshot outlives the iterator reading it
+    std::shared_ptr<const CDBSnapshot> m_snapshot;
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! First txid byte past the range of this cursor, 256 for the end of the coins
+    int m_end_byte = 256;
+
+    void CacheKey();
 
     friend class CCoinsViewDB;
 };
@@ -109,24 +123,26 @@ public:
     bool WriteReindexing(bool fReindexing);
     void ReadReindexing(bool &fReindexing);
 
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value, const CDBSnapshot *snapshot = nullptr);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CDBSnapshot *snapshot = nullptr);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint256 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0, const CDBSnapshot *snapshot = nullptr);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
-    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
+    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<std::pair<uint256, unsigned int> > &vect, const CDBSnapshot *snapshot = nullptr);
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
     bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS);
 
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    bool WriteSnapshotBlockIndex(const std::vector<std::pair<uint256, CDiskBlockIndex> >& entries);
 
 
     bool ReadRCTOutput(int64_t i, CAnonOutput &ao);
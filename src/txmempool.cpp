@@ -1158,7 +1158,7 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
                 if (out->IsType(OUTPUT_CT))
                 {
                     coin.nType = OUTPUT_CT;
-                    coin.commitment = ((CTxOutCT*)out)->commitment;
+                    coin.SetCommitment(((CTxOutCT*)out)->commitment);
                 };
                 return true;
             };
@@ -10,12 +10,17 @@
 #include <hash.h>
 #include <util/validation.h>
 
+#include <atomic>
+
 namespace usb_device {
 
 const char *seed = "debug key";
 
 const size_t MAX_BIP32_PATH = 10;
 
+//! Public key requests answered, lets tests check which queries reached the device
+static std::atomic<int> nPublicKeyRequests{0};
+
 CDebugDevice::CDebugDevice()
 {
     pType = &usbDeviceTypes[USBDEVICE_DEBUG];
@@ -39,11 +44,13 @@ int CDebugDevice::GetInfo(UniValue &info, std::string &sError)
     ekOut.SetKey(ekv);
     info.pushKV("device", "debug");
     info.pushKV("extkey", ekOut.ToString());
+    info.pushKV("public_key_requests", nPublicKeyRequests.load());
     return 0;
 };
 
 int CDebugDevice::GetPubKey(const std::vector<uint32_t> &vPath, CPubKey &pk, std::string &sError)
 {
+    nPublicKeyRequests++;
     if (vPath.size() < 1 || vPath.size() > MAX_BIP32_PATH) {
         return errorN(1, sError, __func__, "Path depth out of range.");
     }
@@ -63,6 +70,7 @@ int CDebugDevice::GetPubKey(const std::vector<uint32_t> &vPath, CPubKey &pk, std
 
 int CDebugDevice::GetXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp, std::string &sError)
 {
+    nPublicKeyRequests++;
     if (vPath.size() < 1 || vPath.size() > MAX_BIP32_PATH) {
         return errorN(1, sError, __func__, "Path depth out of range.");
     }
@@ -75,6 +75,21 @@ static usb_device::CUSBDevice *SelectDevice(std::vector<std::unique_ptr<usb_devi
     return rv;
 };
 
+#ifdef ENABLE_WALLET
+/** Derive the key at vPath from a device account in the request's wallet instead of asking the device */
+static bool GetWalletDeviceXPub(const JSONRPCRequest &request, const std::vector<uint32_t> &vPath, CExtPubKey &ekp)
+{
+    std::shared_ptr<CWallet> wallet;
+    try {
+        wallet = GetWalletForJSONRPCRequest(request);
+    } catch (const UniValue&) {
+        return false; // No wallet loaded or the wallet is ambiguous
+    }
+    CHDWallet *const pwallet = GetParticlWallet(wallet.get());
+    return pwallet && pwallet->GetDeviceXPub(vPath, ekp);
+};
+#endif
+
 static UniValue deviceloadmnemonic(const JSONRPCRequest &request)
 {
             RPCHelpMan{"deviceloadmnemonic",
@@ -313,7 +328,8 @@ static UniValue getdeviceinfo(const JSONRPCRequest &request)
 static UniValue getdevicepublickey(const JSONRPCRequest &request)
 {
             RPCHelpMan{"getdevicepublickey",
-                "\nGet the public key and address at \"path\" from a hardware device.\n",
+                "\nGet the public key and address at \"path\" from a hardware device.\n"
+                "Keys below a hardware device account of the wallet are derived from the account's public key without contacting the device.\n",
                 {
                     {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "The path to the key to sign with.\n"
             "                           The full path is \"accountpath\"/\"path\"."},
@@ -339,13 +355,21 @@ static UniValue getdevicepublickey(const JSONRPCRequest &request)
     std::vector<uint32_t> vPath;
     GetPath(vPath, request.params[0], request.params[1]);
 
-    std::vector<std::unique_ptr<usb_device::CUSBDevice> > vDevices;
-    usb_device::CUSBDevice *pDevice = SelectDevice(vDevices);
-
-    std::string sError;
     CPubKey pk;
-    if (0 != pDevice->GetPubKey(vPath, pk, sError)) {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("GetPubKey failed %s.", sError));
+#ifdef ENABLE_WALLET
+    CExtPubKey ekp;
+    if (GetWalletDeviceXPub(request, vPath, ekp)) {
+        pk = ekp.pubkey;
+    } else
+#endif
+    {
+        std::vector<std::unique_ptr<usb_device::CUSBDevice> > vDevices;
+        usb_device::CUSBDevice *pDevice = SelectDevice(vDevices);
+
+        std::string sError;
+        if (0 != pDevice->GetPubKey(vPath, pk, sError)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("GetPubKey failed %s.", sError));
+        }
     }
 
     std::string sPath;
@@ -364,7 +388,8 @@ static UniValue getdevicepublickey(const JSONRPCRequest &request)
 static UniValue getdevicexpub(const JSONRPCRequest &request)
 {
             RPCHelpMan{"getdevicexpub",
-                "\nGet the extended public key at \"path\" from a hardware device.\n",
+                "\nGet the extended public key at \"path\" from a hardware device.\n"
+                "Keys below a hardware device account of the wallet are derived from the account's public key without contacting the device.\n",
                 {
                     {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "The path to the key to sign with.\n"
             "                           The full path is \"accountpath\"/\"path\"."},
@@ -383,13 +408,18 @@ static UniValue getdevicexpub(const JSONRPCRequest &request)
     std::vector<uint32_t> vPath;
     GetPath(vPath, request.params[0], request.params[1]);
 
-    std::vector<std::unique_ptr<usb_device::CUSBDevice> > vDevices;
-    usb_device::CUSBDevice *pDevice = SelectDevice(vDevices);
-
-    std::string sError;
     CExtPubKey ekp;
-    if (0 != pDevice->GetXPub(vPath, ekp, sError)) {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("GetXPub failed %s.", sError));
+#ifdef ENABLE_WALLET
+    if (!GetWalletDeviceXPub(request, vPath, ekp))
+#endif
+    {
+        std::vector<std::unique_ptr<usb_device::CUSBDevice> > vDevices;
+        usb_device::CUSBDevice *pDevice = SelectDevice(vDevices);
+
+        std::string sError;
+        if (0 != pDevice->GetXPub(vPath, ekp, sError)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("GetXPub failed %s.", sError));
+        }
     }
 
     return CBitcoinExtPubKey(ekp).ToString();
@@ -547,6 +577,14 @@ static UniValue devicesignrawtransaction(const JSONRPCRequest &request)
             usb_device::CPathKey pathkey;
             GetPath(pathkey.vPath, paths[idx], request.params[4]);
 
+#ifdef ENABLE_WALLET
+            CExtPubKey ekp;
+            if (pwallet && pwallet->GetDeviceXPub(pathkey.vPath, ekp)) {
+                pathkey.pk = ekp.pubkey;
+                tempKeystore.AddKey(pathkey);
+                continue;
+            }
+#endif
             std::string sError;
             if (0 != pDevice->GetPubKey(pathkey.vPath, pathkey.pk, sError)) {
                 throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Device GetPubKey failed %s.", sError));
@@ -45,6 +45,7 @@
 #include <util/translation.h>
 #include <util/validation.h>
 #include <validationinterface.h>
+#include <validationstats.h>
 #include <warnings.h>
 #include <smsg/smessage.h>
 #include <net.h>
@@ -53,6 +54,7 @@
 #include <rctindex.h>
 #include <insight/insight.h>
 
+#include <deque>
 #include <future>
 #include <sstream>
 #include <string>
@@ -125,6 +127,7 @@ Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 int nScriptCheckThreads = 0;
+int nBlockPrecheckThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 std::atomic_bool fSkipRangeproof(false);
@@ -150,6 +153,36 @@ CTxMemPool mempool(&feeEstimator);
 /** Constant stuff for coinbase transactions we create: */
 CScript COINBASE_FLAGS;
 
+static Mutex g_chain_view_mutex;
+static std::shared_ptr<const CChainView> g_chain_view GUARDED_BY(g_chain_view_mutex);
+
+std::shared_ptr<const CChainView> GetChainView()
+{
+    LOCK(g_chain_view_mutex);
+    return g_chain_view;
+}
+
+void PublishChainView()
+{
+    AssertLockHeld(cs_main);
+    std::shared_ptr<const CChainView> prev = GetChainView();
+    std::shared_ptr<const CChainView> view = std::make_shared<const CChainView>(::ChainActive(), prev.get(),
+        pblocktree ? pblocktree->GetSnapshot() : nullptr);
+
+    LOCK(g_chain_view_mutex);
+    g_chain_view = std::move(view);
+}
+
+void ResetChainView()
+{
+    {
+        LOCK(g_chain_view_mutex);
+        g_chain_view.reset();
+    }
+    // Views point into the block index and the block tree db, which are unloaded next
+    assert(CChainView::NumViews() == 0);
+}
+
 // Internal stuff
 namespace {
     CBlockIndex* pindexBestInvalid = nullptr;
@@ -608,6 +641,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
 
     const Consensus::Params &consensus = Params().GetConsensus();
     state.SetStateInfo(nAcceptTime, ::ChainActive().Height(), consensus);
+    state.m_cache_proofs = true;
 
     if (!CheckTransaction(tx, state))
         return false; // state filled in by CheckTransaction
@@ -1327,6 +1361,28 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadChainViewBlock(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    // fHavePruned only changes after startup when fPruneMode is set
+    if (fPruneMode || fHavePruned) {
+        // Keep the block file from being pruned until the block is read
+        LOCK(cs_main);
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            return error("%s: Block %s not available (pruned data)", __func__, pindex->GetBlockHash().ToString());
+        }
+        return ReadBlockFromDisk(block, pindex, consensusParams);
+    }
+
+    // The position of a connected block only changes when it's pruned
+    FlatFilePos blockPos(pindex->nFile, pindex->nDataPos);
+    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+        return false;
+    if (block.GetHash() != pindex->GetBlockHash())
+        return error("%s: GetHash() doesn't match index for %s at %s", __func__,
+                pindex->GetBlockHash().ToString(), blockPos.ToString());
+    return true;
+}
+
 bool ReadTransactionFromDiskBlock(const CBlockIndex* pindex, int nIndex, CTransactionRef &txOut)
 {
     FlatFilePos hpos;
@@ -1838,7 +1894,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         } else
         if (coin.nType == OUTPUT_CT) {
             vchAmount.resize(33);
-            memcpy(vchAmount.data(), coin.commitment.data, 33);
+            memcpy(vchAmount.data(), coin.GetCommitment().data, 33);
         }
 
         // Verify signature
@@ -2291,6 +2347,72 @@ void ThreadScriptCheck(int worker_num) {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Blocks received out of order during initial block download wait here for the
+ * context-independent checks, which run without cs_main. The worker owns the
+ * block until fn passes it on, so CBlock::fChecked can be set without a race.
+ */
+class CBlockPrecheckQueue
+{
+private:
+    boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    std::deque<std::pair<std::shared_ptr<const CBlock>, std::function<void()> > > m_queue;
+
+public:
+    bool Add(const std::shared_ptr<const CBlock>& pblock, std::function<void()> fn)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(m_mutex);
+            if (m_queue.size() >= MAX_BLOCK_PRECHECK_QUEUE) {
+                return false;
+            }
+            m_queue.emplace_back(pblock, std::move(fn));
+        }
+        m_cond.notify_one();
+        return true;
+    }
+
+    void Thread()
+    {
+        const Consensus::Params& consensus = Params().GetConsensus();
+        while (true) {
+            std::pair<std::shared_ptr<const CBlock>, std::function<void()> > item;
+            {
+                boost::unique_lock<boost::mutex> lock(m_mutex);
+                while (m_queue.empty()) {
+                    m_cond.wait(lock);
+                }
+                item = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+
+            CValidationState state;
+            if (!CheckBlock(*item.first, state, consensus)
+                || (state.nFlags & BLOCK_FAILED_DUPLICATE_STAKE)) {
+                // Leave the block unchecked, ProcessNewBlock repeats the checks and handles the failure
+                item.first->fChecked = false;
+            }
+            item.second();
+        }
+    }
+};
+
+static CBlockPrecheckQueue blockprecheckqueue;
+
+void ThreadBlockPrecheck(int worker_num) {
+    util::ThreadRename(strprintf("blkcheck.%i", worker_num));
+    blockprecheckqueue.Thread();
+}
+
+bool QueueBlockPrecheck(const std::shared_ptr<const CBlock>& pblock, std::function<void()> fn)
+{
+    if (nBlockPrecheckThreads < 1 || pblock->fChecked) {
+        return false;
+    }
+    return blockprecheckqueue.Add(pblock, std::move(fn));
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -2414,6 +2536,8 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
+//! Time spent writing the timestamp index in ConnectBlock, recorded with the address and spent index writes in FlushView
+static int64_t nTimeInsightPending = 0;
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
@@ -2442,6 +2566,18 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // is enforced in ContextualCheckBlockHeader(); we wouldn't want to
     // re-enforce that rule here (at least until we make it impossible for
     // GetAdjustedTime() to go backward).
+    // A block that passed CheckBlock before it was written to disk only needs the
+    // data read back tied to the header again, the witness merkle root covers the
+    // signatures and range proofs. Outside Particl mode the witness is only committed
+    // in the coinbase, so the block is checked in full.
+    if (fParticlMode && pindex->fBlockChecked && !block.fChecked && !fJustCheck) {
+        bool mutated, witness_mutated;
+        if (BlockMerkleRoot(block, &mutated) == block.hashMerkleRoot && !mutated
+            && BlockWitnessMerkleRoot(block, &witness_mutated) == block.hashWitnessMerkleRoot && !witness_mutated
+            && CheckBlockSignature(block)) {
+            block.fChecked = true;
+        }
+    }
     if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck, !fJustCheck)) {
         if (state.GetReason() == ValidationInvalidReason::BLOCK_MUTATED) {
             // We don't write down blocks to disk if they may have been
@@ -2511,6 +2647,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
+    if (!fJustCheck) RecordValidationStat(VSTAT_SANITY_CHECKS, nTime1 - nTimeStart);
     LogPrint(BCLog::BENCH, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
@@ -2580,6 +2717,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     unsigned int flags = GetBlockScriptFlags(pindex, chainparams.GetConsensus());
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
+    if (!fJustCheck) RecordValidationStat(VSTAT_FORK_CHECKS, nTime2 - nTime1);
     LogPrint(BCLog::BENCH, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
 
     CBlockUndo blockundo;
@@ -2830,6 +2968,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
+    if (!fJustCheck) RecordValidationStat(VSTAT_CONNECT_TXNS, nTime3 - nTime2);
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
 
     if (!control.Wait())
@@ -2843,6 +2982,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             const CAmount nCalculatedStakeReward = Params().GetProofOfStakeReward(pindex->pprev, nFees); // stake_test
 
             if (block.nTime >= consensus.smsg_fee_time) {
+                ValidationStatsTimer smsg_fee_timer(VSTAT_SMSG_FEE_CHECK, !fJustCheck);
                 CAmount smsg_fee_new, smsg_fee_prev;
                 if (pindex->pprev->nHeight > 0 // Skip genesis block (POW)
                     && pindex->pprev->nTime >= consensus.smsg_fee_time) {
@@ -2976,6 +3116,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
+    if (!fJustCheck) RecordValidationStat(VSTAT_VERIFY_TXINS, nTime4 - nTime2);
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
     if (fJustCheck)
@@ -2995,7 +3136,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
 
+    nTimeInsightPending = 0;
     if (fTimestampIndex) {
+        int64_t nTimeInsightStart = GetTimeMicros();
         unsigned int logicalTS = pindex->nTime;
         unsigned int prevLogicalTS = 0;
 
@@ -3018,6 +3161,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS))) {
             return AbortNode(state, "Failed to write blockhash index");
         }
+        nTimeInsightPending = GetTimeMicros() - nTimeInsightStart;
     }
 
     assert(pindex->phashBlock);
@@ -3025,9 +3169,11 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     view.SetBestBlock(pindex->GetBlockHash(), pindex->nHeight);
 
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
+    RecordValidationStat(VSTAT_INDEX_WRITING, nTime5 - nTime4);
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
 
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
+    RecordValidationStat(VSTAT_CALLBACKS, nTime6 - nTime5);
     LogPrint(BCLog::BENCH, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime5), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
 
     return true;
@@ -3180,6 +3326,7 @@ bool FlushView(CCoinsViewCache *view, CValidationState& state, bool fDisconnecti
     if (!view->Flush())
         return false;
 
+    int64_t nTimeStart = GetTimeMicros();
     if (fAddressIndex) {
         if (fDisconnecting) {
             if (!pblocktree->EraseAddressIndex(view->addressIndex)) {
@@ -3202,6 +3349,11 @@ bool FlushView(CCoinsViewCache *view, CValidationState& state, bool fDisconnecti
         }
     }
 
+    if (!fDisconnecting && (fAddressIndex || fSpentIndex || fTimestampIndex)) {
+        // One sample per connected block, including the timestamp index written in ConnectBlock
+        RecordValidationStat(VSTAT_INSIGHT_INDEX_WRITE, GetTimeMicros() - nTimeStart + nTimeInsightPending);
+        nTimeInsightPending = 0;
+    }
     view->addressIndex.clear();
     view->addressUnspentIndex.clear();
     view->spentIndex.clear();
@@ -3225,6 +3377,7 @@ bool FlushView(CCoinsViewCache *view, CValidationState& state, bool fDisconnecti
             }
         }
     } else {
+        ValidationStatsTimer rct_timer(VSTAT_RCT_INDEX_WRITE);
         CDBBatch batch(*pblocktree);
 
         for (auto &it : view->keyImages) {
@@ -3265,6 +3418,7 @@ void UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainParams)
 {
     // New best block
     mempool.AddTransactionsUpdated(1);
+    PublishChainView();
 
     {
         LOCK(g_best_block_mutex);
@@ -3463,6 +3617,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     const CBlock& blockConnecting = *pthisBlock;
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
+    RecordValidationStat(VSTAT_LOAD_BLOCK, nTime2 - nTime1);
     int64_t nTime3;
 
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
@@ -3479,11 +3634,13 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
             return error("%s: ConnectBlock %s failed, %s", __func__, pindexNew->GetBlockHash().ToString(), FormatStateMessage(state));
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
+        RecordValidationStat(VSTAT_CONNECT_TOTAL, nTime3 - nTime2);
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = FlushView(&view, state, false);
         assert(flushed);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
+    RecordValidationStat(VSTAT_FLUSH, nTime4 - nTime3);
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED))
@@ -3492,6 +3649,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         return false;
     }
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
+    RecordValidationStat(VSTAT_WRITE_CHAINSTATE, nTime5 - nTime4);
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
     // Remove conflicting transactions from the mempool.;
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
@@ -3501,6 +3659,10 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     UpdateTip(pindexNew, chainparams);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
+    RecordValidationStat(VSTAT_POST_CONNECT, nTime6 - nTime5);
+    RecordValidationStat(VSTAT_CONNECT_BLOCK, nTime6 - nTime1);
+    IncrementValidationCounter(VCOUNT_BLOCKS_CONNECTED);
+    IncrementValidationCounter(VCOUNT_TXNS_CONNECTED, blockConnecting.vtx.size());
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
 
@@ -5228,6 +5390,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
             return false;
         }
         ReceivedBlockTransactions(block, pindex, blockPos, chainparams.GetConsensus());
+        pindex->fBlockChecked = block.fChecked;
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error: ") + e.what());
     }
@@ -5321,6 +5484,8 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
     indexDummy.pprev = pindexPrev;
     indexDummy.nHeight = pindexPrev->nHeight + 1;
     indexDummy.phashBlock = &block_hash;
+    // Keep verified proofs cached for when the block is connected
+    state.m_cache_proofs = true;
 
     // NOTE: CheckBlockHeader is called by CheckBlock
     if (!ContextualCheckBlockHeader(block, state, chainparams, pindexPrev, GetAdjustedTime()))
@@ -5695,6 +5860,7 @@ bool CChainState::LoadChainTip(const CChainParams& chainparams)
     }
     m_chain.SetTip(pindex);
     PruneBlockIndexCandidates();
+    PublishChainView();
 
     tip = m_chain.Tip();
     LogPrintf("Loaded best chain: hashBestChain=%s height=%d date=%s progress=%f\n",
@@ -5746,7 +5912,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         uiInterface.ShowProgress(_("Verifying blocks...").translated, percentageDone, false);
         if (pindex->nHeight <= ::ChainActive().Height()-nCheckDepth)
             break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+        if ((fPruneMode || fHavePruned) && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
             // If pruning, only go back as far as we have data.
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
@@ -5985,7 +6151,7 @@ bool CChainState::RewindBlockIndex(const CChainParams& params)
             // Make sure nothing changed from under us (this won't happen because RewindBlockIndex runs before importing/network are active)
             assert(tip == m_chain.Tip());
             if (tip == nullptr || tip->nHeight < nHeight) break;
-            if (fPruneMode && !(tip->nStatus & BLOCK_HAVE_DATA)) {
+            if ((fPruneMode || fHavePruned) && !(tip->nStatus & BLOCK_HAVE_DATA)) {
                 // If pruning, don't try rewinding past the HAVE_DATA point;
                 // since older blocks can't be served anyway, there's
                 // no need to walk further, and trying to DisconnectTip()
@@ -6067,6 +6233,7 @@ void UnloadBlockIndex()
 {
     LOCK(cs_main);
     ::ChainActive().SetTip(nullptr);
+    ResetChainView();
     g_blockman.Unload();
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
@@ -26,6 +26,7 @@
 #include <atomic>
 #include <exception>
 #include <map>
+#include <functional>
 #include <memory>
 #include <set>
 #include <stdint.h>
@@ -81,6 +82,10 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -blockprecheckthreads default (threads running the context-independent block checks during initial block download, 0 = disabled) */
+static const int DEFAULT_BLOCK_PRECHECK_THREADS = 2;
+/** Maximum number of blocks waiting for a precheck thread */
+static const size_t MAX_BLOCK_PRECHECK_QUEUE = 128;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -170,6 +175,7 @@ extern std::atomic_bool fReindex;
 extern std::atomic_bool fSkipRangeproof;
 extern std::atomic_bool fBusyImporting;
 extern int nScriptCheckThreads;
+extern int nBlockPrecheckThreads;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
@@ -266,6 +272,8 @@ bool LoadBlockIndex(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck(int worker_num);
+/** Run an instance of the block precheck thread */
+void ThreadBlockPrecheck(int worker_num);
 /** Return the median number of blocks that other nodes claim to have */
 int GetNumBlocksOfPeers();
 /** Return the median number of connected nodes */
@@ -412,6 +420,8 @@ void InitScriptExecutionCache();
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read a block of a CChainView, cs_main is only taken, and held for the read, when blocks may be pruned */
+bool ReadChainViewBlock(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadTransactionFromDiskBlock(const CBlockIndex *pindex, int nIndex, CTransactionRef &txOut);
 
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start);
@@ -425,9 +435,18 @@ bool AddToMapStakeSeen(const COutPoint &kernel, const uint256 &blockHash) EXCLUS
 bool CheckStakeUnused(const COutPoint &kernel);
 bool CheckStakeUnique(const CBlock &block, bool fUpdate=true);
 
+bool CheckBlockSignature(const CBlock &block);
+
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
 
+/**
+ * Queue the context-independent checks of a block received out of order on the
+ * precheck threads, fn is called on the worker once they are done.
+ * Returns false if the block must be processed inline.
+ */
+bool QueueBlockPrecheck(const std::shared_ptr<const CBlock>& pblock, std::function<void()> fn);
+
 unsigned int GetNextTargetRequired(const CBlockIndex *pindexLast);
 
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
@@ -819,6 +838,15 @@ CChain& ChainActive();
 /** @returns the global block index map. */
 BlockMap& BlockIndex();
 
+/** @returns the last published view of the active chain, may be null before the chain is loaded. */
+std::shared_ptr<const CChainView> GetChainView();
+
+/** Publish a view of the active chain and a block tree db snapshot, called on each tip change. */
+void PublishChainView() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/** Drop the published view, must be called before the block index or block tree db are freed. Asserts that no other view is still held. */
+void ResetChainView();
+
 // Most often ::ChainstateActive() should be used instead of this, but some code
 // may not be able to assume that this has been initialized yet and so must use it
 // directly, e.g. init.cpp.
@@ -0,0 +1,145 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <validationstats.h>
+
+#include <univalue.h>
+
+#include <atomic>
+
+namespace {
+struct StageHistogram
+{
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_micros{0};
+    std::atomic<uint64_t> max_micros{0};
+    std::atomic<uint64_t> buckets[VSTAT_HISTOGRAM_BUCKETS];
+
+    StageHistogram()
+    {
+        for (auto &b : buckets) {
+            b = 0;
+        }
+    }
+};
+
+// Updated from the validation, script check and index threads, relaxed ordering
+// is enough as readers only need each value to be consistent with itself.
+StageHistogram g_stages[VSTAT_MAX_STAGES];
+std::atomic<uint64_t> g_counters[VCOUNT_MAX_COUNTERS];
+
+const char *stage_names[VSTAT_MAX_STAGES] = {
+    "sanity_checks",
+    "fork_checks",
+    "connect_txns",
+    "verify_txins",
+    "index_writing",
+    "callbacks",
+    "load_block",
+    "connect_total",
+    "flush",
+    "write_chainstate",
+    "post_connect",
+    "connect_block",
+    "mlsag_verify",
+    "rangeproof_verify",
+    "rct_index_write",
+    "insight_index_write",
+    "cs_index_write",
+    "smsg_fee_check",
+};
+
+const char *counter_names[VCOUNT_MAX_COUNTERS] = {
+    "blocks_connected",
+    "txns_connected",
+    "mlsag_cache_hits",
+    "rangeproof_cache_hits",
+};
+
+int GetBucket(uint64_t micros)
+{
+    int n = 0;
+    while (micros > 0 && n < VSTAT_HISTOGRAM_BUCKETS - 1) {
+        micros >>= 1;
+        n++;
+    }
+    return n;
+}
+
+uint64_t TakeValue(std::atomic<uint64_t> &v, bool reset)
+{
+    return reset ? v.exchange(0, std::memory_order_relaxed) : v.load(std::memory_order_relaxed);
+}
+} // namespace
+
+const char *ValidationStatsStageName(ValidationStatsStage stage)
+{
+    return stage < VSTAT_MAX_STAGES ? stage_names[stage] : "unknown";
+}
+
+const char *ValidationStatsCounterName(ValidationStatsCounter counter)
+{
+    return counter < VCOUNT_MAX_COUNTERS ? counter_names[counter] : "unknown";
+}
+
+void RecordValidationStat(ValidationStatsStage stage, int64_t micros)
+{
+    if (stage >= VSTAT_MAX_STAGES) {
+        return;
+    }
+    uint64_t v = micros > 0 ? micros : 0;
+    StageHistogram &h = g_stages[stage];
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.total_micros.fetch_add(v, std::memory_order_relaxed);
+    h.buckets[GetBucket(v)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t prev_max = h.max_micros.load(std::memory_order_relaxed);
+    while (v > prev_max && !h.max_micros.compare_exchange_weak(prev_max, v, std::memory_order_relaxed));
+}
+
+void IncrementValidationCounter(ValidationStatsCounter counter, uint64_t n)
+{
+    if (counter >= VCOUNT_MAX_COUNTERS) {
+        return;
+    }
+    g_counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void ValidationStatsToJSON(UniValue &obj, bool reset)
+{
+    UniValue stages(UniValue::VOBJ);
+    for (int i = 0; i < VSTAT_MAX_STAGES; ++i) {
+        StageHistogram &h = g_stages[i];
+        UniValue stage(UniValue::VOBJ);
+        uint64_t count = TakeValue(h.count, reset);
+        uint64_t total = TakeValue(h.total_micros, reset);
+        stage.pushKV("count", count);
+        stage.pushKV("total_us", total);
+        stage.pushKV("mean_us", count > 0 ? total / count : 0);
+        stage.pushKV("max_us", TakeValue(h.max_micros, reset));
+
+        UniValue histogram(UniValue::VARR);
+        for (int b = 0; b < VSTAT_HISTOGRAM_BUCKETS; ++b) {
+            uint64_t n = TakeValue(h.buckets[b], reset);
+            if (n == 0) {
+                continue;
+            }
+            UniValue bucket(UniValue::VOBJ);
+            if (b < VSTAT_HISTOGRAM_BUCKETS - 1) {
+                bucket.pushKV("lt_us", (uint64_t)1 << b);
+            }
+            bucket.pushKV("count", n);
+            histogram.push_back(bucket);
+        }
+        stage.pushKV("histogram", histogram);
+        stages.pushKV(stage_names[i], stage);
+    }
+    obj.pushKV("stages", stages);
+
+    UniValue counters(UniValue::VOBJ);
+    for (int i = 0; i < VCOUNT_MAX_COUNTERS; ++i) {
+        counters.pushKV(counter_names[i], TakeValue(g_counters[i], reset));
+    }
+    obj.pushKV("counters", counters);
+}
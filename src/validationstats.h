@@ -0,0 +1,73 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_VALIDATIONSTATS_H
+#define PARTICL_VALIDATIONSTATS_H
+
+#include <util/time.h>
+
+#include <stdint.h>
+
+class UniValue;
+
+/** Timed stages of block validation */
+enum ValidationStatsStage {
+    // ConnectBlock
+    VSTAT_SANITY_CHECKS = 0,
+    VSTAT_FORK_CHECKS,
+    VSTAT_CONNECT_TXNS,
+    VSTAT_VERIFY_TXINS,
+    VSTAT_INDEX_WRITING,
+    VSTAT_CALLBACKS,
+    // ConnectTip
+    VSTAT_LOAD_BLOCK,
+    VSTAT_CONNECT_TOTAL,
+    VSTAT_FLUSH,
+    VSTAT_WRITE_CHAINSTATE,
+    VSTAT_POST_CONNECT,
+    VSTAT_CONNECT_BLOCK,
+    // Particl, MLSAG and rangeproof verifications of transactions entering the mempool or a block template aren't counted
+    VSTAT_MLSAG_VERIFY,
+    VSTAT_RANGEPROOF_VERIFY,
+    VSTAT_RCT_INDEX_WRITE,
+    VSTAT_INSIGHT_INDEX_WRITE,
+    VSTAT_CS_INDEX_WRITE,
+    VSTAT_SMSG_FEE_CHECK,
+    VSTAT_MAX_STAGES,
+};
+
+enum ValidationStatsCounter {
+    VCOUNT_BLOCKS_CONNECTED = 0,
+    VCOUNT_TXNS_CONNECTED,
+    VCOUNT_MLSAG_CACHE_HITS,
+    VCOUNT_RANGEPROOF_CACHE_HITS,
+    VCOUNT_MAX_COUNTERS,
+};
+
+/** Latency histogram buckets, bucket n counts durations below 2^n microseconds, the last bucket is unbounded */
+static const int VSTAT_HISTOGRAM_BUCKETS = 28;
+
+const char *ValidationStatsStageName(ValidationStatsStage stage);
+const char *ValidationStatsCounterName(ValidationStatsCounter counter);
+
+/** Add a duration in microseconds to the histogram of stage */
+void RecordValidationStat(ValidationStatsStage stage, int64_t micros);
+void IncrementValidationCounter(ValidationStatsCounter counter, uint64_t n = 1);
+
+/** Records the time from construction until it goes out of scope, if enabled */
+class ValidationStatsTimer
+{
+private:
+    ValidationStatsStage m_stage;
+    int64_t m_start;
+
+public:
+    explicit ValidationStatsTimer(ValidationStatsStage stage, bool enabled = true) : m_stage(stage), m_start(enabled ? GetTimeMicros() : -1) {}
+    ~ValidationStatsTimer() { if (m_start >= 0) RecordValidationStat(m_stage, GetTimeMicros() - m_start); }
+};
+
+/** Write the histograms and counters to obj, if reset is set they are cleared after being read */
+void ValidationStatsToJSON(UniValue &obj, bool reset = false);
+
+#endif // PARTICL_VALIDATIONSTATS_H
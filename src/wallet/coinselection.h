@@ -43,6 +43,10 @@ public:
         m_input_bytes = input_bytes;
     }
 
+    //! For outputs without a plain txout, blinded and anon values are known only to the wallet
+    CInputCoin(const COutPoint& outpoint_in, const CTxOut& txout_in, int input_bytes)
+        : outpoint(outpoint_in), txout(txout_in), effective_value(txout_in.nValue), m_input_bytes(input_bytes) {}
+
     COutPoint outpoint;
     CTxOut txout;
     CAmount effective_value;
@@ -533,7 +533,7 @@ void BerkeleyEnvironment::CheckpointLSN(const std::string& strFile)
 }
 
 
-BerkeleyBatch::BerkeleyBatch(BerkeleyDatabase& database, const char* pszMode, bool fFlushOnCloseIn) : pdb(nullptr), activeTxn(nullptr)
+BerkeleyBatch::BerkeleyBatch(BerkeleyDatabase& database, const char* pszMode, bool fFlushOnCloseIn) : pdb(nullptr), activeTxn(nullptr), m_database(&database)
 {
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
     fFlushOnClose = fFlushOnCloseIn;
@@ -614,7 +614,7 @@ BerkeleyBatch::BerkeleyBatch(BerkeleyDatabase& database, const char* pszMode, bo
 
 void BerkeleyBatch::Flush()
 {
-    if (activeTxn)
+    if (activeTxn || GetGroupTxn())
         return;
 
     // Flush database activity from memory pool to disk log
@@ -636,6 +636,8 @@ void BerkeleyBatch::Close()
 {
     if (!pdb)
         return;
+    if (activeTxn && activeTxn == m_database->m_group_txn)
+        m_database->m_group_txn = nullptr;
     if (activeTxn)
         activeTxn->abort();
     activeTxn = nullptr;
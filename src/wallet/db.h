@@ -18,6 +18,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -88,10 +89,10 @@ public:
     void CloseDb(const std::string& strFile);
     void ReloadDbEnv();
 
-    DbTxn* TxnBegin(int flags = DB_TXN_WRITE_NOSYNC)
+    DbTxn* TxnBegin(int flags = DB_TXN_WRITE_NOSYNC, DbTxn* parent = nullptr)
     {
         DbTxn* ptxn = nullptr;
-        int ret = dbenv->txn_begin(nullptr, &ptxn, flags);
+        int ret = dbenv->txn_begin(parent, &ptxn, flags);
         if (!ptxn || ret != 0)
             return nullptr;
         return ptxn;
@@ -188,6 +189,17 @@ public:
     /** Database pointer. This is initialized lazily and reset during flushes, so it can be null. */
     std::unique_ptr<Db> m_db;
 
+    /**
+     * Transaction started with BerkeleyBatch::TxnBeginGroup, null if none is open.
+     * While it is open every batch on this database used by the thread that began it
+     * reads and writes inside it and transactions begun by TxnBegin on that thread are
+     * nested in it, so bulk updates such as a rescan reach the disk in one commit.
+     * Batches on other threads are not part of it, the caller holds the wallet lock
+     * while the group is open so no other writer waits on it for long.
+     */
+    std::atomic<DbTxn*> m_group_txn{nullptr};
+    std::atomic<std::thread::id> m_group_thread{};
+
 private:
     std::string strFile;
 
@@ -228,6 +240,7 @@ public:
     Db* pdb;
     std::string strFile;
     DbTxn* activeTxn;
+    BerkeleyDatabase* m_database;
     bool fReadOnly;
     bool fFlushOnClose;
     BerkeleyEnvironment *env;
@@ -251,6 +264,19 @@ public:
     /* verifies the database file */
     static bool VerifyDatabaseFile(const fs::path& file_path, std::string& warningStr, std::string& errorStr, BerkeleyEnvironment::recoverFunc_type recoverFunc);
 
+    /** The database's group transaction if this thread began it, otherwise null */
+    DbTxn* GetGroupTxn() const
+    {
+        DbTxn* ptxn = m_database->m_group_txn;
+        return ptxn && m_database->m_group_thread.load() == std::this_thread::get_id() ? ptxn : nullptr;
+    }
+
+    /** Transaction operations run in, this batch's own or the group transaction of this thread */
+    DbTxn* GetTxn() const
+    {
+        return activeTxn ? activeTxn : GetGroupTxn();
+    }
+
     template <typename K, typename T>
     bool Read(const K& key, T& value, uint32_t nFlags=0)
     {
@@ -265,7 +291,7 @@ public:
 
         // Read
         SafeDbt datValue;
-        int ret = pdb->get(activeTxn, datKey, datValue, nFlags);
+        int ret = pdb->get(GetTxn(), datKey, datValue, nFlags);
         bool success = false;
         if (datValue.get_data() != nullptr) {
             // Unserialize value
@@ -301,7 +327,7 @@ public:
         SafeDbt datValue(ssValue.data(), ssValue.size());
 
         // Write
-        int ret = pdb->put(activeTxn, datKey, datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
+        int ret = pdb->put(GetTxn(), datKey, datValue, (fOverwrite ? 0 : DB_NOOVERWRITE));
         return (ret == 0);
     }
 
@@ -320,7 +346,7 @@ public:
         SafeDbt datKey(ssKey.data(), ssKey.size());
 
         // Erase
-        int ret = pdb->del(activeTxn, datKey, 0);
+        int ret = pdb->del(GetTxn(), datKey, 0);
         return (ret == 0 || ret == DB_NOTFOUND);
     }
 
@@ -337,7 +363,7 @@ public:
         SafeDbt datKey(ssKey.data(), ssKey.size());
 
         // Exists
-        int ret = pdb->exists(activeTxn, datKey, 0);
+        int ret = pdb->exists(GetTxn(), datKey, 0);
         return (ret == 0);
     }
 
@@ -346,7 +372,7 @@ public:
         if (!pdb)
             return nullptr;
         Dbc* pcursor = nullptr;
-        int ret = pdb->cursor(nullptr, &pcursor, 0);
+        int ret = pdb->cursor(GetTxn(), &pcursor, 0);
         if (ret != 0)
             return nullptr;
         return pcursor;
@@ -386,10 +412,24 @@ public:
     {
         if (!pdb || activeTxn)
             return false;
+        DbTxn* ptxn = env->TxnBegin(DB_TXN_WRITE_NOSYNC, GetGroupTxn());
+        if (!ptxn)
+            return false;
+        activeTxn = ptxn;
+        return true;
+    }
+
+    /** Begin a transaction every batch on the database used by this thread joins until it is committed or aborted */
+    bool TxnBeginGroup()
+    {
+        if (!pdb || activeTxn || m_database->m_group_txn)
+            return false;
         DbTxn* ptxn = env->TxnBegin();
         if (!ptxn)
             return false;
         activeTxn = ptxn;
+        m_database->m_group_thread = std::this_thread::get_id();
+        m_database->m_group_txn = ptxn;
         return true;
     }
 
@@ -397,7 +437,11 @@ public:
     {
         if (!pdb || !activeTxn)
             return false;
-        int ret = activeTxn->commit(0);
+        // A group commit is the point the batched writes become durable, sync it to the log
+        bool fGroup = activeTxn == m_database->m_group_txn;
+        if (fGroup)
+            m_database->m_group_txn = nullptr;
+        int ret = activeTxn->commit(fGroup ? DB_TXN_SYNC : 0);
         activeTxn = nullptr;
         return (ret == 0);
     }
@@ -406,6 +450,8 @@ public:
     {
         if (!pdb || !activeTxn)
             return false;
+        if (activeTxn == m_database->m_group_txn)
+            m_database->m_group_txn = nullptr;
         int ret = activeTxn->abort();
         activeTxn = nullptr;
         return (ret == 0);
@@ -165,7 +165,7 @@ void CHDWallet::AddOptions()
     gArgs.AddArg("-createdefaultmasterkey", strprintf("Generate a random master key and main account if no master key exists. (default: %s)", "false"), ArgsManager::ALLOW_ANY, OptionsCategory::PART_WALLET);
 
     gArgs.AddArg("-staking", "Stake your coins to support network and gain reward (default: true)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
-    gArgs.AddArg("-stakingthreads", "Number of threads to start for staking, max 1 per active wallet, will divide wallets evenly between threads (default: 1)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
+    gArgs.AddArg("-stakingthreads", "Number of threads to start for staking, max 1 per active wallet, each free thread searches the next wallet waiting in the current slot (default: 1)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
     gArgs.AddArg("-minstakeinterval=<n>", "Minimum time in seconds between successful stakes (default: 0)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
     gArgs.AddArg("-minersleep=<n>", "Milliseconds between stake attempts. Lowering this param will not result in more stakes. (default: 500)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
     gArgs.AddArg("-reservebalance=<amount>", "Ensure available balance remains above reservebalance. (default: 0)", ArgsManager::ALLOW_ANY, OptionsCategory::PART_STAKING);
@@ -219,7 +219,7 @@ bool CHDWallet::Initialise()
         //We can't rescan beyond non-pruned blocks, stop and throw an error
         //this might happen if a user uses an old wallet within a pruned node
         // or if he ran -disablewallet for a longer time, then decided to re-enable
-        if (fPruneMode)
+        if (chain().havePruned())
         {
             int block_height = *tip_height;
             while (block_height > 0 && locked_chain->haveBlockOnDisk(block_height - 1) && rescan_height != block_height) {
@@ -871,6 +871,8 @@ bool CHDWallet::LoadTxRecords(CHDWalletDB *pwdb)
 
         CTransactionRecord data;
         ssValue >> data;
+        // Narrations are read from the database when requested
+        data.UnloadNarrations();
         LoadToWallet(txhash, data);
         nCount++;
     }
@@ -2854,7 +2856,7 @@ void CHDWallet::AddOutputRecordMetaData(CTransactionRecord &rtx, std::vector<CTe
             }
             rec.nType = r.nType;
             rec.nValue = r.nAmount;
-            rec.sNarration = r.sNarration;
+            rec.SetNarration(r.sNarration);
             rec.scriptPubKey = r.scriptPubKey;
             rtx.InsertOutput(rec);
         } else
@@ -2869,7 +2871,7 @@ void CHDWallet::AddOutputRecordMetaData(CTransactionRecord &rtx, std::vector<CTe
             if (r.fChange && HaveAddress(r.address)) {
                 rec.nFlags |= ORF_CHANGE;
             }
-            rec.sNarration = r.sNarration;
+            rec.SetNarration(r.sNarration);
 
             ParseAddressForMetaData(r.address, rec);
 
@@ -2885,7 +2887,7 @@ void CHDWallet::AddOutputRecordMetaData(CTransactionRecord &rtx, std::vector<CTe
             if (r.fChange && HaveAddress(r.address)) {
                 rec.nFlags |= ORF_CHANGE;
             }
-            rec.sNarration = r.sNarration;
+            rec.SetNarration(r.sNarration);
 
             ParseAddressForMetaData(r.address, rec);
 
@@ -4207,6 +4209,70 @@ int CHDWallet::AddStandardInputs(interfaces::Chain::Lock& locked_chain, CWalletT
     return 0;
 };
 
+//! Ring members are referenced by their index in the anon output table, size estimates assume indices this large
+static const uint64_t ANON_INDEX_SIZE_ESTIMATE = 1 << 20;
+
+int GetBlindedInputBytes(const CHDWallet &wallet, const CCoinControl *coinControl, const COutPoint &prevout, const CScript &scriptPubKey)
+{
+    CTxIn txin(prevout, CScript(), CTxIn::SEQUENCE_FINAL - 1);
+    SignatureData sigdata;
+    std::map<COutPoint, CInputData>::const_iterator it = coinControl->m_inputData.find(prevout);
+    if (it != coinControl->m_inputData.end()) {
+        sigdata.scriptWitness = it->second.scriptWitness;
+    } else
+    if (!ProduceSignature(wallet, DUMMY_SIGNATURE_CREATOR_PARTICL, scriptPubKey, sigdata)) {
+        return -1;
+    }
+    UpdateInput(txin, sigdata);
+    return (GetTransactionInputWeight(txin) + WITNESS_SCALE_FACTOR - 1) / WITNESS_SCALE_FACTOR;
+};
+
+int GetAnonInputBytes(size_t nRingSize, size_t nInputsPerSig)
+{
+    CTxIn txin;
+    txin.nSequence = CTxIn::SEQUENCE_FINAL;
+    txin.prevout.n = COutPoint::ANON_MARKER;
+    txin.SetAnonInfo(nInputsPerSig, nRingSize);
+
+    std::vector<uint8_t> vPubkeyMatrixIndices;
+    for (size_t i = 0; i < nInputsPerSig * nRingSize; ++i) {
+        PutVarInt(vPubkeyMatrixIndices, ANON_INDEX_SIZE_ESTIMATE);
+    }
+    txin.scriptData.stack.emplace_back(33 * nInputsPerSig); // Key images
+    txin.scriptWitness.stack.emplace_back(vPubkeyMatrixIndices);
+    txin.scriptWitness.stack.emplace_back((1 + (nInputsPerSig + 1) * nRingSize) * 32 + 33); // MLSAG, split commitment
+
+    int64_t nDivisor = nInputsPerSig * WITNESS_SCALE_FACTOR;
+    return (GetTransactionInputWeight(txin) + nDivisor - 1) / nDivisor;
+};
+
+/**
+ * Fill the branch and bound parameters from a first pass built with any inputs: the size of all but the
+ * inputs, and the cost of change, which counts only spending it later as the change output is always added.
+ */
+static void SetBnBParams(const CHDWallet &wallet, const CCoinControl &coin_control, const CMutableTransaction &txNew, unsigned int nBytes,
+    const std::vector<int> &vInputBytes, CoinSelectionParams &coin_selection_params)
+{
+    int64_t nInputsWeight = 0;
+    for (const auto &txin : txNew.vin) {
+        nInputsWeight += GetTransactionInputWeight(txin);
+    }
+    coin_selection_params.tx_noinputs_size = std::max((int64_t)1, (int64_t)nBytes - nInputsWeight / WITNESS_SCALE_FACTOR);
+
+    int64_t nTotalBytes = 0, nCoins = 0;
+    for (int n : vInputBytes) {
+        if (n > 0) {
+            nTotalBytes += n;
+            nCoins++;
+        }
+    }
+    coin_selection_params.change_spend_size = nCoins > 0 ? nTotalBytes / nCoins : 0;
+    coin_selection_params.change_output_size = 0;
+
+    FeeCalculation feeCalc;
+    coin_selection_params.effective_fee = GetMinimumFeeRate(wallet, coin_control, &feeCalc);
+};
+
 int CHDWallet::AddBlindedInputs(interfaces::Chain::Lock& locked_chain, CWalletTx &wtx, CTransactionRecord &rtx,
     std::vector<CTempRecipient> &vecSend,
     CExtKeyAccount *sea, CStoredExtKey *pc,
@@ -4253,6 +4319,18 @@ int CHDWallet::AddBlindedInputs(interfaces::Chain::Lock& locked_chain, CWalletTx
         std::vector<COutputR> vAvailableCoins;
         AvailableBlindedCoins(*locked_chain, vAvailableCoins, true, coinControl);
 
+        // Branch and bound needs the size of the outputs, the first pass measures them
+        CoinSelectionParams coin_selection_params;
+        coin_selection_params.use_bnb = nSubtractFeeFromAmount == 0 && !coinControl->HasSelected();
+        std::vector<int> vInputBytes;
+        if (coin_selection_params.use_bnb) {
+            for (const auto &r : vAvailableCoins) {
+                const COutputRecord *oR = r.rtx->second.GetOutput(r.i);
+                vInputBytes.push_back(oR ? GetBlindedInputBytes(*this, coinControl, COutPoint(r.txhash, r.i), oR->scriptPubKey) : -1);
+            }
+        }
+        bool bnb_used = false;
+
         CAmount nValueOutPlain = 0;
         int nChangePosInOut = -1;
 
@@ -4275,12 +4353,22 @@ int CHDWallet::AddBlindedInputs(interfaces::Chain::Lock& locked_chain, CWalletTx
             if (pick_new_inputs) {
                 nValueIn = 0;
                 setCoins.clear();
-                if (!SelectBlindedCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl)) {
+                bnb_used = false;
+                if (coin_selection_params.use_bnb && coin_selection_params.tx_noinputs_size > 0) {
+                    coin_selection_params.use_bnb = false;
+                    bnb_used = SelectBlindedCoinsBnB(vAvailableCoins, vInputBytes, nValue, coin_selection_params, setCoins, nValueIn);
+                }
+                if (!bnb_used && !SelectBlindedCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl)) {
                     return wserrorN(1, sError, __func__, _("Insufficient funds.").translated);
                 }
             }
 
-            const CAmount nChange = nValueIn - nValueToSelect;
+            CAmount nChange = nValueIn - nValueToSelect;
+            if (bnb_used) {
+                // The selection pays the fee, any excess is moved to the change output once the fee is known
+                nFeeRet = nValueIn - nValue;
+                nChange = 0;
+            }
 
             // Remove fee outputs from last round
             for (int i = 0; i < (int) vecSend.size(); ++i) {
@@ -4421,6 +4509,13 @@ int CHDWallet::AddBlindedInputs(interfaces::Chain::Lock& locked_chain, CWalletTx
                 return wserrorN(1, sError, __func__, _("Transaction too large for fee policy.").translated);
             }
 
+            if (coin_selection_params.use_bnb && coin_selection_params.tx_noinputs_size == 0) {
+                // First pass, select again by branch and bound now the outputs are sized
+                SetBnBParams(*this, *coinControl, txNew, nBytes, vInputBytes, coin_selection_params);
+                nFeeRet = nFeeNeeded;
+                continue;
+            }
+
             if (nFeeRet >= nFeeNeeded) {
                 // Reduce fee to only the needed amount if possible. This
                 // prevents potential overpayment in fees if the coins
@@ -4987,6 +5082,18 @@ int CHDWallet::AddAnonInputs(interfaces::Chain::Lock& locked_chain, CWalletTx &w
         std::vector<COutputR> vAvailableCoins;
         AvailableAnonCoins(locked_chain, vAvailableCoins, true, coinControl);
 
+        // Anon inputs stay randomly selected, a selection driven by amounts makes the real inputs of the
+        // rings easier to guess. Leave out coins worth less than the fee for the key image, ring member
+        // indices and MLSAG columns they add, spending them lowers the value available.
+        {
+            FeeCalculation feeCalc;
+            CAmount nInputFee = GetMinimumFeeRate(*this, *coinControl, &feeCalc).GetFee(GetAnonInputBytes(nRingSize, nInputsPerSig));
+            vAvailableCoins.erase(std::remove_if(vAvailableCoins.begin(), vAvailableCoins.end(), [nInputFee](const COutputR &r) {
+                const COutputRecord *oR = r.rtx->second.GetOutput(r.i);
+                return oR && oR->nValue <= nInputFee;
+            }), vAvailableCoins.end());
+        }
+
         CAmount nValueOutPlain = 0;
         int nChangePosInOut = -1;
 
@@ -5534,6 +5641,13 @@ int CHDWallet::AddAnonInputs(interfaces::Chain::Lock& locked_chain, CWalletTx &w
     return 0;
 };
 
+void CHDWallet::MarkDirty()
+{
+    CWallet::MarkDirty();
+    LOCK(cs_wallet);
+    m_tx_query_index.Clear();
+};
+
 void CHDWallet::ClearCachedBalances()
 {
     // Clear cache when a new txn is added to the wallet or a block is added or removed from the chain.
@@ -5570,6 +5684,7 @@ void CHDWallet::LoadToWallet(const uint256 &hash, const CTransactionRecord &rtx)
 
     MapRecords_t::iterator mri = ret.first;
     rtxOrdered.insert(std::make_pair(rtx.GetTxTime(), mri));
+    m_record_coin_index.MarkStale(hash);
 
     // TODO: Spend only owned inputs?
 
@@ -5626,16 +5741,274 @@ int CHDWallet::UnloadTransaction(const uint256 &hash)
             ++it;
         }
 
+        // The index reads the txid of its rows through the records
+        m_record_coin_index.Remove(hash);
         mapRecords.erase(itr);
     } else {
         WalletLogPrintf("Warning: %s - tx not found in wallet! %s.\n", __func__, hash.ToString());
         return 1;
     }
 
+    m_tx_query_index.MarkStale(hash);
+    m_record_coin_index.MarkStale(hash);
+
     NotifyTransactionChanged(this, hash, CT_DELETED);
     return 0;
 };
 
+static void AddTxQueryAddress(TxQueryEntry &entry, const std::string &address)
+{
+    if (std::find(entry.vAddresses.begin(), entry.vAddresses.end(), address) == entry.vAddresses.end()) {
+        entry.vAddresses.push_back(address);
+    }
+};
+
+void CHDWallet::GetTxQueryEntry(interfaces::Chain::Lock& locked_chain, const CWalletTx &wtx, TxQueryEntry &entry) const
+{
+    // Category, amount and addresses as filtertransactions lists them
+    std::list<COutputEntry> listReceived, listSent, listStaked;
+    CAmount nFee, amount = 0;
+    wtx.GetAmounts(listReceived, listSent, listStaked, nFee, ISMINE_ALL, true);
+
+    entry.fRecord = false;
+    entry.nTime = wtx.GetTxTime();
+    entry.nTypes = TXQ_TYPE_STANDARD;
+
+    CBitcoinAddress addr;
+    if (!listStaked.empty()) {
+        entry.nCategory = TXQ_CAT_STAKE;
+        for (const auto &s : listStaked) {
+            if (addr.Set(s.destination)) {
+                AddTxQueryAddress(entry, addr.ToString());
+            }
+        }
+        amount = -nFee;
+    } else {
+        for (const auto &s : listSent) {
+            if (addr.Set(s.destination)) {
+                AddTxQueryAddress(entry, addr.ToString());
+            }
+            amount -= s.amount;
+        }
+        for (const auto &r : listReceived) {
+            if (addr.Set(r.destination)) {
+                AddTxQueryAddress(entry, addr.ToString());
+            }
+            amount += r.amount;
+        }
+
+        if (wtx.IsCoinBase()) {
+            entry.nCategory = TXQ_CAT_COINBASE;
+        } else if (!nFee) {
+            entry.nCategory = TXQ_CAT_RECEIVE;
+        } else if (amount == 0) {
+            entry.nCategory = TXQ_CAT_INTERNAL_TRANSFER;
+        } else {
+            entry.nCategory = TXQ_CAT_SEND;
+            if (nFee < 0) {
+                amount = wtx.GetCredit(locked_chain, ISMINE_ALL) - wtx.GetDebit(ISMINE_ALL);
+            }
+        }
+    }
+
+    CAmount sort_amount = entry.nCategory == TXQ_CAT_SEND ? -amount : amount;
+    entry.nSortAmount[0] = sort_amount;
+    entry.nSortAmount[1] = sort_amount;
+};
+
+void CHDWallet::GetTxQueryEntry(const CTransactionRecord &rtx, TxQueryEntry &entry) const
+{
+    // Category, amount and addresses as filtertransactions lists them
+    size_t nOwned = 0, nFrom = 0, nOutputs = 0;
+    CAmount totalAmount = 0;
+
+    entry.fRecord = true;
+    entry.nTime = rtx.nTimeReceived;
+    entry.nTypes = 0;
+
+    for (const auto &record : rtx.vout) {
+        if (record.nFlags & ORF_CHANGE) {
+            continue;
+        }
+        nOutputs++;
+        if (record.nFlags & ORF_OWN_ANY) {
+            nOwned++;
+        }
+        if (record.nFlags & ORF_FROM) {
+            nFrom++;
+        }
+
+        CTxDestination dest;
+        bool extracted = ExtractDestination(record.scriptPubKey, dest);
+
+        CStealthAddress sx;
+        if (record.vPath.size() > 0) {
+            if (record.vPath[0] == ORA_STEALTH && record.vPath.size() >= 5) {
+                uint32_t sidx;
+                memcpy(&sidx, &record.vPath[1], 4);
+                if (GetStealthByIndex(sidx, sx)) {
+                    AddTxQueryAddress(entry, sx.Encoded());
+                }
+            }
+        } else
+        if (extracted && dest.type() == typeid(PKHash)) {
+            CKeyID idK = CKeyID(boost::get<PKHash>(dest));
+            if (GetStealthLinked(idK, sx)) {
+                AddTxQueryAddress(entry, sx.Encoded());
+            }
+        }
+        if (extracted && dest.type() != typeid(CNoDestination)) {
+            AddTxQueryAddress(entry, CBitcoinAddress(dest).ToString());
+        }
+
+        switch (record.nType) {
+            case OUTPUT_STANDARD: entry.nTypes |= TXQ_TYPE_STANDARD; break;
+            case OUTPUT_CT: entry.nTypes |= TXQ_TYPE_BLIND; break;
+            case OUTPUT_RINGCT: entry.nTypes |= TXQ_TYPE_ANON; break;
+            default: break;
+        }
+
+        totalAmount += (record.nFlags & ORF_OWN_ANY) ? record.nValue : -record.nValue;
+    }
+    if (rtx.nFlags & ORF_BLIND_IN) {
+        entry.nTypes |= TXQ_TYPE_BLIND;
+    }
+    if (rtx.nFlags & ORF_ANON_IN) {
+        entry.nTypes |= TXQ_TYPE_ANON;
+    }
+
+    entry.nCategory = nOwned && nFrom ? TXQ_CAT_INTERNAL_TRANSFER
+                    : nOwned ? TXQ_CAT_RECEIVE
+                    : nFrom ? TXQ_CAT_SEND
+                    : TXQ_CAT_UNKNOWN;
+
+    const isminefilter filters[2] = {ISMINE_SPENDABLE, ISMINE_SPENDABLE | ISMINE_WATCH_ONLY};
+    for (size_t i = 0; i < 2; ++i) {
+        CAmount amount = totalAmount;
+        if (nOwned && nFrom && nOwned != nOutputs) {
+            // Must check against the owned input value
+            CAmount nInput = 0, nOutput = 0;
+            for (const auto &vin : rtx.vin) {
+                if (vin.IsAnonInput()) {
+                    continue;
+                }
+                nInput += GetOwnedOutputValue(vin, filters[i]);
+            }
+            for (const auto &record : rtx.vout) {
+                if ((record.nFlags & ORF_OWNED && filters[i] & ISMINE_SPENDABLE)
+                    || (record.nFlags & ORF_OWN_WATCH && filters[i] & ISMINE_WATCH_ONLY)) {
+                    nOutput += record.nValue;
+                }
+            }
+            amount = nOutput - nInput;
+        }
+        entry.nSortAmount[i] = entry.nCategory == TXQ_CAT_SEND ? -amount : amount;
+    }
+};
+
+void CHDWallet::UpdateTxQueryIndex(interfaces::Chain::Lock& locked_chain)
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!m_tx_query_index.IsBuilt()) {
+        m_tx_query_index.Clear();
+        for (const auto &mi : mapWallet) {
+            TxQueryEntry entry;
+            GetTxQueryEntry(locked_chain, mi.second, entry);
+            m_tx_query_index.Put(mi.first, std::move(entry));
+        }
+        for (const auto &mi : mapRecords) {
+            TxQueryEntry entry;
+            GetTxQueryEntry(mi.second, entry);
+            m_tx_query_index.Put(mi.first, std::move(entry));
+        }
+        m_tx_query_index.SetBuilt();
+        return;
+    }
+
+    std::set<uint256> stale = m_tx_query_index.TakeStale();
+    if (stale.empty()) {
+        return;
+    }
+
+    // The amounts of transactions spending a changed transaction depend on it
+    std::set<uint256> update = stale;
+    for (const auto &hash : stale) {
+        for (auto it = mapTxSpends.lower_bound(COutPoint(hash, 0)); it != mapTxSpends.end() && it->first.hash == hash; ++it) {
+            update.insert(it->second);
+        }
+    }
+
+    for (const auto &hash : update) {
+        MapWallet_t::const_iterator itw;
+        MapRecords_t::const_iterator itr;
+        TxQueryEntry entry;
+        if ((itw = mapWallet.find(hash)) != mapWallet.end()) {
+            GetTxQueryEntry(locked_chain, itw->second, entry);
+        } else
+        if ((itr = mapRecords.find(hash)) != mapRecords.end()) {
+            GetTxQueryEntry(itr->second, entry);
+        } else {
+            m_tx_query_index.Remove(hash);
+            continue;
+        }
+        m_tx_query_index.Put(hash, std::move(entry));
+    }
+};
+
+void CHDWallet::UpdateRecordCoinIndex() const
+{
+    AssertLockHeld(cs_wallet);
+
+    std::vector<MapRecords_t::const_iterator> update;
+    if (!m_record_coin_index.IsBuilt()) {
+        m_record_coin_index.Clear();
+        for (auto it = mapRecords.begin(); it != mapRecords.end(); ++it) {
+            update.push_back(it);
+        }
+        m_record_coin_index.SetBuilt();
+    } else {
+        for (const auto &hash : m_record_coin_index.TakeStale()) {
+            auto it = mapRecords.find(hash);
+            if (it == mapRecords.end()) {
+                m_record_coin_index.Remove(hash);
+                continue;
+            }
+            update.push_back(it);
+        }
+    }
+
+    for (const auto &it : update) {
+        const uint256 &hash = it->first;
+        m_record_coin_index.Put(hash, it);
+
+        // Set the spent hints
+        for (auto mi = mapTxSpends.lower_bound(COutPoint(hash, 0)); mi != mapTxSpends.end() && mi->first.hash == hash; ++mi) {
+            m_record_coin_index.MarkSpent(mi->first);
+        }
+        for (auto mi = m_collapsed_txn_inputs.lower_bound(COutPoint(hash, 0)); mi != m_collapsed_txn_inputs.end() && mi->hash == hash; ++mi) {
+            m_record_coin_index.MarkSpent(*mi);
+        }
+    }
+    m_record_coin_index.Sort();
+};
+
+std::string CHDWallet::GetOutputNarration(const uint256 &txhash, const CTransactionRecord &rtx, const COutputRecord &r) const
+{
+    if (!rtx.fNarrationsUnloaded || !r.GetNarration().empty()) {
+        return r.GetNarration();
+    }
+
+    CHDWalletDB wdb(*database, "r");
+    CTransactionRecord rtxStored;
+    const COutputRecord *pout;
+    if (!wdb.ReadTxRecord(txhash, rtxStored)
+        || !(pout = rtxStored.GetOutput(r.n))) {
+        return "";
+    }
+    return pout->GetNarration();
+};
+
 int CHDWallet::GetDefaultConfidentialChain(CHDWalletDB *pwdb, CExtKeyAccount *&sea, CStoredExtKey *&pc)
 {
     pc = nullptr;
@@ -8171,6 +8544,49 @@ bool CHDWallet::GetFullChainPath(const CExtKeyAccount *pa, size_t nChain, std::v
     return true;
 };
 
+bool CHDWallet::GetDeviceXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekpOut) const
+{
+    LOCK(cs_wallet);
+
+    // Find the deepest device chain on the path, a shallower one can't avoid a hardened step either
+    const CStoredExtKey *sekBest = nullptr;
+    size_t nBestDepth = 0;
+    std::vector<uint32_t> vChainPath;
+    for (const auto &mi : mapExtAccounts) {
+        const CExtKeyAccount *sea = mi.second;
+        if (!(sea->nFlags & EAF_HARDWARE_DEVICE)) {
+            continue;
+        }
+        for (size_t i = 0; i < sea->vExtKeys.size(); ++i) {
+            const CStoredExtKey *sek = sea->vExtKeys[i];
+            if (!(sek->nFlags & EAF_HARDWARE_DEVICE)
+                || !sek->kp.IsValidP()
+                || !GetFullChainPath(sea, i, vChainPath)
+                || vChainPath.size() != sek->kp.nDepth // Path doesn't lead from the device root
+                || vChainPath.size() > vPath.size()
+                || (sekBest && vChainPath.size() <= nBestDepth)
+                || !std::equal(vChainPath.begin(), vChainPath.end(), vPath.begin())) {
+                continue;
+            }
+            sekBest = sek;
+            nBestDepth = vChainPath.size();
+        }
+    }
+    if (!sekBest) {
+        return false;
+    }
+
+    CExtPubKey ekp = sekBest->kp.GetExtPubKey(), ekpChild;
+    for (size_t k = nBestDepth; k < vPath.size(); ++k) {
+        if (IsHardened(vPath[k]) || !ekp.Derive(ekpChild, vPath[k])) {
+            return false;
+        }
+        ekp = ekpChild;
+    }
+    ekpOut = ekp;
+    return true;
+};
+
 bool CHDWallet::FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nChangePosInOut, std::string& strFailReason, bool lockUnspents, const std::set<int>& setSubtractFeeFromOutputs, CCoinControl coinControl)
 {
     std::vector<CTempRecipient> vecSend;
@@ -8948,6 +9364,8 @@ bool CHDWallet::ProcessLockedBlindedOutputs()
             }
 
             setChanged.insert(op.hash);
+            m_tx_query_index.MarkStale(op.hash);
+            m_record_coin_index.MarkStale(op.hash);
         }
 
         nExpanded++;
@@ -9583,6 +10001,7 @@ int CHDWallet::UnloadSpent(const uint256 &wtxid, int depth, const uint256 &wtxid
     for (const CTxIn &txin : thisTx.tx->vin) {
         if (m_collapsed_txns.find(txin.prevout.hash) == m_collapsed_txns.end()) {
             m_collapsed_txn_inputs.insert(txin.prevout);
+            m_record_coin_index.MarkSpent(txin.prevout);
             mapTxCollapsedSpends[wtxid_from].insert(txin.prevout.hash);
         }
     }
@@ -9641,11 +10060,18 @@ void CHDWallet::PostProcessUnloadSpent()
     }
 };
 
+void CHDWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
+{
+    CWallet::AddToSpends(outpoint, wtxid);
+    m_record_coin_index.MarkSpent(outpoint);
+};
+
 void CHDWallet::AddToSpends(const uint256& wtxid)
 {
     auto it = mapWallet.find(wtxid);
     assert(it != mapWallet.end());
     CWalletTx& thisTx = it->second;
+    m_tx_query_index.MarkStale(wtxid);
     if (thisTx.IsCoinBase()) // Coinbases don't spend anything!
         return;
 
@@ -9894,7 +10320,7 @@ int CHDWallet::OwnStandardOut(const CTxOutStandard *pout, const CTxOutData *pdat
         }
 
         if (sNarr.length() > 0) {
-            rout.sNarration = sNarr;
+            rout.SetNarration(sNarr);
         }
     }
 
@@ -10059,7 +10485,11 @@ int CHDWallet::OwnBlindOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOu
             return werrorN(0, "%s: secp256k1_bulletproof_rangeproof_rewind failed.", __func__);
         }
 
-        ExtractNarration(nonce, pout->vData, rout.sNarration);
+        std::string sNarr;
+        ExtractNarration(nonce, pout->vData, sNarr);
+        if (sNarr.length() > 0) {
+            rout.SetNarration(sNarr);
+        }
     } else
     if (1 != secp256k1_rangeproof_rewind(secp256k1_ctx_blind,
         blindOut, &amountOut, msg, &mlen, nonce.begin(),
@@ -10074,7 +10504,7 @@ int CHDWallet::OwnBlindOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOu
 
     size_t nNarr = strlen((const char*)msg);
     if (nNarr > 0) {
-        rout.sNarration.assign((const char*)msg, nNarr);
+        rout.SetNarration(std::string((const char*)msg, nNarr));
     }
 
     rout.nValue = amountOut;
@@ -10159,7 +10589,11 @@ int CHDWallet::OwnAnonOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOut
             return werrorN(0, "%s: secp256k1_bulletproof_rangeproof_rewind failed.", __func__);
         }
 
-        ExtractNarration(nonce, pout->vData, rout.sNarration);
+        std::string sNarr;
+        ExtractNarration(nonce, pout->vData, sNarr);
+        if (sNarr.length() > 0) {
+            rout.SetNarration(sNarr);
+        }
     } else
     if (1 != secp256k1_rangeproof_rewind(secp256k1_ctx_blind,
         blindOut, &amountOut, msg, &mlen, nonce.begin(),
@@ -10173,7 +10607,7 @@ int CHDWallet::OwnAnonOut(CHDWalletDB *pwdb, const uint256 &txhash, const CTxOut
     msg[mlen-1] = '\0';
     size_t nNarr = strlen((const char*)msg);
     if (nNarr > 0) {
-        rout.sNarration.assign((const char*)msg, nNarr);
+        rout.SetNarration(std::string((const char*)msg, nNarr));
     }
 
     if (rout.vPath.size() == 0) {
@@ -10488,6 +10922,11 @@ bool CHDWallet::AddToRecord(CTransactionRecord &rtxIn, const CTransaction &tx,
         }
     }
 
+    if (fInsertedNew || fUpdated) {
+        m_tx_query_index.MarkStale(txhash);
+        m_record_coin_index.MarkStale(txhash);
+    }
+
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, txhash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -11030,8 +11469,14 @@ void CHDWallet::AvailableBlindedCoins(interfaces::Chain::Lock& locked_chain, std
     // a coin control object is provided, and has the avoid address reuse flag set to false, do we allow already used addresses
     bool allow_used_addresses = !IsWalletFlagSet(WALLET_FLAG_AVOID_REUSE) || (coinControl && !coinControl->m_avoid_address_reuse);
 
-    for (MapRecords_t::const_iterator it = mapRecords.begin(); it != mapRecords.end(); ++it) {
-        const uint256 &txid = it->first;
+    UpdateRecordCoinIndex();
+    const RecordCoinIndex &index = m_record_coin_index;
+    for (uint32_t t : index.Order()) {
+        if (!index.TxHasType(t, OUTPUT_CT)) {
+            continue;
+        }
+        const uint256 &txid = index.TxHash(t);
+        MapRecords_t::const_iterator it = index.TxRecord(t);
         const CTransactionRecord &rtx = it->second;
 
         // TODO: implement when moving coinbase and coinstake txns to mapRecords
@@ -11063,45 +11508,48 @@ void CHDWallet::AvailableBlindedCoins(interfaces::Chain::Lock& locked_chain, std
             continue;
         }
 
-        for (const auto &r : rtx.vout) {
-            if (r.nType != OUTPUT_CT) {
+        // The index holds owned outputs only
+        for (uint32_t o = index.OutputsBegin(t); o < index.OutputsEnd(t); ++o) {
+            if (index.OutputType(o) != OUTPUT_CT) {
                 continue;
             }
+            uint16_t n = index.OutputN(o);
+            uint8_t nFlags = index.OutputFlags(o);
+            CAmount nValue = index.OutputValue(o);
 
-            if (!(r.nFlags & ORF_OWN_ANY)) {
-                continue;
-            }
-
-            if (IsSpent(locked_chain, txid, r.n)) {
+            if (index.OutputSpent(o) && IsSpent(locked_chain, txid, n)) {
                 continue;
             }
 
-            if (r.nValue < nMinimumAmount || r.nValue > nMaximumAmount) {
+            if (nValue < nMinimumAmount || nValue > nMaximumAmount) {
                 continue;
             }
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(txid, r.n))) {
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(txid, n))) {
                 continue;
             }
 
             if ((!coinControl || !coinControl->fAllowLocked)
-                && IsLockedCoin(txid, r.n)) {
+                && IsLockedCoin(txid, n)) {
                 continue;
             }
 
-            if (!allow_used_addresses && IsUsedDestination(&r.scriptPubKey)) {
-                continue;
+            if (!allow_used_addresses) {
+                const COutputRecord *pout = rtx.GetOutput(n);
+                if (pout && IsUsedDestination(&pout->scriptPubKey)) {
+                    continue;
+                }
             }
 
             bool fMature = true;
-            bool fSpendable = (coinControl && !coinControl->fAllowWatchOnly && !(r.nFlags & ORF_OWNED)) ? false : true;
+            bool fSpendable = (coinControl && !coinControl->fAllowWatchOnly && !(nFlags & ORF_OWNED)) ? false : true;
             bool fSolvable = true;
-            bool fNeedHardwareKey = (r.nFlags & ORF_HARDWARE_DEVICE);
+            bool fNeedHardwareKey = (nFlags & ORF_HARDWARE_DEVICE);
 
-            vCoins.emplace_back(txid, it, r.n, nDepth, fSpendable, fSolvable, safeTx, fMature, fNeedHardwareKey);
+            vCoins.emplace_back(txid, it, n, nDepth, fSpendable, fSolvable, safeTx, fMature, fNeedHardwareKey);
 
             if (nMinimumSumAmount != MAX_MONEY) {
-                nTotal += r.nValue;
+                nTotal += nValue;
 
                 if (nTotal >= nMinimumSumAmount) {
                     return;
@@ -11249,6 +11697,63 @@ bool CHDWallet::SelectBlindedCoins(const std::vector<COutputR> &vAvailableCoins,
     return res;
 };
 
+bool CHDWallet::SelectBlindedCoinsBnB(const std::vector<COutputR> &vAvailableCoins, const std::vector<int> &vInputBytes, const CAmount &nTargetValue,
+    const CoinSelectionParams &coin_selection_params, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet) const
+{
+    assert(vAvailableCoins.size() == vInputBytes.size());
+    setCoinsRet.clear();
+    nValueRet = 0;
+
+    // Get long term estimate
+    FeeCalculation feeCalc;
+    CCoinControl temp;
+    temp.m_confirm_target = 1008;
+    CFeeRate long_term_feerate = GetMinimumFeeRate(*this, temp, &feeCalc);
+
+    CAmount cost_of_change = GetDiscardRate(*this).GetFee(coin_selection_params.change_spend_size) + coin_selection_params.effective_fee.GetFee(coin_selection_params.change_output_size);
+
+    std::vector<OutputGroup> utxo_pool;
+    std::map<COutPoint, MapRecords_t::const_iterator> mapCoinRecords;
+    for (size_t i = 0; i < vAvailableCoins.size(); ++i) {
+        const COutputR &r = vAvailableCoins[i];
+        // Confirmed coins only, as the first pass of SelectCoinsMinConf
+        if (r.nDepth < 1 || vInputBytes[i] < 0) {
+            continue;
+        }
+        const COutputRecord *oR = r.rtx->second.GetOutput(r.i);
+        if (!oR) {
+            continue;
+        }
+        CAmount fee = coin_selection_params.effective_fee.GetFee(vInputBytes[i]);
+        if (oR->nValue - fee <= 0) {
+            continue;
+        }
+
+        CInputCoin coin(COutPoint(r.txhash, r.i), CTxOut(oR->nValue, oR->scriptPubKey), vInputBytes[i]);
+        OutputGroup group(coin, r.nDepth, true, 0, 0);
+        group.fee = fee;
+        group.long_term_fee = long_term_feerate.GetFee(vInputBytes[i]);
+        group.effective_value = oR->nValue - fee;
+        utxo_pool.push_back(group);
+        mapCoinRecords.emplace(coin.outpoint, r.rtx);
+    }
+
+    CAmount not_input_fees = coin_selection_params.effective_fee.GetFee(coin_selection_params.tx_noinputs_size);
+    std::set<CInputCoin> setCoins;
+    if (!SelectCoinsBnB(utxo_pool, nTargetValue, cost_of_change, setCoins, nValueRet, not_input_fees)) {
+        return false;
+    }
+
+    for (const auto &coin : setCoins) {
+        setCoinsRet.push_back(std::make_pair(mapCoinRecords[coin.outpoint], coin.outpoint.n));
+    }
+    random_shuffle(setCoinsRet.begin(), setCoinsRet.end(), GetRandInt);
+
+    LogPrint(BCLog::HDWALLET, "%s: Selected %d inputs by branch and bound, value %d, fee rate %s.\n",
+        __func__, setCoinsRet.size(), nValueRet, coin_selection_params.effective_fee.ToString());
+    return true;
+};
+
 void CHDWallet::AvailableAnonCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutputR> &vCoins, bool fOnlySafe, const CCoinControl *coinControl, const CAmount& nMinimumAmount, const CAmount& nMaximumAmount, const CAmount& nMinimumSumAmount, const uint64_t& nMaximumCount) const
 {
     AssertLockHeld(cs_main);
@@ -11262,8 +11767,14 @@ void CHDWallet::AvailableAnonCoins(interfaces::Chain::Lock& locked_chain, std::v
     const bool fIncludeImmature = {coinControl ? coinControl->m_include_immature : false};
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
-    for (MapRecords_t::const_iterator it = mapRecords.begin(); it != mapRecords.end(); ++it) {
-        const uint256 &txid = it->first;
+    UpdateRecordCoinIndex();
+    const RecordCoinIndex &index = m_record_coin_index;
+    for (uint32_t t : index.Order()) {
+        if (!index.TxHasType(t, OUTPUT_RINGCT)) {
+            continue;
+        }
+        const uint256 &txid = index.TxHash(t);
+        MapRecords_t::const_iterator it = index.TxRecord(t);
         const CTransactionRecord &rtx = it->second;
 
         // TODO: implement when moving coinbase and coinstake txns to mapRecords
@@ -11289,41 +11800,44 @@ void CHDWallet::AvailableAnonCoins(interfaces::Chain::Lock& locked_chain, std::v
             continue;
         }
 
-        for (const auto &r : rtx.vout) {
-            if (r.nType != OUTPUT_RINGCT) {
+        for (uint32_t o = index.OutputsBegin(t); o < index.OutputsEnd(t); ++o) {
+            if (index.OutputType(o) != OUTPUT_RINGCT) {
                 continue;
             }
+            uint16_t n = index.OutputN(o);
+            uint8_t nFlags = index.OutputFlags(o);
+            CAmount nValue = index.OutputValue(o);
 
-            if (!(r.nFlags & ORF_OWNED)) {
+            if (!(nFlags & ORF_OWNED)) {
                 continue;
             }
 
-            if (IsSpent(locked_chain, txid, r.n)) {
+            if (index.OutputSpent(o) && IsSpent(locked_chain, txid, n)) {
                 continue;
             }
 
-            if (r.nValue < nMinimumAmount || r.nValue > nMaximumAmount) {
+            if (nValue < nMinimumAmount || nValue > nMaximumAmount) {
                 continue;
             }
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(txid, r.n))) {
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(txid, n))) {
                 continue;
             }
 
             if ((!coinControl || !coinControl->fAllowLocked)
-                && IsLockedCoin(txid, r.n)) {
+                && IsLockedCoin(txid, n)) {
                 continue;
             }
 
             bool fMature = true;
-            bool fSpendable = (coinControl && !coinControl->fAllowWatchOnly && !(r.nFlags & ORF_OWNED)) ? false : true;
+            bool fSpendable = (coinControl && !coinControl->fAllowWatchOnly && !(nFlags & ORF_OWNED)) ? false : true;
             bool fSolvable = true;
-            bool fNeedHardwareKey = (r.nFlags & ORF_HARDWARE_DEVICE);
+            bool fNeedHardwareKey = (nFlags & ORF_HARDWARE_DEVICE);
 
-            vCoins.emplace_back(txid, it, r.n, nDepth, fSpendable, fSolvable, safeTx, fMature, fNeedHardwareKey);
+            vCoins.emplace_back(txid, it, n, nDepth, fSpendable, fSolvable, safeTx, fMature, fNeedHardwareKey);
 
             if (nMinimumSumAmount != MAX_MONEY) {
-                nTotal += r.nValue;
+                nTotal += nValue;
 
                 if (nTotal >= nMinimumSumAmount) {
                     return;
@@ -8,6 +8,8 @@
 #include <wallet/wallet.h>
 #include <wallet/hdwalletdb.h>
 #include <wallet/hdwallettypes.h>
+#include <wallet/recordcoinindex.h>
+#include <wallet/txqueryindex.h>
 
 #include <key_io.h>
 #include <key/extkey.h>
@@ -246,6 +248,18 @@ public:
     void RemoveFromTxSpends(const uint256 &hash, const CTransactionRef pt) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int UnloadTransaction(const uint256 &hash) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /** Fill the filtertransactions index entry of a transaction or record */
+    void GetTxQueryEntry(interfaces::Chain::Lock& locked_chain, const CWalletTx &wtx, TxQueryEntry &entry) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void GetTxQueryEntry(const CTransactionRecord &rtx, TxQueryEntry &entry) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Build m_tx_query_index on first use, then recompute the entries of changed transactions */
+    void UpdateTxQueryIndex(interfaces::Chain::Lock& locked_chain) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Also drops m_tx_query_index, what is mine may have changed */
+    void MarkDirty() override;
+    /** Build m_record_coin_index on first use, then replace the rows of changed records */
+    void UpdateRecordCoinIndex() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Narration of an output of a record, read from the stored record if it was not loaded */
+    std::string GetOutputNarration(const uint256 &txhash, const CTransactionRecord &rtx, const COutputRecord &r) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     int GetDefaultConfidentialChain(CHDWalletDB *pwdb, CExtKeyAccount *&sea, CStoredExtKey *&pc);
 
     int MakeDefaultAccount();
@@ -325,6 +339,13 @@ public:
 
     bool GetFullChainPath(const CExtKeyAccount *pa, size_t nChain, std::vector<uint32_t> &vPath) const;
 
+    /**
+     * Derive the extended public key at a full hardware device path from the chains of the
+     * wallet's device accounts, so path queries don't need a round trip to the device.
+     * Fails if vPath doesn't extend the path of a device chain by non-hardened steps only.
+     */
+    bool GetDeviceXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekpOut) const;
+
     /**
      * Insert additional inputs into the transaction by
      * calling CreateTransaction();
@@ -367,7 +388,7 @@ public:
     int UnloadSpent(const uint256 &wtxid, int depth, const uint256 &wtxid_from);
     void PostProcessUnloadSpent();
 
-    using CWallet::AddToSpends;
+    void AddToSpends(const COutPoint& outpoint, const uint256& wtxid) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void AddToSpends(const uint256& wtxid) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool AddToWalletIfInvolvingMe(const CTransactionRef& ptx, CWalletTx::Status status, const uint256& block_hash, int posInBlock, bool fUpdate) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
@@ -404,6 +425,15 @@ public:
 
     void AvailableBlindedCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutputR>& vCoins, bool fOnlySafe=true, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t& nMaximumCount = 0) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool SelectBlindedCoins(const std::vector<COutputR>& vAvailableCoins, const CAmount& nTargetValue, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet, const CCoinControl *coinControl = nullptr, bool random_selection = false) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /**
+     * Branch and bound over blinded or anon coins, each coin valued at its amount less the fee for
+     * the vInputBytes[i] it adds as an input. An anon input carries a key image, ring member indices
+     * and MLSAG columns for every ring member, so with larger rings fewer inputs are preferred.
+     * Succeeds only if a selection exceeds the target by less than the cost of change, the excess is
+     * paid as fee.
+     */
+    bool SelectBlindedCoinsBnB(const std::vector<COutputR>& vAvailableCoins, const std::vector<int>& vInputBytes, const CAmount& nTargetValue,
+        const CoinSelectionParams& coin_selection_params, std::vector<std::pair<MapRecords_t::const_iterator,unsigned int> > &setCoinsRet, CAmount &nValueRet) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     void AvailableAnonCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutputR> &vCoins, bool fOnlySafe=true, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t& nMaximumCount = 0) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
@@ -460,7 +490,6 @@ public:
     int64_t nLastCoinStakeSearchTime = 0;
     uint32_t nStealth, nFoundStealth; // for reporting, zero before use
     int64_t nReserveBalance = 0;
-    size_t nStakeThread = 9999999; // unset
 
     mutable int m_greatest_txn_depth = 0; // depth of most deep txn
     //mutable int m_least_txn_depth = 0; // depth of least deep txn
@@ -478,6 +507,13 @@ public:
     };
     std::atomic<eStakingState> m_is_staking {NOT_STAKING};
 
+    // Staking search metrics, latencies in microseconds
+    std::atomic<int64_t> m_stake_searches {0};
+    std::atomic<int64_t> m_stake_missed_slots {0};
+    std::atomic<int64_t> m_stake_last_latency {0};
+    std::atomic<int64_t> m_stake_total_latency {0};
+    std::atomic<int64_t> m_stake_max_latency {0};
+
     std::set<CStealthAddress> stealthAddresses;
 
     CStoredExtKey *pEKMaster = nullptr;
@@ -489,6 +525,8 @@ public:
 
     MapRecords_t mapRecords;
     RtxOrdered_t rtxOrdered;
+    TxQueryIndex m_tx_query_index GUARDED_BY(cs_wallet);
+    mutable RecordCoinIndex m_record_coin_index GUARDED_BY(cs_wallet);
     mutable MapRecords_t mapTempRecords; // Hack for sending unmined inputs through fundrawtransactionfrom
 
     std::vector<CVoteToken> vVoteTokens;
@@ -563,6 +601,11 @@ bool CheckOutputValue(interfaces::Chain& chain, const CTempRecipient &r, const C
 int CreateOutput(OUTPUT_PTR<CTxOutBase> &txbout, CTempRecipient &r, std::string &sError);
 void ExtractNarration(const uint256 &nonce, const std::vector<uint8_t> &vData, std::string &sNarr);
 
+//! Virtual size of a blinded input spending scriptPubKey, signed with dummy signatures as for the fee estimate, -1 if it can't be signed
+int GetBlindedInputBytes(const CHDWallet &wallet, const CCoinControl *coinControl, const COutPoint &prevout, const CScript &scriptPubKey);
+//! Virtual size an anon input adds, its share of a txin signed by one MLSAG over nInputsPerSig inputs
+int GetAnonInputBytes(size_t nRingSize, size_t nInputsPerSig);
+
 // Calculate the size of the transaction assuming all signatures are max size
 // Use DummySignatureCreator, which inserts 72 byte signatures everywhere.
 // NOTE: this requires that all inputs must be in mapWallet (eg the tx should
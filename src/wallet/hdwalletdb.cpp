@@ -212,8 +212,22 @@ bool CHDWalletDB::WriteVoteTokens(const std::vector<CVoteToken> &vVoteTokens)
 };
 
 
+bool CHDWalletDB::ReadTxRecord(const uint256 &hash, CTransactionRecord &rtx, uint32_t nFlags)
+{
+    return m_batch.Read(std::make_pair(std::string("rtx"), hash), rtx, nFlags);
+};
+
 bool CHDWalletDB::WriteTxRecord(const uint256 &hash, const CTransactionRecord &rtx)
 {
+    if (rtx.fNarrationsUnloaded) {
+        // Keep the narrations that were not loaded into memory
+        CTransactionRecord rtxStored;
+        if (ReadTxRecord(hash, rtxStored)) {
+            CTransactionRecord rtxWrite = rtx;
+            rtxWrite.CopyNarrations(rtxStored);
+            return WriteIC(std::make_pair(std::string("rtx"), hash), rtxWrite, true);
+        }
+    }
     return WriteIC(std::make_pair(std::string("rtx"), hash), rtx, true);
 };
 
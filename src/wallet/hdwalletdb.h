@@ -385,6 +385,7 @@ public:
     bool ReadVoteTokens(std::vector<CVoteToken> &vVoteTokens, uint32_t nFlags=DB_READ_UNCOMMITTED);
     bool WriteVoteTokens(const std::vector<CVoteToken> &vVoteTokens);
 
+    bool ReadTxRecord(const uint256 &hash, CTransactionRecord &rtx, uint32_t nFlags=DB_READ_UNCOMMITTED);
     bool WriteTxRecord(const uint256 &hash, const CTransactionRecord &rtx);
     bool EraseTxRecord(const uint256 &hash);
 
@@ -63,6 +63,27 @@ const COutputRecord *CTransactionRecord::GetOutput(int n) const
     return nullptr;
 };
 
+void CTransactionRecord::UnloadNarrations()
+{
+    for (auto &r : vout) {
+        if (!r.GetNarration().empty()) {
+            r.SetNarration("");
+            fNarrationsUnloaded = true;
+        }
+    }
+};
+
+void CTransactionRecord::CopyNarrations(const CTransactionRecord &rtxStored)
+{
+    for (auto &r : vout) {
+        const COutputRecord *pout;
+        if (r.GetNarration().empty()
+            && (pout = rtxStored.GetOutput(r.n))) {
+            r.SetNarration(pout->GetNarration());
+        }
+    }
+};
+
 const COutputRecord *CTransactionRecord::GetChangeOutput() const
 {
     for (const auto &r : vout) {
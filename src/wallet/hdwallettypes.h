@@ -13,6 +13,7 @@
 
 #include <stdint.h>
 #include <map>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -76,7 +77,6 @@ public:
     uint16_t n;
     CAmount nValue;
     CScript scriptPubKey;
-    std::string sNarration;
 
     /*
     vPath 0 - ORA_EXTKEY
@@ -92,6 +92,22 @@ public:
     */
     std::vector<uint8_t> vPath; // index to m is stored in first entry
 
+    // Narrations are rare, held out of line so outputs without one only pay for a pointer.
+    // Empty if the output has no narration or the narrations of the record were not loaded.
+    const std::string &GetNarration() const
+    {
+        static const std::string sEmpty;
+        return m_narration ? *m_narration : sEmpty;
+    }
+    void SetNarration(const std::string &sNarration)
+    {
+        if (sNarration.empty()) {
+            m_narration.reset();
+        } else {
+            m_narration = std::make_shared<const std::string>(sNarration);
+        }
+    }
+
     ADD_SERIALIZE_METHODS;
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream &s, Operation ser_action)
@@ -101,9 +117,16 @@ public:
         READWRITE(n);
         READWRITE(nValue);
         READWRITE(*(CScriptBase*)(&scriptPubKey));
+        std::string sNarration = GetNarration();
         READWRITE(sNarration);
+        if (ser_action.ForRead()) {
+            SetNarration(sNarration);
+        }
         READWRITE(vPath);
     }
+
+private:
+    std::shared_ptr<const std::string> m_narration;
 };
 
 class CTransactionRecord
@@ -114,6 +137,8 @@ public:
     uint256 blockHash;
     int16_t nFlags = 0;
     int16_t nIndex = 0;
+    // Not stored, set when the narrations of the outputs were left in the database on load
+    bool fNarrationsUnloaded = false;
 
     int64_t nBlockTime = 0;
     int64_t nTimeReceived = 0;
@@ -130,6 +155,11 @@ public:
     const COutputRecord *GetOutput(int n) const;
     const COutputRecord *GetChangeOutput() const;
 
+    //! Drop the narrations of the outputs, they stay in the stored record
+    void UnloadNarrations();
+    //! Set the narrations missing from the outputs from the stored record
+    void CopyNarrations(const CTransactionRecord &rtxStored);
+
     void SetMerkleBranch(const uint256 &blockHash_, int posInBlock)
     {
         blockHash = blockHash_;
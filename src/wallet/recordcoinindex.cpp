@@ -0,0 +1,237 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/recordcoinindex.h>
+
+#include <algorithm>
+
+//! Dead rows kept before compacting is considered
+static const size_t MIN_DEAD_ROWS_COMPACT = 256;
+
+//! Values of m_tx_slots that are not rows
+static const uint32_t SLOT_EMPTY = ~uint32_t(0);
+static const uint32_t SLOT_DELETED = ~uint32_t(0) - 1;
+//! Returned by FindSlot for transactions that are not indexed
+static const size_t NO_SLOT = ~size_t(0);
+
+void RecordCoinIndex::Clear()
+{
+    m_built = false;
+    m_stale.clear();
+    m_tx_slots.clear();
+    m_used_slots = 0;
+    m_live_txns = 0;
+    m_order.clear();
+    m_order_sorted = 0;
+    m_order_dead = false;
+    m_tx_record.clear();
+    m_tx_types.clear();
+    m_tx_begin.clear();
+    m_tx_end.clear();
+    m_out_n.clear();
+    m_out_value.clear();
+    m_out_type.clear();
+    m_out_flags.clear();
+    m_out_spent.clear();
+    m_dead_txns = 0;
+    m_dead_outputs = 0;
+};
+
+void RecordCoinIndex::Put(const uint256 &hash, MapRecords_t::const_iterator rtx)
+{
+    Remove(hash);
+
+    uint32_t begin = m_out_n.size();
+    uint8_t types = 0;
+    for (const auto &r : rtx->second.vout) {
+        if ((r.nType != OUTPUT_CT && r.nType != OUTPUT_RINGCT)
+            || !(r.nFlags & ORF_OWN_ANY)) {
+            continue;
+        }
+        m_out_n.push_back(r.n);
+        m_out_value.push_back(r.nValue);
+        m_out_type.push_back(r.nType);
+        m_out_flags.push_back(r.nFlags);
+        m_out_spent.push_back(0);
+        types |= 1 << r.nType;
+    }
+    if (!types) {
+        return;
+    }
+
+    // Keep at least half of the slots empty, before the new row is added
+    if ((m_used_slots + 1) * 2 > m_tx_slots.size()) {
+        RebuildSlots(m_live_txns + 1);
+    }
+    uint32_t t = m_tx_record.size();
+    m_tx_record.push_back(rtx);
+    m_tx_types.push_back(types);
+    m_tx_begin.push_back(begin);
+    m_tx_end.push_back(m_out_n.size());
+    InsertSlot(hash, t);
+    m_order.push_back(t);
+};
+
+void RecordCoinIndex::Remove(const uint256 &hash)
+{
+    size_t slot = FindSlot(hash);
+    if (slot == NO_SLOT) {
+        return;
+    }
+    uint32_t t = m_tx_slots[slot];
+    m_dead_outputs += m_tx_end[t] - m_tx_begin[t];
+    m_dead_txns++;
+    m_tx_types[t] = 0;
+    m_tx_end[t] = m_tx_begin[t];
+    m_tx_slots[slot] = SLOT_DELETED;
+    m_live_txns--;
+    m_order_dead = true;
+};
+
+void RecordCoinIndex::MarkSpent(const COutPoint &outpoint)
+{
+    size_t slot = FindSlot(outpoint.hash);
+    if (slot == NO_SLOT) {
+        return;
+    }
+    uint32_t t = m_tx_slots[slot];
+    for (uint32_t o = m_tx_begin[t]; o < m_tx_end[t]; ++o) {
+        if (m_out_n[o] == outpoint.n) {
+            m_out_spent[o] = 1;
+            return;
+        }
+    }
+};
+
+void RecordCoinIndex::Sort()
+{
+    if (m_order_dead) {
+        // Drop removed transactions from both the sorted part and the tail
+        auto dead = [this](uint32_t t) { return m_tx_types[t] == 0; };
+        auto sorted_end = std::remove_if(m_order.begin(), m_order.begin() + m_order_sorted, dead);
+        auto tail_end = std::remove_if(m_order.begin() + m_order_sorted, m_order.end(), dead);
+        auto end = std::move(m_order.begin() + m_order_sorted, tail_end, sorted_end);
+        m_order_sorted = sorted_end - m_order.begin();
+        m_order.erase(end, m_order.end());
+        m_order_dead = false;
+    }
+
+    if (m_order_sorted < m_order.size()) {
+        auto cmp = [this](uint32_t a, uint32_t b) { return TxHash(a) < TxHash(b); };
+        std::sort(m_order.begin() + m_order_sorted, m_order.end(), cmp);
+        std::inplace_merge(m_order.begin(), m_order.begin() + m_order_sorted, m_order.end(), cmp);
+        m_order_sorted = m_order.size();
+    }
+
+    if ((m_dead_txns > MIN_DEAD_ROWS_COMPACT && m_dead_txns * 2 > m_tx_record.size())
+        || (m_dead_outputs > MIN_DEAD_ROWS_COMPACT && m_dead_outputs * 2 > m_out_n.size())) {
+        Compact();
+    }
+};
+
+void RecordCoinIndex::Compact()
+{
+    // m_order is sorted
+    size_t nTxns = Size(), nOutputs = NumOutputs();
+    std::vector<MapRecords_t::const_iterator> tx_record;
+    std::vector<uint8_t> tx_types;
+    std::vector<uint32_t> tx_begin, tx_end;
+    tx_record.reserve(nTxns);
+    tx_types.reserve(nTxns);
+    tx_begin.reserve(nTxns);
+    tx_end.reserve(nTxns);
+
+    std::vector<uint16_t> out_n;
+    std::vector<CAmount> out_value;
+    std::vector<uint8_t> out_type, out_flags, out_spent;
+    out_n.reserve(nOutputs);
+    out_value.reserve(nOutputs);
+    out_type.reserve(nOutputs);
+    out_flags.reserve(nOutputs);
+    out_spent.reserve(nOutputs);
+
+    // Rows are written in txid order, leaving m_order the identity
+    std::vector<uint32_t> order;
+    order.reserve(nTxns);
+    for (uint32_t t : m_order) {
+        if (!m_tx_types[t]) {
+            continue;
+        }
+        uint32_t t_new = tx_record.size();
+        tx_record.push_back(m_tx_record[t]);
+        tx_types.push_back(m_tx_types[t]);
+        tx_begin.push_back(out_n.size());
+        for (uint32_t o = m_tx_begin[t]; o < m_tx_end[t]; ++o) {
+            out_n.push_back(m_out_n[o]);
+            out_value.push_back(m_out_value[o]);
+            out_type.push_back(m_out_type[o]);
+            out_flags.push_back(m_out_flags[o]);
+            out_spent.push_back(m_out_spent[o]);
+        }
+        tx_end.push_back(out_n.size());
+        order.push_back(t_new);
+    }
+    m_order.swap(order);
+    m_order_sorted = m_order.size();
+
+    m_tx_record.swap(tx_record);
+    m_tx_types.swap(tx_types);
+    m_tx_begin.swap(tx_begin);
+    m_tx_end.swap(tx_end);
+    m_out_n.swap(out_n);
+    m_out_value.swap(out_value);
+    m_out_type.swap(out_type);
+    m_out_flags.swap(out_flags);
+    m_out_spent.swap(out_spent);
+    m_dead_txns = 0;
+    m_dead_outputs = 0;
+    RebuildSlots(m_live_txns);
+};
+
+size_t RecordCoinIndex::FindSlot(const uint256 &hash) const
+{
+    if (m_tx_slots.empty()) {
+        return NO_SLOT;
+    }
+    size_t mask = m_tx_slots.size() - 1;
+    for (size_t slot = m_hasher(hash) & mask; ; slot = (slot + 1) & mask) {
+        uint32_t t = m_tx_slots[slot];
+        if (t == SLOT_EMPTY) {
+            return NO_SLOT;
+        }
+        if (t != SLOT_DELETED && TxHash(t) == hash) {
+            return slot;
+        }
+    }
+};
+
+void RecordCoinIndex::InsertSlot(const uint256 &hash, uint32_t t)
+{
+    size_t mask = m_tx_slots.size() - 1;
+    size_t slot = m_hasher(hash) & mask;
+    while (m_tx_slots[slot] != SLOT_EMPTY && m_tx_slots[slot] != SLOT_DELETED) {
+        slot = (slot + 1) & mask;
+    }
+    if (m_tx_slots[slot] == SLOT_EMPTY) {
+        m_used_slots++;
+    }
+    m_tx_slots[slot] = t;
+    m_live_txns++;
+};
+
+void RecordCoinIndex::RebuildSlots(size_t min_txns)
+{
+    size_t size = 16;
+    while (size < min_txns * 4) {
+        size *= 2;
+    }
+    m_tx_slots.assign(size, SLOT_EMPTY);
+    m_used_slots = 0;
+    m_live_txns = 0;
+    for (uint32_t t = 0; t < m_tx_record.size(); ++t) {
+        if (m_tx_types[t]) {
+            InsertSlot(TxHash(t), t);
+        }
+    }
+};
@@ -0,0 +1,119 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_WALLET_RECORDCOININDEX_H
+#define PARTICL_WALLET_RECORDCOININDEX_H
+
+#include <amount.h>
+#include <primitives/transaction.h>
+#include <txmempool.h>
+#include <uint256.h>
+#include <wallet/hdwallettypes.h>
+
+#include <stdint.h>
+#include <set>
+#include <vector>
+
+/**
+ * The owned blinded and anon outputs of the wallet records in flat arrays, so
+ * listing spendable coins reads a few columns instead of walking mapRecords and
+ * the outputs of every record.
+ *
+ * Each transaction is a row of the tx columns, its outputs a contiguous range of
+ * rows in the output columns. Replacing a transaction appends new rows and leaves
+ * the old ones dead, the columns are compacted once most rows are dead.
+ * Transactions are listed in txid order, as mapRecords is. The txid of a row is
+ * read through its record, only live rows are ever dereferenced.
+ *
+ * The index is built from the wallet on first use, after that records are marked
+ * stale as they change and are recomputed before the next enumeration.
+ */
+class RecordCoinIndex
+{
+public:
+    bool IsBuilt() const { return m_built; }
+    void SetBuilt() { m_built = true; }
+
+    //! Drop everything, the index is rebuilt on the next enumeration
+    void Clear();
+
+    void MarkStale(const uint256 &hash)
+    {
+        if (m_built) {
+            m_stale.insert(hash);
+        }
+    }
+    std::set<uint256> TakeStale()
+    {
+        std::set<uint256> stale;
+        stale.swap(m_stale);
+        return stale;
+    }
+
+    //! Replace the rows of a transaction with the owned blinded and anon outputs of its record
+    void Put(const uint256 &hash, MapRecords_t::const_iterator rtx);
+    void Remove(const uint256 &hash);
+
+    //! Outputs with a recorded spend are checked with IsSpent when listed, other outputs are unspent
+    void MarkSpent(const COutPoint &outpoint);
+
+    //! Restore txid order after changes, compacting the columns when most rows are dead
+    void Sort();
+
+    size_t Size() const { return m_live_txns; }
+    size_t NumOutputs() const { return m_out_n.size() - m_dead_outputs; }
+
+    //! Rows of the indexed transactions, in txid order after Sort()
+    const std::vector<uint32_t> &Order() const { return m_order; }
+
+    const uint256 &TxHash(uint32_t t) const { return m_tx_record[t]->first; }
+    MapRecords_t::const_iterator TxRecord(uint32_t t) const { return m_tx_record[t]; }
+    bool TxHasType(uint32_t t, uint8_t type) const { return m_tx_types[t] & (1 << type); }
+    uint32_t OutputsBegin(uint32_t t) const { return m_tx_begin[t]; }
+    uint32_t OutputsEnd(uint32_t t) const { return m_tx_end[t]; }
+
+    uint16_t OutputN(uint32_t o) const { return m_out_n[o]; }
+    CAmount OutputValue(uint32_t o) const { return m_out_value[o]; }
+    uint8_t OutputType(uint32_t o) const { return m_out_type[o]; }
+    uint8_t OutputFlags(uint32_t o) const { return m_out_flags[o]; }
+    bool OutputSpent(uint32_t o) const { return m_out_spent[o]; }
+
+private:
+    void Compact();
+
+    //! Slot of the row of a transaction in m_tx_slots, NO_SLOT if it is not indexed
+    size_t FindSlot(const uint256 &hash) const;
+    void InsertSlot(const uint256 &hash, uint32_t t);
+    //! Refill m_tx_slots from the live rows, sized for at least min_txns transactions at a quarter load
+    void RebuildSlots(size_t min_txns);
+
+    bool m_built = false;
+    std::set<uint256> m_stale;
+
+    // Rows by txid, an open addressing table of row numbers probed linearly and
+    // compared through the records, so the txid is not stored again.
+    // Rows are removed before their records are erased from mapRecords.
+    SaltedTxidHasher m_hasher;
+    std::vector<uint32_t> m_tx_slots;
+    size_t m_used_slots = 0;
+    size_t m_live_txns = 0;
+    std::vector<uint32_t> m_order;
+    size_t m_order_sorted = 0;
+    bool m_order_dead = false;
+
+    std::vector<MapRecords_t::const_iterator> m_tx_record;
+    std::vector<uint8_t> m_tx_types;
+    std::vector<uint32_t> m_tx_begin;
+    std::vector<uint32_t> m_tx_end;
+
+    std::vector<uint16_t> m_out_n;
+    std::vector<CAmount> m_out_value;
+    std::vector<uint8_t> m_out_type;
+    std::vector<uint8_t> m_out_flags;
+    std::vector<uint8_t> m_out_spent;
+    size_t m_dead_txns = 0;
+    size_t m_dead_outputs = 0;
+};
+
+#endif // PARTICL_WALLET_RECORDCOININDEX_H
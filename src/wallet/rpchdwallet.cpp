@@ -2415,11 +2415,28 @@ static UniValue deriverangekeys(const JSONRPCRequest &request)
             }
         }
 
+        // Non-hardened keys are derived from the public key together, a child that is
+        // invalid takes the key of the next valid child like DeriveKey does
+        std::vector<CPubKey> vDerived;
+        if (!fHardened && nEnd - nStart >= 1) {
+            if (0 != sek->DeriveKeys(vDerived, (uint32_t)nStart, (uint32_t)(nEnd - nStart) + 1, GetNumCores())) {
+                throw JSONRPCError(RPC_WALLET_ERROR, "DeriveKeys failed.");
+            }
+        }
+
         uint32_t nChildIn = (uint32_t)nStart;
         CPubKey newKey;
         for (int i = nStart; i <= nEnd; ++i) {
             nChildIn = (uint32_t)i;
             uint32_t nChildOut = 0;
+            size_t k = i - nStart;
+            while (k < vDerived.size() && !vDerived[k].IsValid()) {
+                k++;
+            }
+            if (k < vDerived.size()) {
+                newKey = vDerived[k];
+                nChildOut = (uint32_t)(nStart + k);
+            } else
             if (0 != sek->DeriveKey(newKey, nChildIn, nChildOut, fHardened)) {
                 throw JSONRPCError(RPC_WALLET_ERROR, "DeriveKey failed.");
             }
@@ -2958,8 +2975,9 @@ static void ParseRecords(
             : record.nType == OUTPUT_RINGCT   ? "anon"
             : "unknown");
 
-        if (!record.sNarration.empty()) {
-            output.__pushKV("narration", record.sNarration);
+        std::string sNarration = pwallet->GetOutputNarration(hash, rtx, record);
+        if (!sNarration.empty()) {
+            output.__pushKV("narration", sNarration);
         }
 
         CAmount amount = record.nValue;
@@ -3285,84 +3303,106 @@ static UniValue filtertransactions(const JSONRPCRequest &request)
         }
     }
 
+    int type_i = type == "standard" ? OUTPUT_STANDARD :
+                 type == "blind" ? OUTPUT_CT :
+                 type == "anon" ? OUTPUT_RINGCT :
+                 0;
+
+    // Plan the query against the wallet's indexes, only candidates are parsed into entries
+    TxQueryFilter filter;
+    filter.nTimeFrom = timeFrom;
+    filter.nTimeTo = timeTo;
+    filter.nCategory = category == "send" ? TXQ_CAT_SEND :
+                       category == "receive" ? TXQ_CAT_RECEIVE :
+                       category == "internal_transfer" ? TXQ_CAT_INTERNAL_TRANSFER :
+                       category == "stake" || category == "orphaned_stake" ? TXQ_CAT_STAKE :
+                       category == "coinbase" || category == "immature" || category == "orphan" ? TXQ_CAT_COINBASE :
+                       -1;
+    filter.nTypes = type_i == OUTPUT_STANDARD ? TXQ_TYPE_STANDARD :
+                    type_i == OUTPUT_CT ? TXQ_TYPE_BLIND :
+                    type_i == OUTPUT_RINGCT ? TXQ_TYPE_ANON :
+                    0;
+    // Amounts are searched as strings of digits, '.' and '-'
+    if (search.find_first_not_of("0123456789.-") != std::string::npos) {
+        filter.sAddressSearch = search;
+    }
+    filter.fWatchOnly = watchonly & ISMINE_WATCH_ONLY;
+    filter.nSort = sort == "time" ? TXQ_SORT_TIME :
+                   sort == "amount" ? TXQ_SORT_AMOUNT :
+                   sort == "txid" ? TXQ_SORT_TXID :
+                   TXQ_SORT_NONE;
+
+    pwallet->UpdateTxQueryIndex(*locked_chain);
+    TxQueryCursor cursor = pwallet->m_tx_query_index.Query(filter);
+
     // for transactions and records
     UniValue transactions(UniValue::VARR);
-
-    // transaction processing
-    const CHDWallet::TxItems &txOrdered = pwallet->wtxOrdered;
-    CWallet::TxItems::const_reverse_iterator tit = txOrdered.rbegin();
-    if (type == "all" || type == "standard")
-    while (tit != txOrdered.rend()) {
-        CWalletTx *const pwtx = tit->second;
-        int64_t txTime = pwtx->GetTxTime();
-        if (txTime < timeFrom) break;
-        if (txTime <= timeTo)
-            ParseOutputs(
+    uint256 hash;
+    bool fRecord;
+    while (cursor.Next(hash, fRecord)) {
+        // The cursor returns entries in the requested order, stop once the page is complete
+        if (filter.nSort != TXQ_SORT_NONE && count != 0
+            && transactions.size() >= (size_t)skip + count) {
+            break;
+        }
+        if (fRecord) {
+            MapRecords_t::const_iterator mri = pwallet->mapRecords.find(hash);
+            if (mri == pwallet->mapRecords.end()) {
+                continue;
+            }
+            const CTransactionRecord &rtx = mri->second;
+            int64_t txTime = rtx.GetTxTime();
+            if (txTime < timeFrom || txTime > timeTo) {
+                continue;
+            }
+            ParseRecords(
                 *locked_chain,
                 transactions,
-                *pwtx,
+                hash,
+                rtx,
                 pwallet,
                 watchonly,
                 search,
                 category,
-                fWithReward,
-                fBech32,
-                hide_zero_coinstakes,
-                vDevFundScripts
+                type_i
             );
-        tit++;
-    }
-
-    int type_i = type == "standard" ? OUTPUT_STANDARD :
-                 type == "blind" ? OUTPUT_CT :
-                 type == "anon" ? OUTPUT_RINGCT :
-                 0;
-    // records processing
-    const RtxOrdered_t &rtxOrdered = pwallet->rtxOrdered;
-    RtxOrdered_t::const_reverse_iterator rit = rtxOrdered.rbegin();
-    while (rit != rtxOrdered.rend()) {
-        const uint256 &hash = rit->second->first;
-        const CTransactionRecord &rtx = rit->second->second;
-        int64_t txTime = rtx.GetTxTime();
-        if (txTime < timeFrom) break;
-        if (txTime <= timeTo)
-            ParseRecords(
+        } else {
+            MapWallet_t::iterator mwi = pwallet->mapWallet.find(hash);
+            if (mwi == pwallet->mapWallet.end()) {
+                continue;
+            }
+            ParseOutputs(
                 *locked_chain,
                 transactions,
-                hash,
-                rtx,
+                mwi->second,
                 pwallet,
                 watchonly,
                 search,
                 category,
-                type_i
+                fWithReward,
+                fBech32,
+                hide_zero_coinstakes,
+                vDevFundScripts
             );
-        rit++;
+        }
     }
 
-    // sort
     std::vector<UniValue> values = transactions.getValues();
-    std::sort(values.begin(), values.end(), [sort] (UniValue a, UniValue b) -> bool {
-        std::string a_address = getAddress(a);
-        std::string b_address = getAddress(b);
-        double a_amount =   a["category"].get_str() == "send"
-                        ? -(a["amount"  ].get_real())
-                        :   a["amount"  ].get_real();
-        double b_amount =   b["category"].get_str() == "send"
-                        ? -(b["amount"  ].get_real())
-                        :   b["amount"  ].get_real();
-        return (
-              sort == "address"
-                ? a_address < b_address
-            : sort == "category" || sort == "txid"
-                ? a[sort].get_str() < b[sort].get_str()
-            : sort == "time" || sort == "confirmations"
-                ? a[sort].get_real() > b[sort].get_real()
-            : sort == "amount"
-                ? a_amount > b_amount
-            : false
-            );
-    });
+    if (filter.nSort == TXQ_SORT_NONE) {
+        std::sort(values.begin(), values.end(), [sort] (UniValue a, UniValue b) -> bool {
+            std::string a_address = getAddress(a);
+            std::string b_address = getAddress(b);
+            return (
+                  sort == "address"
+                    ? a_address < b_address
+                : sort == "category"
+                    ? a[sort].get_str() < b[sort].get_str()
+                : sort == "confirmations"
+                    ? a[sort].get_real() > b[sort].get_real()
+                : false
+                );
+        });
+    }
 
     // filter, skip, count and sum
     CAmount nTotalAmount = 0, nTotalReward = 0;
@@ -3821,6 +3861,13 @@ static UniValue getstakinginfo(const JSONRPCRequest &request)
             "  \"weight\": xxxxxxx              (numeric) the current stake weight of this wallet\n"
             "  \"netstakeweight\": xxxxxxx      (numeric) the current stake weight of the network\n"
             "  \"expectedtime\": xxxxxxx        (numeric) estimated time for next stake\n"
+            "  \"searchstats\": {               (object) kernel searches by this wallet since it was loaded\n"
+            "    \"searches\": n,                (numeric) number of slots searched\n"
+            "    \"missedslots\": n,             (numeric) number of slots that passed before the wallet could be searched\n"
+            "    \"lastlatency\": n,             (numeric) duration of the last search in microseconds\n"
+            "    \"avglatency\": n,              (numeric) average duration of a search in microseconds\n"
+            "    \"maxlatency\": n,              (numeric) longest duration of a search in microseconds\n"
+            "  }\n"
             "}\n"
                 },
                 RPCExamples{
@@ -3906,6 +3953,15 @@ static UniValue getstakinginfo(const JSONRPCRequest &request)
 
     obj.pushKV("expectedtime", nExpectedTime);
 
+    UniValue searchstats(UniValue::VOBJ);
+    int64_t nSearches = pwallet->m_stake_searches;
+    searchstats.pushKV("searches", nSearches);
+    searchstats.pushKV("missedslots", (int64_t)pwallet->m_stake_missed_slots);
+    searchstats.pushKV("lastlatency", (int64_t)pwallet->m_stake_last_latency);
+    searchstats.pushKV("avglatency", nSearches > 0 ? pwallet->m_stake_total_latency / nSearches : 0);
+    searchstats.pushKV("maxlatency", (int64_t)pwallet->m_stake_max_latency);
+    obj.pushKV("searchstats", searchstats);
+
     return obj;
 };
 
@@ -4175,7 +4231,6 @@ static UniValue listunspentanon(const JSONRPCRequest &request)
     // the user could have gotten from another RPC command prior to now
     pwallet->BlockUntilSyncedToCurrentChain();
 
-    UniValue results(UniValue::VARR);
     std::vector<COutputR> vecOutputs;
     assert(pwallet != nullptr);
 
@@ -4190,71 +4245,73 @@ static UniValue listunspentanon(const JSONRPCRequest &request)
         pwallet->AvailableAnonCoins(*locked_chain, vecOutputs, !include_unsafe, &cctl, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount);
     }
 
-    LOCK(pwallet->cs_wallet);
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        LOCK(pwallet->cs_wallet);
 
-    for (const auto &out : vecOutputs)
-    {
-        if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
-            continue;
+        writer.BeginArray();
+        for (const auto &out : vecOutputs)
+        {
+            if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
+                continue;
 
-        const COutputRecord *pout = out.rtx->second.GetOutput(out.i);
+            const COutputRecord *pout = out.rtx->second.GetOutput(out.i);
 
-        if (!pout)
-        {
-            LogPrintf("%s: ERROR - Missing output %s %d\n", __func__, out.txhash.ToString(), out.i);
-            continue;
-        };
+            if (!pout)
+            {
+                LogPrintf("listunspentanon: ERROR - Missing output %s %d\n", out.txhash.ToString(), out.i);
+                continue;
+            };
 
-        CAmount nValue = pout->nValue;
+            CAmount nValue = pout->nValue;
 
-        UniValue entry(UniValue::VOBJ);
-        entry.pushKV("txid", out.txhash.GetHex());
-        entry.pushKV("vout", out.i);
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("txid", out.txhash.GetHex());
+            entry.pushKV("vout", out.i);
 
-        if (pout->vPath.size() > 0 && pout->vPath[0] == ORA_STEALTH) {
-            if (pout->vPath.size() < 5) {
-                LogPrintf("%s: Warning, malformed vPath.\n", __func__);
-            } else {
-                uint32_t sidx;
-                memcpy(&sidx, &pout->vPath[1], 4);
-                CStealthAddress sx;
-                if (pwallet->GetStealthByIndex(sidx, sx)) {
-                    entry.pushKV("address", sx.Encoded());
+            if (pout->vPath.size() > 0 && pout->vPath[0] == ORA_STEALTH) {
+                if (pout->vPath.size() < 5) {
+                    LogPrintf("listunspentanon: Warning, malformed vPath.\n");
+                } else {
+                    uint32_t sidx;
+                    memcpy(&sidx, &pout->vPath[1], 4);
+                    CStealthAddress sx;
+                    if (pwallet->GetStealthByIndex(sidx, sx)) {
+                        entry.pushKV("address", sx.Encoded());
 
-                    auto i = pwallet->mapAddressBook.find(sx);
-                    if (i != pwallet->mapAddressBook.end()) {
-                        entry.pushKV("label", i->second.name);
-                    }
-                    if (setAddress.size() && !setAddress.count(CBitcoinAddress(CTxDestination(sx)))) {
-                        continue;
+                        auto i = pwallet->mapAddressBook.find(sx);
+                        if (i != pwallet->mapAddressBook.end()) {
+                            entry.pushKV("label", i->second.name);
+                        }
+                        if (setAddress.size() && !setAddress.count(CBitcoinAddress(CTxDestination(sx)))) {
+                            continue;
+                        }
                     }
                 }
             }
-        }
 
-        if (!entry.exists("address")) {
-            entry.pushKV("address", "unknown");
-            if (setAddress.size()) {
-                continue;
+            if (!entry.exists("address")) {
+                entry.pushKV("address", "unknown");
+                if (setAddress.size()) {
+                    continue;
+                }
             }
-        }
-        if (fCCFormat) {
-            entry.pushKV("time", out.rtx->second.GetTxTime());
-            entry.pushKV("amount", nValue);
-        } else {
-            entry.pushKV("amount", ValueFromAmount(nValue));
-        }
-        entry.pushKV("confirmations", out.nDepth);
-        //entry.pushKV("spendable", out.fSpendable);
-        //entry.pushKV("solvable", out.fSolvable);
-        entry.pushKV("safe", out.fSafe);
-        if (fIncludeImmature)
-            entry.pushKV("mature", out.fMature);
-
-        results.push_back(entry);
-    }
+            if (fCCFormat) {
+                entry.pushKV("time", out.rtx->second.GetTxTime());
+                entry.pushKV("amount", nValue);
+            } else {
+                entry.pushKV("amount", ValueFromAmount(nValue));
+            }
+            entry.pushKV("confirmations", out.nDepth);
+            //entry.pushKV("spendable", out.fSpendable);
+            //entry.pushKV("solvable", out.fSolvable);
+            entry.pushKV("safe", out.fSafe);
+            if (fIncludeImmature)
+                entry.pushKV("mature", out.fMature);
 
-    return results;
+            writer.Value(entry);
+        }
+        writer.EndArray();
+    });
 };
 
 static UniValue listunspentblind(const JSONRPCRequest &request)
@@ -7891,7 +7948,7 @@ static UniValue verifyrawtransaction(const JSONRPCRequest &request)
                 }
                 std::vector<uint8_t> vchCommitment = ParseHex(s);
                 assert(vchCommitment.size() == 33);
-                memcpy(newcoin.commitment.data, vchCommitment.data(), 33);
+                newcoin.SetCommitment(vchCommitment.data());
                 newcoin.nType = OUTPUT_CT;
             } else {
                 throw JSONRPCError(RPC_INVALID_PARAMETER, "\"amount\" or \"amount_commitment\" is required");
@@ -7950,7 +8007,7 @@ static UniValue verifyrawtransaction(const JSONRPCRequest &request)
         } else
         if (coin.nType == OUTPUT_CT) {
             vchAmount.resize(33);
-            memcpy(vchAmount.data(), coin.commitment.data, 33);
+            memcpy(vchAmount.data(), coin.GetCommitment().data, 33);
         } else {
             throw JSONRPCError(RPC_MISC_ERROR, strprintf("Bad input type: %d", coin.nType));
         }
@@ -1859,8 +1859,9 @@ static void ListRecord(interfaces::Chain::Lock& locked_chain, CHDWallet *phdw, c
 
         PushTime(entry, "time", rtx.nTimeReceived);
 
-        if (!r.sNarration.empty()) {
-            entry.pushKV("narration", r.sNarration);
+        std::string sNarration = phdw->GetOutputNarration(hash, rtx, r);
+        if (!sNarration.empty()) {
+            entry.pushKV("narration", sNarration);
         }
 
         if (r.nFlags & ORF_FROM) {
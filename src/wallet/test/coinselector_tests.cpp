@@ -263,6 +263,36 @@ BOOST_AUTO_TEST_CASE(bnb_search_test)
     BOOST_CHECK(!coin_selection_params_bnb.use_bnb);
 }
 
+BOOST_AUTO_TEST_CASE(bnb_input_cost_test)
+{
+    // Coins without a plain txout, as blinded and anon coins are passed, with the input size of a large ring
+    const int input_bytes = 1100;
+    const CFeeRate effective_fee(10000), long_term_fee(1000);
+    const CAmount fee = effective_fee.GetFee(input_bytes);
+
+    std::vector<OutputGroup> utxo_pool;
+    auto add_value_coin = [&](CAmount value) {
+        CInputCoin coin(COutPoint(InsecureRand256(), 0), CTxOut(value, CScript()), input_bytes);
+        OutputGroup group(coin, 6, true, 0, 0);
+        group.fee = fee;
+        group.long_term_fee = long_term_fee.GetFee(input_bytes);
+        group.effective_value = value - fee;
+        utxo_pool.push_back(group);
+        return coin.outpoint;
+    };
+    add_value_coin(CENT / 2 + fee);
+    add_value_coin(CENT / 2 + fee);
+    COutPoint single = add_value_coin(CENT + fee);
+
+    // Both the pair and the single coin pay the target exactly, the single input wastes less
+    CoinSet selection;
+    CAmount value_ret = 0;
+    BOOST_CHECK(SelectCoinsBnB(utxo_pool, CENT, 5000, selection, value_ret, 0));
+    BOOST_CHECK_EQUAL(selection.size(), 1U);
+    BOOST_CHECK(selection.begin()->outpoint == single);
+    BOOST_CHECK_EQUAL(value_ret, CENT + fee);
+}
+
 BOOST_AUTO_TEST_CASE(knapsack_solver_test)
 {
     CoinSet setCoinsRet, setCoinsRet2;
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <memory>
+#include <thread>
 
 #include <boost/test/unit_test.hpp>
 
@@ -69,4 +70,64 @@ BOOST_AUTO_TEST_CASE(getwalletenv_g_dbenvs_free_instance)
     BOOST_CHECK(env_2_a == env_2_b);
 }
 
+BOOST_AUTO_TEST_CASE(group_txn)
+{
+    std::unique_ptr<BerkeleyDatabase> database = BerkeleyDatabase::CreateMock();
+    const std::string key_a = "a", key_b = "b", key_c = "c", key_d = "d";
+    int value = 0;
+
+    {
+        BerkeleyBatch group(*database);
+        BOOST_CHECK(group.TxnBeginGroup());
+        BOOST_CHECK(!group.TxnBeginGroup());
+
+        // Other batches write into the group transaction
+        BerkeleyBatch batch(*database);
+        BOOST_CHECK(batch.Write(key_a, 1));
+        BOOST_CHECK(batch.Read(key_a, value) && value == 1);
+
+        // Transactions begun while the group is open are nested in it
+        BerkeleyBatch nested(*database);
+        BOOST_CHECK(nested.TxnBegin());
+        BOOST_CHECK(nested.Write(key_b, 2));
+        BOOST_CHECK(nested.TxnAbort());
+        BOOST_CHECK(nested.TxnBegin());
+        BOOST_CHECK(nested.Write(key_c, 3));
+        BOOST_CHECK(nested.TxnCommit());
+
+        // Batches on other threads write outside the group transaction, waiting for it to end
+        bool other_in_group = true, other_written = false;
+        std::thread writer([&] {
+            BerkeleyBatch other(*database);
+            other_in_group = other.GetTxn() != nullptr;
+            other_written = other.Write(key_d, 4);
+        });
+
+        BOOST_CHECK(group.TxnAbort());
+        writer.join();
+        BOOST_CHECK(!other_in_group);
+        BOOST_CHECK(other_written);
+        BOOST_CHECK(!batch.Exists(key_a));
+        BOOST_CHECK(!batch.Exists(key_c));
+        BOOST_CHECK(batch.Read(key_d, value) && value == 4);
+    }
+
+    {
+        BerkeleyBatch group(*database);
+        BOOST_CHECK(group.TxnBeginGroup());
+        BerkeleyBatch batch(*database);
+        BOOST_CHECK(batch.Write(key_a, 1));
+        BerkeleyBatch nested(*database);
+        BOOST_CHECK(nested.TxnBegin());
+        BOOST_CHECK(nested.Write(key_c, 3));
+        BOOST_CHECK(nested.TxnCommit());
+        BOOST_CHECK(group.TxnCommit());
+    }
+
+    BerkeleyBatch batch(*database);
+    BOOST_CHECK(batch.Read(key_a, value) && value == 1);
+    BOOST_CHECK(batch.Read(key_c, value) && value == 3);
+    BOOST_CHECK(!batch.Exists(key_b));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <wallet/hdwallet.h>
+#include <wallet/hdwalletdb.h>
+#include <wallet/coincontrol.h>
 
 #include <wallet/test/hdwallet_test_fixture.h>
 #include <base58.h>
@@ -10,6 +12,7 @@
 #include <smsg/smessage.h>
 #include <smsg/crypter.h>
 #include <blind.h>
+#include <anon.h>
 #include <primitives/transaction.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
@@ -18,7 +21,7 @@
 
 #include <boost/test/unit_test.hpp>
 
-extern bool CheckAnonOutput(CValidationState &state, const CTxOutRingCT *p);
+extern bool CheckAnonOutput(CValidationState &state, const CTxOutRingCT *p, const uint256 *wtxid = nullptr, uint32_t n = 0);
 extern void SetCTOutVData(std::vector<uint8_t> &vData, CPubKey &pkEphem, const CTempRecipient &r);
 
 BOOST_FIXTURE_TEST_SUITE(hdwallet_tests, HDWalletTestingSetup)
@@ -596,4 +599,325 @@ BOOST_AUTO_TEST_CASE(opiscoinstake_test)
 }
 
 
+BOOST_AUTO_TEST_CASE(tx_query_index)
+{
+    TxQueryIndex index;
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 40; ++i) {
+        TxQueryEntry entry;
+        entry.fRecord = i % 2;
+        entry.nTime = 1000 + i;
+        entry.nCategory = i % 4 == 0 ? TXQ_CAT_SEND : TXQ_CAT_RECEIVE;
+        entry.nTypes = i % 10 == 0 ? TXQ_TYPE_ANON : TXQ_TYPE_STANDARD;
+        entry.nSortAmount[0] = entry.nSortAmount[1] = (i * 7) % 40;
+        entry.vAddresses.push_back(strprintf("addr%d", i % 5));
+        hashes.push_back(GetRandHash());
+        index.Put(hashes.back(), entry);
+    }
+    BOOST_CHECK(index.Size() == 40);
+
+    auto read_all = [&index](const TxQueryFilter &filter) {
+        std::vector<uint256> result;
+        TxQueryCursor cursor = index.Query(filter);
+        uint256 hash;
+        bool fRecord;
+        while (cursor.Next(hash, fRecord)) {
+            BOOST_CHECK(index.Get(hash) && index.Get(hash)->fRecord == fRecord);
+            result.push_back(hash);
+        }
+        return result;
+    };
+
+    // Most recent first, stops at nTimeFrom
+    TxQueryFilter filter;
+    filter.nTimeFrom = 1030;
+    std::vector<uint256> result = read_all(filter);
+    BOOST_CHECK(result.size() == 10);
+    for (size_t i = 0; i < result.size(); ++i) {
+        BOOST_CHECK(result[i] == hashes[39 - i]);
+    }
+
+    // Largest first
+    filter = TxQueryFilter();
+    filter.nSort = TXQ_SORT_AMOUNT;
+    result = read_all(filter);
+    BOOST_CHECK(result.size() == 40);
+    for (size_t i = 1; i < result.size(); ++i) {
+        BOOST_CHECK(index.Get(result[i - 1])->nSortAmount[0] >= index.Get(result[i])->nSortAmount[0]);
+    }
+
+    // Hex string order
+    filter.nSort = TXQ_SORT_TXID;
+    result = read_all(filter);
+    BOOST_CHECK(result.size() == 40);
+    for (size_t i = 1; i < result.size(); ++i) {
+        BOOST_CHECK(result[i - 1].GetHex() < result[i].GetHex());
+    }
+
+    // Small postings are read as candidates, ordered the same as streamed results
+    filter = TxQueryFilter();
+    filter.nTypes = TXQ_TYPE_ANON;
+    result = read_all(filter);
+    BOOST_CHECK(result.size() == 4);
+    for (size_t i = 0; i < result.size(); ++i) {
+        BOOST_CHECK(result[i] == hashes[30 - i * 10]);
+    }
+
+    filter = TxQueryFilter();
+    filter.nCategory = TXQ_CAT_SEND;
+    filter.sAddressSearch = "addr0";
+    filter.nSort = TXQ_SORT_AMOUNT;
+    result = read_all(filter);
+    BOOST_CHECK(result.size() == 2);
+    BOOST_CHECK(result[0] == hashes[20]);
+    BOOST_CHECK(result[1] == hashes[0]);
+
+    // Updated entries move, removed entries are no longer returned
+    TxQueryEntry entry = *index.Get(hashes[0]);
+    entry.nTime = 2000;
+    entry.vAddresses[0] = "moved";
+    index.Put(hashes[0], entry);
+    index.Remove(hashes[39]);
+    BOOST_CHECK(index.Size() == 39);
+    filter = TxQueryFilter();
+    result = read_all(filter);
+    BOOST_CHECK(result.size() == 39);
+    BOOST_CHECK(result[0] == hashes[0]);
+    BOOST_CHECK(result[1] == hashes[38]);
+    filter.sAddressSearch = "addr0";
+    BOOST_CHECK(read_all(filter).size() == 7);
+    filter.sAddressSearch = "moved";
+    BOOST_CHECK(read_all(filter).size() == 1);
+
+    index.Clear();
+    BOOST_CHECK(index.Size() == 0);
+    BOOST_CHECK(!index.IsBuilt());
+}
+
+BOOST_AUTO_TEST_CASE(record_coin_index)
+{
+    MapRecords_t records;
+    for (int i = 0; i < 600; ++i) {
+        CTransactionRecord rtx;
+        for (int k = 0; k < 3; ++k) {
+            COutputRecord r;
+            r.n = k;
+            r.nType = k == 0 ? OUTPUT_STANDARD : (i % 2 ? OUTPUT_CT : OUTPUT_RINGCT);
+            r.nFlags = k == 2 && i % 3 == 0 ? 0 : ORF_OWNED;
+            r.nValue = i * 10 + k;
+            rtx.InsertOutput(r);
+        }
+        records.emplace(GetRandHash(), rtx);
+    }
+
+    RecordCoinIndex index;
+    for (auto it = records.begin(); it != records.end(); ++it) {
+        index.Put(it->first, it);
+    }
+    index.Sort();
+    BOOST_CHECK(index.Size() == 600);
+    BOOST_CHECK(index.NumOutputs() == 1000);
+
+    auto check_order = [&index, &records]() {
+        auto it = records.begin();
+        for (uint32_t t : index.Order()) {
+            if (!index.TxHasType(t, OUTPUT_CT) && !index.TxHasType(t, OUTPUT_RINGCT)) {
+                continue;
+            }
+            BOOST_REQUIRE(it != records.end());
+            BOOST_CHECK(index.TxHash(t) == it->first);
+            BOOST_CHECK(index.TxRecord(t) == it);
+            for (uint32_t o = index.OutputsBegin(t); o < index.OutputsEnd(t); ++o) {
+                const COutputRecord *pout = it->second.GetOutput(index.OutputN(o));
+                BOOST_REQUIRE(pout);
+                BOOST_CHECK(pout->nType == index.OutputType(o));
+                BOOST_CHECK(pout->nValue == index.OutputValue(o));
+                BOOST_CHECK(pout->nFlags & ORF_OWN_ANY);
+            }
+            ++it;
+        }
+        BOOST_CHECK(it == records.end());
+    };
+    check_order();
+
+    // Spent hints are kept per output
+    auto first = records.begin();
+    index.MarkSpent(COutPoint(first->first, 1));
+    uint32_t t = index.Order()[0];
+    BOOST_CHECK(index.OutputN(index.OutputsBegin(t)) == 1);
+    BOOST_CHECK(index.OutputSpent(index.OutputsBegin(t)));
+
+    // Replaced rows are appended, txid order is restored by Sort
+    first->second.GetOutput(1)->nValue = 12345;
+    index.Put(first->first, first);
+    index.Sort();
+    t = index.Order()[0];
+    BOOST_CHECK(index.TxHash(t) == first->first);
+    BOOST_CHECK(index.OutputValue(index.OutputsBegin(t)) == 12345);
+    BOOST_CHECK(!index.OutputSpent(index.OutputsBegin(t)));
+    check_order();
+
+    // Removing most transactions compacts the columns
+    size_t i = 0;
+    for (auto it = records.begin(); it != records.end(); ++i) {
+        if (i % 4 != 0) {
+            index.Remove(it->first);
+            it = records.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    index.Sort();
+    BOOST_CHECK(index.Size() == 150);
+    BOOST_CHECK(index.Order().size() == 150);
+    check_order();
+
+    index.Clear();
+    BOOST_CHECK(index.Size() == 0);
+    BOOST_CHECK(index.NumOutputs() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(record_narrations)
+{
+    CHDWallet *pwallet = pwalletMain.get();
+    uint256 txhash = GetRandHash();
+
+    CTransactionRecord rtx;
+    for (int k = 0; k < 2; ++k) {
+        COutputRecord r;
+        r.n = k;
+        r.nValue = k + 1;
+        if (k == 1) {
+            r.SetNarration("test narration");
+        }
+        rtx.InsertOutput(r);
+    }
+    CHDWalletDB wdb(pwallet->GetDBHandle());
+    BOOST_CHECK(wdb.WriteTxRecord(txhash, rtx));
+
+    // Records are loaded without narrations, they are read from the database when requested
+    CTransactionRecord rtxLoaded;
+    BOOST_CHECK(wdb.ReadTxRecord(txhash, rtxLoaded));
+    BOOST_CHECK(rtxLoaded.GetOutput(1)->GetNarration() == "test narration");
+    rtxLoaded.UnloadNarrations();
+    BOOST_CHECK(rtxLoaded.fNarrationsUnloaded);
+    BOOST_CHECK(rtxLoaded.GetOutput(0)->GetNarration().empty());
+    BOOST_CHECK(rtxLoaded.GetOutput(1)->GetNarration().empty());
+    {
+        LOCK(pwallet->cs_wallet);
+        BOOST_CHECK(pwallet->GetOutputNarration(txhash, rtxLoaded, *rtxLoaded.GetOutput(0)).empty());
+        BOOST_CHECK(pwallet->GetOutputNarration(txhash, rtxLoaded, *rtxLoaded.GetOutput(1)) == "test narration");
+    }
+
+    // Writing the record back keeps the stored narrations
+    rtxLoaded.GetOutput(0)->nValue = 5;
+    BOOST_CHECK(wdb.WriteTxRecord(txhash, rtxLoaded));
+    CTransactionRecord rtxStored;
+    BOOST_CHECK(wdb.ReadTxRecord(txhash, rtxStored));
+    BOOST_CHECK(!rtxStored.fNarrationsUnloaded);
+    BOOST_CHECK(rtxStored.GetOutput(0)->nValue == 5);
+    BOOST_CHECK(rtxStored.GetOutput(1)->GetNarration() == "test narration");
+
+    // A narration set in memory replaces the stored one
+    rtxLoaded.GetOutput(0)->SetNarration("new narration");
+    BOOST_CHECK(wdb.WriteTxRecord(txhash, rtxLoaded));
+    BOOST_CHECK(wdb.ReadTxRecord(txhash, rtxStored));
+    BOOST_CHECK(rtxStored.GetOutput(0)->GetNarration() == "new narration");
+    BOOST_CHECK(rtxStored.GetOutput(1)->GetNarration() == "test narration");
+    BOOST_CHECK(wdb.EraseTxRecord(txhash));
+}
+
+BOOST_AUTO_TEST_CASE(input_bytes)
+{
+    CHDWallet *pwallet = pwalletMain.get();
+
+    // Every ring member adds its index and MLSAG columns
+    int nLastBytes = 0;
+    for (size_t nRingSize = MIN_RINGSIZE; nRingSize <= 32; ++nRingSize) {
+        int nBytes = GetAnonInputBytes(nRingSize, 1);
+        BOOST_CHECK(nBytes > nLastBytes);
+        nLastBytes = nBytes;
+    }
+    // Inputs signed by one MLSAG share its commitment column
+    BOOST_CHECK(GetAnonInputBytes(DEFAULT_RING_SIZE, 2) < GetAnonInputBytes(DEFAULT_RING_SIZE, 1));
+
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    AddKey(*pwallet, key);
+    CScript script = GetScriptForDestination(PKHash(key.GetPubKey()));
+    CCoinControl coinControl;
+    COutPoint prevout(GetRandHash(), 1);
+
+    int nBlindedBytes = GetBlindedInputBytes(*pwallet, &coinControl, prevout, script);
+    BOOST_CHECK(nBlindedBytes > 0);
+    BOOST_CHECK(GetAnonInputBytes(DEFAULT_RING_SIZE, 1) > nBlindedBytes);
+
+    // Inputs without a key can't be signed
+    BOOST_CHECK(GetBlindedInputBytes(*pwallet, &coinControl, prevout, GetScriptForDestination(PKHash(keyOther.GetPubKey()))) == -1);
+
+    // A witness passed through coin control is used in place of the dummy signatures
+    coinControl.m_inputData[prevout].scriptWitness.stack = {std::vector<uint8_t>(8)};
+    BOOST_CHECK(GetBlindedInputBytes(*pwallet, &coinControl, prevout, script) < nBlindedBytes);
+}
+
+BOOST_AUTO_TEST_CASE(select_blinded_coins_bnb)
+{
+    CHDWallet *pwallet = pwalletMain.get();
+    LOCK(pwallet->cs_wallet);
+
+    // An effective fee rate above the long term rate, so each extra input adds waste
+    CoinSelectionParams coin_selection_params;
+    coin_selection_params.effective_fee = CFeeRate(200000);
+    coin_selection_params.tx_noinputs_size = 100;
+    const int nInputBytes = GetAnonInputBytes(DEFAULT_RING_SIZE, 1);
+    const CAmount nInputFee = coin_selection_params.effective_fee.GetFee(nInputBytes);
+    const CAmount nNotInputFees = coin_selection_params.effective_fee.GetFee(coin_selection_params.tx_noinputs_size);
+
+    MapRecords_t records;
+    std::vector<COutputR> vCoins;
+    auto add_coin = [&](CAmount nValue) {
+        CTransactionRecord rtx;
+        COutputRecord r;
+        r.n = 0;
+        r.nType = OUTPUT_RINGCT;
+        r.nFlags = ORF_OWNED;
+        r.nValue = nValue;
+        rtx.InsertOutput(r);
+        uint256 txhash = GetRandHash();
+        MapRecords_t::const_iterator it = records.emplace(txhash, rtx).first;
+        vCoins.emplace_back(txhash, it, 0, 6, true, true, true, true, false);
+    };
+
+    // Two coins paying the target together and one paying it alone, net of the fees for their inputs
+    add_coin(CENT / 2 + nInputFee + nNotInputFees / 2);
+    add_coin(CENT / 2 + nInputFee + nNotInputFees / 2);
+    add_coin(CENT + nInputFee + nNotInputFees);
+    std::vector<int> vInputBytes(vCoins.size(), nInputBytes);
+
+    std::vector<std::pair<MapRecords_t::const_iterator, unsigned int> > setCoins;
+    CAmount nValueIn = 0;
+    BOOST_CHECK(pwallet->SelectBlindedCoinsBnB(vCoins, vInputBytes, CENT, coin_selection_params, setCoins, nValueIn));
+    BOOST_REQUIRE(setCoins.size() == 1);
+    BOOST_CHECK(setCoins[0].first->first == vCoins[2].txhash);
+    BOOST_CHECK(nValueIn == CENT + nInputFee + nNotInputFees);
+
+    // Unconfirmed coins are not selected
+    vCoins[2].nDepth = 0;
+    BOOST_CHECK(pwallet->SelectBlindedCoinsBnB(vCoins, vInputBytes, CENT, coin_selection_params, setCoins, nValueIn));
+    BOOST_CHECK(setCoins.size() == 2);
+    BOOST_CHECK(nValueIn == CENT + 2 * nInputFee + nNotInputFees);
+    vCoins[2].nDepth = 6;
+
+    // Coins that could not be sized are not selected
+    vInputBytes[2] = -1;
+    BOOST_CHECK(pwallet->SelectBlindedCoinsBnB(vCoins, vInputBytes, CENT, coin_selection_params, setCoins, nValueIn));
+    BOOST_CHECK(setCoins.size() == 2);
+    vInputBytes[2] = nInputBytes;
+
+    // No selection within the cost of change, which is 0 here
+    BOOST_CHECK(!pwallet->SelectBlindedCoinsBnB(vCoins, vInputBytes, CENT + 1, coin_selection_params, setCoins, nValueIn));
+    BOOST_CHECK(setCoins.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
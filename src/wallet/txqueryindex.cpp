@@ -0,0 +1,250 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/txqueryindex.h>
+
+#include <algorithm>
+
+bool TxQueryEntry::HasAddress(const std::string &search) const
+{
+    for (const auto &address : vAddresses) {
+        if (address.find(search) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+};
+
+bool TxQueryFilter::Matches(const TxQueryEntry &entry) const
+{
+    if (entry.nTime < nTimeFrom) {
+        return false;
+    }
+    if (!entry.fRecord && entry.nTime > nTimeTo) {
+        return false;
+    }
+    if (nCategory >= 0 && entry.nCategory != nCategory) {
+        return false;
+    }
+    if (nTypes && !(entry.nTypes & nTypes)) {
+        return false;
+    }
+    if (!sAddressSearch.empty() && !entry.HasAddress(sAddressSearch)) {
+        return false;
+    }
+    return true;
+};
+
+bool TxQueryCursor::Next(uint256 &hash, bool &fRecord)
+{
+    if (m_use_candidates) {
+        if (m_pos >= m_candidates.size()) {
+            return false;
+        }
+        hash = m_candidates[m_pos]->first;
+        fRecord = m_candidates[m_pos]->second.fRecord;
+        m_pos++;
+        return true;
+    }
+
+    if (m_filter.nSort == TXQ_SORT_TIME || m_filter.nSort == TXQ_SORT_AMOUNT) {
+        for (; m_it_order != m_end_order; ++m_it_order) {
+            if (m_filter.nSort == TXQ_SORT_TIME && m_it_order->first < m_filter.nTimeFrom) {
+                // All remaining entries are older
+                m_it_order = m_end_order;
+                return false;
+            }
+            auto it = m_index.m_entries.find(m_it_order->second);
+            if (it == m_index.m_entries.end() || !m_filter.Matches(it->second)) {
+                continue;
+            }
+            hash = it->first;
+            fRecord = it->second.fRecord;
+            ++m_it_order;
+            return true;
+        }
+        return false;
+    }
+
+    for (; m_it_txid != m_index.m_entries.end(); ++m_it_txid) {
+        if (!m_filter.Matches(m_it_txid->second)) {
+            continue;
+        }
+        hash = m_it_txid->first;
+        fRecord = m_it_txid->second.fRecord;
+        ++m_it_txid;
+        return true;
+    }
+    return false;
+};
+
+void TxQueryIndex::Clear()
+{
+    m_built = false;
+    m_stale.clear();
+    m_entries.clear();
+    m_by_time.clear();
+    for (auto &s : m_by_amount) {
+        s.clear();
+    }
+    for (auto &s : m_by_category) {
+        s.clear();
+    }
+    for (auto &s : m_by_type) {
+        s.clear();
+    }
+    m_by_address.clear();
+};
+
+void TxQueryIndex::Put(const uint256 &hash, TxQueryEntry entry)
+{
+    Remove(hash);
+
+    m_by_time.insert(std::make_pair(entry.nTime, hash));
+    for (size_t i = 0; i < 2; ++i) {
+        m_by_amount[i].insert(std::make_pair(entry.nSortAmount[i], hash));
+    }
+    if (entry.nCategory < TXQ_CATEGORIES) {
+        m_by_category[entry.nCategory].insert(hash);
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        if (entry.nTypes & (1 << i)) {
+            m_by_type[i].insert(hash);
+        }
+    }
+    for (const auto &address : entry.vAddresses) {
+        m_by_address[address].insert(hash);
+    }
+
+    m_entries.emplace(hash, std::move(entry));
+};
+
+void TxQueryIndex::Remove(const uint256 &hash)
+{
+    auto it = m_entries.find(hash);
+    if (it == m_entries.end()) {
+        return;
+    }
+    const TxQueryEntry &entry = it->second;
+
+    m_by_time.erase(std::make_pair(entry.nTime, hash));
+    for (size_t i = 0; i < 2; ++i) {
+        m_by_amount[i].erase(std::make_pair(entry.nSortAmount[i], hash));
+    }
+    if (entry.nCategory < TXQ_CATEGORIES) {
+        m_by_category[entry.nCategory].erase(hash);
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        m_by_type[i].erase(hash);
+    }
+    for (const auto &address : entry.vAddresses) {
+        auto mi = m_by_address.find(address);
+        if (mi == m_by_address.end()) {
+            continue;
+        }
+        mi->second.erase(hash);
+        if (mi->second.empty()) {
+            m_by_address.erase(mi);
+        }
+    }
+
+    m_entries.erase(it);
+};
+
+const TxQueryEntry *TxQueryIndex::Get(const uint256 &hash) const
+{
+    auto it = m_entries.find(hash);
+    return it == m_entries.end() ? nullptr : &it->second;
+};
+
+TxQueryCursor TxQueryIndex::Query(const TxQueryFilter &filter) const
+{
+    TxQueryCursor cursor(*this, filter);
+    size_t amount_index = filter.fWatchOnly ? 1 : 0;
+
+    // Find the smallest posting set the filter restricts the results to
+    const std::set<uint256> *posting = nullptr;
+    std::set<uint256> posting_union;
+    size_t nPosting = m_entries.size();
+    if (filter.nCategory >= 0 && filter.nCategory < TXQ_CATEGORIES
+        && m_by_category[filter.nCategory].size() < nPosting) {
+        posting = &m_by_category[filter.nCategory];
+        nPosting = posting->size();
+    }
+    if (filter.nTypes) {
+        size_t n = 0;
+        for (size_t i = 0; i < 3; ++i) {
+            if (filter.nTypes & (1 << i)) {
+                n += m_by_type[i].size();
+            }
+        }
+        if (n < nPosting) {
+            for (size_t i = 0; i < 3; ++i) {
+                if (filter.nTypes & (1 << i)) {
+                    posting_union.insert(m_by_type[i].begin(), m_by_type[i].end());
+                }
+            }
+            posting = &posting_union;
+            nPosting = posting->size();
+        }
+    }
+    if (!filter.sAddressSearch.empty()) {
+        std::set<uint256> matched;
+        for (const auto &mi : m_by_address) {
+            if (mi.first.find(filter.sAddressSearch) != std::string::npos) {
+                matched.insert(mi.second.begin(), mi.second.end());
+            }
+        }
+        if (matched.size() < nPosting) {
+            posting_union.swap(matched);
+            posting = &posting_union;
+            nPosting = posting->size();
+        }
+    }
+
+    // Reading and sorting the candidates pays off when they are a small part of the index,
+    // otherwise streaming the sort order can stop at the end of the page.
+    if (posting && (filter.nSort == TXQ_SORT_NONE || nPosting * 4 <= m_entries.size())) {
+        cursor.m_use_candidates = true;
+        for (const auto &hash : *posting) {
+            auto it = m_entries.find(hash);
+            if (it != m_entries.end() && filter.Matches(it->second)) {
+                cursor.m_candidates.push_back(it);
+            }
+        }
+        typedef TxQueryEntries::const_iterator EntryIt;
+        switch (filter.nSort) {
+            case TXQ_SORT_TIME:
+                std::sort(cursor.m_candidates.begin(), cursor.m_candidates.end(), [](const EntryIt &a, const EntryIt &b) {
+                    return std::make_pair(a->second.nTime, a->first) > std::make_pair(b->second.nTime, b->first);
+                });
+                break;
+            case TXQ_SORT_AMOUNT:
+                std::sort(cursor.m_candidates.begin(), cursor.m_candidates.end(), [amount_index](const EntryIt &a, const EntryIt &b) {
+                    return std::make_pair(a->second.nSortAmount[amount_index], a->first) > std::make_pair(b->second.nSortAmount[amount_index], b->first);
+                });
+                break;
+            case TXQ_SORT_TXID:
+                std::sort(cursor.m_candidates.begin(), cursor.m_candidates.end(), [](const EntryIt &a, const EntryIt &b) {
+                    return TxidHexCompare()(a->first, b->first);
+                });
+                break;
+            default:
+                break;
+        }
+        return cursor;
+    }
+
+    if (filter.nSort == TXQ_SORT_TIME) {
+        cursor.m_it_order = m_by_time.rbegin();
+        cursor.m_end_order = m_by_time.rend();
+    } else
+    if (filter.nSort == TXQ_SORT_AMOUNT) {
+        cursor.m_it_order = m_by_amount[amount_index].rbegin();
+        cursor.m_end_order = m_by_amount[amount_index].rend();
+    } else {
+        cursor.m_it_txid = m_entries.begin();
+    }
+    return cursor;
+};
@@ -0,0 +1,173 @@
+// Copyright (c) 2019 The Particl Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef PARTICL_WALLET_TXQUERYINDEX_H
+#define PARTICL_WALLET_TXQUERYINDEX_H
+
+#include <amount.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Category classes of wallet transactions, stake and coinbase are split further by depth when listed */
+enum TxQueryCategory : uint8_t
+{
+    TXQ_CAT_RECEIVE = 0,
+    TXQ_CAT_SEND,
+    TXQ_CAT_INTERNAL_TRANSFER,
+    TXQ_CAT_STAKE,              //! stake, orphaned_stake
+    TXQ_CAT_COINBASE,           //! coinbase, immature, orphan
+    TXQ_CAT_UNKNOWN,
+    TXQ_CATEGORIES,
+};
+
+enum TxQueryTypeFlags : uint8_t
+{
+    TXQ_TYPE_STANDARD       = (1 << 0),
+    TXQ_TYPE_BLIND          = (1 << 1),
+    TXQ_TYPE_ANON           = (1 << 2),
+};
+
+enum TxQuerySort
+{
+    TXQ_SORT_TIME = 0,          //! Most recent first
+    TXQ_SORT_AMOUNT,            //! Largest first
+    TXQ_SORT_TXID,              //! As the hex strings compare
+    TXQ_SORT_NONE,              //! Any order, the caller sorts the results
+};
+
+/** Orders txids as their hex strings compare */
+struct TxidHexCompare
+{
+    bool operator()(const uint256 &a, const uint256 &b) const
+    {
+        for (int i = 31; i >= 0; --i) {
+            if (a.begin()[i] != b.begin()[i]) {
+                return a.begin()[i] < b.begin()[i];
+            }
+        }
+        return false;
+    }
+};
+
+/** What filtertransactions needs to know about a wallet transaction before building its entry */
+class TxQueryEntry
+{
+public:
+    bool fRecord = false;
+    int64_t nTime = 0;          //! Listed time, records are filtered by their block time which is never later
+    uint8_t nCategory = TXQ_CAT_UNKNOWN;
+    uint8_t nTypes = 0;         //! TxQueryTypeFlags of the outputs and inputs
+    CAmount nSortAmount[2] = {0, 0}; //! Amount as sorted, sends negated, [1] including watch-only inputs and outputs
+    std::vector<std::string> vAddresses;
+
+    bool HasAddress(const std::string &search) const;
+};
+
+struct TxQueryFilter
+{
+    int64_t nTimeFrom = 0;
+    int64_t nTimeTo = std::numeric_limits<int64_t>::max();
+    int nCategory = -1;         //! TxQueryCategory, -1 for all
+    uint8_t nTypes = 0;         //! Entries must have one of the TxQueryTypeFlags, 0 for all
+    std::string sAddressSearch; //! Entries must have an address containing the string, empty for all
+    bool fWatchOnly = false;
+    TxQuerySort nSort = TXQ_SORT_TIME;
+
+    bool Matches(const TxQueryEntry &entry) const;
+};
+
+typedef std::map<uint256, TxQueryEntry, TxidHexCompare> TxQueryEntries;
+typedef std::set<std::pair<int64_t, uint256> > TxQueryOrder;
+
+class TxQueryIndex;
+
+/**
+ * Returns the txids of the entries matching a filter in the order of the filter's sort key.
+ * Ordered queries stream from the index, so a page costs only the entries read up to its end.
+ */
+class TxQueryCursor
+{
+public:
+    bool Next(uint256 &hash, bool &fRecord);
+
+private:
+    friend class TxQueryIndex;
+
+    TxQueryCursor(const TxQueryIndex &index, const TxQueryFilter &filter) : m_index(index), m_filter(filter) {};
+
+    const TxQueryIndex &m_index;
+    const TxQueryFilter m_filter;
+
+    bool m_use_candidates = false;
+    std::vector<TxQueryEntries::const_iterator> m_candidates;
+    size_t m_pos = 0;
+
+    TxQueryOrder::const_reverse_iterator m_it_order, m_end_order;
+    TxQueryEntries::const_iterator m_it_txid;
+};
+
+/**
+ * Secondary indexes over the wallet transactions and records by time, amount,
+ * category, output type and address.
+ *
+ * The index is built from the wallet on first use, after that transactions are
+ * marked stale as they change and are recomputed before the next query.
+ */
+class TxQueryIndex
+{
+public:
+    bool IsBuilt() const { return m_built; }
+    void SetBuilt() { m_built = true; }
+
+    //! Drop everything, the index is rebuilt on the next query
+    void Clear();
+
+    void MarkStale(const uint256 &hash)
+    {
+        if (m_built) {
+            m_stale.insert(hash);
+        }
+    }
+    std::set<uint256> TakeStale()
+    {
+        std::set<uint256> stale;
+        stale.swap(m_stale);
+        return stale;
+    }
+
+    void Put(const uint256 &hash, TxQueryEntry entry);
+    void Remove(const uint256 &hash);
+
+    size_t Size() const { return m_entries.size(); }
+    const TxQueryEntry *Get(const uint256 &hash) const;
+
+    /**
+     * Plan a query: when the category, type or address postings leave a small
+     * enough candidate set it is read and sorted, otherwise the index of the
+     * sort key is streamed and the filter applied to each entry.
+     */
+    TxQueryCursor Query(const TxQueryFilter &filter) const;
+
+private:
+    friend class TxQueryCursor;
+
+    bool m_built = false;
+    std::set<uint256> m_stale;
+
+    TxQueryEntries m_entries;
+    TxQueryOrder m_by_time;
+    TxQueryOrder m_by_amount[2];
+    std::set<uint256> m_by_category[TXQ_CATEGORIES];
+    std::set<uint256> m_by_type[3];
+    std::map<std::string, std::set<uint256> > m_by_address;
+};
+
+#endif // PARTICL_WALLET_TXQUERYINDEX_H
@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <deque>
 #include <future>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -705,6 +706,10 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 
 void CWallet::ChainStateFlushed(const CBlockLocator& loc)
 {
+    // A rescan in progress owns the best block, so an interruption resumes the rescan
+    if (m_rescan_best_block) {
+        return;
+    }
     WalletBatch batch(*database);
     batch.WriteBestBlock(loc);
 }
@@ -2196,6 +2201,94 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
         progress_end = chain().guessVerificationProgress(stop_block.IsNull() ? tip_hash : stop_block);
     }
     double progress_current = progress_begin;
+
+    // Blocks are read into a window without holding any lock, then the records found in the
+    // window are written in one database transaction with the chain and wallet locks held.
+    // The locks are released between windows, so cs_main is never held over block reads
+    // and the transaction is never open while another thread can write to the wallet.
+    // If the wallet was synced up to the start block each commit also writes the last scanned
+    // block as the best block, so an interrupted scan resumes from there on the next start.
+    // When rescanning for imported keys this rewinds the best block below the tip until the
+    // scan ends.
+    const Optional<int> start_height = block_height;
+    const unsigned int commit_blocks = gArgs.GetArg("-rescancommitblocks", DEFAULT_RESCAN_COMMIT_BLOCKS);
+    bool group_commit = commit_blocks > 0 && block_height;
+    Optional<int> synced_height;
+    CBlockLocator synced_locator;
+    if (group_commit) {
+        WalletBatch batch(*database);
+        if (batch.ReadBestBlock(synced_locator)) {
+            auto locked_chain = chain().lock();
+            synced_height = locked_chain->findLocatorFork(synced_locator);
+        }
+    }
+    const bool checkpoint = synced_height && *synced_height + 1 >= *start_height;
+    if (checkpoint) {
+        m_rescan_best_block = true;
+    }
+    struct WindowBlock {
+        uint256 hash;
+        int height;
+        size_t size;
+        CBlock block;
+    };
+    std::deque<WindowBlock> window;
+    size_t window_bytes = 0;
+    int64_t window_start = GetTimeMillis();
+    WalletBatch group_batch(*database, "r+", false);
+    // Returns false if a block in the window is no longer active
+    auto scan_window = [&]() {
+        while (!window.empty()) {
+            auto locked_chain = chain().lock();
+            LOCK(cs_wallet);
+            if (group_commit && !group_batch.TxnBeginGroup()) {
+                group_commit = false;
+            }
+            const unsigned int group_updates = database->nUpdateCounter;
+            const int64_t group_start = GetTimeMillis();
+            bool active = true;
+            do {
+                WindowBlock& scan = window.front();
+                if (!locked_chain->getBlockHeight(scan.hash)) {
+                    // Abort scan if current block is no longer active, to prevent
+                    // marking transactions as coming from the wrong block.
+                    // TODO: This should return success instead of failure, see
+                    // https://github.com/bitcoin/bitcoin/pull/14711#issuecomment-458342518
+                    result.last_failed_block = scan.hash;
+                    result.status = ScanResult::FAILURE;
+                    active = false;
+                    break;
+                }
+                for (size_t posInBlock = 0; posInBlock < scan.block.vtx.size(); ++posInBlock) {
+                    SyncTransaction(scan.block.vtx[posInBlock], CWalletTx::Status::CONFIRMED, scan.hash, posInBlock, fUpdate);
+                }
+                // scan succeeded, record block as most recent successfully scanned
+                result.last_scanned_block = scan.hash;
+                result.last_scanned_height = scan.height;
+                window_bytes -= scan.size;
+                window.pop_front();
+            } while (!window.empty() && group_commit
+                && database->nUpdateCounter - group_updates < RESCAN_COMMIT_MAX_WRITES
+                && GetTimeMillis() - group_start < RESCAN_COMMIT_INTERVAL_MS);
+            if (group_commit) {
+                if (checkpoint && result.last_failed_block.IsNull() && result.last_scanned_height
+                    && locked_chain->getBlockHeight(result.last_scanned_block) == result.last_scanned_height) {
+                    group_batch.WriteBestBlock(locked_chain->getLocator(*result.last_scanned_height));
+                }
+                if (!group_batch.TxnCommit()) {
+                    WalletLogPrintf("ScanForWalletTransactions: Committing the rescan records failed.\n");
+                }
+            }
+            if (!active) {
+                window.clear();
+                window_bytes = 0;
+                return false;
+            }
+        }
+        window_start = GetTimeMillis();
+        return true;
+    };
+
     while (block_height && !fAbortRescan && !chain().shutdownRequested()) {
         m_scanning_progress = (progress_current - progress_begin) / (progress_end - progress_begin);
         if (*block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
@@ -2208,28 +2301,23 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
 
         CBlock block;
         if (chain().findBlock(block_hash, &block) && !block.IsNull()) {
-            auto locked_chain = chain().lock();
-            LOCK(cs_wallet);
-            if (!locked_chain->getBlockHeight(block_hash)) {
-                // Abort scan if current block is no longer active, to prevent
-                // marking transactions as coming from the wrong block.
-                // TODO: This should return success instead of failure, see
-                // https://github.com/bitcoin/bitcoin/pull/14711#issuecomment-458342518
-                result.last_failed_block = block_hash;
-                result.status = ScanResult::FAILURE;
-                break;
-            }
-            for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                SyncTransaction(block.vtx[posInBlock], CWalletTx::Status::CONFIRMED, block_hash, posInBlock, fUpdate);
-            }
-            // scan succeeded, record block as most recent successfully scanned
-            result.last_scanned_block = block_hash;
-            result.last_scanned_height = *block_height;
+            size_t block_size = ::GetSerializeSize(block, PROTOCOL_VERSION);
+            window_bytes += block_size;
+            window.push_back({block_hash, *block_height, block_size, std::move(block)});
         } else {
             // could not scan block, keep scanning but record this block as the most recent failure
             result.last_failed_block = block_hash;
             result.status = ScanResult::FAILURE;
         }
+        if (!window.empty()
+            && (!group_commit
+                || window.size() >= commit_blocks
+                || window_bytes >= RESCAN_WINDOW_MAX_BYTES
+                || GetTimeMillis() - window_start >= RESCAN_COMMIT_INTERVAL_MS)) {
+            if (!scan_window()) {
+                break;
+            }
+        }
         if (block_hash == stop_block) {
             break;
         }
@@ -2255,6 +2343,19 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             }
         }
     }
+    scan_window();
+    if (checkpoint && !chain().shutdownRequested()) {
+        // Put back the best block the wallet was synced to if the scan stopped below it,
+        // it is left at the last commit on shutdown so the scan resumes on the next start
+        auto locked_chain = chain().lock();
+        LOCK(cs_wallet);
+        if (!result.last_failed_block.IsNull() || !result.last_scanned_height
+            || *result.last_scanned_height < *synced_height) {
+            WalletBatch batch(*database);
+            batch.WriteBestBlock(synced_locator);
+        }
+        m_rescan_best_block = false;
+    }
     ShowProgress(strprintf("%s " + _("Rescanning...").translated, GetDisplayName()), 100); // hide progress dialog in GUI
     if (block_height && fAbortRescan) {
         WalletLogPrintf("Rescan aborted at block %d. Progress=%f\n", *block_height, progress_current);
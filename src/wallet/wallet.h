@@ -87,6 +87,14 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -rescancommitblocks default, blocks scanned between commits of the wallet records a rescan writes
+static const unsigned int DEFAULT_RESCAN_COMMIT_BLOCKS = 1000;
+//! Maximum time a rescan reads blocks before writing their records, and holds the chain and wallet locks writing them
+static const int64_t RESCAN_COMMIT_INTERVAL_MS = 1000;
+//! Maximum size of the blocks a rescan reads before writing their records
+static const size_t RESCAN_WINDOW_MAX_BYTES = 32 * 1024 * 1024;
+//! Maximum writes in one rescan commit, the database lock table limits the size of a transaction
+static const unsigned int RESCAN_COMMIT_MAX_WRITES = 2000;
 //! -maxtxfee default
 constexpr CAmount DEFAULT_TRANSACTION_MAXFEE{COIN / 2};
 constexpr CAmount DEFAULT_TRANSACTION_MAXFEE_BTC{COIN / 10};
@@ -804,6 +812,8 @@ private:
     std::atomic<bool> fScanningWallet{false}; // controlled by WalletRescanReserver
     std::atomic<int64_t> m_scanning_start{0};
     std::atomic<double> m_scanning_progress{0};
+    //! Set while a rescan writes its progress as the best block, ChainStateFlushed leaves it alone
+    std::atomic<bool> m_rescan_best_block{false};
     std::mutex mutexScanning;
     friend class WalletRescanReserver;
 
@@ -828,7 +838,7 @@ private:
      */
     typedef std::multimap<COutPoint, uint256> TxSpends;
     TxSpends mapTxSpends GUARDED_BY(cs_wallet);
-    void AddToSpends(const COutPoint& outpoint, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    virtual void AddToSpends(const COutPoint& outpoint, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     virtual void AddToSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     /**
@@ -1143,7 +1153,7 @@ public:
 
     //! For ParticlWallet, clear cached balances from wallet called at new block and adding new transaction
     virtual void ClearCachedBalances() {};
-    void MarkDirty();
+    virtual void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     virtual void LoadToWallet(CWalletTx& wtxIn) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
@@ -817,6 +817,11 @@ bool WalletBatch::TxnBegin()
     return m_batch.TxnBegin();
 }
 
+bool WalletBatch::TxnBeginGroup()
+{
+    return m_batch.TxnBeginGroup();
+}
+
 bool WalletBatch::TxnCommit()
 {
     return m_batch.TxnCommit();
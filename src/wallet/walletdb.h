@@ -279,6 +279,8 @@ public:
     bool WriteWalletFlags(const uint64_t flags);
     //! Begin a new transaction
     bool TxnBegin();
+    //! Begin a transaction all batches on the database join until it is committed
+    bool TxnBeginGroup();
     //! Commit current transaction
     bool TxnCommit();
     //! Abort current transaction
@@ -5,6 +5,7 @@
 #include <zmq/zmqabstractnotifier.h>
 
 const int CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM;
+const int CZMQAbstractNotifier::DEFAULT_ZMQ_BACKLOG;
 
 CZMQAbstractNotifier::~CZMQAbstractNotifier()
 {
@@ -30,3 +31,8 @@ bool CZMQAbstractNotifier::NotifySecureMessage(const smsg::SecureMessage *psmsg,
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::FlushBacklog()
+{
+    return true;
+}
@@ -19,8 +19,9 @@ class CZMQAbstractNotifier
 {
 public:
     static const int DEFAULT_ZMQ_SNDHWM {1000};
+    static const int DEFAULT_ZMQ_BACKLOG {0};
 
-    CZMQAbstractNotifier() : psocket(nullptr), outbound_message_high_water_mark(DEFAULT_ZMQ_SNDHWM) { }
+    CZMQAbstractNotifier() : psocket(nullptr), outbound_message_high_water_mark(DEFAULT_ZMQ_SNDHWM), outbound_message_backlog(DEFAULT_ZMQ_BACKLOG) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -39,6 +40,14 @@ public:
             outbound_message_high_water_mark = sndhwm;
         }
     }
+    int GetOutboundMessageBacklog() const { return outbound_message_backlog; }
+    void SetOutboundMessageBacklog(const int backlog) {
+        if (backlog >= 0) {
+            outbound_message_backlog = backlog;
+        }
+    }
+    bool GetNoDropSocket() const { return nodrop_socket; }
+    void SetNoDropSocket(bool nodrop) { nodrop_socket = nodrop; }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
@@ -49,11 +58,16 @@ public:
     virtual bool NotifyTransaction(const std::string &sWalletName, const CTransaction &transaction);
     virtual bool NotifySecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash);
 
+    // Retry messages held back while subscribers were at the high water mark
+    virtual bool FlushBacklog();
+
 protected:
     void *psocket;
     std::string type;
     std::string address;
     int outbound_message_high_water_mark; // aka SNDHWM
+    int outbound_message_backlog; // messages held while subscribers are at the high water mark
+    bool nodrop_socket{false}; // publish through an XPUB socket reporting when subscribers are at the high water mark
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
@@ -119,6 +119,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
 
     factories["pubhashwtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashWalletTransactionNotifier>;
     factories["pubsmsg"] = CZMQAbstractNotifier::Create<CZMQPublishSMSGNotifier>;
+    factories["pubvalidationstats"] = CZMQAbstractNotifier::Create<CZMQPublishValidationStatsNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -131,14 +132,33 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
             notifier->SetType(entry.first);
             notifier->SetAddress(address);
             notifier->SetOutboundMessageHighWaterMark(static_cast<int>(gArgs.GetArg(arg + "hwm", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM)));
+            notifier->SetOutboundMessageBacklog(static_cast<int>(gArgs.GetArg(arg + "backlog", CZMQAbstractNotifier::DEFAULT_ZMQ_BACKLOG)));
             notifiers.push_back(notifier);
         }
     }
 
+    // A backlog needs a socket that reports subscribers at the high water mark,
+    // notifiers sharing an address share the socket.
+    for (const auto *notifier : notifiers)
+    {
+        if (notifier->GetOutboundMessageBacklog() < 1)
+            continue;
+        for (auto *other : notifiers)
+        {
+            if (other->GetAddress() == notifier->GetAddress())
+                other->SetNoDropSocket(true);
+        }
+    }
+
     if (!notifiers.empty())
     {
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
+        for (auto *notifier : notifiers)
+        {
+            if (notifier->GetOutboundMessageBacklog() > 0)
+                notificationInterface->vBacklogNotifiers.push_back(notifier);
+        }
 
         if (!notificationInterface->Initialize())
         {
@@ -244,6 +264,12 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
+void CZMQNotificationInterface::FlushBacklogs()
+{
+    for (auto *notifier : vBacklogNotifiers)
+        notifier->FlushBacklog();
+}
+
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
     if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
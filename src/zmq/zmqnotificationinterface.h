@@ -19,6 +19,9 @@ class SecureMessage;
 }
 class CZMQAbstractNotifier;
 
+//! Interval at which the scheduler retries backlogged messages
+static const int64_t ZMQ_BACKLOG_FLUSH_INTERVAL_MS = 100;
+
 class CZMQNotificationInterface final : public CValidationInterface
 {
 public:
@@ -28,6 +31,9 @@ public:
 
     static CZMQNotificationInterface* Create();
 
+    // Retry the messages notifiers hold back while subscribers are at the high water mark
+    void FlushBacklogs();
+
 protected:
     bool Initialize();
     void Shutdown();
@@ -46,6 +52,7 @@ private:
 
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    std::vector<CZMQAbstractNotifier*> vBacklogNotifiers; // set at creation, notifiers are removed from the list above on failure
 
     bool IsWhitelistedRange(const CNetAddr &addr);
     void ThreadZAP();
@@ -12,58 +12,103 @@
 #include <util/strencodings.h>
 #include <smsg/smessage.h>
 #include <compat/byteswap.h>
+#include <validationstats.h>
+#include <sync.h>
+
+#include <univalue.h>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
+// Sockets are shared by the notifiers publishing to an address and are sent to from the
+// notification callbacks and the scheduler, which drains the backlogs.
+static CCriticalSection cs_publish;
+
 static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
 static const char *MSG_HASHWTX   = "hashwtx";
 static const char *MSG_SMSG      = "smsg";
+static const char *MSG_VSTATS    = "validationstats";
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
+static void zmq_free_buffer(void *data, void *hint)
 {
-    va_list args;
-    va_start(args, size);
-
-    while (1)
-    {
-        zmq_msg_t msg;
-
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
-        {
-            zmqError("Unable to initialize ZMQ msg");
-            va_end(args);
-            return -1;
-        }
-
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
+    delete static_cast<ZMQBuffer*>(hint);
+}
 
-        data = va_arg(args, const void*);
+// Send a part following an accepted first part, blocking and retried if interrupted.
+// The high water mark is checked per message, once the first part is accepted the rest are too.
+// A part that can't be built is sent empty so the message is still terminated.
+static int zmq_send_next_part(void *sock, zmq_msg_t *msg, bool fInit, int flags)
+{
+    int err = 0;
+    if (!fInit) {
+        err = errno;
+        zmqError("Unable to initialize ZMQ msg");
+        zmq_msg_init(msg);
+    }
+    int rc;
+    while ((rc = zmq_msg_send(msg, sock, flags)) == -1 && errno == EINTR) {}
+    if (rc == -1) {
+        err = errno;
+        zmq_msg_close(msg);
+    }
+    errno = err;
+    return err == 0 ? 0 : -1;
+}
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1)
-        {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            va_end(args);
-            return -1;
-        }
+// Internal function to send a multipart message, the data part references the buffer instead of copying it.
+// Returns -1 with errno EAGAIN if a nodrop socket has a subscriber at the high water mark, nothing is sent then.
+// On any other error the message may have been partly sent and must not be sent again.
+static int zmq_send_multipart(void *sock, const char *command, const ZMQBuffer &data, uint32_t sequence)
+{
+    zmq_msg_t msg;
 
+    size_t size = strlen(command);
+    if (zmq_msg_init_size(&msg, size) != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
+    }
+    memcpy(zmq_msg_data(&msg), command, size);
+    if (zmq_msg_send(&msg, sock, ZMQ_SNDMORE | ZMQ_DONTWAIT) == -1) {
+        int err = errno;
         zmq_msg_close(&msg);
+        errno = err;
+        return -1;
+    }
 
-        if (!data)
-            break;
+    // Once the first part is accepted every part is sent even if an earlier one failed,
+    // a socket left holding a partial message would prepend it to the next message.
+    bool fInit;
+    if (data->empty()) {
+        fInit = zmq_msg_init_size(&msg, 0) == 0;
+    } else {
+        ZMQBuffer *hint = new ZMQBuffer(data);
+        fInit = zmq_msg_init_data(&msg, (void*)data->data(), data->size(), zmq_free_buffer, hint) == 0;
+        if (!fInit) {
+            delete hint;
+        }
+    }
+    int rv = zmq_send_next_part(sock, &msg, fInit, ZMQ_SNDMORE);
+    int err = errno;
 
-        size = va_arg(args, size_t);
+    /* LE 4byte sequence number */
+    fInit = zmq_msg_init_size(&msg, sizeof(uint32_t)) == 0;
+    if (fInit) {
+        WriteLE32((unsigned char*)zmq_msg_data(&msg), sequence);
+    }
+    if (zmq_send_next_part(sock, &msg, fInit, 0) == -1) {
+        if (rv == 0) {
+            err = errno;
+        }
+        rv = -1;
     }
 
-    va_end(args);
-    return 0;
+    if (rv == -1) {
+        // The message is not kept for a retry, even if a part reported EAGAIN
+        errno = err == EAGAIN ? EFSM : err;
+    }
+    return rv;
 }
 
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
@@ -75,12 +120,32 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
     if (i==mapPublishNotifiers.end())
     {
-        psocket = zmq_socket(pcontext, ZMQ_PUB);
+#ifndef ZMQ_XPUB_NODROP
+        if (nodrop_socket)
+        {
+            LogPrintf("zmq: Warning: ZMQ_XPUB_NODROP is not supported by this libzmq, messages over the high water mark at %s are dropped\n", address);
+            nodrop_socket = false;
+        }
+#endif
+        psocket = zmq_socket(pcontext, nodrop_socket ? ZMQ_XPUB : ZMQ_PUB);
         if (!psocket)
         {
             zmqError("Failed to create socket");
             return false;
         }
+#ifdef ZMQ_XPUB_NODROP
+        if (nodrop_socket)
+        {
+            LogPrint(BCLog::ZMQ, "zmq: Holding back messages over the high water mark at %s\n", address);
+            const int nodrop = 1;
+            if (zmq_setsockopt(psocket, ZMQ_XPUB_NODROP, &nodrop, sizeof(nodrop)) != 0)
+            {
+                zmqError("Failed to set ZMQ_XPUB_NODROP");
+                zmq_close(psocket);
+                return false;
+            }
+        }
+#endif
 
         std::string sServerKey64 = gArgs.GetArg("-serverkeyzmq", "");
         if (sServerKey64.length() > 1)
@@ -134,6 +199,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
         LogPrint(BCLog::ZMQ, "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, outbound_message_high_water_mark);
 
         psocket = i->second->psocket;
+        nodrop_socket = i->second->nodrop_socket;
         mapPublishNotifiers.insert(std::make_pair(address, this));
 
         return true;
@@ -144,6 +210,12 @@ void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    LOCK(cs_publish);
+    if (!m_backlog.empty()) {
+        LogPrint(BCLog::ZMQ, "zmq: Dropped %u backlogged %s messages at %s\n", m_backlog.size(), type, address);
+        m_backlog.clear();
+    }
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -171,18 +243,61 @@ void CZMQAbstractPublishNotifier::Shutdown()
 }
 
 bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    return SendMessage(command, std::make_shared<const std::vector<unsigned char> >(p, p + size));
+}
+
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, ZMQBuffer data)
 {
     assert(psocket);
 
-    /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
-    if (rc == -1)
-        return false;
+    LOCK(cs_publish);
+    /* the memory only sequence number counts notifications, messages dropped from the backlog leave a gap */
+    m_backlog.push_back(PendingMessage{command, std::move(data), nSequence++});
+
+    bool rv = SendBacklog();
+
+    if (m_backlog.size() > (size_t)outbound_message_backlog) {
+        size_t nDrop = m_backlog.size() - outbound_message_backlog;
+        LogPrint(BCLog::ZMQ, "zmq: Subscribers to %s at %s are at the high water mark, dropped %u messages\n", type, address, nDrop);
+        m_backlog.erase(m_backlog.begin(), m_backlog.begin() + nDrop);
+    }
+
+    return rv;
+}
+
+bool CZMQAbstractPublishNotifier::FlushBacklog()
+{
+    LOCK(cs_publish);
+    if (!psocket || m_backlog.empty()) {
+        return true;
+    }
+    return SendBacklog();
+}
+
+bool CZMQAbstractPublishNotifier::SendBacklog()
+{
+    AssertLockHeld(cs_publish);
+
+    if (nodrop_socket) {
+        // Discard subscription messages, the XPUB socket queues them for reading
+        char buf[256];
+        while (zmq_recv(psocket, buf, sizeof(buf), ZMQ_DONTWAIT) >= 0) {}
+    }
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
+    while (!m_backlog.empty()) {
+        const PendingMessage &msg = m_backlog.front();
+        if (zmq_send_multipart(psocket, msg.command, msg.data, msg.sequence) == -1) {
+            if (errno == EAGAIN) {
+                break;
+            }
+            zmqError("Unable to send ZMQ msg");
+            m_backlog.pop_front();
+            return false;
+        }
+        m_backlog.pop_front();
+    }
 
     return true;
 }
@@ -211,30 +326,40 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    const CChainParams& chainparams = Params();
+    std::shared_ptr<std::vector<unsigned char> > data = std::make_shared<std::vector<unsigned char> >();
+    if (RPCSerializationFlags() == 0)
+    {
+        // The block is stored as it is published, send the bytes read from disk
+        if (!ReadRawBlockFromDisk(*data, pindex, chainparams.MessageStart()))
+        {
+            zmqError("Can't read block from disk");
+            return false;
+        }
+    }
+    else
     {
-        LOCK(cs_main);
         CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
         {
             zmqError("Can't read block from disk");
             return false;
         }
-
-        ss << block;
+        data->reserve(GetSerializeSize(block, PROTOCOL_VERSION | RPCSerializationFlags()));
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(), *data, 0) << block;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, std::move(data));
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtx %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    std::shared_ptr<std::vector<unsigned char> > data = std::make_shared<std::vector<unsigned char> >();
+    data->reserve(GetSerializeSize(transaction, PROTOCOL_VERSION | RPCSerializationFlags()));
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(), *data, 0) << transaction;
+    return SendMessage(MSG_RAWTX, std::move(data));
 }
 
 bool CZMQPublishHashWalletTransactionNotifier::NotifyTransaction(const std::string &sWalletName, const CTransaction &transaction)
@@ -263,3 +388,14 @@ bool CZMQPublishSMSGNotifier::NotifySecureMessage(const smsg::SecureMessage *psm
     ss << hash;
     return SendMessage(MSG_SMSG, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishValidationStatsNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish validationstats %s\n", pindex->GetBlockHash().GetHex());
+    UniValue stats(UniValue::VOBJ);
+    stats.pushKV("hash", pindex->GetBlockHash().GetHex());
+    stats.pushKV("height", pindex->nHeight);
+    ValidationStatsToJSON(stats);
+    std::string json = stats.write();
+    return SendMessage(MSG_VSTATS, json.data(), json.size());
+}
@@ -7,12 +7,28 @@
 
 #include <zmq/zmqabstractnotifier.h>
 
+#include <deque>
+#include <memory>
+#include <vector>
+
 class CBlockIndex;
 
+typedef std::shared_ptr<const std::vector<unsigned char> > ZMQBuffer;
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
+    struct PendingMessage
+    {
+        const char *command;
+        ZMQBuffer data;
+        uint32_t sequence;
+    };
+
     uint32_t nSequence {0U}; //!< upcounting per message sequence number
+    std::deque<PendingMessage> m_backlog; //!< messages not yet accepted by a nodrop socket, oldest first
+
+    bool SendBacklog();
 
 public:
 
@@ -23,6 +39,10 @@ public:
           * message sequence number
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    /* as above, the data part references the buffer instead of copying it */
+    bool SendMessage(const char *command, ZMQBuffer data);
+
+    bool FlushBacklog() override;
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
@@ -64,5 +84,11 @@ public:
     bool NotifySecureMessage(const smsg::SecureMessage *psmsg, const uint160 &hash) override;
 };
 
+class CZMQPublishValidationStatsNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlock(const CBlockIndex *pindex) override;
+};
+
 
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
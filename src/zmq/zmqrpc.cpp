@@ -31,6 +31,7 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
             "    \"type\": \"pubhashtx\",   (string) Type of notification\n"
             "    \"address\": \"...\",      (string) Address of the publisher\n"
             "    \"hwm\": n                 (numeric) Outbound message high water mark\n"
+            "    \"backlog\": n             (numeric, optional) Messages held while subscribers are at the high water mark\n"
             "  },\n"
             "  ...\n"
             "]\n"
@@ -48,6 +49,9 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
             obj.pushKV("type", n->GetType());
             obj.pushKV("address", n->GetAddress());
             obj.pushKV("hwm", n->GetOutboundMessageHighWaterMark());
+            if (n->GetOutboundMessageBacklog() > 0) {
+                obj.pushKV("backlog", n->GetOutboundMessageBacklog());
+            }
             result.push_back(obj);
         }
     }
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Particl Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_particl import ParticlTestFramework, connect_nodes_bi
+from test_framework.messages import CBlockHeader, msg_generic, msg_headers
+from test_framework.mininode import P2PInterface
+from test_framework.util import assert_equal, wait_until
+
+
+class BlockPrecheckTest(ParticlTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+        self.extra_args = [['-debug', '-noacceptnonstdtxn', '-reservebalance=10000000'] for i in range(self.num_nodes)]
+        self.extra_args[1].append('-blockprecheckthreads=2')
+        self.extra_args[2].append('-blockprecheckthreads=2')
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def setup_network(self, split=False):
+        self.add_nodes(self.num_nodes, extra_args=self.extra_args)
+        self.start_nodes()
+
+    def get_block_header(self, node, block_hash):
+        target_block = node.getblock(block_hash, 2)
+        block = CBlockHeader(is_part=True)
+        block.nTime = target_block['time']
+        block.hashPrevBlock = int(target_block['previousblockhash'], 16)
+        block.nVersion = target_block['version']
+        block.nBits = int(target_block['bits'], 16)
+        block.hashMerkleRoot = int(target_block['merkleroot'], 16)
+        block.hashWitnessMerkleRoot = int(target_block['witnessmerkleroot'], 16)
+        block.calc_sha256()
+        return block
+
+    def run_test(self):
+        nodes = self.nodes
+
+        nodes[0].extkeyimportmaster('abandon baby cabbage dad eager fabric gadget habit ice kangaroo lab absorb')
+        assert(nodes[0].getwalletinfo()['total_balance'] == 100000)
+        self.stakeBlocks(10, fSync=False)
+        best_hash = nodes[0].getbestblockhash()
+        block_hashes = [nodes[0].getblockhash(i) for i in range(1, 11)]
+
+        self.log.info('Send blocks in reverse order to a node in initial block download')
+        assert(nodes[1].getblockchaininfo()['initialblockdownload'])
+        conn = nodes[1].add_p2p_connection(P2PInterface())
+        conn.send_message(msg_headers([self.get_block_header(nodes[0], h) for h in block_hashes]))
+        conn.sync_with_ping()
+        assert_equal(nodes[1].getblockchaininfo()['headers'], 10)
+
+        # Every block but the first arrives before its parent is connected and is checked on the precheck threads
+        for h in reversed(block_hashes):
+            conn.send_message(msg_generic(b'block', bytes.fromhex(nodes[0].getblock(h, 0))))
+        conn.sync_with_ping()
+        wait_until(lambda: nodes[1].getbestblockhash() == best_hash, timeout=60)
+        assert_equal(nodes[1].getblockcount(), 10)
+        assert_equal(nodes[1].gettxoutsetinfo()['hash_serialized_2'], nodes[0].gettxoutsetinfo()['hash_serialized_2'])
+        nodes[1].disconnect_p2ps()
+
+        self.log.info('Sync from a peer')
+        connect_nodes_bi(self.nodes, 0, 2)
+        self.sync_all([nodes[0], nodes[2]])
+        assert_equal(nodes[2].getbestblockhash(), best_hash)
+
+        # Blocks checked on the precheck threads are connected as usual after the node leaves initial block download
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.stakeBlocks(2)
+        assert_equal(nodes[1].getbestblockhash(), nodes[0].getbestblockhash())
+        assert_equal(nodes[2].getbestblockhash(), nodes[0].getbestblockhash())
+
+
+if __name__ == '__main__':
+    BlockPrecheckTest().main()
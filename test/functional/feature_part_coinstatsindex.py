@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Particl Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_particl import ParticlTestFramework, connect_nodes_bi
+from test_framework.util import assert_equal, assert_raises_rpc_error, wait_until
+
+
+class CoinStatsIndexTest(ParticlTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [
+            ['-debug', ],
+            ['-debug', '-coinstatsindex'], ]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def setup_network(self):
+        self.add_nodes(self.num_nodes, extra_args=self.extra_args)
+        self.start_nodes()
+
+        connect_nodes_bi(self.nodes, 0, 1)
+
+        self.sync_all()
+
+    def wait_for_index(self, node):
+        tip = node.getbestblockhash()
+        wait_until(lambda: node.gettxoutsetinfo('muhash', tip)['bestblock'] == tip)
+
+    def run_test(self):
+        nodes = self.nodes
+
+        for i in range(len(nodes)):
+            nodes[i].reservebalance(True, 10000000)  # Stop staking
+
+        nodes[0].extkeyimportmaster('abandon baby cabbage dad eager fabric gadget habit ice kangaroo lab absorb')
+        assert(nodes[0].getwalletinfo()['total_balance'] == 100000)
+
+        assert(nodes[0].getindexinfo()['coinstatsindex'] is False)
+        assert(nodes[1].getindexinfo()['coinstatsindex'] is True)
+
+        addr_plain = nodes[1].getnewaddress()
+        addr_stealth = nodes[1].getnewstealthaddress()
+        nodes[0].sendtoaddress(addr_plain, 10)
+        nodes[0].sendtypeto('part', 'blind', [{'address': addr_stealth, 'amount': 2}])
+        self.stakeBlocks(1)
+        self.stakeBlocks(1)
+
+        self.log.info('Compare index against a scan of the chainstate')
+        self.wait_for_index(nodes[1])
+        ro_scan = nodes[0].gettxoutsetinfo('muhash')
+        ro_index = nodes[1].gettxoutsetinfo('muhash')
+        ro_noindex = nodes[1].gettxoutsetinfo('muhash', None, False)
+        for ro in (ro_index, ro_noindex):
+            assert_equal(ro['height'], ro_scan['height'])
+            assert_equal(ro['muhash'], ro_scan['muhash'])
+            assert_equal(ro['txouts'], ro_scan['txouts'])
+            assert_equal(ro['txouts_blinded'], ro_scan['txouts_blinded'])
+            assert_equal(ro['total_amount'], ro_scan['total_amount'])
+        assert('transactions' not in ro_index)
+        assert('total_unspendable_amount' in ro_index)
+
+        # The default hash type is the one the index can serve
+        ro = nodes[1].gettxoutsetinfo()
+        assert_equal(ro['muhash'], ro_index['muhash'])
+        assert('hash_serialized_2' not in ro and 'transactions' not in ro)
+        assert('hash_serialized_2' in nodes[0].gettxoutsetinfo())
+        assert('hash_serialized_2' in nodes[1].gettxoutsetinfo(None, None, False))
+
+        by_script_index = nodes[1].gettxoutsetinfobyscript()
+        by_script_scan = nodes[0].gettxoutsetinfobyscript()
+        assert_equal(by_script_index, by_script_scan)
+        assert(by_script_index['paytopubkeyhash']['num_plain'] > 0)
+
+        self.log.info('Look up stats at an earlier height')
+        ro_h1 = nodes[1].gettxoutsetinfo('muhash', 1)
+        assert_equal(ro_h1['height'], 1)
+        assert(ro_h1['muhash'] != ro_index['muhash'])
+        assert_raises_rpc_error(-8, 'Querying specific block heights requires coinstatsindex', nodes[0].gettxoutsetinfo, 'muhash', 1)
+        assert_raises_rpc_error(-8, 'hash_serialized_2 hash type cannot be queried for a specific block', nodes[1].gettxoutsetinfo, 'hash_serialized_2', 1)
+
+        self.log.info('Check the index follows a reorg')
+        tip = nodes[1].getbestblockhash()
+        nodes[1].invalidateblock(tip)
+        prev = nodes[1].getbestblockhash()
+        wait_until(lambda: nodes[1].gettxoutsetinfo('muhash')['bestblock'] == prev)
+        assert_equal(nodes[1].gettxoutsetinfo('muhash')['muhash'], nodes[1].gettxoutsetinfo('muhash', None, False)['muhash'])
+        nodes[1].reconsiderblock(tip)
+        self.wait_for_index(nodes[1])
+        assert_equal(nodes[1].gettxoutsetinfo('muhash')['muhash'], ro_index['muhash'])
+
+        self.log.info('Restart the node with the index')
+        self.restart_node(1, self.extra_args[1])
+        self.wait_for_index(nodes[1])
+        assert_equal(nodes[1].gettxoutsetinfo('muhash')['muhash'], ro_index['muhash'])
+
+
+if __name__ == '__main__':
+    CoinStatsIndexTest().main()
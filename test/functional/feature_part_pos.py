@@ -120,6 +120,9 @@ class PosTest(ParticlTestFramework):
         assert(nodes[2].getstakinginfo()['weight'] == 400000000000)
 
         self.stakeBlocks(1, nStakeNode=2)
+        ro = nodes[2].getstakinginfo()['searchstats']
+        assert(ro['searches'] > 0)
+        assert(ro['maxlatency'] >= ro['avglatency'])
 
         self.log.info('Test rewardaddress')
         addrRewardExt = nodes[0].getnewextaddress()
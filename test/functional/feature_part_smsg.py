@@ -129,6 +129,74 @@ class SmsgTest(ParticlTestFramework):
         assert(len(ro['messages']) == 1)
         assert(ro['messages'][0]['text'] == 'Test 1->0 no network')
 
+        self.log.info('Test inbox index')
+        ro = nodes[0].smsginbox('count')
+        assert(ro['total'] == 4)
+        assert(ro['unread'] == 0)
+        assert(len(ro['addresses']) == 1)
+        assert(ro['addresses'][0]['address'] == address0)
+        ro = nodes[0].smsginbox('count', '', {'address': address1})
+        assert(ro['total'] == 0)
+
+        ro = nodes[0].smsginbox('all')
+        assert(len(ro['messages']) == 4)
+        all_msgids = [m['msgid'] for m in ro['messages']]
+        ro = nodes[0].smsginbox('all', '', {'offset': 1, 'limit': 2})
+        assert([m['msgid'] for m in ro['messages']] == all_msgids[1:3])
+        ro = nodes[0].smsginbox('all', 'Test 1->0', {'offset': 1, 'address': address0})
+        assert(len(ro['messages']) == 2)
+
+        nodes[0].smsg(msg0_id, {'setread': False})
+        assert(nodes[0].smsginbox('count')['unread'] == 1)
+        # Read and unread messages of an address are merged in order of time received
+        ro = nodes[0].smsginbox('all', '', {'address': address0, 'updatestatus': False})
+        assert([m['msgid'] for m in ro['messages']] == all_msgids)
+        ro = nodes[0].smsginbox('all', '', {'after': all_msgids[1], 'limit': 1, 'updatestatus': False})
+        assert([m['msgid'] for m in ro['messages']] == all_msgids[2:3])
+        ro = nodes[0].smsginbox('all', '', {'address': address0, 'after': all_msgids[0], 'updatestatus': False})
+        assert([m['msgid'] for m in ro['messages']] == all_msgids[1:])
+        try:
+            nodes[0].smsginbox('all', '', {'after': 'ff'})
+            assert(False), "smsginbox with bad after."
+        except JSONRPCException as e:
+            assert('after must be a 28 byte hex msgid' in e.error['message'])
+        ro = nodes[0].smsginbox('unread', '', {'updatestatus': False})
+        assert(len(ro['messages']) == 1)
+        assert(ro['messages'][0]['msgid'] == msg0_id)
+        ro = nodes[0].smsginbox()
+        assert(len(ro['messages']) == 1)
+        assert(nodes[0].smsginbox('count')['unread'] == 0)
+
+        # Messages are listed in order of time received, the sender sets the time sent
+        now = int(time.time())
+        sendoptions = {'submitmsg': False, 'savemsg': False}
+        nodes[1].setmocktime(now - 600)
+        msg_early = nodes[1].smsgsend(address1, address0, 'Test 1->0 sent early', False, 1, False, sendoptions)
+        nodes[1].setmocktime(now - 300)
+        msg_late = nodes[1].smsgsend(address1, address0, 'Test 1->0 sent late', False, 1, False, sendoptions)
+        nodes[1].setmocktime(0)
+        assert(msg_early['msgid'] < msg_late['msgid'])
+        nodes[0].setmocktime(now + 10)
+        nodes[0].smsgimport(msg_late['msg'])
+        nodes[0].setmocktime(now + 20)
+        nodes[0].smsgimport(msg_early['msg'])
+        nodes[0].setmocktime(0)
+        received_msgids = all_msgids + [msg_late['msgid'], msg_early['msgid']]
+        ro = nodes[0].smsginbox('all', '', {'address': address0, 'updatestatus': False})
+        assert([m['msgid'] for m in ro['messages']] == received_msgids)
+        ro = nodes[0].smsginbox('unread', '', {'updatestatus': False})
+        assert([m['msgid'] for m in ro['messages']] == received_msgids[-2:])
+        ro = nodes[0].smsginbox('all', '', {'after': msg_late['msgid']})
+        assert([m['msgid'] for m in ro['messages']] == [msg_early['msgid']])
+        ro = nodes[0].smsginbox('all', '', {'updatestatus': False})
+        assert([m['msgid'] for m in ro['messages']] == received_msgids)
+        assert(nodes[0].smsginbox('count')['unread'] == 1)
+        try:
+            nodes[0].smsginbox('all', '', {'after': msg_early['msgid'][:-2] + 'ff'})
+            assert(False), "smsginbox with unknown after."
+        except JSONRPCException as e:
+            assert('after message not found' in e.error['message'])
+
         sendoptions = {'submitmsg': False, 'savemsg': False}
         ro = nodes[1].smsgsend(address1, address0, 'Test 1->0 no network, no outbox', False, 1, False, sendoptions)
         assert(len(nodes[1].smsgoutbox()['messages']) == 4)  # No change
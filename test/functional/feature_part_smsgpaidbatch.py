@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Particl Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+import time
+
+from test_framework.test_particl import ParticlTestFramework
+from test_framework.util import assert_raises_rpc_error, connect_nodes, wait_until
+
+
+class SmsgPaidBatchTest(ParticlTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [ ['-debug','-noacceptnonstdtxn','-reservebalance=10000000'] for i in range(self.num_nodes) ]
+        self.extra_args[1] += ['-smsgfundbatchsize=4', '-smsgfundbatchdelay=600']
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def setup_network(self, split=False):
+        self.add_nodes(self.num_nodes, extra_args=self.extra_args)
+        self.start_nodes()
+        connect_nodes(self.nodes[0], 1)
+
+        self.sync_all()
+
+    def run_test(self):
+        nodes = self.nodes
+
+        nodes[0].extkeyimportmaster(nodes[0].mnemonic('new')['master'])
+        nodes[1].extkeyimportmaster('abandon baby cabbage dad eager fabric gadget habit ice kangaroo lab absorb')
+
+        address0 = nodes[0].getnewaddress()
+        address1 = nodes[1].getnewaddress()
+
+        ro = nodes[0].smsgaddlocaladdress(address0)
+        assert('Receiving messages enabled for address' in ro['result'])
+        ro = nodes[0].smsglocalkeys()
+        ro = nodes[1].smsgaddaddress(address0, ro['wallet_keys'][0]['public_key'])
+        assert(ro['result'] == 'Public key added to db.')
+
+        ro = nodes[1].smsggetinfo()
+        assert(ro['funding']['batch_default'] is False)
+        assert(ro['funding']['batch_size'] == 4)
+        assert(ro['funding']['queued'] == 0)
+
+        self.log.info('Test coin_control is rejected with fund_batch')
+        assert_raises_rpc_error(-8, 'Can\'t use coin_control with fund_batch',
+                                nodes[1].smsgsend, address1, address0, 'msg', True, 4, False, {'fund_batch': True}, {'changeaddress': address1})
+
+        self.log.info('Test queued messages are funded by one transaction')
+        sendoptions = {'fund_batch': True}
+        msgids = []
+        texts = ['batched message %d' % (i) for i in range(4)]
+        for i, text in enumerate(texts):
+            ro = nodes[1].smsgsend(address1, address0, text, True, 4, False, sendoptions)
+            assert(ro['result'] == 'Queued for funding.')
+            assert(ro['funding'] == 'queued')
+            assert('txid' not in ro)
+            msgids.append(ro['msgid'])
+            if i < len(texts) - 1:
+                ro = nodes[1].smsgoutbox('all', '', {'funding': True})
+                assert(len(ro['messages']) == i + 1)
+
+        funding_txid = None
+        for i in range(20):
+            ro = nodes[1].smsgoutbox()
+            txids = set([m['txid'] for m in ro['messages'] if 'txid' in m])
+            if len(txids) == 1 and len(ro['messages']) == 4 and all('txid' in m for m in ro['messages']):
+                funding_txid = txids.pop()
+                break
+            time.sleep(1)
+        assert(funding_txid is not None)
+        assert(nodes[1].smsggetinfo()['funding']['queued'] == 0)
+
+        fund_tx = nodes[1].getrawtransaction(funding_txid, True)
+        num_fund_outputs = 0
+        for out in fund_tx['vout']:
+            if out['type'] == 'data' and out['data_hex'].startswith('08'):
+                num_fund_outputs += 1
+        assert(num_fund_outputs == 2)
+
+        self.sync_all()
+        self.stakeBlocks(1, nStakeNode=1)
+        self.waitForSmsgExchange(4, 1, 0)
+
+        ro = nodes[0].smsginbox()
+        assert(len(ro['messages']) == 4)
+        for msg in ro['messages']:
+            assert(msg['text'] in texts)
+            assert(msg['msgid'] in msgids)
+
+        self.log.info('Test failed batches are retried with backoff and dropped')
+        ro = nodes[1].smsgsend(address1, address0, 'unfundable', True, 4, False, {'fund_batch': True, 'fund_from_rct': True})
+        assert(ro['result'] == 'Queued for funding.')
+        mocktime = int(time.time()) + 601
+        for attempt in range(1, 5):
+            nodes[1].setmocktime(mocktime)
+            wait_until(lambda: nodes[1].smsgoutbox('all', '', {'funding': True})['messages'][0]['funding_attempts'] == attempt)
+            assert('last_error' in nodes[1].smsggetinfo()['funding'])
+            mocktime += 3600
+        nodes[1].setmocktime(mocktime)
+        wait_until(lambda: nodes[1].smsggetinfo()['funding']['queued'] == 0)
+        assert('Dropped 1 messages' in nodes[1].smsggetinfo()['funding']['last_error'])
+        nodes[1].setmocktime(0)
+
+        # The outbox copy of a dropped message is marked as failed
+        ro = nodes[1].smsgoutbox('all', 'unfundable')
+        assert(len(ro['messages']) == 1)
+        assert(ro['messages'][0]['funding'] == 'failed')
+        assert('txid' not in ro['messages'][0])
+
+
+if __name__ == '__main__':
+    SmsgPaidBatchTest().main()
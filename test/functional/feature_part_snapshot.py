@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Particl Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+import os
+
+from test_framework.test_particl import ParticlTestFramework, connect_nodes_bi
+from test_framework.test_node import ErrorMatch
+from test_framework.util import assert_equal, assert_raises_rpc_error
+
+
+class SnapshotTest(ParticlTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+        self.extra_args = [['-debug', '-noacceptnonstdtxn', '-reservebalance=10000000'] for i in range(self.num_nodes)]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def setup_network(self, split=False):
+        self.add_nodes(self.num_nodes, extra_args=self.extra_args)
+        self.start_node(0)
+        self.start_node(1)
+
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.sync_all(self.nodes[:2])
+
+    def run_test(self):
+        nodes = self.nodes
+
+        nodes[0].extkeyimportmaster('abandon baby cabbage dad eager fabric gadget habit ice kangaroo lab absorb')
+        assert(nodes[0].getwalletinfo()['total_balance'] == 100000)
+        nodes[1].extkeyimportmaster('drip fog service village program equip minute dentist series hawk crop sphere olympic lazy garbage segment fox library good alley steak jazz force inmate')
+        sx_addr0 = nodes[0].getnewstealthaddress()
+        sx_addr1 = nodes[1].getnewstealthaddress()
+
+        for i in range(5):
+            txid = nodes[0].sendparttoanon(sx_addr1, 10)
+        nodes[0].sendparttoblind(sx_addr0, 100)
+        assert(self.wait_for_mempool(nodes[1], txid))
+        self.stakeBlocks(2, fSync=False)
+        self.sync_all(self.nodes[:2])
+
+        # Spend an anon output so the snapshot includes a key image
+        txid = nodes[1].sendanontoanon(sx_addr0, 1, '', '', False, '', 3)
+        assert(self.wait_for_mempool(nodes[0], txid))
+        self.stakeBlocks(1, fSync=False)
+        self.sync_all(self.nodes[:2])
+
+        self.log.info('Dump the chainstate')
+        snapshot_path = os.path.join(nodes[0].datadir, 'snapshot.dat')
+        ro = nodes[0].dumptxoutset('snapshot.dat')
+        assert_equal(ro['path'], snapshot_path)
+        assert_equal(ro['base_height'], 3)
+        assert_equal(ro['base_hash'], nodes[0].getbestblockhash())
+        assert_equal(ro['anon_outputs_written'], nodes[0].anonoutput()['lastindex'])
+        assert(ro['key_images_written'] > 0)
+        assert_raises_rpc_error(-8, 'already exists', nodes[0].dumptxoutset, 'snapshot.dat')
+
+        self.log.info('Load the snapshot into an empty datadir')
+        # Indexes synced from genesis need the blocks below the snapshot
+        self.nodes[2].assert_start_raises_init_error(self.extra_args[2] + ['-loadsnapshot=' + snapshot_path, '-txindex'], '-loadsnapshot is incompatible with -txindex', match=ErrorMatch.PARTIAL_REGEX)
+        self.start_node(2, self.extra_args[2] + ['-loadsnapshot=' + snapshot_path])
+        assert_equal(nodes[2].getbestblockhash(), nodes[0].getbestblockhash())
+        assert_raises_rpc_error(-1, 'Block not available (pruned data)', nodes[2].getblock, nodes[0].getblockhash(1))
+        assert_equal(int(nodes[2].getnetworkinfo()['localservices'], 16) & 1, 0)  # NODE_NETWORK
+
+        # The loaded datadir is marked as pruned, a restart without -prune must not ask for a reindex
+        self.restart_node(2, self.extra_args[2])
+        assert_equal(nodes[2].getbestblockhash(), nodes[0].getbestblockhash())
+        assert_equal(int(nodes[2].getnetworkinfo()['localservices'], 16) & 1, 0)
+
+        utxo0 = nodes[0].gettxoutsetinfo('muhash')
+        utxo2 = nodes[2].gettxoutsetinfo('muhash')
+        for key in ['height', 'bestblock', 'txouts', 'txouts_blinded', 'txouts_anon', 'muhash', 'total_amount', 'money_supply']:
+            assert_equal(utxo0[key], utxo2[key])
+
+        last_index = nodes[0].anonoutput()['lastindex']
+        assert_equal(nodes[2].anonoutput()['lastindex'], last_index)
+        ao = nodes[0].anonoutput(str(last_index))
+        assert_equal(nodes[2].anonoutput(str(last_index)), ao)
+        assert_equal(nodes[2].anonoutput(ao['publickey']), ao)
+
+        self.log.info('Sync blocks past the snapshot')
+        connect_nodes_bi(self.nodes, 0, 2)
+        txid = nodes[1].sendanontoanon(sx_addr0, 1, '', '', False, '', 3)
+        assert(self.wait_for_mempool(nodes[0], txid))
+        self.stakeBlocks(1, fSync=False)
+        self.sync_all()
+        assert_equal(nodes[2].getblockcount(), 4)
+        assert_equal(nodes[2].gettxoutsetinfo('muhash')['muhash'], nodes[0].gettxoutsetinfo('muhash')['muhash'])
+
+        self.log.info('A snapshot is only loaded into an empty chainstate')
+        self.stop_node(2)
+        self.nodes[2].assert_start_raises_init_error(self.extra_args[2] + ['-loadsnapshot=' + snapshot_path], 'A snapshot can only be loaded into an empty chainstate', match=ErrorMatch.PARTIAL_REGEX)
+        self.nodes[2].assert_start_raises_init_error(self.extra_args[2] + ['-coinstatsindex'], 'the blocks below the loaded snapshot are missing', match=ErrorMatch.PARTIAL_REGEX)
+
+
+if __name__ == '__main__':
+    SnapshotTest().main()
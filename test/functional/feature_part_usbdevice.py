@@ -91,6 +91,19 @@ class USBDeviceTest(ParticlTestFramework):
         assert(n > -1)
         assert(ro['chains'][n]['path'] == "m/0h/444445h")
 
+        # Keys below the device account are derived by the wallet without asking the device
+        num_requests = nodes[1].getdeviceinfo()['public_key_requests']
+        ro = nodes[1].getdevicepublickey('0/1')
+        assert(ro['address'] == 'peWvjy33QptC2Gz3ww7jTTLPjC2QJmifBR')
+        assert(ro['path'] == "m/44'/1'/0'/0/1")
+        ro = nodes[1].getdevicexpub("m/44'/1'/0'", "")
+        assert(ro == 'pparszKXPyRegWYwPacdPduNPNEryRbZDCAiSyo8oZYSsbTjc6FLP4TCPEX58kAeCB6YW9cSdR6fsbpeWDBTgjbkYjXCoD9CNoFVefbkg3exzpQE')
+        assert(nodes[1].getdeviceinfo()['public_key_requests'] == num_requests)
+
+        # Hardened paths still go to the device
+        nodes[1].getdevicepublickey("0h")
+        assert(nodes[1].getdeviceinfo()['public_key_requests'] == num_requests + 1)
+
 
         addr1_0 = nodes[1].getnewaddress('lbl1_0')
         ro = nodes[1].filteraddresses()
@@ -145,8 +158,10 @@ class USBDeviceTest(ParticlTestFramework):
             rtx = nodes[1].getrawtransaction(vin['txid'], True)
             prev_out = rtx['vout'][vin['vout']]
             prevtxns.append({'txid': vin['txid'], 'vout': vin['vout'], 'scriptPubKey': prev_out['scriptPubKey']['hex'], 'amount': prev_out['value']})
+        num_requests = nodes[1].getdeviceinfo()['public_key_requests']
         ro = nodes[1].devicesignrawtransaction(hexFunded, prevtxns, ['0/0', '2/0'])
         assert(ro['complete'] == True)
+        assert(nodes[1].getdeviceinfo()['public_key_requests'] == num_requests)
 
         ro = nodes[1].listunspent()
         assert(ro[0]['ondevice'] == True)
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Particl Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_particl import ParticlTestFramework, connect_nodes_bi
+from test_framework.util import assert_equal
+
+
+class ValidationStatsTest(ParticlTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+        self.extra_args = [['-debug', '-noacceptnonstdtxn', '-reservebalance=10000000'] for i in range(self.num_nodes)]
+        self.extra_args[2] += ['-addressindex', '-spentindex', '-timestampindex']
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def setup_network(self, split=False):
+        self.add_nodes(self.num_nodes, extra_args=self.extra_args)
+        self.start_nodes()
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.sync_all(self.nodes[:2])
+
+    def run_test(self):
+        nodes = self.nodes
+
+        nodes[0].extkeyimportmaster('abandon baby cabbage dad eager fabric gadget habit ice kangaroo lab absorb')
+        nodes[1].extkeyimportmaster('drip fog service village program equip minute dentist series hawk crop sphere olympic lazy garbage segment fox library good alley steak jazz force inmate')
+        sx_addr0 = nodes[0].getnewstealthaddress()
+        sx_addr1 = nodes[1].getnewstealthaddress()
+
+        for i in range(5):
+            txid = nodes[0].sendparttoanon(sx_addr1, 10)
+        nodes[0].sendparttoblind(sx_addr0, 100)
+        assert(self.wait_for_mempool(nodes[1], txid))
+        self.stakeBlocks(2, fSync=False)
+        self.sync_all(self.nodes[:2])
+
+        txid = nodes[1].sendanontoanon(sx_addr0, 1, '', '', False, '', 3)
+        assert(self.wait_for_mempool(nodes[0], txid))
+        self.stakeBlocks(1, fSync=False)
+        self.sync_all(self.nodes[:2])
+
+        # Node 2 receives the transactions in blocks only
+        connect_nodes_bi(self.nodes, 0, 2)
+        self.sync_all()
+
+        self.log.info('Check the stages and counters')
+        for node in nodes:
+            ro = node.getvalidationstats()
+            stages = ro['stages']
+            counters = ro['counters']
+            assert_equal(counters['blocks_connected'], 3)
+            assert_equal(stages['connect_block']['count'], 3)
+            assert(stages['connect_block']['total_us'] >= stages['connect_block']['max_us'])
+            assert_equal(sum(b['count'] for b in stages['connect_block']['histogram']), 3)
+            # Checking the block template of a staked block is not counted
+            assert_equal(stages['sanity_checks']['count'], 3)
+            assert_equal(stages['verify_txins']['count'], 3)
+            assert(stages['rct_index_write']['count'] > 0)
+            assert(stages['smsg_fee_check']['count'] > 0)
+
+        for node in nodes[:2]:
+            ro = node.getvalidationstats()
+            # Proofs verified when the transactions entered the mempool are not verified again, or counted
+            assert_equal(ro['stages']['rangeproof_verify']['count'], 0)
+            assert_equal(ro['stages']['mlsag_verify']['count'], 0)
+            assert(ro['counters']['rangeproof_cache_hits'] > 0)
+            assert(ro['counters']['mlsag_cache_hits'] > 0)
+            assert_equal(ro['stages']['insight_index_write']['count'], 0)
+
+        ro = nodes[2].getvalidationstats()
+        assert(ro['stages']['rangeproof_verify']['count'] > 0)
+        assert(ro['stages']['mlsag_verify']['count'] > 0)
+        assert_equal(ro['counters']['rangeproof_cache_hits'], 0)
+        assert_equal(ro['counters']['mlsag_cache_hits'], 0)
+        # The timestamp, address and spent index writes are one sample per block
+        assert_equal(ro['stages']['insight_index_write']['count'], 3)
+
+        self.log.info('Test reset')
+        ro = nodes[0].getvalidationstats(True)
+        assert_equal(ro['counters']['blocks_connected'], 3)
+        ro = nodes[0].getvalidationstats()
+        assert_equal(ro['counters']['blocks_connected'], 0)
+        assert_equal(ro['stages']['connect_block']['count'], 0)
+        assert_equal(ro['stages']['connect_block']['histogram'], [])
+
+
+if __name__ == '__main__':
+    ValidationStatsTest().main()
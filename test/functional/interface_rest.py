@@ -246,6 +246,12 @@ class RESTTest (BitcoinTestFramework):
         # Check json format
         block_json_obj = self.test_rest_request("/block/{}".format(bb_hash))
         assert_equal(block_json_obj['hash'], bb_hash)
+
+        # JSON is streamed in chunks as it's written
+        response_json = self.test_rest_request("/block/{}".format(bb_hash), ret_type=RetType.OBJ)
+        assert_equal(response_json.getheader('transfer-encoding'), 'chunked')
+        assert_equal(response_json.getheader('content-length'), None)
+        assert_equal(json.loads(response_json.read().decode('utf-8'))['hash'], bb_hash)
         assert_equal(self.test_rest_request("/blockhashbyheight/{}".format(block_json_obj['height']))['blockhash'], bb_hash)
 
         # Check hex/bin format
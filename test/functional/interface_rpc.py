@@ -34,6 +34,36 @@ class RPCInterfaceTest(BitcoinTestFramework):
         assert_greater_than_or_equal(command['duration'], 0)
         assert_equal(info['logpath'], os.path.join(self.nodes[0].datadir, 'regtest', 'debug.log'))
 
+    def test_work_queues(self):
+        self.log.info("Testing work queues...")
+
+        self.nodes[0].getblockcount()
+        self.nodes[0].getblockhash(0)
+        queues = {q['name']: q for q in self.nodes[0].getrpcinfo()['work_queues']}
+        assert_equal(sorted(queues.keys()), ['fast', 'main'])
+        assert_equal(queues['main']['threads'], 4)
+        assert_equal(queues['fast']['threads'], 1)
+
+        fast = queues['fast']['methods']
+        assert 'getblockcount' in fast
+        assert 'getblockhash' not in fast
+        assert_greater_than_or_equal(fast['getblockcount']['calls'], 1)
+        assert_equal(fast['getrpcinfo']['running'], 1)
+
+        method = queues['main']['methods']['getblockhash']
+        assert_equal(method['limit'], 3)
+        assert_equal(method['rejected'], 0)
+        assert_equal(len(method['wait']), 10)
+        assert_equal(sum(method['duration']), method['calls'])
+
+        self.restart_node(0, extra_args=['-rpcfastthreads=0', '-rpcmethodlimit=getblockhash:1'])
+        self.nodes[0].getblockhash(0)
+        queues = self.nodes[0].getrpcinfo()['work_queues']
+        assert_equal(len(queues), 1)
+        assert_equal(queues[0]['methods']['getblockhash']['limit'], 1)
+        assert_equal(queues[0]['methods']['getrpcinfo']['running'], 1)
+        self.restart_node(0)
+
     def test_batch_request(self):
         self.log.info("Testing basic JSON-RPC batch request...")
 
@@ -68,6 +98,7 @@ class RPCInterfaceTest(BitcoinTestFramework):
 
     def run_test(self):
         self.test_getrpcinfo()
+        self.test_work_queues()
         self.test_batch_request()
         self.test_http_status_codes()
 
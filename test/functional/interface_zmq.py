@@ -101,6 +101,8 @@ class ZMQTest (BitcoinTestFramework):
             # Should receive the generated raw block.
             block = rawblock.receive()
             assert_equal(genhashes[x], hash256_reversed(block[:80]).hex())
+            # The raw block is published as stored
+            assert_equal(block.hex(), self.nodes[0].getblock(hash, 0))
 
         if self.is_wallet_compiled():
             self.log.info("Wait for tx from second node")
@@ -126,6 +128,25 @@ class ZMQTest (BitcoinTestFramework):
 
         assert_equal(self.nodes[1].getzmqnotifications(), [])
 
+        self.log.info("Test raw notifications with a backlog")
+        socket.close()
+        socket = self.ctx.socket(zmq.SUB)
+        socket.set(zmq.RCVTIMEO, 60000)
+        rawblock = ZMQSubscriber(socket, b"rawblock")
+        rawtx = ZMQSubscriber(socket, b"rawtx")
+        self.restart_node(0, ["-zmqpub%s=%s" % (sub.topic.decode(), address) for sub in [rawblock, rawtx]] + ["-zmqpubrawblockbacklog=100"])
+        socket.connect(address)
+        sleep(0.2)
+        genhashes = self.nodes[0].generatetoaddress(2, ADDRESS_BCRT1_UNSPENDABLE)
+        for x in range(2):
+            hex = rawtx.receive()
+            block = rawblock.receive()
+            assert_equal(genhashes[x], hash256_reversed(block[:80]).hex())
+        assert_equal(self.nodes[0].getzmqnotifications(), [
+            {"type": "pubrawblock", "address": address, "hwm": 1000, "backlog": 100},
+            {"type": "pubrawtx", "address": address, "hwm": 1000},
+        ])
+
     def test_reorg(self):
         import zmq
         address = 'tcp://127.0.0.1:28333'
@@ -335,6 +335,20 @@ class FilterTransactionsTest(ParticlTestFramework):
                         assert(t[sorting[0]] <= prev[sorting[0]])
                 prev = t
 
+        # pages read from the sorted indexes match the full listing
+        for sorting in ['time', 'amount', 'txid']:
+            ro = nodes[0].filtertransactions({ 'sort': sorting, 'count': 0 })
+            paged = []
+            for skip in range(0, len(ro), 3):
+                paged += nodes[0].filtertransactions({ 'sort': sorting, 'count': 3, 'skip': skip })
+            assert([t['txid'] for t in paged] == [t['txid'] for t in ro])
+
+        # address search answered from the address index
+        ro = nodes[0].filtertransactions({ 'search': targetAddress, 'count': 0 })
+        assert(len(ro) > 0)
+        for t in ro:
+            assert(any(o.get('address') == targetAddress for o in t['outputs']))
+
         # invalid sort
         try:
             ro = nodes[0].filtertransactions({ 'sort': 'invalid' })
@@ -230,6 +230,7 @@ PARTICL_SCRIPTS = [
     'rpc_part_mnemonic.py',
     'feature_part_smsg.py',
     'feature_part_smsgpaid.py',
+    'feature_part_smsgpaidbatch.py',
     'feature_part_smsgpaidfee.py',
     'wallet_part_multisig.py',
     'wallet_part_multiwallet.py',
@@ -256,6 +257,10 @@ INSIGHT_SCRIPTS = [
     'feature_ins_spentindex.py',
     'feature_ins_txindex.py',
     'feature_ins_csindex.py',
+    'feature_part_coinstatsindex.py',
+    'feature_part_snapshot.py',
+    'feature_part_blockprecheck.py',
+    'feature_part_validationstats.py',
 ]
 
 # Place EXTENDED_SCRIPTS first since it has the 3 longest running tests